@@ -1,7 +1,7 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-#pragma import_defines (VSG_TEXTURECOORD_0, VSG_TEXTURECOORD_1, VSG_TEXTURECOORD_2, VSG_TEXTURECOORD_3, VSG_BILLBOARD, VSG_INSTANCE_TRANSLATION, VSG_INSTANCE_ROTATION, VSG_INSTANCE_SCALE, VSG_DISPLACEMENT_MAP, VSG_SKINNING, VSG_POINT_SPRITE)
+#pragma import_defines (VSG_TEXTURECOORD_0, VSG_TEXTURECOORD_1, VSG_TEXTURECOORD_2, VSG_TEXTURECOORD_3, VSG_BILLBOARD, VSG_INSTANCE_TRANSLATION, VSG_INSTANCE_ROTATION, VSG_INSTANCE_SCALE, VSG_DISPLACEMENT_MAP, VSG_SKINNING, VSG_SKINNING_INSTANCED, VSG_POINT_SPRITE)
 
 #define VIEW_DESCRIPTOR_SET 0
 #define MATERIAL_DESCRIPTOR_SET 1
@@ -74,6 +74,11 @@ layout(set = MATERIAL_DESCRIPTOR_SET, binding = 12) readonly buffer JointMatrice
 {
 	mat4 matrices[];
 } joint;
+
+#ifdef VSG_SKINNING_INSTANCED
+// each instance has its own palette of joint matrices packed one after the other in the jointMatrices buffer
+layout(constant_id = 4) const uint vsg_JointsPerInstance = 1;
+#endif
 #endif
 
 layout(location = 0) out vec3 eyePos;
@@ -153,6 +158,19 @@ void main()
     normal.xyz = normalize(dx * vsg_Normal.x + dy * vsg_Normal.y + dz * vsg_Normal.z);
 #endif
 
+#if defined(VSG_SKINNING) && defined(VSG_SKINNING_INSTANCED)
+    // skin in model space so the per instance placement is applied to the posed vertex
+    uint jointBase = uint(gl_InstanceIndex) * vsg_JointsPerInstance;
+    mat4 skinMat =
+        vsg_JointWeights.x * joint.matrices[jointBase + vsg_JointIndices.x] +
+        vsg_JointWeights.y * joint.matrices[jointBase + vsg_JointIndices.y] +
+        vsg_JointWeights.z * joint.matrices[jointBase + vsg_JointIndices.z] +
+        vsg_JointWeights.w * joint.matrices[jointBase + vsg_JointIndices.w];
+
+    vertex = skinMat * vertex;
+    normal = skinMat * normal;
+#endif
+
 #ifdef VSG_INSTANCE_SCALE
     vertex.xyz = vertex.xyz * vsg_Scale;
 #endif
@@ -168,7 +186,7 @@ void main()
 
 #ifdef VSG_BILLBOARD
     mat4 mv = computeBillboadMatrix(pc.modelView * vec4(vsg_Translation_scaleDistance.xyz, 1.0), vsg_Translation_scaleDistance.w);
-#elif defined(VSG_SKINNING)
+#elif defined(VSG_SKINNING) && !defined(VSG_SKINNING_INSTANCED)
     // Calculate skinned matrix from weights and joint indices of the current vertex
     mat4 skinMat =
         vsg_JointWeights.x * joint.matrices[vsg_JointIndices.x] +
@@ -0,0 +1,127 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(binding = 0) uniform sampler3D atlas;
+layout(binding = 1) uniform usampler3D pageTable;
+layout(binding = 2) uniform sampler3D brickInfo;
+layout(binding = 3) uniform VolumeSettings
+{
+    vec4 volume; // xyz voxels along each axis of the volume
+    vec4 bricks; // xyz bricks along each axis, w voxels along each side of a brick
+    vec4 atlas;  // xyz texels along each axis of the atlas, w value below which bricks are empty
+} settings;
+
+layout(location = 0) in vec4 cameraPos;
+layout(location = 1) in vec4 vertexPos;
+layout(location = 2) in mat4 texgen;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec4 t0 = vertexPos;
+    vec4 te = cameraPos;
+    if( te.x>=0.0 && te.x<=1.0 &&
+        te.y>=0.0 && te.y<=1.0 &&
+        te.z>=0.0 && te.z<=1.0
+        )
+    { } else {
+        if (te.x<0.0){
+            float r = -te.x / (t0.x-te.x);
+            te = te + (t0-te)*r;
+        }
+        if (te.x>1.0){
+            float r = (1.0-te.x) / (t0.x-te.x);
+            te = te + (t0-te)*r;
+        }
+        if (te.y<0.0){
+            float r = -te.y / (t0.y-te.y);
+            te = te + (t0-te)*r;
+        }
+        if (te.y>1.0){
+            float r = (1.0-te.y) / (t0.y-te.y);
+            te = te + (t0-te)*r;
+        }
+        if (te.z<0.0){
+            float r = -te.z / (t0.z-te.z);
+            te = te + (t0-te)*r;
+        }
+        if (te.z>1.0){
+            float r = (1.0-te.z) / (t0.z-te.z);
+            te = te + (t0-te)*r;
+        }
+    }
+    t0 = t0 * texgen;
+    te = te * texgen;
+
+    const float min_iterations = 2.0;
+    const float max_iterations = 2048.0;
+
+    float TransparencyValue = 0.2;
+    float AlphaFuncValue = 0.1;
+    float SampleDensityValue = 0.005; // 0.5 / texture_sample_count
+
+    float num_iterations = ceil(length((te-t0).xyz)/SampleDensityValue);
+    if (num_iterations<min_iterations) num_iterations = min_iterations;
+    else if (num_iterations>max_iterations) num_iterations = max_iterations;
+
+    vec3 deltaTexCoord=(te-t0).xyz/(num_iterations-1.0);
+    vec3 texcoord = t0.xyz;
+
+    float brickSize = settings.bricks.w;
+    ivec3 maxBrick = ivec3(settings.bricks.xyz) - 1;
+    vec3 brickExtent = vec3(brickSize) / settings.volume.xyz;
+
+    vec4 fragColor = vec4(0.0, 0.0, 0.0, 0.0);
+    while(num_iterations>0.0)
+    {
+        vec3 voxel = texcoord * settings.volume.xyz;
+        ivec3 brick = clamp(ivec3(floor(voxel / brickSize)), ivec3(0), maxBrick);
+
+        vec4 info = texelFetch(brickInfo, brick, 0);
+        if (info.g <= settings.atlas.w)
+        {
+            // none of the brick's samples can pass the alpha test, so step straight to the first sample beyond it
+            vec3 brickMin = vec3(brick) * brickExtent;
+            vec3 exitPlane = brickMin + step(0.0, deltaTexCoord) * brickExtent;
+            vec3 exitSteps = abs(exitPlane - texcoord) / max(abs(deltaTexCoord), vec3(1e-10));
+            float steps = min(floor(min(exitSteps.x, min(exitSteps.y, exitSteps.z))) + 1.0, num_iterations);
+
+            texcoord += deltaTexCoord * steps;
+            num_iterations -= steps;
+            continue;
+        }
+
+        float alpha;
+        uvec4 page = texelFetch(pageTable, brick, 0);
+        if (page.w != 0u)
+        {
+            // bricks are stored with a one voxel apron either side
+            vec3 atlasCoord = vec3(page.xyz) * (brickSize + 2.0) + 1.0 + (voxel - vec3(brick) * brickSize);
+            alpha = texture(atlas, atlasCoord / settings.atlas.xyz).r;
+        }
+        else
+        {
+            // brick not paged in yet, so use its mean
+            alpha = texture(brickInfo, texcoord).b;
+        }
+
+        vec4 color = vec4(alpha, alpha, alpha, alpha * TransparencyValue);
+        float r = color.a;
+        if (r > AlphaFuncValue)
+        {
+            fragColor.rgb = mix(fragColor.rgb, color.rgb, r);
+            fragColor.a += r;
+        }
+
+        if (color.a > fragColor.a)
+        {
+            fragColor = color;
+        }
+
+        texcoord += deltaTexCoord;
+        --num_iterations;
+    }
+    if (fragColor.a>1.0) fragColor.a = 1.0;
+    if (fragColor.a<AlphaFuncValue) discard;
+    outColor = fragColor;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <functional>
+#include <ostream>
+
+/// DeferredSampler stands in for a TransformSampler or JointSampler in an Animation's samplers, recording the time the Animation asks for
+/// so the AnimationBatcher can evaluate all the samplers together once the AnimationManager has run.
+class DeferredSampler : public vsg::Inherit<vsg::AnimationSampler, DeferredSampler>
+{
+public:
+    explicit DeferredSampler(vsg::ref_ptr<vsg::AnimationSampler> in_sampler);
+
+    vsg::ref_ptr<vsg::AnimationSampler> sampler;
+    double time = 0.0;
+    bool pending = false;
+    uint32_t cursors[3] = {0, 0, 0}; // last keyframe segment used for positions, rotations and scales
+
+    void update(double in_time) override
+    {
+        time = in_time;
+        pending = true;
+    }
+
+    double maxTime() const override { return sampler->maxTime(); }
+};
+
+/// AnimationBatcher replaces the per sampler keyframe evaluation done by vsg::AnimationManager with a separate update stage.
+/// The keyframe segments of all the active TransformSamplers are gathered into structure of arrays batches that are interpolated
+/// laneSize channels at a time, with lerp for positions and scales and a polynomial slerp for rotations so the loops vectorize,
+/// with ranges of samplers spread across OperationThreads. The JointSamplers are then updated in parallel from the new joint transforms.
+class AnimationBatcher : public vsg::Inherit<vsg::Object, AnimationBatcher>
+{
+public:
+    explicit AnimationBatcher(vsg::ref_ptr<vsg::OperationThreads> in_operationThreads = {});
+
+    /// number of channels interpolated together
+    static constexpr uint32_t laneSize = 8;
+
+    vsg::ref_ptr<vsg::OperationThreads> operationThreads;
+    uint32_t samplersPerOperation = 256;
+
+    /// replace the TransformSamplers and JointSamplers of the animations with DeferredSamplers, call before the animations are played.
+    void assign(const vsg::Animations& animations);
+
+    /// evaluate the samplers the AnimationManager updated this frame, call after Viewer::update().
+    void update();
+
+    /// evaluate this frame's active TransformSamplers in [begin, end), used by the operations update() dispatches.
+    void sampleTransforms(size_t begin, size_t end);
+
+    void report(std::ostream& out) const;
+
+    // stats
+    uint64_t numFrames = 0;
+    uint64_t numChannels = 0;      // keyframe channels interpolated
+    uint64_t numJointUpdates = 0;
+    double transformTime = 0.0;    // milliseconds spent sampling TransformSamplers
+    double jointTime = 0.0;        // milliseconds spent updating JointSamplers
+
+protected:
+    void _dispatch(size_t count, const std::function<void(size_t, size_t)>& function);
+
+    std::vector<vsg::ref_ptr<DeferredSampler>> _transformSamplers;
+    std::vector<vsg::ref_ptr<DeferredSampler>> _jointSamplers;
+    std::vector<DeferredSampler*> _activeTransforms;
+    std::vector<DeferredSampler*> _activeJoints;
+    std::atomic_uint64_t _numChannels = 0;
+};
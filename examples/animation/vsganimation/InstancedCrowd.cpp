@@ -0,0 +1,382 @@
+#include "InstancedCrowd.h"
+
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // constant_id of vsg_JointsPerInstance in shaders/standard.vert, clear of the ids that the standard shaders' specialization constants use
+    constexpr uint32_t jointsPerInstanceConstantID = 4;
+
+    // find the StateGroups that bind a JointSampler's jointMatrices, along with the transform from them to the root of the model
+    class FindSkinnedMeshes : public vsg::Inherit<vsg::Visitor, FindSkinnedMeshes>
+    {
+    public:
+        explicit FindSkinnedMeshes(const vsg::Data* in_jointMatrices) :
+            jointMatrices(in_jointMatrices) {}
+
+        struct Mesh
+        {
+            vsg::ref_ptr<vsg::StateGroup> stateGroup;
+            vsg::dmat4 matrix;
+        };
+
+        const vsg::Data* jointMatrices;
+        std::vector<vsg::dmat4> matrixStack{vsg::dmat4()};
+        std::vector<Mesh> meshes;
+
+        static vsg::DescriptorBuffer* findJointMatrices(const vsg::DescriptorSet& descriptorSet, const vsg::Data* data)
+        {
+            for (auto& descriptor : descriptorSet.descriptors)
+            {
+                if (auto descriptorBuffer = descriptor.cast<vsg::DescriptorBuffer>())
+                {
+                    for (auto& bufferInfo : descriptorBuffer->bufferInfoList)
+                    {
+                        if (bufferInfo->data == data) return descriptorBuffer;
+                    }
+                }
+            }
+            return nullptr;
+        }
+
+        void apply(vsg::Node& node) override
+        {
+            node.traverse(*this);
+        }
+
+        void apply(vsg::Transform& transform) override
+        {
+            matrixStack.push_back(transform.transform(matrixStack.back()));
+            transform.traverse(*this);
+            matrixStack.pop_back();
+        }
+
+        void apply(vsg::StateGroup& stateGroup) override
+        {
+            for (auto& stateCommand : stateGroup.stateCommands)
+            {
+                auto bindDescriptorSet = stateCommand.cast<vsg::BindDescriptorSet>();
+                if (bindDescriptorSet && bindDescriptorSet->descriptorSet && findJointMatrices(*bindDescriptorSet->descriptorSet, jointMatrices))
+                {
+                    meshes.push_back(Mesh{vsg::ref_ptr<vsg::StateGroup>(&stateGroup), matrixStack.back()});
+                    return;
+                }
+            }
+            stateGroup.traverse(*this);
+        }
+    };
+} // namespace
+
+InstancedCrowd::InstancedCrowd(vsg::ref_ptr<vsg::OperationThreads> in_operationThreads) :
+    operationThreads(in_operationThreads)
+{
+}
+
+vsg::ref_ptr<vsg::Node> InstancedCrowd::create(const std::vector<vsg::ref_ptr<vsg::Node>>& in_sources, uint32_t numInstances, vsg::ref_ptr<const vsg::Options> options)
+{
+    sources = in_sources;
+    _jointSamplers.clear();
+
+    for (auto& source : sources)
+    {
+        vsg::FindAnimations findAnimations;
+        source->accept(findAnimations);
+
+        vsg::ref_ptr<vsg::JointSampler> jointSampler;
+        for (auto& animation : findAnimations.animations)
+        {
+            for (auto& sampler : animation->samplers)
+            {
+                if (auto js = sampler.cast<vsg::JointSampler>(); js && js->jointMatrices) jointSampler = js;
+            }
+            if (jointSampler) break;
+        }
+
+        if (jointSampler) _jointSamplers.push_back(jointSampler);
+    }
+
+    if (_jointSamplers.empty())
+    {
+        vsg::warn("InstancedCrowd::create() no JointSampler found in source models.");
+        return {};
+    }
+
+    // the instanced variant of the standard vertex shader, the built in shader sets don't have VSG_SKINNING_INSTANCED so take it from the data directory
+    auto standardVertexShader = vsg::read_cast<vsg::ShaderStage>("shaders/standard.vert", options);
+    if (!standardVertexShader || !standardVertexShader->module || standardVertexShader->module->source.empty())
+    {
+        vsg::warn("InstancedCrowd::create() could not read shaders/standard.vert.");
+        return {};
+    }
+
+    // take the instance attribute locations and formats from the ShaderSet the models are loaded with, pbr and phong share the standard vertex shader
+    vsg::ref_ptr<vsg::ShaderSet> shaderSet;
+    for (auto name : {"pbr", "phong"})
+    {
+        if (auto itr = options->shaderSets.find(name); itr != options->shaderSets.end())
+        {
+            shaderSet = itr->second;
+            break;
+        }
+    }
+    if (!shaderSet) shaderSet = vsg::createPhysicsBasedRenderingShaderSet(options);
+
+    const auto& translationAttribute = shaderSet->getAttributeBinding("vsg_Translation");
+    const auto& rotationAttribute = shaderSet->getAttributeBinding("vsg_Rotation");
+    if (translationAttribute.name.empty() || rotationAttribute.name.empty())
+    {
+        vsg::warn("InstancedCrowd::create() ShaderSet has no vsg_Translation and vsg_Rotation attribute bindings.");
+        return {};
+    }
+
+    auto& jointMatrices = _jointSamplers.front()->jointMatrices;
+    _jointsPerInstance = static_cast<uint32_t>(jointMatrices->size());
+    _numInstances = std::max(numInstances, 1u);
+
+    auto findSkinnedMeshes = FindSkinnedMeshes::create(jointMatrices.get());
+    sources.front()->accept(*findSkinnedMeshes);
+    if (findSkinnedMeshes->meshes.empty())
+    {
+        vsg::warn("InstancedCrowd::create() no skinned meshes found.");
+        return {};
+    }
+
+    // all the meshes share the palettes, so the transform above the first is used for all of them
+    auto& meshMatrix = findSkinnedMeshes->meshes.front().matrix;
+    _meshMatrix = vsg::mat4(meshMatrix);
+    _applyMeshMatrix = meshMatrix != vsg::dmat4();
+    for (auto& mesh : findSkinnedMeshes->meshes)
+    {
+        if (mesh.matrix != meshMatrix) vsg::warn("InstancedCrowd::create() skinned meshes have different transforms, using the transform of the first.");
+    }
+
+    _poses.resize(_jointSamplers.size() * _jointsPerInstance);
+
+    _palettes = vsg::mat4Array::create(_numInstances * _jointsPerInstance);
+    _palettes->properties.dataVariance = vsg::DYNAMIC_DATA;
+
+    // lay the characters out on a grid, with random headings
+    vsg::ComputeBounds computeBounds;
+    computeBounds.useNodeBounds = false;
+    sources.front()->accept(computeBounds);
+    auto modelBounds = computeBounds.bounds;
+
+    double spacing = std::max(modelBounds.max.x - modelBounds.min.x, modelBounds.max.y - modelBounds.min.y);
+    uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(_numInstances))));
+
+    auto translations = vsg::vec3Array::create(_numInstances);
+    auto rotations = vsg::quatArray::create(_numInstances);
+    for (uint32_t i = 0; i < _numInstances; ++i)
+    {
+        translations->at(i) = vsg::vec3(static_cast<float>(spacing * (i % columns)), static_cast<float>(spacing * (i / columns)), 0.0f);
+
+        double heading = 2.0 * vsg::PI * static_cast<double>(std::rand()) / static_cast<double>(RAND_MAX);
+        rotations->at(i) = vsg::quat(static_cast<float>(heading), vsg::vec3(0.0f, 0.0f, 1.0f));
+    }
+
+    double radius = vsg::length(vsg::dvec2(std::max(std::abs(modelBounds.min.x), std::abs(modelBounds.max.x)), std::max(std::abs(modelBounds.min.y), std::abs(modelBounds.max.y))));
+    bounds = vsg::dbox();
+    bounds.add(vsg::dvec3(-radius, -radius, modelBounds.min.z));
+    bounds.add(vsg::dvec3(spacing * (columns - 1) + radius, spacing * ((_numInstances - 1) / columns) + radius, modelBounds.max.z));
+
+    auto crowd = vsg::Group::create();
+    _numDraws = 0;
+
+    for (auto& mesh : findSkinnedMeshes->meshes)
+    {
+        auto& stateGroup = *mesh.stateGroup;
+
+        // find the pipeline, and the descriptor set that binds the joint matrices
+        vsg::ref_ptr<vsg::GraphicsPipeline> pipeline;
+        vsg::ref_ptr<vsg::VertexInputState> vertexInputState;
+        for (auto& stateCommand : stateGroup.stateCommands)
+        {
+            if (auto bindGraphicsPipeline = stateCommand.cast<vsg::BindGraphicsPipeline>())
+            {
+                pipeline = bindGraphicsPipeline->pipeline;
+                for (auto& pipelineState : pipeline->pipelineStates)
+                {
+                    if (auto vis = pipelineState.cast<vsg::VertexInputState>()) vertexInputState = vis;
+                }
+            }
+        }
+
+        if (!pipeline || !vertexInputState)
+        {
+            vsg::warn("InstancedCrowd::create() skinned mesh without a graphics pipeline, skipping.");
+            continue;
+        }
+
+        bool locationsFree = true;
+        for (auto& attribute : vertexInputState->vertexAttributeDescriptions)
+        {
+            if (attribute.location == translationAttribute.location || attribute.location == rotationAttribute.location) locationsFree = false;
+        }
+        if (!locationsFree)
+        {
+            vsg::warn("InstancedCrowd::create() skinned mesh already uses the instance attribute locations, skipping.");
+            continue;
+        }
+
+        auto crowdStateGroup = vsg::StateGroup::create();
+        std::vector<vsg::ref_ptr<vsg::VertexIndexDraw>> draws;
+        for (auto& child : stateGroup.children)
+        {
+            if (auto vid = child.cast<vsg::VertexIndexDraw>()) draws.push_back(vid);
+        }
+        if (draws.empty())
+        {
+            vsg::warn("InstancedCrowd::create() skinned mesh is not drawn with VertexIndexDraw, skipping.");
+            continue;
+        }
+
+        // the per instance translations and rotations go in the bindings following the mesh's vertex arrays
+        uint32_t translationBinding = draws.front()->firstBinding + static_cast<uint32_t>(draws.front()->arrays.size());
+        uint32_t rotationBinding = translationBinding + 1;
+
+        auto vertexBindings = vertexInputState->vertexBindingDescriptions;
+        auto vertexAttributes = vertexInputState->vertexAttributeDescriptions;
+        vertexBindings.push_back(VkVertexInputBindingDescription{translationBinding, sizeof(vsg::vec3), VK_VERTEX_INPUT_RATE_INSTANCE});
+        vertexAttributes.push_back(VkVertexInputAttributeDescription{translationAttribute.location, translationBinding, translationAttribute.format, 0});
+        vertexBindings.push_back(VkVertexInputBindingDescription{rotationBinding, sizeof(vsg::quat), VK_VERTEX_INPUT_RATE_INSTANCE});
+        vertexAttributes.push_back(VkVertexInputAttributeDescription{rotationAttribute.location, rotationBinding, rotationAttribute.format, 0});
+
+        vsg::GraphicsPipelineStates pipelineStates;
+        for (auto& pipelineState : pipeline->pipelineStates)
+        {
+            if (pipelineState == vertexInputState)
+                pipelineStates.push_back(vsg::VertexInputState::create(vertexBindings, vertexAttributes));
+            else
+                pipelineStates.push_back(pipelineState);
+        }
+
+        vsg::ShaderStages shaderStages;
+        for (auto& shaderStage : pipeline->stages)
+        {
+            if (shaderStage->stage != VK_SHADER_STAGE_VERTEX_BIT)
+            {
+                shaderStages.push_back(shaderStage);
+                continue;
+            }
+
+            // same defines as the original, so the descriptor set layouts and the outputs to the fragment shader are unchanged
+            auto hints = vsg::ShaderCompileSettings::create();
+            if (shaderStage->module && shaderStage->module->hints) hints->defines = shaderStage->module->hints->defines;
+            hints->defines.insert("VSG_SKINNING_INSTANCED");
+            hints->defines.insert("VSG_INSTANCE_TRANSLATION");
+            hints->defines.insert("VSG_INSTANCE_ROTATION");
+
+            auto vertexShader = vsg::ShaderStage::create(VK_SHADER_STAGE_VERTEX_BIT, "main", standardVertexShader->module->source, hints);
+            vertexShader->specializationConstants = shaderStage->specializationConstants;
+            vertexShader->specializationConstants[jointsPerInstanceConstantID] = vsg::uintValue::create(_jointsPerInstance);
+            shaderStages.push_back(vertexShader);
+        }
+
+        crowdStateGroup->add(vsg::BindGraphicsPipeline::create(vsg::GraphicsPipeline::create(pipeline->layout, shaderStages, pipelineStates, pipeline->subpass)));
+
+        for (auto& stateCommand : stateGroup.stateCommands)
+        {
+            if (stateCommand.cast<vsg::BindGraphicsPipeline>()) continue;
+
+            auto bindDescriptorSet = stateCommand.cast<vsg::BindDescriptorSet>();
+            auto jointMatricesDescriptor = bindDescriptorSet && bindDescriptorSet->descriptorSet ? FindSkinnedMeshes::findJointMatrices(*bindDescriptorSet->descriptorSet, jointMatrices.get()) : nullptr;
+            if (!jointMatricesDescriptor)
+            {
+                crowdStateGroup->add(stateCommand);
+                continue;
+            }
+
+            // share the material's descriptors, binding the crowd's palettes in place of the source's joint matrices
+            vsg::Descriptors descriptors;
+            for (auto& descriptor : bindDescriptorSet->descriptorSet->descriptors)
+            {
+                if (descriptor.get() == jointMatricesDescriptor)
+                    descriptors.push_back(vsg::DescriptorBuffer::create(_palettes, jointMatricesDescriptor->dstBinding, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER));
+                else
+                    descriptors.push_back(descriptor);
+            }
+
+            auto descriptorSet = vsg::DescriptorSet::create(bindDescriptorSet->descriptorSet->setLayout, descriptors);
+            crowdStateGroup->add(vsg::BindDescriptorSet::create(bindDescriptorSet->pipelineBindPoint, bindDescriptorSet->layout, bindDescriptorSet->firstSet, descriptorSet));
+        }
+
+        for (auto& draw : draws)
+        {
+            vsg::DataList arrays;
+            for (auto& bufferInfo : draw->arrays) arrays.push_back(bufferInfo->data);
+            arrays.push_back(translations);
+            arrays.push_back(rotations);
+
+            auto crowdDraw = vsg::VertexIndexDraw::create();
+            crowdDraw->firstBinding = draw->firstBinding;
+            crowdDraw->assignArrays(arrays);
+            crowdDraw->assignIndices(draw->indices->data);
+            crowdDraw->indexCount = draw->indexCount;
+            crowdDraw->firstIndex = draw->firstIndex;
+            crowdDraw->vertexOffset = draw->vertexOffset;
+            crowdDraw->instanceCount = _numInstances;
+            crowdStateGroup->addChild(crowdDraw);
+            ++_numDraws;
+        }
+
+        crowd->addChild(crowdStateGroup);
+    }
+
+    if (crowd->children.empty()) return {};
+
+    return crowd;
+}
+
+void InstancedCrowd::_dispatch(size_t count, const std::function<void(size_t, size_t)>& function)
+{
+    parallelFor(operationThreads, count, instancesPerOperation, function);
+}
+
+void InstancedCrowd::update()
+{
+    if (!_palettes) return;
+
+    auto startTime = vsg::clock::now();
+
+    // gather the poses, applying the mesh transform once per source rather than once per instance
+    for (size_t si = 0; si < _jointSamplers.size(); ++si)
+    {
+        auto& jointMatrices = *_jointSamplers[si]->jointMatrices;
+        auto pose = _poses.data() + si * _jointsPerInstance;
+        uint32_t count = std::min(_jointsPerInstance, static_cast<uint32_t>(jointMatrices.size()));
+        for (uint32_t j = 0; j < count; ++j)
+        {
+            pose[j] = _applyMeshMatrix ? _meshMatrix * jointMatrices[j] : jointMatrices[j];
+        }
+    }
+
+    // instances cycle through the poses, a crowd with its own animation state per character would write each instance's joint matrices here
+    size_t paletteSize = _jointsPerInstance * sizeof(vsg::mat4);
+    size_t numPoses = _jointSamplers.size();
+    _dispatch(_numInstances, [this, paletteSize, numPoses](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            std::memcpy(&_palettes->at(i * _jointsPerInstance), _poses.data() + (i % numPoses) * _jointsPerInstance, paletteSize);
+        }
+    });
+
+    // a single upload of all the palettes
+    _palettes->dirty();
+
+    packTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+    numBytesUploaded += _palettes->dataSize();
+    ++numFrames;
+}
+
+void InstancedCrowd::report(std::ostream& out) const
+{
+    out << "InstancedCrowd instances = " << _numInstances << ", joints per instance = " << _jointsPerInstance << ", poses = " << _jointSamplers.size() << ", draws = " << _numDraws
+        << ", palettes = " << (_palettes ? static_cast<double>(_palettes->dataSize()) / (1024.0 * 1024.0) : 0.0) << "MB" << std::endl;
+    if (numFrames == 0) return;
+
+    double frames = static_cast<double>(numFrames);
+    out << "    pack = " << (packTime / frames) << "ms/frame, upload = " << (static_cast<double>(numBytesUploaded) / (1024.0 * 1024.0 * frames)) << "MB/frame" << std::endl;
+}
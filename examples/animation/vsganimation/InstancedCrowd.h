@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <functional>
+#include <ostream>
+
+/// InstancedCrowd renders many copies of a skinned character with a single instanced draw per mesh rather than a subgraph, draw and joint upload per character.
+/// The skinned StateGroups of the first source model are cloned with their vertex shader compiled from shaders/standard.vert with VSG_SKINNING_INSTANCED,
+/// so each instance indexes its own palette of joint matrices in one large jointMatrices storage buffer, and is placed using the VSG_INSTANCE_TRANSLATION
+/// and VSG_INSTANCE_ROTATION per instance attributes. The palettes are packed from the JointSamplers of the source models each frame and the buffer is
+/// uploaded once. The source models are copies of the same character whose animations are played out of phase to give the crowd a spread of poses.
+class InstancedCrowd : public vsg::Inherit<vsg::Object, InstancedCrowd>
+{
+public:
+    explicit InstancedCrowd(vsg::ref_ptr<vsg::OperationThreads> in_operationThreads = {});
+
+    vsg::ref_ptr<vsg::OperationThreads> operationThreads;
+    uint32_t instancesPerOperation = 1024;
+
+    /// models that provide the poses, not rendered themselves, so their animations need to be found and played separately from the scene
+    std::vector<vsg::ref_ptr<vsg::Node>> sources;
+
+    /// bounds of the crowd, valid after create()
+    vsg::dbox bounds;
+
+    /// create the crowd subgraph with numInstances characters laid out on a grid, returns null if the first source has no skinned meshes.
+    vsg::ref_ptr<vsg::Node> create(const std::vector<vsg::ref_ptr<vsg::Node>>& in_sources, uint32_t numInstances, vsg::ref_ptr<const vsg::Options> options);
+
+    /// pack this frame's joint matrices into the palette buffer and mark it for upload, call after the animations have been updated.
+    void update();
+
+    void report(std::ostream& out) const;
+
+    // stats
+    uint64_t numFrames = 0;
+    uint64_t numBytesUploaded = 0;
+    double packTime = 0.0; // milliseconds spent packing the palettes
+
+protected:
+    void _dispatch(size_t count, const std::function<void(size_t, size_t)>& function);
+
+    std::vector<vsg::ref_ptr<vsg::JointSampler>> _jointSamplers; // one per source
+    vsg::mat4 _meshMatrix;                                       // transform from the skinned meshes to the source model's root
+    bool _applyMeshMatrix = false;
+    std::vector<vsg::mat4> _poses;                               // palettes of each source with the mesh matrix applied
+    vsg::ref_ptr<vsg::mat4Array> _palettes;
+    uint32_t _jointsPerInstance = 0;
+    uint32_t _numInstances = 0;
+    uint32_t _numDraws = 0;
+};
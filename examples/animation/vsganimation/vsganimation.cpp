@@ -8,6 +8,9 @@
 #    include <vsg/utils/TracyInstrumentation.h>
 #endif
 
+#include "AnimationBatcher.h"
+#include "InstancedCrowd.h"
+
 #include <iostream>
 
 class AnimationControl : public vsg::Inherit<vsg::Visitor, AnimationControl>
@@ -235,6 +238,35 @@ int main(int argc, char** argv)
     }
 
     auto numCopies = arguments.value<unsigned int>(1, "-n");
+
+    // crowd benchmark, load numCopies of the models with their animation speeds varied so they drift out of phase
+    bool crowd = arguments.read("--crowd", numCopies);
+
+    auto numAnimationThreads = arguments.value<uint32_t>(std::max(1u, std::thread::hardware_concurrency()), "--animation-threads");
+    vsg::ref_ptr<vsg::OperationThreads> animationThreads;
+    auto getAnimationThreads = [&]() {
+        if (!animationThreads && numAnimationThreads > 1) animationThreads = vsg::OperationThreads::create(numAnimationThreads - 1);
+        return animationThreads;
+    };
+
+    // evaluate the keyframes in batches across threads rather than sampler by sampler in AnimationManager
+    vsg::ref_ptr<AnimationBatcher> animationBatcher;
+    if (arguments.read({"--batch-animation", "--ba"}))
+    {
+        animationBatcher = AnimationBatcher::create(getAnimationThreads());
+        arguments.read("--samplers-per-operation", animationBatcher->samplersPerOperation);
+    }
+
+    // GPU skinned crowd benchmark, a single instanced draw of n characters posed from numCopies of the first model
+    vsg::ref_ptr<InstancedCrowd> instancedCrowd;
+    auto numCrowdInstances = arguments.value<uint32_t>(0, "--instanced-crowd");
+    if (numCrowdInstances > 0)
+    {
+        instancedCrowd = InstancedCrowd::create(getAnimationThreads());
+        arguments.read("--instances-per-operation", instancedCrowd->instancesPerOperation);
+        numCopies = arguments.value<unsigned int>(8, "--crowd-poses");
+        crowd = true;
+    }
     auto autoPlay = !arguments.read({"--no-auto-play", "--nop"});
     auto outputFilename = arguments.value<vsg::Path>("", "-o");
 
@@ -270,9 +302,10 @@ int main(int argc, char** argv)
     };
 
     std::list<ModelBound> models;
+    int numFilenames = instancedCrowd ? std::min(argc, 2) : argc;
     for (unsigned int ci = 0; ci < numCopies; ++ci)
     {
-        for (int i = 1; i < argc; ++i)
+        for (int i = 1; i < numFilenames; ++i)
         {
             vsg::Path filename = arguments[i];
             if (auto node = vsg::read_cast<vsg::Node>(filename, options))
@@ -299,6 +332,21 @@ int main(int argc, char** argv)
     }
     else
 #endif
+    if (instancedCrowd)
+    {
+        std::vector<vsg::ref_ptr<vsg::Node>> sources;
+        for (auto& model : models) sources.push_back(model.node);
+
+        auto crowdNode = instancedCrowd->create(sources, numCrowdInstances, options);
+        if (!crowdNode)
+        {
+            std::cout << "Unable to create instanced crowd, the model needs to be a skinned character." << std::endl;
+            return 1;
+        }
+
+        scene->addChild(crowdNode);
+    }
+    else
     {
         // find the largest model diameter so we can use it to set up layout
         double maxDiameter = 0.0;
@@ -340,6 +388,7 @@ int main(int argc, char** argv)
     }
 
     auto bounds = vsg::visit<vsg::ComputeBounds>(scene).bounds;
+    if (instancedCrowd) bounds.add(instancedCrowd->bounds);
     double viewingDistance = vsg::length(bounds.max - bounds.min) * 2.0;
 
     vsg::ref_ptr<vsg::LookAt> lookAt;
@@ -415,12 +464,20 @@ int main(int argc, char** argv)
     vsg::FindAnimations findAnimations;
     scene->accept(findAnimations);
 
+    // the crowd's poses come from source models outside the scene graph
+    if (instancedCrowd)
+    {
+        for (auto& source : instancedCrowd->sources) source->accept(findAnimations);
+    }
+
     auto animations = findAnimations.animations;
     auto animationGroups = findAnimations.animationGroups;
 
     std::cout << "Model contains " << animations.size() << " animations." << std::endl;
     for (auto& ag : animationGroups)
     {
+        if (crowd) break;
+
         std::cout << "AnimationGroup " << ag << std::endl;
         for (auto animation : ag->animations)
         {
@@ -428,6 +485,14 @@ int main(int argc, char** argv)
         }
     }
 
+    if (crowd)
+    {
+        for (auto& animation : animations)
+        {
+            animation->speed *= 0.75 + 0.5 * static_cast<double>(std::rand()) / static_cast<double>(RAND_MAX);
+        }
+    }
+
     // write out scene if required
     if (outputFilename)
     {
@@ -486,6 +551,8 @@ int main(int argc, char** argv)
     std::cout << "Compile time : " << std::chrono::duration<double, std::chrono::seconds::period>(vsg::clock::now() - before_compile).count() * 1000.0 << " ms" << std::endl;
     ;
 
+    if (animationBatcher) animationBatcher->assign(animations);
+
     // start first animation if available
     if (autoPlay && !animations.empty())
     {
@@ -510,6 +577,9 @@ int main(int argc, char** argv)
 
         viewer->update();
 
+        if (animationBatcher) animationBatcher->update();
+        if (instancedCrowd) instancedCrowd->update();
+
         updateTime += std::chrono::duration<double, std::chrono::seconds::period>(vsg::clock::now() - before).count();
 
         viewer->recordAndSubmit();
@@ -523,6 +593,8 @@ int main(int argc, char** argv)
     {
         std::cout << "Average frame rate = " << (numFramesCompleted / duration) << std::endl;
         std::cout << "Average update time = " << (updateTime / numFramesCompleted) * 1000.0 << " ms" << std::endl;
+        if (animationBatcher) animationBatcher->report(std::cout);
+        if (instancedCrowd) instancedCrowd->report(std::cout);
     }
 
     if (auto profiler = instrumentation.cast<vsg::Profiler>())
@@ -19,8 +19,11 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #    include <vsgXchange/all.h>
 #endif
 
+#include <algorithm>
 #include <chrono>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <thread>
 
 namespace vsg
@@ -388,6 +391,27 @@ std::pair<vsg::ref_ptr<vsg::Commands>, vsg::ref_ptr<vsg::Image>> createColorCapt
 
     commands->addChild(cmd_transitionFromTransferBarrier);
 
+    // 3.e) with several frames in flight the next frame's render pass mustn't write to the source image until the copy has read it
+    auto sourceImageReadBeforeWriteBarrier = vsg::ImageMemoryBarrier::create(
+        VK_ACCESS_TRANSFER_READ_BIT,                                   // srcAccessMask
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,                          // dstAccessMask
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,                          // oldLayout
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,                          // newLayout
+        VK_QUEUE_FAMILY_IGNORED,                                       // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                                       // dstQueueFamilyIndex
+        sourceImage,                                                   // image
+        VkImageSubresourceRange{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1} // subresourceRange
+    );
+
+    auto cmd_sourceImageReadBeforeWriteBarrier = vsg::PipelineBarrier::create(
+        VK_PIPELINE_STAGE_TRANSFER_BIT,                 // srcStageMask
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,  // dstStageMask
+        0,                                              // dependencyFlags
+        sourceImageReadBeforeWriteBarrier               // barrier
+    );
+
+    commands->addChild(cmd_sourceImageReadBeforeWriteBarrier);
+
     return {commands, destinationImage};
 }
 
@@ -480,11 +504,11 @@ std::pair<vsg::ref_ptr<vsg::Commands>, vsg::ref_ptr<vsg::Buffer>> createDepthCap
     );
 
     auto cmd_transitionSourceImageBackToPresentBarrier = vsg::PipelineBarrier::create(
-        VK_PIPELINE_STAGE_TRANSFER_BIT,                                                            // srcStageMask
-        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, // dstStageMask
-        0,                                                                                         // dependencyFlags
-        transitionSourceImageBackToPresentBarrier,                                                 // barrier
-        transitionDestinationBufferToMemoryReadBarrier                                             // barrier
+        VK_PIPELINE_STAGE_TRANSFER_BIT,                                                                                                         // srcStageMask
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, // dstStageMask
+        0,                                                                                                                                      // dependencyFlags
+        transitionSourceImageBackToPresentBarrier,                                                                                              // barrier
+        transitionDestinationBufferToMemoryReadBarrier                                                                                          // barrier
     );
 
     commands->addChild(cmd_transitionSourceImageBackToPresentBarrier);
@@ -492,6 +516,239 @@ std::pair<vsg::ref_ptr<vsg::Commands>, vsg::ref_ptr<vsg::Buffer>> createDepthCap
     return {commands, destinationBuffer};
 }
 
+// a slot in the ring of capture targets, each frame copies into the next slot so the CPU can read back one frame while later frames are rendered and copied
+struct CaptureSlot
+{
+    vsg::ref_ptr<vsg::Group> captureCommands;
+    vsg::ref_ptr<vsg::Image> copiedColorBuffer;
+    vsg::ref_ptr<vsg::Buffer> copiedDepthBuffer;
+    VkExtent2D extent{0, 0};
+    uint64_t frameCount = 0;
+    vsg::Path colorFilename;
+    vsg::Path depthFilename;
+    vsg::ref_ptr<vsg::Object> job; // kept alive until the capture has been read back
+    bool pending = false;
+};
+
+std::vector<CaptureSlot> createCaptureSlots(vsg::ref_ptr<vsg::Device> device, const VkExtent2D& extent, uint32_t numSlots, vsg::ref_ptr<vsg::Image> colorImage, VkFormat imageFormat, vsg::ref_ptr<vsg::Image> depthImage, VkFormat depthFormat)
+{
+    std::vector<CaptureSlot> slots(numSlots);
+    for (auto& slot : slots)
+    {
+        slot.extent = extent;
+        slot.captureCommands = vsg::Group::create();
+
+        vsg::ref_ptr<vsg::Commands> colorBufferCapture, depthBufferCapture;
+        std::tie(colorBufferCapture, slot.copiedColorBuffer) = createColorCapture(device, extent, colorImage, imageFormat);
+        slot.captureCommands->addChild(colorBufferCapture);
+
+        if (depthImage)
+        {
+            std::tie(depthBufferCapture, slot.copiedDepthBuffer) = createDepthCapture(device, extent, depthImage, depthFormat);
+            slot.captureCommands->addChild(depthBufferCapture);
+        }
+    }
+    return slots;
+}
+
+// map the slot's copied color and depth buffers and either write them to the slot's files or copy them into CPU side arrays
+void readCaptureSlot(vsg::ref_ptr<vsg::Device> device, CaptureSlot& slot, VkFormat imageFormat, VkFormat depthFormat, bool writeFiles)
+{
+    auto& extent = slot.extent;
+    slot.pending = false;
+
+    if (slot.copiedColorBuffer)
+    {
+        VkImageSubresource subResource{VK_IMAGE_ASPECT_COLOR_BIT, 0, 0};
+        VkSubresourceLayout subResourceLayout;
+        vkGetImageSubresourceLayout(*device, slot.copiedColorBuffer->vk(device->deviceID), &subResource, &subResourceLayout);
+
+        auto deviceMemory = slot.copiedColorBuffer->getDeviceMemory(device->deviceID);
+
+        size_t destRowWidth = extent.width * sizeof(vsg::ubvec4);
+        vsg::ref_ptr<vsg::Data> imageData;
+        if (writeFiles && destRowWidth == subResourceLayout.rowPitch)
+        {
+            // Map the buffer memory and assign as a vec4Array2D that will automatically unmap itself on destruction.
+            imageData = vsg::MappedData<vsg::ubvec4Array2D>::create(deviceMemory, subResourceLayout.offset, 0, vsg::Data::Properties{imageFormat}, extent.width, extent.height);
+        }
+        else
+        {
+            // Map the buffer memory and assign as a ubyteArray that will automatically unmap itself on destruction.
+            // A ubyteArray is used as the graphics buffer memory is not contiguous like vsg::Array2D, so map to a flat buffer first then copy to Array2D.
+            auto mappedData = vsg::MappedData<vsg::ubyteArray>::create(deviceMemory, subResourceLayout.offset, 0, vsg::Data::Properties{imageFormat}, subResourceLayout.rowPitch * extent.height);
+            imageData = vsg::ubvec4Array2D::create(extent.width, extent.height, vsg::Data::Properties{imageFormat});
+            for (uint32_t row = 0; row < extent.height; ++row)
+            {
+                std::memcpy(imageData->dataPointer(row * extent.width), mappedData->dataPointer(row * subResourceLayout.rowPitch), destRowWidth);
+            }
+        }
+
+        if (writeFiles && slot.colorFilename) vsg::write(imageData, slot.colorFilename);
+    }
+
+    if (slot.copiedDepthBuffer && (slot.depthFilename || !writeFiles))
+    {
+        // 3. map buffer and copy data.
+        auto deviceMemory = slot.copiedDepthBuffer->getDeviceMemory(device->deviceID);
+
+        // Map the buffer memory and assign as a floatArray2D/uintArray2D that will automatically unmap itself on destruction.
+        vsg::ref_ptr<vsg::Data> imageData;
+        if (depthFormat == VK_FORMAT_D32_SFLOAT || depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT)
+            imageData = vsg::MappedData<vsg::floatArray2D>::create(deviceMemory, 0, 0, vsg::Data::Properties{depthFormat}, extent.width, extent.height); // deviceMemory, offset, flags and dimensions
+        else
+            imageData = vsg::MappedData<vsg::uintArray2D>::create(deviceMemory, 0, 0, vsg::Data::Properties{depthFormat}, extent.width, extent.height); // deviceMemory, offset, flags and dimensions
+
+        if (writeFiles)
+        {
+            vsg::write(imageData, slot.depthFilename);
+        }
+        else
+        {
+            auto depthData = vsg::uintArray2D::create(extent.width, extent.height, vsg::Data::Properties{depthFormat});
+            std::memcpy(depthData->dataPointer(), imageData->dataPointer(), depthData->dataSize());
+        }
+    }
+}
+
+// compute a LookAt and ProjectionMatrix that frame the whole of the node, viewed from the front or from above
+std::pair<vsg::ref_ptr<vsg::LookAt>, vsg::ref_ptr<vsg::ProjectionMatrix>> createCameraMatrices(vsg::ref_ptr<vsg::Node> node, const VkExtent2D& extent, bool above)
+{
+    // compute the bounds of the scene graph to help position camera
+    vsg::ComputeBounds computeBounds;
+    node->accept(computeBounds);
+    vsg::dvec3 centre(0.0, 0.0, 0.0);
+    double radius = 1.0;
+    if (computeBounds.bounds.valid())
+    {
+        centre = (computeBounds.bounds.min + computeBounds.bounds.max) * 0.5;
+        radius = vsg::length(computeBounds.bounds.max - computeBounds.bounds.min) * 0.6;
+    }
+    double nearFarRatio = 0.001;
+
+    // set up the camera
+    auto lookAt = (above) ? vsg::LookAt::create(centre + vsg::dvec3(0.0, 0.0, radius * 1.5), centre, vsg::dvec3(0.0, 1.0, 0.0)) : vsg::LookAt::create(centre + vsg::dvec3(0.0, -radius * 1.5, 0.0), centre, vsg::dvec3(0.0, 0.0, 1.0));
+
+    vsg::ref_ptr<vsg::ProjectionMatrix> perspective;
+    if (auto ellipsoidModel = node->getRefObject<vsg::EllipsoidModel>("EllipsoidModel"))
+    {
+        perspective = vsg::EllipsoidPerspective::create(lookAt, ellipsoidModel, 30.0, static_cast<double>(extent.width) / static_cast<double>(extent.height), nearFarRatio, 0.0);
+    }
+    else
+    {
+        perspective = vsg::Perspective::create(30.0, static_cast<double>(extent.width) / static_cast<double>(extent.height), nearFarRatio * radius, radius * 4.5);
+    }
+
+    return {lookAt, perspective};
+}
+
+// a (model, camera, output) job read from a --manifest file
+struct BatchJob : public vsg::Inherit<vsg::Object, BatchJob>
+{
+    vsg::Path modelFilename;
+    vsg::Path outputFilename;
+    bool above = false;
+    bool useLookAt = false;
+    vsg::dvec3 eye, center, up;
+
+    // assigned by LoadBatchJob
+    vsg::ref_ptr<vsg::Latch> loaded = vsg::Latch::create(1);
+    vsg::ref_ptr<vsg::Node> node;
+    vsg::ref_ptr<vsg::LookAt> lookAt;
+    vsg::ref_ptr<vsg::ProjectionMatrix> projectionMatrix;
+    vsg::CompileResult compileResult;
+    double loadTime = 0.0;    // milliseconds
+    double compileTime = 0.0; // milliseconds
+
+    // assigned by the render loop
+    vsg::time_point renderStartTime;
+    double renderTime = 0.0; // milliseconds from the job becoming current to its image being written
+    bool completed = false;
+};
+
+// each non blank line of a manifest is "model output [front | above | lookAt eye.x eye.y eye.z center.x center.y center.z up.x up.y up.z]", lines starting with # are ignored
+std::vector<vsg::ref_ptr<BatchJob>> readManifest(const vsg::Path& filename)
+{
+    std::vector<vsg::ref_ptr<BatchJob>> jobs;
+
+    std::ifstream fin(filename);
+    std::string line;
+    while (std::getline(fin, line))
+    {
+        std::istringstream str(line);
+        std::string model, output, camera;
+        if (!(str >> model) || model[0] == '#') continue;
+        if (!(str >> output))
+        {
+            vsg::warn("Manifest line has no output filename : ", line);
+            continue;
+        }
+
+        auto job = BatchJob::create();
+        job->modelFilename = model;
+        job->outputFilename = output;
+
+        if (str >> camera)
+        {
+            if (camera == "above")
+            {
+                job->above = true;
+            }
+            else if (camera == "lookAt")
+            {
+                job->useLookAt = static_cast<bool>(str >> job->eye.x >> job->eye.y >> job->eye.z >> job->center.x >> job->center.y >> job->center.z >> job->up.x >> job->up.y >> job->up.z);
+                if (!job->useLookAt) vsg::warn("Manifest line has incomplete lookAt, using default camera : ", line);
+            }
+        }
+
+        jobs.push_back(job);
+    }
+
+    return jobs;
+}
+
+// load and compile a BatchJob's model on a background thread so it's ready to merge by the time the render loop reaches it
+struct LoadBatchJob : public vsg::Inherit<vsg::Operation, LoadBatchJob>
+{
+    LoadBatchJob(vsg::ref_ptr<BatchJob> in_job, vsg::ref_ptr<vsg::Viewer> in_viewer, vsg::ref_ptr<vsg::Options> in_options, const VkExtent2D& in_extent) :
+        job(in_job),
+        viewer(in_viewer),
+        options(in_options),
+        extent(in_extent) {}
+
+    vsg::ref_ptr<BatchJob> job;
+    vsg::observer_ptr<vsg::Viewer> viewer;
+    vsg::ref_ptr<vsg::Options> options;
+    VkExtent2D extent;
+
+    void run() override
+    {
+        auto startTime = vsg::clock::now();
+
+        auto node = vsg::read_cast<vsg::Node>(job->modelFilename, options);
+
+        auto loadedTime = vsg::clock::now();
+        job->loadTime = std::chrono::duration<double, std::chrono::milliseconds::period>(loadedTime - startTime).count();
+
+        vsg::ref_ptr<vsg::Viewer> ref_viewer = viewer;
+        if (node && ref_viewer)
+        {
+            std::tie(job->lookAt, job->projectionMatrix) = createCameraMatrices(node, extent, job->above);
+            if (job->useLookAt) job->lookAt->set(job->eye, job->center, job->up);
+
+            job->compileResult = ref_viewer->compileManager->compile(node);
+            job->compileTime = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - loadedTime).count();
+
+            if (job->compileResult)
+                job->node = node;
+            else
+                vsg::warn("Loaded ", job->modelFilename, " but compile failed { ", job->compileResult.result, ", ", job->compileResult.message, " }");
+        }
+
+        job->loaded->count_down();
+    }
+};
+
 int main(int argc, char** argv)
 {
     // set up defaults and read command line arguments to override them
@@ -514,9 +771,19 @@ int main(int argc, char** argv)
     bool above = arguments.read("--above");
     bool enableGeometryShader = arguments.read("--gs");
 
+    // number of capture targets in the readback ring, 1 waits for each frame's copy before rendering the next
+    auto readbackDepth = arguments.value<uint32_t>(3, {"--readback-depth", "--rd"});
+    bool writeFiles = !arguments.read("--no-write");
+
+    // render a manifest of (model, camera, output) jobs in one process, see readManifest() for the file format
+    auto manifestFilename = arguments.value<vsg::Path>("", "--manifest");
+    auto prefetchCount = arguments.value<uint32_t>(4, "--prefetch");
+    auto numLoadThreads = arguments.value<uint32_t>(2, "--load-threads");
+    auto jobFrames = std::max(arguments.value<uint32_t>(1, "--job-frames"), 1u);
+
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
-    if (argc <= 1)
+    if (argc <= 1 && !manifestFilename)
     {
         std::cout << "Please specify model to load on command line" << std::endl;
         return 1;
@@ -531,6 +798,7 @@ int main(int argc, char** argv)
     if (samples != VK_SAMPLE_COUNT_1_BIT) vulkanVersion = VK_API_VERSION_1_2;
 
     auto options = vsg::Options::create();
+    options->sharedObjects = vsg::SharedObjects::create();
     options->fileCache = vsg::getEnv("VSG_FILE_CACHE");
     options->paths = vsg::getEnvPaths("VSG_FILE_PATH");
 #ifdef vsgXchange_all
@@ -538,11 +806,29 @@ int main(int argc, char** argv)
     options->add(vsgXchange::all::create());
 #endif
 
-    auto vsg_scene = vsg::read_cast<vsg::Node>(argv[1], options);
-    if (!vsg_scene)
+    vsg::ref_ptr<vsg::Node> vsg_scene;
+    vsg::ref_ptr<vsg::Group> batchRoot;
+    std::vector<vsg::ref_ptr<BatchJob>> batchJobs;
+    if (manifestFilename)
     {
-        std::cout << "No command graph created." << std::endl;
-        return 1;
+        batchJobs = readManifest(manifestFilename);
+        if (batchJobs.empty())
+        {
+            std::cout << "No jobs read from manifest " << manifestFilename << std::endl;
+            return 1;
+        }
+
+        // each job's subgraph is swapped in as the child of batchRoot
+        vsg_scene = batchRoot = vsg::Group::create();
+    }
+    else
+    {
+        vsg_scene = vsg::read_cast<vsg::Node>(argv[1], options);
+        if (!vsg_scene)
+        {
+            std::cout << "No command graph created." << std::endl;
+            return 1;
+        }
     }
 
     // create instance
@@ -575,35 +861,19 @@ int main(int argc, char** argv)
 
     auto device = vsg::Device::create(physicalDevice, queueSettings, validatedNames, deviceExtensions, deviceFeatures);
 
-    // compute the bounds of the scene graph to help position camera
-    vsg::ComputeBounds computeBounds;
-    vsg_scene->accept(computeBounds);
-    vsg::dvec3 centre = (computeBounds.bounds.min + computeBounds.bounds.max) * 0.5;
-    double radius = vsg::length(computeBounds.bounds.max - computeBounds.bounds.min) * 0.6;
-    double nearFarRatio = 0.001;
-
-    // set up the camera
-    auto lookAt = (above) ? vsg::LookAt::create(centre + vsg::dvec3(0.0, 0.0, radius * 1.5), centre, vsg::dvec3(0.0, 1.0, 0.0)) : vsg::LookAt::create(centre + vsg::dvec3(0.0, -radius * 1.5, 0.0), centre, vsg::dvec3(0.0, 0.0, 1.0));
-
+    vsg::ref_ptr<vsg::LookAt> lookAt;
     vsg::ref_ptr<vsg::ProjectionMatrix> perspective;
-    if (auto ellipsoidModel = vsg_scene->getRefObject<vsg::EllipsoidModel>("EllipsoidModel"))
-    {
-        perspective = vsg::EllipsoidPerspective::create(lookAt, ellipsoidModel, 30.0, static_cast<double>(extent.width) / static_cast<double>(extent.height), nearFarRatio, 0.0);
-    }
-    else
-    {
-        perspective = vsg::Perspective::create(30.0, static_cast<double>(extent.width) / static_cast<double>(extent.height), nearFarRatio * radius, radius * 4.5);
-    }
+    std::tie(lookAt, perspective) = createCameraMatrices(vsg_scene, extent, above);
 
     auto camera = vsg::Camera::create(perspective, lookAt, vsg::ViewportState::create(extent));
 
+    // the viewer's RecordAndSubmitTask keeps fences for 3 frames when no window is assigned, so frames older than that can't be waited on individually
+    const uint32_t maxFramesInFlight = 3;
+    readbackDepth = std::clamp(readbackDepth, 1u, maxFramesInFlight);
+
     vsg::ref_ptr<vsg::Framebuffer> framebuffer;
     vsg::ref_ptr<vsg::ImageView> colorImageView;
     vsg::ref_ptr<vsg::ImageView> depthImageView;
-    vsg::ref_ptr<vsg::Commands> colorBufferCapture;
-    vsg::ref_ptr<vsg::Image> copiedColorBuffer;
-    vsg::ref_ptr<vsg::Commands> depthBufferCapture;
-    vsg::ref_ptr<vsg::Buffer> copiedDepthBuffer;
 
     // set up the RenderGraph to manage the rendering
     if (useDepthBuffer)
@@ -623,10 +893,6 @@ int main(int argc, char** argv)
             auto renderPass = vsg::createOffscreenMultisampledRenderPass(device, imageFormat, depthFormat, samples, true);
             framebuffer = vsg::Framebuffer::create(renderPass, vsg::ImageViews{msaa_colorImageView, colorImageView, msaa_depthImageView, depthImageView}, extent.width, extent.height, 1);
         }
-
-        // create support for copying the color buffer
-        std::tie(colorBufferCapture, copiedColorBuffer) = createColorCapture(device, extent, colorImageView->image, imageFormat);
-        std::tie(depthBufferCapture, copiedDepthBuffer) = createDepthCapture(device, extent, depthImageView->image, depthFormat);
     }
     else
     {
@@ -643,11 +909,13 @@ int main(int argc, char** argv)
             auto renderPass = vsg::createMultisampledRenderPass(device, imageFormat, samples);
             framebuffer = vsg::Framebuffer::create(renderPass, vsg::ImageViews{msaa_colorImageView, colorImageView}, extent.width, extent.height, 1);
         }
-
-        // create support for copying the color buffer
-        std::tie(colorBufferCapture, copiedColorBuffer) = createColorCapture(device, extent, colorImageView->image, imageFormat);
     }
 
+    // create support for copying the color and depth buffers, one capture target per frame in flight with a Switch selecting which one to record each frame
+    auto captureSlots = createCaptureSlots(device, extent, readbackDepth, colorImageView->image, imageFormat, depthImageView ? depthImageView->image : vsg::ref_ptr<vsg::Image>(), depthFormat);
+    auto captureSwitch = vsg::Switch::create();
+    for (auto& slot : captureSlots) captureSwitch->addChild(false, slot.captureCommands);
+
     auto renderGraph = vsg::RenderGraph::create();
 
     renderGraph->framebuffer = framebuffer;
@@ -678,8 +946,7 @@ int main(int argc, char** argv)
     auto commandGraph = vsg::CommandGraph::create(device, queueFamily);
     commandGraph->addChild(renderGraph);
     commandGraphs.push_back(commandGraph);
-    if (colorBufferCapture) commandGraph->addChild(colorBufferCapture);
-    if (depthBufferCapture) commandGraph->addChild(depthBufferCapture);
+    commandGraph->addChild(captureSwitch);
 
     // create the viewer
     auto viewer = vsg::Viewer::create();
@@ -697,147 +964,209 @@ int main(int argc, char** argv)
 
     uint64_t waitTimeout = 1999999999; // 1second in nanoseconds.
 
-    // rendering main loop
-    while (viewer->advanceToNextFrame() && (numFrames--) > 0)
-    {
-        std::cout << "Frame " << viewer->getFrameStamp()->frameCount << std::endl;
-        if (resizeCadence && (viewer->getFrameStamp()->frameCount > 0) && ((viewer->getFrameStamp()->frameCount) % resizeCadence == 0))
+    uint64_t numFramesCaptured = 0;
+    auto readSlot = [&](CaptureSlot& slot) {
+        readCaptureSlot(device, slot, imageFormat, depthFormat, writeFiles);
+        ++numFramesCaptured;
+
+        if (auto job = slot.job.cast<BatchJob>())
         {
-            viewer->deviceWaitIdle();
+            job->renderTime = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - job->renderStartTime).count();
+            job->completed = true;
+
+            // the job's subgraph is no longer referenced by any frame in flight, so release it
+            job->node = {};
+            job->compileResult = {};
+        }
+        slot.job = {};
+    };
 
-            extent.width /= 2;
-            extent.height /= 2;
+    auto readPendingSlots = [&]() {
+        // read back any slots still in flight in the order they were rendered
+        viewer->deviceWaitIdle();
 
-            if (extent.width < 1) extent.width = 1;
-            if (extent.height < 1) extent.height = 1;
+        std::vector<CaptureSlot*> pendingSlots;
+        for (auto& slot : captureSlots)
+        {
+            if (slot.pending) pendingSlots.push_back(&slot);
+        }
+        std::sort(pendingSlots.begin(), pendingSlots.end(), [](const CaptureSlot* lhs, const CaptureSlot* rhs) { return lhs->frameCount < rhs->frameCount; });
+
+        for (auto slot : pendingSlots) readSlot(*slot);
+    };
+
+    uint64_t frameNumber = 0;
+    uint64_t captureNumber = 0;
+
+    // copy this frame into the next slot of the ring
+    auto beginCapture = [&](const vsg::Path& colorFile, const vsg::Path& depthFile, vsg::ref_ptr<vsg::Object> job) {
+        uint32_t index = captureNumber % readbackDepth;
+        captureSwitch->setSingleChildOn(index);
+
+        auto& slot = captureSlots[index];
+        slot.extent = extent;
+        slot.frameCount = frameNumber;
+        slot.colorFilename = colorFile;
+        slot.depthFilename = depthFile;
+        slot.job = job;
+        slot.pending = true;
+    };
+
+    // after recordAndSubmit(), read back the oldest capture in flight, its slot is the one the next capture will copy into
+    auto endFrame = [&](bool captured) {
+        if (captured)
+        {
+            auto& oldestSlot = captureSlots[(captureNumber + 1) % readbackDepth];
+            if (oldestSlot.pending)
+            {
+                // wait for completion, frames older than maxFramesInFlight will already have been waited on by the viewer
+                uint64_t relativeFrameIndex = frameNumber - oldestSlot.frameCount;
+                if (relativeFrameIndex < maxFramesInFlight) viewer->waitForFences(relativeFrameIndex, waitTimeout);
 
-            std::cout << "Resized to " << extent.width << ", " << extent.height << std::endl;
+                readSlot(oldestSlot);
+            }
+            ++captureNumber;
+        }
+        ++frameNumber;
+    };
 
-            auto replace_child = [](vsg::Group* group, vsg::ref_ptr<vsg::Node> previous, vsg::ref_ptr<vsg::Node> replacement) {
-                for (auto& child : group->children)
-                {
-                    if (child == previous) child = replacement;
-                }
-            };
+    auto startTime = vsg::clock::now();
 
-            auto previous_colorBufferCapture = colorBufferCapture;
-            auto previous_depthBufferCapture = depthBufferCapture;
+    if (batchRoot)
+    {
+        // load and compile upcoming jobs on background threads while the current one renders, all sharing the one device, render pass and SharedObjects
+        auto loadThreads = vsg::OperationThreads::create(numLoadThreads, viewer->status);
 
-            if (useDepthBuffer)
+        size_t numQueued = 0;
+        for (size_t i = 0; i < batchJobs.size() && viewer->active(); ++i)
+        {
+            for (; numQueued < batchJobs.size() && numQueued <= i + prefetchCount; ++numQueued)
             {
-                colorImageView = createColorImageView(device, extent, imageFormat, VK_SAMPLE_COUNT_1_BIT);
-                depthImageView = createDepthImageView(device, extent, depthFormat, VK_SAMPLE_COUNT_1_BIT);
-                if (samples == VK_SAMPLE_COUNT_1_BIT)
-                {
-                    auto renderPass = vsg::createRenderPass(device, imageFormat, depthFormat, true);
-                    framebuffer = vsg::Framebuffer::create(renderPass, vsg::ImageViews{colorImageView, depthImageView}, extent.width, extent.height, 1);
-                }
-                else
-                {
-                    auto msaa_colorImageView = createColorImageView(device, extent, imageFormat, samples);
-                    auto msaa_depthImageView = createDepthImageView(device, extent, depthFormat, samples);
+                loadThreads->add(LoadBatchJob::create(batchJobs[numQueued], viewer, options, extent));
+            }
 
-                    auto renderPass = vsg::createMultisampledRenderPass(device, imageFormat, depthFormat, samples, true);
-                    framebuffer = vsg::Framebuffer::create(renderPass, vsg::ImageViews{msaa_colorImageView, colorImageView, msaa_depthImageView, depthImageView}, extent.width, extent.height, 1);
-                }
+            auto& job = batchJobs[i];
+            job->loaded->wait();
+            if (!job->node)
+            {
+                std::cout << "Unable to load " << job->modelFilename << std::endl;
+                continue;
+            }
 
-                renderGraph->framebuffer = framebuffer;
+            job->renderStartTime = vsg::clock::now();
 
-                // create new copy subgraphs
-                std::tie(colorBufferCapture, copiedColorBuffer) = createColorCapture(device, extent, colorImageView->image, imageFormat);
-                std::tie(depthBufferCapture, copiedDepthBuffer) = createDepthCapture(device, extent, depthImageView->image, depthFormat);
+            vsg::updateViewer(*viewer, job->compileResult);
+            batchRoot->children = {job->node};
+            camera->viewMatrix = job->lookAt;
+            camera->projectionMatrix = job->projectionMatrix;
 
-                replace_child(commandGraph, previous_colorBufferCapture, colorBufferCapture);
-                replace_child(commandGraph, previous_depthBufferCapture, depthBufferCapture);
-            }
-            else
+            // only the last frame of each job is captured, earlier frames give paged databases and animations a chance to update
+            for (uint32_t frame = 0; frame < jobFrames && viewer->advanceToNextFrame(); ++frame)
             {
-                colorImageView = createColorImageView(device, extent, imageFormat, VK_SAMPLE_COUNT_1_BIT);
-                if (samples == VK_SAMPLE_COUNT_1_BIT)
-                {
-                    auto renderPass = vsg::createRenderPass(device, imageFormat);
-                    framebuffer = vsg::Framebuffer::create(renderPass, vsg::ImageViews{colorImageView}, extent.width, extent.height, 1);
-                }
-                else
-                {
-                    auto msaa_colorImageView = createColorImageView(device, extent, imageFormat, samples);
+                viewer->handleEvents();
+                viewer->update();
 
-                    auto renderPass = vsg::createMultisampledRenderPass(device, imageFormat, samples);
-                    framebuffer = vsg::Framebuffer::create(renderPass, vsg::ImageViews{msaa_colorImageView, colorImageView}, extent.width, extent.height, 1);
-                }
-
-                renderGraph->framebuffer = framebuffer;
+                bool capture = (frame + 1) == jobFrames;
+                if (capture)
+                    beginCapture(job->outputFilename, {}, job);
+                else
+                    captureSwitch->setAllChildren(false);
 
-                // create new copy subgraphs
-                std::tie(colorBufferCapture, copiedColorBuffer) = createColorCapture(device, extent, colorImageView->image, imageFormat);
+                viewer->recordAndSubmit();
 
-                replace_child(commandGraph, previous_colorBufferCapture, colorBufferCapture);
-                replace_child(commandGraph, previous_depthBufferCapture, depthBufferCapture);
+                endFrame(capture);
             }
         }
-
-        // pass any events into EventHandlers assigned to the Viewer, this includes Frame events generated by the viewer each frame
-        viewer->handleEvents();
-
-        viewer->update();
-
-        viewer->recordAndSubmit();
-
-        if (copiedColorBuffer || copiedDepthBuffer)
+    }
+    else
+    {
+        // rendering main loop
+        while (viewer->advanceToNextFrame() && (numFrames--) > 0)
         {
-            // wait for completion.
-            viewer->waitForFences(0, waitTimeout);
-
-            if (copiedColorBuffer)
+            std::cout << "Frame " << viewer->getFrameStamp()->frameCount << std::endl;
+            if (resizeCadence && (viewer->getFrameStamp()->frameCount > 0) && ((viewer->getFrameStamp()->frameCount) % resizeCadence == 0))
             {
-                VkImageSubresource subResource{VK_IMAGE_ASPECT_COLOR_BIT, 0, 0};
-                VkSubresourceLayout subResourceLayout;
-                vkGetImageSubresourceLayout(*device, copiedColorBuffer->vk(device->deviceID), &subResource, &subResourceLayout);
+                readPendingSlots();
 
-                auto deviceMemory = copiedColorBuffer->getDeviceMemory(device->deviceID);
+                extent.width /= 2;
+                extent.height /= 2;
 
-                size_t destRowWidth = extent.width * sizeof(vsg::ubvec4);
-                vsg::ref_ptr<vsg::Data> imageData;
-                if (destRowWidth == subResourceLayout.rowPitch)
+                if (extent.width < 1) extent.width = 1;
+                if (extent.height < 1) extent.height = 1;
+
+                std::cout << "Resized to " << extent.width << ", " << extent.height << std::endl;
+
+                if (useDepthBuffer)
                 {
-                    // Map the buffer memory and assign as a vec4Array2D that will automatically unmap itself on destruction.
-                    imageData = vsg::MappedData<vsg::ubvec4Array2D>::create(deviceMemory, subResourceLayout.offset, 0, vsg::Data::Properties{imageFormat}, extent.width, extent.height);
+                    colorImageView = createColorImageView(device, extent, imageFormat, VK_SAMPLE_COUNT_1_BIT);
+                    depthImageView = createDepthImageView(device, extent, depthFormat, VK_SAMPLE_COUNT_1_BIT);
+                    if (samples == VK_SAMPLE_COUNT_1_BIT)
+                    {
+                        auto renderPass = vsg::createRenderPass(device, imageFormat, depthFormat, true);
+                        framebuffer = vsg::Framebuffer::create(renderPass, vsg::ImageViews{colorImageView, depthImageView}, extent.width, extent.height, 1);
+                    }
+                    else
+                    {
+                        auto msaa_colorImageView = createColorImageView(device, extent, imageFormat, samples);
+                        auto msaa_depthImageView = createDepthImageView(device, extent, depthFormat, samples);
+
+                        auto renderPass = vsg::createMultisampledRenderPass(device, imageFormat, depthFormat, samples, true);
+                        framebuffer = vsg::Framebuffer::create(renderPass, vsg::ImageViews{msaa_colorImageView, colorImageView, msaa_depthImageView, depthImageView}, extent.width, extent.height, 1);
+                    }
                 }
                 else
                 {
-                    // Map the buffer memory and assign as a ubyteArray that will automatically unmap itself on destruction.
-                    // A ubyteArray is used as the graphics buffer memory is not contiguous like vsg::Array2D, so map to a flat buffer first then copy to Array2D.
-                    auto mappedData = vsg::MappedData<vsg::ubyteArray>::create(deviceMemory, subResourceLayout.offset, 0, vsg::Data::Properties{imageFormat}, subResourceLayout.rowPitch * extent.height);
-                    imageData = vsg::ubvec4Array2D::create(extent.width, extent.height, vsg::Data::Properties{imageFormat});
-                    for (uint32_t row = 0; row < extent.height; ++row)
+                    colorImageView = createColorImageView(device, extent, imageFormat, VK_SAMPLE_COUNT_1_BIT);
+                    if (samples == VK_SAMPLE_COUNT_1_BIT)
                     {
-                        std::memcpy(imageData->dataPointer(row * extent.width), mappedData->dataPointer(row * subResourceLayout.rowPitch), destRowWidth);
+                        auto renderPass = vsg::createRenderPass(device, imageFormat);
+                        framebuffer = vsg::Framebuffer::create(renderPass, vsg::ImageViews{colorImageView}, extent.width, extent.height, 1);
+                    }
+                    else
+                    {
+                        auto msaa_colorImageView = createColorImageView(device, extent, imageFormat, samples);
+
+                        auto renderPass = vsg::createMultisampledRenderPass(device, imageFormat, samples);
+                        framebuffer = vsg::Framebuffer::create(renderPass, vsg::ImageViews{msaa_colorImageView, colorImageView}, extent.width, extent.height, 1);
                     }
                 }
 
-                vsg::write(imageData, colorFilename);
+                renderGraph->framebuffer = framebuffer;
+
+                // create new copy subgraphs
+                captureSlots = createCaptureSlots(device, extent, readbackDepth, colorImageView->image, imageFormat, depthImageView ? depthImageView->image : vsg::ref_ptr<vsg::Image>(), depthFormat);
+                captureSwitch->children.clear();
+                for (auto& slot : captureSlots) captureSwitch->addChild(false, slot.captureCommands);
             }
 
-            if (copiedDepthBuffer)
-            {
-                // 3. map buffer and copy data.
-                auto deviceMemory = copiedDepthBuffer->getDeviceMemory(device->deviceID);
+            // pass any events into EventHandlers assigned to the Viewer, this includes Frame events generated by the viewer each frame
+            viewer->handleEvents();
 
-                // Map the buffer memory and assign as a vec4Array2D that will automatically unmap itself on destruction.
-                if (depthFormat == VK_FORMAT_D32_SFLOAT || depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT)
-                {
-                    auto imageData = vsg::MappedData<vsg::floatArray2D>::create(deviceMemory, 0, 0, vsg::Data::Properties{depthFormat}, extent.width, extent.height); // deviceMemory, offset, flags and dimensions
+            viewer->update();
 
-                    vsg::write(imageData, depthFilename);
-                }
-                else
-                {
-                    auto imageData = vsg::MappedData<vsg::uintArray2D>::create(deviceMemory, 0, 0, vsg::Data::Properties{depthFormat}, extent.width, extent.height); // deviceMemory, offset, flags and dimensions
+            beginCapture(colorFilename, depthFilename, {});
 
-                    vsg::write(imageData, depthFilename);
-                }
-            }
+            viewer->recordAndSubmit();
+
+            endFrame(true);
+        }
+    }
+
+    readPendingSlots();
+
+    double duration = std::chrono::duration<double, std::chrono::seconds::period>(vsg::clock::now() - startTime).count();
+    std::cout << "Captured " << numFramesCaptured << " frames at " << extent.width << "x" << extent.height << " with a readback depth of " << readbackDepth << ", " << (static_cast<double>(numFramesCaptured) / duration) << " frames/second" << std::endl;
+
+    if (batchRoot)
+    {
+        size_t numCompleted = 0;
+        for (auto& job : batchJobs)
+        {
+            if (!job->completed) continue;
+            ++numCompleted;
+            std::cout << "    " << job->modelFilename << " -> " << job->outputFilename << " : load " << job->loadTime << "ms, compile " << job->compileTime << "ms, render and write " << job->renderTime << "ms" << std::endl;
         }
+        std::cout << "Batch of " << batchJobs.size() << " jobs, " << numCompleted << " images written, " << (static_cast<double>(numCompleted) / duration) << " images/second" << std::endl;
     }
 
     // clean up done automatically thanks to ref_ptr<>
@@ -26,6 +26,8 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #include <stdexcept>
 #include <thread>
 
+#include "ImageEncoderPool.h"
+
 bool supportsBlit(vsg::ref_ptr<vsg::Device> device, VkFormat format)
 {
     auto physicalDevice = device->getPhysicalDevice();
@@ -463,7 +465,8 @@ void replaceChild(vsg::Switch* toggle, vsg::ref_ptr<vsg::Node> previous, vsg::re
         vsg::info("replaceChild succeeded\n");
 }
 
-vsg::ref_ptr<vsg::Data> getImageData(vsg::ref_ptr<vsg::Viewer> viewer, vsg::ref_ptr<vsg::Device> device, vsg::ref_ptr<vsg::Image> captureImage)
+/// when converter is provided and the rows aren't tightly packed the mapped rows are returned as is, with converter set to repack them later
+vsg::ref_ptr<vsg::Data> getImageData(vsg::ref_ptr<vsg::Viewer> viewer, vsg::ref_ptr<vsg::Device> device, vsg::ref_ptr<vsg::Image> captureImage, ImageEncoderPool::Converter* converter = nullptr)
 {
     constexpr uint64_t waitTimeout = 1000000000; // 1 second
     viewer->waitForFences(0, waitTimeout);
@@ -500,6 +503,11 @@ vsg::ref_ptr<vsg::Data> getImageData(vsg::ref_ptr<vsg::Viewer> viewer, vsg::ref_
             0,
             vsg::Data::Properties{captureImage->format},
             subResourceLayout.rowPitch * captureImage->extent.height);
+        if (converter)
+        {
+            *converter = ImageEncoderPool::repackRows(captureImage->extent.width, captureImage->extent.height, subResourceLayout.rowPitch, captureImage->format);
+            return mappedData;
+        }
         imageData = vsg::ubvec4Array2D::create(captureImage->extent.width, captureImage->extent.height, vsg::Data::Properties{captureImage->format});
         for (uint32_t row = 0; row < captureImage->extent.height; ++row)
         {
@@ -514,8 +522,19 @@ void saveImage(
     vsg::ref_ptr<vsg::Viewer> viewer,
     vsg::ref_ptr<vsg::Device> device,
     vsg::ref_ptr<vsg::Image> captureImage,
-    vsg::ref_ptr<vsg::Options> options)
+    vsg::ref_ptr<vsg::Options> options,
+    vsg::ref_ptr<ImageEncoderPool> encoderPool = {})
 {
+    if (encoderPool)
+    {
+        // the mapped captureImage memory is handed to the pool, the caller must use a new captureImage for subsequent captures
+        ImageEncoderPool::Converter converter;
+        auto imageData = getImageData(viewer, device, captureImage, &converter);
+        encoderPool->add(imageData, filename, converter);
+        vsg::info("image queued for writing to file: ", filename);
+        return;
+    }
+
     vsg::info("writing image to file: ", filename);
     auto imageData = getImageData(viewer, device, captureImage);
     vsg::write(imageData, filename, options);
@@ -561,6 +580,10 @@ int main(int argc, char** argv)
     auto captureFilename = arguments.value<vsg::Path>("screenshot.vsgt", {"--capture-file", "-f"});
     bool msaa = arguments.read("--msaa");
 
+    // convert and write images on background threads, the default of 0 threads writes them synchronously on the frame thread
+    auto numEncoderThreads = arguments.value<uint32_t>(0, "--encoder-threads");
+    auto encoderQueueSize = arguments.value<size_t>(8, "--encoder-queue");
+
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
     // if we are multisampling then to enable copying of the depth buffer we have to
@@ -695,6 +718,9 @@ int main(int argc, char** argv)
     offscreenRenderGraph->addChild(offscreenView);
 
     auto screenshotHandler = ScreenshotHandler::create();
+
+    vsg::ref_ptr<ImageEncoderPool> encoderPool;
+    if (numEncoderThreads > 0) encoderPool = ImageEncoderPool::create(numEncoderThreads, encoderQueueSize, options);
     viewer->addEventHandler(screenshotHandler);
 
     if (nestedCommandGraph)
@@ -780,10 +806,25 @@ int main(int argc, char** argv)
             screenshotHandler->do_image_capture = false;
             offscreenEnabled = false;
             offscreenSwitch->setAllChildren(offscreenEnabled);
-            saveImage(captureFilename, viewer, device, captureImage, options);
+            saveImage(captureFilename, viewer, device, captureImage, options, encoderPool);
+
+            if (encoderPool)
+            {
+                // captureImage's memory stays mapped until the pool has written it, so copy the next capture to a fresh image
+                auto prevCaptureCommands = captureCommands;
+                captureImage = createCaptureImage(device, offscreenImageFormat, offscreenExtent);
+                captureCommands = createTransferCommands(device, transferImageView->image, captureImage);
+                replaceChild(offscreenSwitch, prevCaptureCommands, captureCommands);
+            }
         }
     }
 
+    if (encoderPool)
+    {
+        encoderPool->flush();
+        encoderPool->report(std::cout);
+    }
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }
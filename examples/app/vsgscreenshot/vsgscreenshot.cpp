@@ -6,154 +6,179 @@
 
 #include <algorithm>
 #include <chrono>
+#include <functional>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <thread>
 
-class ScreenshotHandler : public vsg::Inherit<vsg::Visitor, ScreenshotHandler>
+#include "ImageEncoderPool.h"
+
+/// ColorCapture copies the swapchain image into one of a small ring of host visible capture images as part of the frame's own command buffer,
+/// so a capture needs neither a separate submission nor a fence wait on the frame thread. The viewer waits on a frame's fence before it reuses
+/// it numFrames frames later, after which the capture image is mapped and handed on to be written. The capture image is reused once the
+/// written data has released its mapping.
+class ColorCapture : public vsg::Inherit<vsg::Command, ColorCapture>
 {
 public:
-    bool do_image_capture = false;
-    bool do_depth_capture = false;
-    vsg::ref_ptr<vsg::Event> event;
-    bool eventDebugTest = false;
-    vsg::Path colorFilename;
-    vsg::Path depthFilename;
-    vsg::ref_ptr<vsg::Options> options;
-
-    ScreenshotHandler(vsg::ref_ptr<vsg::Event> in_event, const vsg::Path& in_colorFilename, const vsg::Path& in_depthFilename, vsg::ref_ptr<vsg::Options> in_options = {}) :
-        event(in_event),
-        colorFilename(in_colorFilename),
-        depthFilename(in_depthFilename),
-        options(in_options)
+    ColorCapture(vsg::ref_ptr<vsg::Window> in_window, uint32_t numImages) :
+        window(in_window),
+        _captureImages(std::max(numImages, 1u))
     {
+        auto physicalDevice = window->getOrCreatePhysicalDevice();
+        VkFormat sourceImageFormat = window->surfaceFormat().format;
+
+        VkFormatProperties srcFormatProperties;
+        vkGetPhysicalDeviceFormatProperties(*(physicalDevice), sourceImageFormat, &srcFormatProperties);
+
+        VkFormatProperties destFormatProperties;
+        vkGetPhysicalDeviceFormatProperties(*(physicalDevice), VK_FORMAT_R8G8B8A8_SRGB, &destFormatProperties);
+
+        supportsBlit = ((srcFormatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT) != 0) &&
+                       ((destFormatProperties.linearTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT) != 0);
+
+        // we can automatically convert the image format when blit, so take advantage of it to ensure RGBA
+        targetImageFormat = supportsBlit ? VK_FORMAT_R8G8B8A8_SRGB : sourceImageFormat;
+
+        vsg::info("supportsBlit = ", supportsBlit);
     }
 
-    void apply(vsg::KeyPressEvent& keyPress) override
+    using Writer = std::function<void(vsg::ref_ptr<vsg::Data> imageData, const vsg::Path& filename, ImageEncoderPool::Converter converter)>;
+
+    vsg::ref_ptr<vsg::Window> window;
+    VkFormat targetImageFormat = VK_FORMAT_UNDEFINED;
+    bool supportsBlit = false;
+
+    /// copy the color image of the frame about to be recorded to filename, returns false if all the capture images are still in use
+    bool capture(const vsg::Path& filename, uint64_t frameCount)
     {
-        if (keyPress.keyBase == 's')
+        // capture images are free again once the data handed on to be written has been released
+        for (auto& captureImage : _captureImages)
         {
-            do_image_capture = true;
+            if (captureImage.imageData && captureImage.imageData->referenceCount() == 1) captureImage.imageData = {};
         }
-        if (keyPress.keyBase == 'd')
+
+        auto itr = std::find_if(_captureImages.begin(), _captureImages.end(), [](const CaptureImage& captureImage) { return !captureImage.pending && !captureImage.imageData; });
+        if (itr == _captureImages.end())
         {
-            do_depth_capture = true;
+            ++numSkipped;
+            return false;
         }
-    }
 
-    void printInfo(vsg::ref_ptr<vsg::Window> window)
-    {
-        auto device = window->getDevice();
-        auto physicalDevice = window->getPhysicalDevice();
-        auto swapchain = window->getSwapchain();
-        std::cout << "\nNeed to take screenshot " << window << std::endl;
-        std::cout << "    device = " << device << std::endl;
-        std::cout << "    physicalDevice = " << physicalDevice << std::endl;
-        std::cout << "    swapchain = " << swapchain << std::endl;
-        std::cout << "        swapchain->getImageFormat() = " << swapchain->getImageFormat() << std::endl;
-        std::cout << "        swapchain->getExtent() = " << swapchain->getExtent().width << ", " << swapchain->getExtent().height << std::endl;
+        auto& captureImage = *itr;
+        auto width = window->extent2D().width;
+        auto height = window->extent2D().height;
 
-        for (auto& imageView : swapchain->getImageViews())
+        // (re)create the image on first use or when the window has been resized
+        if (!captureImage.image || captureImage.image->extent.width != width || captureImage.image->extent.height != height)
         {
-            std::cout << "        imageview = " << imageView << std::endl;
-        }
+            auto device = window->getDevice();
 
-        std::cout << "    numFrames() = " << window->numFrames() << std::endl;
-        for (size_t i = 0; i < window->numFrames(); ++i)
-        {
-            std::cout << "        imageview[" << i << "] = " << window->imageView(i) << std::endl;
-            std::cout << "        framebuffer[" << i << "] = " << window->framebuffer(i) << std::endl;
+            auto destinationImage = vsg::Image::create();
+            destinationImage->imageType = VK_IMAGE_TYPE_2D;
+            destinationImage->format = targetImageFormat;
+            destinationImage->extent.width = width;
+            destinationImage->extent.height = height;
+            destinationImage->extent.depth = 1;
+            destinationImage->arrayLayers = 1;
+            destinationImage->mipLevels = 1;
+            destinationImage->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            destinationImage->samples = VK_SAMPLE_COUNT_1_BIT;
+            destinationImage->tiling = VK_IMAGE_TILING_LINEAR;
+            destinationImage->usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+            destinationImage->compile(device);
+
+            auto deviceMemory = vsg::DeviceMemory::create(device, destinationImage->getMemoryRequirements(device->deviceID), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+            destinationImage->bind(deviceMemory, 0);
+
+            captureImage.image = destinationImage;
+            ++numImagesCreated;
         }
 
-        std::cout << "    surfaceFormat() = " << window->surfaceFormat().format << ", " << window->surfaceFormat().colorSpace << std::endl;
-        std::cout << "    depthFormat() = " << window->depthFormat() << std::endl;
+        captureImage.filename = filename;
+        captureImage.frameCount = frameCount;
+        _nextCapture = &captureImage;
+        _recorded = false;
+        return true;
     }
 
-    void screenshot_image(vsg::ref_ptr<vsg::Window> window)
+    /// call after recordAndSubmit(), hands the captures whose frames have completed on to writer
+    void completed(uint64_t frameCount, const Writer& writer)
     {
-        // printInfo(window);
-
-        do_image_capture = false;
-
-        if (eventDebugTest && event && event->status() == VK_EVENT_RESET)
+        if (_nextCapture)
         {
-            std::cout << "event->status() == VK_EVENT_RESET" << std::endl;
-            // manually wait for the event to be signaled
-            while (event->status() == VK_EVENT_RESET)
-            {
-                std::cout << "w";
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
-            }
-            std::cout << std::endl;
+            // the frame may not have been recorded, for instance while the window is minimized
+            if (_recorded)
+                _nextCapture->pending = true;
+            else
+                ++numSkipped;
+            _nextCapture = nullptr;
         }
 
-        auto width = window->extent2D().width;
-        auto height = window->extent2D().height;
-
-        auto device = window->getDevice();
-        auto physicalDevice = window->getPhysicalDevice();
-        auto swapchain = window->getSwapchain();
+        // frames at least numFrames old have been waited on by the viewer before their fence was reused
+        for (auto& captureImage : _captureImages)
+        {
+            if (captureImage.pending && (frameCount - captureImage.frameCount) >= window->numFrames()) _write(captureImage, writer);
+        }
+    }
 
-        // get the colour buffer image of the previous rendered frame as the current frame hasn't been rendered yet.  The 1 in window->imageIndex(1) means image from 1 frame ago.
-        auto sourceImage = window->imageView(window->imageIndex(1))->image;
+    /// hand all the captures still in flight on to writer in the order they were taken, call once the device is idle
+    void flush(const Writer& writer)
+    {
+        std::vector<CaptureImage*> pendingImages;
+        for (auto& captureImage : _captureImages)
+        {
+            if (captureImage.pending) pendingImages.push_back(&captureImage);
+        }
+        std::sort(pendingImages.begin(), pendingImages.end(), [](const CaptureImage* lhs, const CaptureImage* rhs) { return lhs->frameCount < rhs->frameCount; });
 
-        VkFormat sourceImageFormat = swapchain->getImageFormat();
-        VkFormat targetImageFormat = sourceImageFormat;
+        for (auto captureImage : pendingImages) _write(*captureImage, writer);
+    }
 
-        //
-        // 1) Check to see if Blit is supported.
-        //
-        VkFormatProperties srcFormatProperties;
-        vkGetPhysicalDeviceFormatProperties(*(physicalDevice), sourceImageFormat, &srcFormatProperties);
+    void record(vsg::CommandBuffer& commandBuffer) const override
+    {
+        if (!_nextCapture) return;
 
-        VkFormatProperties destFormatProperties;
-        vkGetPhysicalDeviceFormatProperties(*(physicalDevice), VK_FORMAT_R8G8B8A8_SRGB, &destFormatProperties);
+        // copy the swapchain image this frame is rendering to, the render pass has already transitioned it to the present layout
+        auto sourceImage = window->imageView(window->imageIndex())->image;
+        _createCopyCommands(sourceImage, _nextCapture->image)->record(commandBuffer);
+        _recorded = true;
+    }
 
-        bool supportsBlit = ((srcFormatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT) != 0) &&
-                            ((destFormatProperties.linearTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT) != 0);
+    void report(std::ostream& out) const
+    {
+        out << "ColorCapture images = " << _captureImages.size() << ", created = " << numImagesCreated << ", captured = " << numCaptured << ", skipped = " << numSkipped << std::endl;
+    }
 
-        if (supportsBlit)
-        {
-            // we can automatically convert the image format when blit, so take advantage of it to ensure RGBA
-            targetImageFormat = VK_FORMAT_R8G8B8A8_SRGB;
-        }
+    // stats
+    uint64_t numCaptured = 0;
+    uint64_t numSkipped = 0; // captures skipped as all the capture images were still in use
+    uint64_t numImagesCreated = 0;
 
-        vsg::info("supportsBlit = ", supportsBlit);
+protected:
+    struct CaptureImage
+    {
+        vsg::ref_ptr<vsg::Image> image;
+        vsg::ref_ptr<vsg::Data> imageData; // mapping handed on to be written, released once it is the only reference left
+        vsg::Path filename;
+        uint64_t frameCount = 0;
+        bool pending = false; // copy recorded into a frame that may still be in flight
+    };
+
+    std::vector<CaptureImage> _captureImages;
+    CaptureImage* _nextCapture = nullptr;
+    mutable bool _recorded = false;
+
+    vsg::ref_ptr<vsg::Commands> _createCopyCommands(vsg::ref_ptr<vsg::Image> sourceImage, vsg::ref_ptr<vsg::Image> destinationImage) const
+    {
+        auto width = destinationImage->extent.width;
+        auto height = destinationImage->extent.height;
 
-        //
-        // 2) create image to write to
-        //
-        auto destinationImage = vsg::Image::create();
-        destinationImage->imageType = VK_IMAGE_TYPE_2D;
-        destinationImage->format = targetImageFormat;
-        destinationImage->extent.width = width;
-        destinationImage->extent.height = height;
-        destinationImage->extent.depth = 1;
-        destinationImage->arrayLayers = 1;
-        destinationImage->mipLevels = 1;
-        destinationImage->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        destinationImage->samples = VK_SAMPLE_COUNT_1_BIT;
-        destinationImage->tiling = VK_IMAGE_TILING_LINEAR;
-        destinationImage->usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-
-        destinationImage->compile(device);
-
-        auto deviceMemory = vsg::DeviceMemory::create(device, destinationImage->getMemoryRequirements(device->deviceID), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-        destinationImage->bind(deviceMemory, 0);
-
-        //
-        // 3) create command buffer and submit to graphics queue
-        //
         auto commands = vsg::Commands::create();
 
-        if (event)
-        {
-            vsg::info("Using vsg::Event/vkEvent");
-            commands->addChild(vsg::WaitEvents::create(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, event));
-            commands->addChild(vsg::ResetEvent::create(event, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT));
-        }
-
-        // 3.a) transition destinationImage to transfer destination initialLayout
+        // 1.a) transition destinationImage to transfer destination initialLayout
         auto transitionDestinationImageToDestinationLayoutBarrier = vsg::ImageMemoryBarrier::create(
             0,                                                             // srcAccessMask
             VK_ACCESS_TRANSFER_WRITE_BIT,                                  // dstAccessMask
@@ -165,9 +190,9 @@ public:
             VkImageSubresourceRange{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1} // subresourceRange
         );
 
-        // 3.b) transition swapChainImage from present to transfer source initialLayout
+        // 1.b) transition swapChainImage from present to transfer source initialLayout once the render pass has written it
         auto transitionSourceImageToTransferSourceLayoutBarrier = vsg::ImageMemoryBarrier::create(
-            VK_ACCESS_MEMORY_READ_BIT,                                     // srcAccessMask
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,                          // srcAccessMask
             VK_ACCESS_TRANSFER_READ_BIT,                                   // dstAccessMask
             VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,                               // oldLayout
             VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,                          // newLayout
@@ -178,7 +203,7 @@ public:
         );
 
         auto cmd_transitionForTransferBarrier = vsg::PipelineBarrier::create(
-            VK_PIPELINE_STAGE_TRANSFER_BIT,                       // srcStageMask
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,        // srcStageMask
             VK_PIPELINE_STAGE_TRANSFER_BIT,                       // dstStageMask
             0,                                                    // dependencyFlags
             transitionDestinationImageToDestinationLayoutBarrier, // barrier
@@ -189,7 +214,7 @@ public:
 
         if (supportsBlit)
         {
-            // 3.c.1) if blit using vkCmdBlitImage
+            // 1.c.1) if blit using vkCmdBlitImage
             VkImageBlit region{};
             region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
             region.srcSubresource.layerCount = 1;
@@ -212,7 +237,7 @@ public:
         }
         else
         {
-            // 3.c.2) else use vkCmdCopyImage
+            // 1.c.2) else use vkCmdCopyImage
 
             VkImageCopy region{};
             region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -233,10 +258,10 @@ public:
             commands->addChild(copyImage);
         }
 
-        // 3.d) transition destination image from transfer destination layout to general layout to enable mapping to image DeviceMemory
+        // 1.d) transition destination image from transfer destination layout to general layout to enable mapping to image DeviceMemory
         auto transitionDestinationImageToMemoryReadBarrier = vsg::ImageMemoryBarrier::create(
             VK_ACCESS_TRANSFER_WRITE_BIT,                                  // srcAccessMask
-            VK_ACCESS_MEMORY_READ_BIT,                                     // dstAccessMask
+            VK_ACCESS_HOST_READ_BIT,                                       // dstAccessMask
             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,                          // oldLayout
             VK_IMAGE_LAYOUT_GENERAL,                                       // newLayout
             VK_QUEUE_FAMILY_IGNORED,                                       // srcQueueFamilyIndex
@@ -245,10 +270,10 @@ public:
             VkImageSubresourceRange{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1} // subresourceRange
         );
 
-        // 3.e) transition swap chain image back to present
+        // 1.e) transition swap chain image back to present
         auto transitionSourceImageBackToPresentBarrier = vsg::ImageMemoryBarrier::create(
             VK_ACCESS_TRANSFER_READ_BIT,                                   // srcAccessMask
-            VK_ACCESS_MEMORY_READ_BIT,                                     // dstAccessMask
+            0,                                                             // dstAccessMask
             VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,                          // oldLayout
             VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,                               // newLayout
             VK_QUEUE_FAMILY_IGNORED,                                       // srcQueueFamilyIndex
@@ -258,57 +283,170 @@ public:
         );
 
         auto cmd_transitionFromTransferBarrier = vsg::PipelineBarrier::create(
-            VK_PIPELINE_STAGE_TRANSFER_BIT,                // srcStageMask
-            VK_PIPELINE_STAGE_TRANSFER_BIT,                // dstStageMask
-            0,                                             // dependencyFlags
-            transitionDestinationImageToMemoryReadBarrier, // barrier
-            transitionSourceImageBackToPresentBarrier      // barrier
+            VK_PIPELINE_STAGE_TRANSFER_BIT,                                   // srcStageMask
+            VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, // dstStageMask
+            0,                                                                // dependencyFlags
+            transitionDestinationImageToMemoryReadBarrier,                    // barrier
+            transitionSourceImageBackToPresentBarrier                         // barrier
         );
 
         commands->addChild(cmd_transitionFromTransferBarrier);
 
-        auto fence = vsg::Fence::create(device);
-        auto queueFamilyIndex = physicalDevice->getQueueFamily(VK_QUEUE_GRAPHICS_BIT);
-        auto commandPool = vsg::CommandPool::create(device, queueFamilyIndex);
-        auto queue = device->getQueue(queueFamilyIndex);
+        return commands;
+    }
 
-        vsg::submitCommandsToQueue(commandPool, fence, 100000000000, queue, [&](vsg::CommandBuffer& commandBuffer) {
-            commands->record(commandBuffer);
-        });
+    // map the capture image and hand it on, the mapped memory is kept alive until written
+    void _write(CaptureImage& captureImage, const Writer& writer)
+    {
+        captureImage.pending = false;
+        ++numCaptured;
+
+        auto device = window->getDevice();
+        auto width = captureImage.image->extent.width;
+        auto height = captureImage.image->extent.height;
+        auto deviceMemory = captureImage.image->getDeviceMemory(device->deviceID);
 
-        //
-        // 4) map image and copy
-        //
         VkImageSubresource subResource{VK_IMAGE_ASPECT_COLOR_BIT, 0, 0};
         VkSubresourceLayout subResourceLayout;
-        vkGetImageSubresourceLayout(*device, destinationImage->vk(device->deviceID), &subResource, &subResourceLayout);
+        vkGetImageSubresourceLayout(*device, captureImage.image->vk(device->deviceID), &subResource, &subResourceLayout);
 
         size_t destRowWidth = width * sizeof(vsg::ubvec4);
-        vsg::ref_ptr<vsg::Data> imageData;
         if (destRowWidth == subResourceLayout.rowPitch)
         {
-            imageData = vsg::MappedData<vsg::ubvec4Array2D>::create(deviceMemory, subResourceLayout.offset, 0, vsg::Data::Properties{targetImageFormat}, width, height); // deviceMemory, offset, flags and dimensions
+            captureImage.imageData = vsg::MappedData<vsg::ubvec4Array2D>::create(deviceMemory, subResourceLayout.offset, 0, vsg::Data::Properties{targetImageFormat}, width, height); // deviceMemory, offset, flags and dimensions
+            writer(captureImage.imageData, captureImage.filename, {});
         }
         else
         {
             // Map the buffer memory and assign as a ubyteArray that will automatically unmap itself on destruction.
-            // A ubyteArray is used as the graphics buffer memory is not contiguous like vsg::Array2D, so map to a flat buffer first then copy to Array2D.
-            auto mappedData = vsg::MappedData<vsg::ubyteArray>::create(deviceMemory, subResourceLayout.offset, 0, vsg::Data::Properties{targetImageFormat}, subResourceLayout.rowPitch * height);
-            imageData = vsg::ubvec4Array2D::create(width, height, vsg::Data::Properties{targetImageFormat});
-            for (uint32_t row = 0; row < height; ++row)
-            {
-                std::memcpy(imageData->dataPointer(row * width), mappedData->dataPointer(row * subResourceLayout.rowPitch), destRowWidth);
-            }
+            // A ubyteArray is used as the graphics buffer memory is not contiguous like vsg::Array2D, so map to a flat buffer first and repack the rows into an Array2D when written.
+            captureImage.imageData = vsg::MappedData<vsg::ubyteArray>::create(deviceMemory, subResourceLayout.offset, 0, vsg::Data::Properties{targetImageFormat}, subResourceLayout.rowPitch * height);
+            writer(captureImage.imageData, captureImage.filename, ImageEncoderPool::repackRows(width, height, subResourceLayout.rowPitch, targetImageFormat));
         }
+    }
+};
+
+class ScreenshotHandler : public vsg::Inherit<vsg::Visitor, ScreenshotHandler>
+{
+public:
+    bool do_image_capture = false;
+    bool do_depth_capture = false;
+    vsg::ref_ptr<vsg::Event> event;
+    bool eventDebugTest = false;
+    vsg::Path colorFilename;
+    vsg::Path depthFilename;
+    vsg::ref_ptr<vsg::Options> options;
+
+    // when assigned, images are converted and written on the pool's worker threads rather than the frame thread
+    vsg::ref_ptr<ImageEncoderPool> encoderPool;
+
+    // copies the color image into a ring of capture images as part of the frame's command buffer
+    vsg::ref_ptr<ColorCapture> colorCapture;
+
+    // when recording, a color image is captured every frame and written to a numbered file
+    bool recording = false;
+    uint32_t sequenceNumber = 0;
 
-        if (vsg::write(imageData, colorFilename, options))
+    ScreenshotHandler(vsg::ref_ptr<vsg::Event> in_event, const vsg::Path& in_colorFilename, const vsg::Path& in_depthFilename, vsg::ref_ptr<vsg::Options> in_options = {}) :
+        event(in_event),
+        colorFilename(in_colorFilename),
+        depthFilename(in_depthFilename),
+        options(in_options)
+    {
+    }
+
+    void apply(vsg::KeyPressEvent& keyPress) override
+    {
+        if (keyPress.keyBase == 's')
         {
-            std::cout << "Written color buffer to " << colorFilename << std::endl;
+            do_image_capture = true;
+        }
+        if (keyPress.keyBase == 'd')
+        {
+            do_depth_capture = true;
+        }
+        if (keyPress.keyBase == 'r')
+        {
+            recording = !recording;
+            std::cout << (recording ? "Started" : "Stopped") << " recording image sequence" << std::endl;
+        }
+    }
+
+    vsg::Path sequenceFilename(const vsg::Path& filename)
+    {
+        std::ostringstream str;
+        str << vsg::removeExtension(filename).string() << "_" << std::setw(5) << std::setfill('0') << sequenceNumber++ << vsg::fileExtension(filename).string();
+        return vsg::Path(str.str());
+    }
+
+    void write(vsg::ref_ptr<vsg::Data> imageData, const vsg::Path& filename, ImageEncoderPool::Converter converter = {})
+    {
+        if (encoderPool)
+        {
+            encoderPool->add(imageData, filename, converter);
+            return;
+        }
+
+        if (converter) imageData = converter(imageData);
+        if (imageData && vsg::write(imageData, filename, options))
+        {
+            std::cout << "Written " << filename << std::endl;
         }
         else
         {
-            std::cout << "Failed to write color buffer to " << colorFilename << std::endl;
+            std::cout << "Failed to write " << filename << std::endl;
+        }
+    }
+
+    void printInfo(vsg::ref_ptr<vsg::Window> window)
+    {
+        auto device = window->getDevice();
+        auto physicalDevice = window->getPhysicalDevice();
+        auto swapchain = window->getSwapchain();
+        std::cout << "\nNeed to take screenshot " << window << std::endl;
+        std::cout << "    device = " << device << std::endl;
+        std::cout << "    physicalDevice = " << physicalDevice << std::endl;
+        std::cout << "    swapchain = " << swapchain << std::endl;
+        std::cout << "        swapchain->getImageFormat() = " << swapchain->getImageFormat() << std::endl;
+        std::cout << "        swapchain->getExtent() = " << swapchain->getExtent().width << ", " << swapchain->getExtent().height << std::endl;
+
+        for (auto& imageView : swapchain->getImageViews())
+        {
+            std::cout << "        imageview = " << imageView << std::endl;
+        }
+
+        std::cout << "    numFrames() = " << window->numFrames() << std::endl;
+        for (size_t i = 0; i < window->numFrames(); ++i)
+        {
+            std::cout << "        imageview[" << i << "] = " << window->imageView(i) << std::endl;
+            std::cout << "        framebuffer[" << i << "] = " << window->framebuffer(i) << std::endl;
         }
+
+        std::cout << "    surfaceFormat() = " << window->surfaceFormat().format << ", " << window->surfaceFormat().colorSpace << std::endl;
+        std::cout << "    depthFormat() = " << window->depthFormat() << std::endl;
+    }
+
+    void screenshot_image(uint64_t frameCount)
+    {
+        do_image_capture = false;
+
+        // the copy is recorded into this frame's command buffer, the image is written once the frame has completed
+        auto filename = recording ? sequenceFilename(colorFilename) : colorFilename;
+        if (!colorCapture->capture(filename, frameCount))
+        {
+            std::cout << "Skipped " << filename << " as all the capture images are in use" << std::endl;
+        }
+    }
+
+    void writeCompletedImages(uint64_t frameCount)
+    {
+        colorCapture->completed(frameCount, [&](vsg::ref_ptr<vsg::Data> imageData, const vsg::Path& filename, ImageEncoderPool::Converter converter) { write(imageData, filename, converter); });
+    }
+
+    // write the captures still in flight, call once the device is idle
+    void writePendingImages()
+    {
+        colorCapture->flush([&](vsg::ref_ptr<vsg::Data> imageData, const vsg::Path& filename, ImageEncoderPool::Converter converter) { write(imageData, filename, converter); });
     }
 
     void screenshot_depth(vsg::ref_ptr<vsg::Window> window)
@@ -468,19 +606,13 @@ public:
             std::cout << "num_unset_depth = " << num_unset_depth << std::endl;
             std::cout << "num_set_depth = " << num_set_depth << std::endl;
 
-            if (vsg::write(imageData, depthFilename, options))
-            {
-                std::cout << "Written depth buffer to " << depthFilename << std::endl;
-            }
+            write(imageData, depthFilename);
         }
         else
         {
             auto imageData = vsg::MappedData<vsg::uintArray2D>::create(destinationMemory, 0, 0, vsg::Data::Properties{targetImageFormat}, width, height); // deviceMemory, offset, flags and dimensions
 
-            if (vsg::write(imageData, depthFilename))
-            {
-                std::cout << "Written depth buffer to " << depthFilename << std::endl;
-            }
+            write(imageData, depthFilename);
         }
     }
 };
@@ -516,6 +648,15 @@ int main(int argc, char** argv)
     if (arguments.read("--msaa")) windowTraits->samples = VK_SAMPLE_COUNT_8_BIT;
     if (arguments.read("--float")) windowTraits->depthFormat = VK_FORMAT_D32_SFLOAT;
     auto numFrames = arguments.value(-1, "-f");
+    bool recording = arguments.read("--record");
+
+    // convert and write images on background threads, 0 threads writes them synchronously on the frame thread
+    auto numEncoderThreads = arguments.value<uint32_t>(2, "--encoder-threads");
+    auto encoderQueueSize = arguments.value<size_t>(8, "--encoder-queue");
+    bool dropWhenFull = arguments.read("--drop-when-full");
+
+    // number of images the color captures are copied into, a capture is skipped if all of them are waiting for their frame to complete or to be written
+    auto numCaptureImages = arguments.value<uint32_t>(5, "--capture-images");
 
     // if we are multisampling then to enable copying of the depth buffer we have to enable a depth buffer resolve extension for vsg::RenderPass or require a minimum vulkan version of 1.2
     if (windowTraits->samples != VK_SAMPLE_COUNT_1_BIT) windowTraits->vulkanVersion = VK_API_VERSION_1_2;
@@ -604,9 +745,20 @@ int main(int argc, char** argv)
 
     // Add ScreenshotHandler to respond to keyboard and mouse events.
     auto screenshotHandler = ScreenshotHandler::create(event, colorFilename, depthFilename, options);
+    screenshotHandler->recording = recording;
+    if (numEncoderThreads > 0)
+    {
+        screenshotHandler->encoderPool = ImageEncoderPool::create(numEncoderThreads, encoderQueueSize, options);
+        screenshotHandler->encoderPool->dropWhenFull = dropWhenFull;
+    }
     viewer->addEventHandler(screenshotHandler);
 
     auto commandGraph = vsg::createCommandGraphForView(window, camera, vsg_scene);
+
+    // record the color capture copies after the render pass
+    screenshotHandler->colorCapture = ColorCapture::create(window, numCaptureImages);
+    commandGraph->addChild(screenshotHandler->colorCapture);
+
     if (event) commandGraph->addChild(vsg::SetEvent::create(event, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT));
 
     viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
@@ -621,14 +773,28 @@ int main(int argc, char** argv)
 
         viewer->update();
 
+        auto frameCount = viewer->getFrameStamp()->frameCount;
+        if (screenshotHandler->do_image_capture || screenshotHandler->recording) screenshotHandler->screenshot_image(frameCount);
+
         viewer->recordAndSubmit();
 
-        if (screenshotHandler->do_image_capture) screenshotHandler->screenshot_image(window);
+        screenshotHandler->writeCompletedImages(frameCount);
         if (screenshotHandler->do_depth_capture) screenshotHandler->screenshot_depth(window);
 
         viewer->present();
     }
 
+    // write the captures whose frames were still in flight
+    viewer->deviceWaitIdle();
+    screenshotHandler->writePendingImages();
+    screenshotHandler->colorCapture->report(std::cout);
+
+    if (auto encoderPool = screenshotHandler->encoderPool)
+    {
+        encoderPool->flush();
+        encoderPool->report(std::cout);
+    }
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }
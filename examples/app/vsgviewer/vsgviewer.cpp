@@ -9,6 +9,8 @@
 #include <iostream>
 #include <thread>
 
+#include "SpirvCache.h"
+
 vsg::ref_ptr<vsg::Node> createTextureQuad(vsg::ref_ptr<vsg::Data> sourceData, vsg::ref_ptr<vsg::Options> options)
 {
     auto builder = vsg::Builder::create();
@@ -142,6 +144,9 @@ int main(int argc, char** argv)
             windowTraits->deviceExtensionNames.push_back(VK_KHR_SHADER_NON_SEMANTIC_INFO_EXTENSION_NAME);
         }
 
+        // use SPIR-V compiled by earlier runs or by vsgprecompileshaders rather than compiling GLSL, i.e. --spirv-cache spirv_cache
+        auto spirvCacheDirectory = arguments.value<vsg::Path>("", "--spirv-cache");
+
         if (int log_level = 0; arguments.read("--log-level", log_level)) vsg::Logger::instance()->level = vsg::Logger::Level(log_level);
         auto logFilename = arguments.value<vsg::Path>("", "--log");
 
@@ -379,6 +384,15 @@ int main(int argc, char** argv)
             vsg::setAffinity(affinity);
         }
 
+        if (spirvCacheDirectory)
+        {
+            // fill in the SPIR-V of the scene's shaders from the cache, compiling and caching any that miss, so viewer->compile() has no GLSL left to compile
+            auto spirvCache = SpirvCache::create(spirvCacheDirectory);
+            auto stages = vsg::visit<CollectShaderStages>(vsg_scene).stages;
+            if (!spirvCache->compile(stages, vsg::ShaderCompiler::create(), options)) vsg::warn("Unable to compile all the shaders through the SPIR-V cache.");
+            spirvCache->report(std::cout);
+        }
+
         viewer->compile(resourceHints);
 
         if (maxPagedLOD > 0)
@@ -9,6 +9,8 @@
 #include <iostream>
 #include <thread>
 
+#include "ResidencyBudget.h"
+
 class StdAllocator : public vsg::Allocator
 {
 public:
@@ -118,6 +120,7 @@ int main(int argc, char** argv)
         auto loadLevels = arguments.value(0, "--load-levels");
         auto horizonMountainHeight = arguments.value(0.0, "--hmh");
         auto maxPagedLOD = arguments.value(0, "--maxPagedLOD");
+        auto residencyBudgetMB = arguments.value<uint64_t>(0, "--budget");
         if (arguments.read("--rgb")) options->mapRGBtoRGBAHint = false;
 
         size_t stats = 0;
@@ -135,6 +138,12 @@ int main(int argc, char** argv)
 
         if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
+        if (residencyBudgetMB > 0 && maxPagedLOD > 0)
+        {
+            std::cout << "--budget sets targetMaxNumPagedLODWithHighResSubgraphs each frame, so can't be combined with --maxPagedLOD." << std::endl;
+            return 1;
+        }
+
         // if required set the affinity of the main thread.
         if (affinity) vsg::setAffinity(affinity);
 
@@ -271,6 +280,8 @@ int main(int argc, char** argv)
                 }
             }
 
+            auto residencyBudget = ResidencyBudget::install(*viewer, vsg_scene, residencyBudgetMB * 1024 * 1024);
+
             auto startOfFrameLopp = vsg::clock::now();
 
             // rendering main loop
@@ -281,6 +292,8 @@ int main(int argc, char** argv)
 
                 viewer->update();
 
+                if (residencyBudget) residencyBudget->update(viewer->getFrameStamp());
+
                 viewer->recordAndSubmit();
 
                 viewer->present();
@@ -296,6 +309,8 @@ int main(int argc, char** argv)
                 auto duration = std::chrono::duration<double, std::chrono::seconds::period>(vsg::clock::now() - startOfFrameLopp).count();
                 frameRate = (double(viewer->getFrameStamp()->frameCount) / duration);
             }
+
+            if (residencyBudget) residencyBudget->report(std::cout);
         }
 
         std::cout << "\nBefore end of Viewer scope." << std::endl;
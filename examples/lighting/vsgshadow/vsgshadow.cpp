@@ -10,6 +10,8 @@
 
 #include <iostream>
 
+#include "ShapeBatcher.h"
+
 struct ModelSettings
 {
     vsg::ref_ptr<vsg::Options> options;
@@ -19,6 +21,9 @@ struct ModelSettings
     bool insertCullNode = false;
     bool insertLODNode = false;
     uint32_t targetNumObjects = 1000;
+    bool useShapeCache = false; // share the tessellated geometry between shapes that differ only in position
+    uint32_t numColors = 0;     // when non zero pick random colors from a palette of this size, so shapes can share geometry
+    bool useInstancing = false; // draw the repeated shapes with one instanced draw per shape type
 };
 
 vsg::ref_ptr<vsg::Node> decorateIfRequired(vsg::ref_ptr<vsg::Node> node, const ModelSettings& settings)
@@ -97,6 +102,9 @@ vsg::ref_ptr<vsg::Node> createLargeTestScene(const ModelSettings& settings)
     auto builder = vsg::Builder::create();
     builder->options = settings.options;
 
+    auto shapeCache = ShapeCache::create(builder);
+    auto shapeBatcher = ShapeBatcher::create(builder);
+
     auto scene = vsg::Group::create();
 
     vsg::GeometryInfo geomInfo;
@@ -105,6 +113,15 @@ vsg::ref_ptr<vsg::Node> createLargeTestScene(const ModelSettings& settings)
     vsg::StateInfo stateInfo;
     if (settings.textureFile) stateInfo.image = vsg::read_cast<vsg::Data>(settings.textureFile, settings.options);
 
+    std::vector<vsg::vec4> palette(settings.numColors);
+    for (auto& color : palette)
+    {
+        color.set(float(std::rand()) / float(RAND_MAX),
+                  float(std::rand()) / float(RAND_MAX),
+                  float(std::rand()) / float(RAND_MAX),
+                  1.0f);
+    }
+
     vsg::box bounds(vsg::vec3(0.0f, 0.0f, 0.0f), vsg::vec3(1000.0f, 1000.0f, 20.0f));
 
     uint32_t numBoxes = (400 * settings.targetNumObjects) / 1000;
@@ -123,16 +140,31 @@ vsg::ref_ptr<vsg::Node> createLargeTestScene(const ModelSettings& settings)
         geomInfo.dy.set(0.0f, length, 0.0f);
         geomInfo.dz.set(0.0f, 0.0f, length);
 
-        geomInfo.color.set(float(std::rand()) / float(RAND_MAX),
-                           float(std::rand()) / float(RAND_MAX),
-                           float(std::rand()) / float(RAND_MAX),
-                           1.0f);
+        if (palette.empty())
+        {
+            geomInfo.color.set(float(std::rand()) / float(RAND_MAX),
+                               float(std::rand()) / float(RAND_MAX),
+                               float(std::rand()) / float(RAND_MAX),
+                               1.0f);
+        }
+        else
+        {
+            geomInfo.color = palette[static_cast<size_t>(std::rand()) % palette.size()];
+        }
     };
 
+    auto startTime = vsg::clock::now();
+
     for (uint32_t bi = 0; bi < numBoxes; ++bi)
     {
         assignRandomGeometryInfo();
-        auto model = decorateIfRequired(builder->createBox(geomInfo, stateInfo), settings);
+        if (settings.useInstancing)
+        {
+            shapeBatcher->add(ShapeCache::BOX, geomInfo, stateInfo);
+            continue;
+        }
+
+        auto model = decorateIfRequired(settings.useShapeCache ? shapeCache->createBox(geomInfo, stateInfo) : builder->createBox(geomInfo, stateInfo), settings);
         // vsg::info("BOX geomInfo.position = ", geomInfo.position, ", ", model);
         scene->addChild(model);
     }
@@ -140,7 +172,13 @@ vsg::ref_ptr<vsg::Node> createLargeTestScene(const ModelSettings& settings)
     for (uint32_t bi = 0; bi < numSpheres; ++bi)
     {
         assignRandomGeometryInfo();
-        auto model = decorateIfRequired(builder->createSphere(geomInfo, stateInfo), settings);
+        if (settings.useInstancing)
+        {
+            shapeBatcher->add(ShapeCache::SPHERE, geomInfo, stateInfo);
+            continue;
+        }
+
+        auto model = decorateIfRequired(settings.useShapeCache ? shapeCache->createSphere(geomInfo, stateInfo) : builder->createSphere(geomInfo, stateInfo), settings);
         // vsg::info("Sphere geomInfo.position = ", geomInfo.position, ", ", model);
         scene->addChild(model);
     }
@@ -148,11 +186,25 @@ vsg::ref_ptr<vsg::Node> createLargeTestScene(const ModelSettings& settings)
     for (uint32_t bi = 0; bi < numCapsules; ++bi)
     {
         assignRandomGeometryInfo();
-        auto model = decorateIfRequired(builder->createCapsule(geomInfo, stateInfo), settings);
+        if (settings.useInstancing)
+        {
+            shapeBatcher->add(ShapeCache::CAPSULE, geomInfo, stateInfo);
+            continue;
+        }
+
+        auto model = decorateIfRequired(settings.useShapeCache ? shapeCache->createCapsule(geomInfo, stateInfo) : builder->createCapsule(geomInfo, stateInfo), settings);
         // vsg::info("Capsule geomInfo.position = ", geomInfo.position, ", ", model);
         scene->addChild(model);
     }
 
+    if (settings.useInstancing) scene->addChild(shapeBatcher->build());
+
+    auto creationTime = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+    std::cout << "createLargeTestScene() created " << (numBoxes + numSpheres + numCapsules) << " shapes in " << creationTime << "ms" << std::endl;
+    if (settings.useInstancing) shapeBatcher->report(std::cout);
+    if (settings.useShapeCache) shapeCache->report(std::cout);
+    vsg::visit<CollectGeometryStats>(scene).report(std::cout);
+
     if (settings.insertBaseGeometry)
     {
         float diameter = static_cast<float>(vsg::length(bounds.max - bounds.min));
@@ -267,6 +319,15 @@ int main(int argc, char** argv)
     settings.insertCullNode = arguments.read("--cull");
     settings.insertLODNode = arguments.read("--lod");
     arguments.read("--target", settings.targetNumObjects);
+    settings.useShapeCache = arguments.read("--shape-cache");
+    arguments.read("--colors", settings.numColors);
+    settings.useInstancing = arguments.read("--instance");
+    if (settings.useInstancing && settings.insertLODNode)
+    {
+        // an instanced draw covers every shape of its type, so an LOD could only cull the whole batch rather than the distant shapes
+        std::cout << "--lod is not supported with --instance, as the instanced shapes are drawn together." << std::endl;
+        return 1;
+    }
 
     auto numShadowMapsPerLight = arguments.value<uint32_t>(1, "--sm");
     auto numLights = arguments.value<uint32_t>(1, "-n");
@@ -686,6 +747,7 @@ int main(int argc, char** argv)
         if (numFramesCompleted > 0.0)
         {
             std::cout << "Average frame rate = " << (numFramesCompleted / elapesedTime) << std::endl;
+            std::cout << "Average frame time = " << (elapesedTime * 1000.0 / numFramesCompleted) << "ms" << std::endl;
         }
     }
 
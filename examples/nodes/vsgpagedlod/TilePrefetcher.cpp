@@ -0,0 +1,189 @@
+#include "TilePrefetcher.h"
+
+#include <algorithm>
+
+namespace
+{
+    // collect the PagedLOD whose bounds would be in view and large enough on screen to need their high resolution child.
+    // Assumes PagedLOD bounds are in world coordinates, as is the case for the tiles created by TileReader.
+    class CollectTiles : public vsg::Visitor
+    {
+    public:
+        CollectTiles(const vsg::dmat4& in_view, const vsg::dmat4& projection) :
+            view(in_view),
+            sx(std::abs(projection[0][0])),
+            sy(std::abs(projection[1][1])),
+            sx_norm(std::sqrt(sx * sx + 1.0)),
+            sy_norm(std::sqrt(sy * sy + 1.0))
+        {
+        }
+
+        const vsg::dmat4 view;
+        const double sx;
+        const double sy;
+        const double sx_norm;
+        const double sy_norm;
+
+        std::vector<vsg::PagedLOD*> loaded;
+        std::vector<vsg::PagedLOD*> unloaded;
+        std::vector<double> unloadedRatios; // how far beyond the transition point each unloaded tile is, used as the request priority
+
+        void apply(vsg::Node& node) override
+        {
+            node.traverse(*this);
+        }
+
+        void apply(vsg::PagedLOD& plod) override
+        {
+            auto& sphere = plod.bound;
+            auto v = view * sphere.center;
+            double z = -v.z;
+
+            // cull against the side planes of the view frustum
+            if (z + sphere.radius <= 0.0) return;
+            if ((std::abs(v.x) * sx - z) / sx_norm > sphere.radius) return;
+            if ((std::abs(v.y) * sy - z) / sy_norm > sphere.radius) return;
+
+            // same test as the RecordTraversal, high resolution child required when sphere.radius exceeds lodDistance * minimumScreenHeightRatio
+            auto& highRes = plod.children[0];
+            double cutoff = (z / sy) * highRes.minimumScreenHeightRatio;
+            if (sphere.radius <= cutoff) return;
+
+            if (highRes.node)
+            {
+                loaded.push_back(&plod);
+                highRes.node->accept(*this);
+            }
+            else
+            {
+                unloaded.push_back(&plod);
+                unloadedRatios.push_back(cutoff > 0.0 ? sphere.radius / cutoff : 2.0);
+            }
+        }
+    };
+} // namespace
+
+TilePrefetcher::TilePrefetcher(vsg::ref_ptr<vsg::Camera> in_camera, vsg::ref_ptr<vsg::Node> in_scene) :
+    camera(in_camera),
+    scene(in_scene),
+    _startTime(vsg::clock::now())
+{
+}
+
+void TilePrefetcher::update(vsg::ref_ptr<vsg::FrameStamp> frameStamp)
+{
+    auto lookAt = camera->viewMatrix.cast<vsg::LookAt>();
+    if (!lookAt || !scene || !frameStamp) return;
+
+    ++numFrames;
+
+    double time = std::chrono::duration<double, std::chrono::seconds::period>(frameStamp->time - _startTime).count();
+    _history.push_back(CameraSample{time, lookAt->eye, lookAt->center, lookAt->up});
+    while (_history.size() > historySize) _history.pop_front();
+
+    auto projection = camera->projectionMatrix->transform();
+
+    // measure what the current view needs
+    CollectTiles current(lookAt->transform(), projection);
+    scene->accept(current);
+
+    for (auto plod : current.loaded)
+    {
+        if (_needed.insert(plod->filename).second) ++numHits;
+    }
+
+    for (auto plod : current.unloaded)
+    {
+        if (_needed.insert(plod->filename).second) ++numMisses;
+    }
+
+    if (!current.unloaded.empty()) ++numCoarseFrames;
+
+    if (!enabled || !databasePager || _history.size() < 2) return;
+
+    // least squares estimate of the eye and center velocities over the recorded frames
+    double meanTime = 0.0;
+    vsg::dvec3 meanEye, meanCenter;
+    for (auto& sample : _history)
+    {
+        meanTime += sample.time;
+        meanEye += sample.eye;
+        meanCenter += sample.center;
+    }
+
+    double invCount = 1.0 / static_cast<double>(_history.size());
+    meanTime *= invCount;
+    meanEye *= invCount;
+    meanCenter *= invCount;
+
+    double sumTimeSquared = 0.0;
+    vsg::dvec3 eyeVelocity, centerVelocity;
+    for (auto& sample : _history)
+    {
+        double dt = sample.time - meanTime;
+        sumTimeSquared += dt * dt;
+        eyeVelocity += (sample.eye - meanEye) * dt;
+        centerVelocity += (sample.center - meanCenter) * dt;
+    }
+
+    if (sumTimeSquared <= 0.0) return;
+
+    eyeVelocity /= sumTimeSquared;
+    centerVelocity /= sumTimeSquared;
+
+    // nothing to predict when the camera is stationary
+    if (vsg::length(eyeVelocity) == 0.0 && vsg::length(centerVelocity) == 0.0) return;
+
+    auto& latest = _history.back();
+    uint32_t numRequestsThisFrame = 0;
+
+    for (uint32_t i = 1; i <= numSamples; ++i)
+    {
+        double dt = lookAhead * static_cast<double>(i) / static_cast<double>(numSamples);
+        auto predictedView = vsg::lookAt(latest.eye + eyeVelocity * dt, latest.center + centerVelocity * dt, latest.up);
+
+        CollectTiles predicted(predictedView, projection);
+        scene->accept(predicted);
+
+        for (size_t t = 0; t < predicted.unloaded.size(); ++t)
+        {
+            auto plod = predicted.unloaded[t];
+
+            // tiles the current view needs are left to the RecordTraversal's own requests
+            if (std::find(current.unloaded.begin(), current.unloaded.end(), plod) != current.unloaded.end()) continue;
+
+            bool newRequest = _prefetched.count(plod->filename) == 0;
+            if (newRequest && numRequestsThisFrame >= maxRequestsPerFrame) continue;
+
+            // negative priorities sort below every on-demand request, tiles further along the path and closer to their transition point are less urgent.
+            // frameHighResLastUsed is deliberately left alone so tiles along a mispredicted path still expire.
+            plod->priority = -static_cast<double>(i) / predicted.unloadedRatios[t];
+
+            databasePager->request(vsg::ref_ptr<vsg::PagedLOD>(plod));
+
+            if (newRequest)
+            {
+                _prefetched.insert(plod->filename);
+                ++numPrefetchRequests;
+                ++numRequestsThisFrame;
+            }
+        }
+    }
+}
+
+void TilePrefetcher::report(std::ostream& out) const
+{
+    size_t numWasted = 0;
+    for (auto& filename : _prefetched)
+    {
+        if (_needed.count(filename) == 0) ++numWasted;
+    }
+
+    double hitRate = (numHits + numMisses) > 0 ? static_cast<double>(numHits) / static_cast<double>(numHits + numMisses) : 0.0;
+
+    out << "prefetch " << (enabled ? "enabled" : "disabled") << std::endl;
+    out << "    numFrames = " << numFrames << std::endl;
+    out << "    numCoarseFrames = " << numCoarseFrames << std::endl;
+    out << "    numPrefetchRequests = " << numPrefetchRequests << ", never needed = " << numWasted << std::endl;
+    out << "    numHits = " << numHits << ", numMisses = " << numMisses << ", hit rate = " << hitRate * 100.0 << "%" << std::endl;
+}
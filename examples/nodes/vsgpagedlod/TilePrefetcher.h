@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <deque>
+#include <ostream>
+#include <set>
+
+/// TilePrefetcher extrapolates the camera's LookAt over the last few frames and requests the PagedLOD high resolution
+/// children that will cross their minimumScreenHeightRatio within the lookAhead period, so they are loaded before they come into view.
+/// Requests are submitted with negative priorities so the DatabasePager reads them after any tile the current view needs.
+/// It also measures how often tiles are already loaded when first needed, and how many frames show coarse tiles, whether or not prefetching is enabled.
+class TilePrefetcher : public vsg::Inherit<vsg::Object, TilePrefetcher>
+{
+public:
+    TilePrefetcher(vsg::ref_ptr<vsg::Camera> in_camera, vsg::ref_ptr<vsg::Node> in_scene);
+
+    vsg::ref_ptr<vsg::Camera> camera;
+    vsg::ref_ptr<vsg::Node> scene;
+    vsg::ref_ptr<vsg::DatabasePager> databasePager;
+
+    bool enabled = true;
+    double lookAhead = 1.0;            // seconds
+    uint32_t numSamples = 4;           // positions along the predicted trajectory that are tested
+    size_t historySize = 8;            // number of frames used to estimate the camera velocity
+    uint32_t maxRequestsPerFrame = 16; // limit on the number of new prefetch requests issued each frame
+
+    /// call once per frame after the camera has been updated by event handlers and before the record traversal.
+    void update(vsg::ref_ptr<vsg::FrameStamp> frameStamp);
+
+    void report(std::ostream& out) const;
+
+    // stats
+    uint64_t numFrames = 0;
+    uint64_t numCoarseFrames = 0;     // frames where at least one visible tile needed a high resolution child that wasn't loaded
+    uint64_t numPrefetchRequests = 0; // tiles requested ahead of time
+    uint64_t numHits = 0;             // tiles already loaded when first needed
+    uint64_t numMisses = 0;           // tiles that still had to be loaded when first needed
+
+protected:
+    struct CameraSample
+    {
+        double time;
+        vsg::dvec3 eye;
+        vsg::dvec3 center;
+        vsg::dvec3 up;
+    };
+
+    std::deque<CameraSample> _history;
+    vsg::time_point _startTime;
+
+    std::set<vsg::Path> _needed;     // tiles that have already been needed by the current view
+    std::set<vsg::Path> _prefetched; // tiles requested by the prefetcher
+};
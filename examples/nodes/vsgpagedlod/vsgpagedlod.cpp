@@ -7,6 +7,8 @@
 #include <iostream>
 #include <thread>
 
+#include "TilePack.h"
+#include "TilePrefetcher.h"
 #include "TileReader.h"
 
 int main(int argc, char** argv)
@@ -46,6 +48,9 @@ int main(int argc, char** argv)
 
         arguments.read("--file-cache", options->fileCache);
         bool osgEarthStyleMouseButtons = arguments.read({"--osgearth", "-e"});
+        bool prefetch = arguments.read("--prefetch");
+        bool prefetchStats = arguments.read("--prefetch-stats");
+        auto prefetchTime = arguments.value(1.0, "--prefetch-time");
 
         uint32_t numOperationThreads = 0;
         if (arguments.read("--ot", numOperationThreads)) options->operationThreads = vsg::OperationThreads::create(numOperationThreads);
@@ -75,6 +80,20 @@ int main(int argc, char** argv)
         arguments.read("-t", tileReader->lodTransitionScreenHeightRatio);
         arguments.read("-m", tileReader->maxLevel);
 
+        // serve image tiles from a single memory mapped pack file ahead of the URL template, adding any that are missing as they are downloaded.
+        vsg::ref_ptr<TilePack> tilePack;
+        if (vsg::Path packFilename; arguments.read("--pack", packFilename))
+        {
+            auto packSizeMB = arguments.value<uint64_t>(1024, "--pack-size");
+            tilePack = TilePack::create(packFilename, packSizeMB * 1024 * 1024);
+            if (tilePack->valid())
+            {
+                auto tilePackReaderWriter = TilePackReaderWriter::create(tilePack, std::vector<vsg::Path>{tileReader->imageLayer});
+                tilePackReaderWriter->readOnly = arguments.read("--pack-read-only");
+                options->readerWriters.insert(options->readerWriters.begin(), tilePackReaderWriter);
+            }
+        }
+
         const double invalid_value = std::numeric_limits<double>::max();
         double poi_latitude = invalid_value;
         double poi_longitude = invalid_value;
@@ -225,12 +244,27 @@ int main(int argc, char** argv)
             }
         }
 
+        // request tiles along the camera's extrapolated trajectory, with --prefetch-stats alone just measure how often coarse tiles are shown.
+        vsg::ref_ptr<TilePrefetcher> prefetcher;
+        if (prefetch || prefetchStats)
+        {
+            prefetcher = TilePrefetcher::create(camera, vsg_scene);
+            prefetcher->enabled = prefetch;
+            prefetcher->lookAhead = prefetchTime;
+            for (auto& task : viewer->recordAndSubmitTasks)
+            {
+                if (task->databasePager) prefetcher->databasePager = task->databasePager;
+            }
+        }
+
         // rendering main loop
         while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
         {
             // pass any events into EventHandlers assigned to the Viewer
             viewer->handleEvents();
 
+            if (prefetcher) prefetcher->update(viewer->getFrameStamp());
+
             viewer->update();
 
             viewer->recordAndSubmit();
@@ -244,6 +278,17 @@ int main(int argc, char** argv)
             std::cout << "numTilesRead = " << tileReader->numTilesRead << std::endl;
             std::cout << "average TimeReadingTiles = " << (tileReader->totalTimeReadingTiles / static_cast<double>(tileReader->numTilesRead)) << std::endl;
         }
+
+        if (prefetcher) prefetcher->report(std::cout);
+
+        if (tilePack)
+        {
+            tilePack->flush();
+
+            auto stats = tilePack->getStats();
+            std::cout << "tilePack hits = " << stats.hits << ", misses = " << stats.misses << ", writes = " << stats.writes << ", evictions = " << stats.evictions << std::endl;
+            std::cout << "tilePack numTiles = " << stats.numTiles << ", liveBytes = " << stats.liveBytes << ", fileSize = " << stats.fileSize << std::endl;
+        }
     }
     catch (const vsg::Exception& ve)
     {
@@ -0,0 +1,244 @@
+#include "CompressTextures.h"
+
+#include <cstring>
+
+namespace
+{
+    uint16_t toRGB565(const vsg::ubvec4& c)
+    {
+        return static_cast<uint16_t>(((c.r >> 3) << 11) | ((c.g >> 2) << 5) | (c.b >> 3));
+    }
+
+    vsg::ubvec4 fromRGB565(uint16_t v)
+    {
+        uint8_t r = static_cast<uint8_t>((v >> 11) & 0x1f);
+        uint8_t g = static_cast<uint8_t>((v >> 5) & 0x3f);
+        uint8_t b = static_cast<uint8_t>(v & 0x1f);
+        return vsg::ubvec4(static_cast<uint8_t>((r << 3) | (r >> 2)), static_cast<uint8_t>((g << 2) | (g >> 4)), static_cast<uint8_t>((b << 3) | (b >> 2)), 255);
+    }
+
+    // encode a 4x4 block of texels using the bounding box of the block colours as the end points
+    void encodeBlock(const vsg::ubvec4 texels[16], uint8_t* block)
+    {
+        vsg::ubvec4 minColor(255, 255, 255, 255), maxColor(0, 0, 0, 255);
+        for (int i = 0; i < 16; ++i)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                minColor[c] = std::min(minColor[c], texels[i][c]);
+                maxColor[c] = std::max(maxColor[c], texels[i][c]);
+            }
+        }
+
+        // inset the bounding box slightly to reduce the error at the end points
+        for (int c = 0; c < 3; ++c)
+        {
+            uint8_t inset = static_cast<uint8_t>((maxColor[c] - minColor[c]) >> 4);
+            minColor[c] = static_cast<uint8_t>(minColor[c] + inset);
+            maxColor[c] = static_cast<uint8_t>(maxColor[c] - inset);
+        }
+
+        uint16_t c0 = toRGB565(maxColor);
+        uint16_t c1 = toRGB565(minColor);
+        if (c0 < c1) std::swap(c0, c1);
+
+        uint32_t indices = 0;
+        if (c0 != c1)
+        {
+            // four colour mode as c0 > c1
+            auto p0 = fromRGB565(c0);
+            auto p1 = fromRGB565(c1);
+            int palette[4][3];
+            for (int c = 0; c < 3; ++c)
+            {
+                palette[0][c] = p0[c];
+                palette[1][c] = p1[c];
+                palette[2][c] = (2 * p0[c] + p1[c]) / 3;
+                palette[3][c] = (p0[c] + 2 * p1[c]) / 3;
+            }
+
+            for (int i = 0; i < 16; ++i)
+            {
+                uint32_t best = 0;
+                int bestDistance = std::numeric_limits<int>::max();
+                for (uint32_t p = 0; p < 4; ++p)
+                {
+                    int distance = 0;
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        int delta = static_cast<int>(texels[i][c]) - palette[p][c];
+                        distance += delta * delta;
+                    }
+                    if (distance < bestDistance)
+                    {
+                        bestDistance = distance;
+                        best = p;
+                    }
+                }
+                indices |= best << (2 * i);
+            }
+        }
+
+        block[0] = static_cast<uint8_t>(c0 & 0xff);
+        block[1] = static_cast<uint8_t>(c0 >> 8);
+        block[2] = static_cast<uint8_t>(c1 & 0xff);
+        block[3] = static_cast<uint8_t>(c1 >> 8);
+        std::memcpy(block + 4, &indices, 4); // little endian as required by BC1
+    }
+
+    // 2x2 box filter to the next mipmap level
+    std::vector<vsg::ubvec4> downsample(const std::vector<vsg::ubvec4>& src, uint32_t width, uint32_t height, uint32_t newWidth, uint32_t newHeight)
+    {
+        std::vector<vsg::ubvec4> dest(newWidth * newHeight);
+        for (uint32_t r = 0; r < newHeight; ++r)
+        {
+            uint32_t r0 = std::min(r * 2, height - 1);
+            uint32_t r1 = std::min(r * 2 + 1, height - 1);
+            for (uint32_t c = 0; c < newWidth; ++c)
+            {
+                uint32_t c0 = std::min(c * 2, width - 1);
+                uint32_t c1 = std::min(c * 2 + 1, width - 1);
+                auto& t00 = src[r0 * width + c0];
+                auto& t01 = src[r0 * width + c1];
+                auto& t10 = src[r1 * width + c0];
+                auto& t11 = src[r1 * width + c1];
+                auto& result = dest[r * newWidth + c];
+                for (int i = 0; i < 4; ++i)
+                {
+                    result[i] = static_cast<uint8_t>((t00[i] + t01[i] + t10[i] + t11[i] + 2) / 4);
+                }
+            }
+        }
+        return dest;
+    }
+} // namespace
+
+vsg::ref_ptr<vsg::Data> CompressTextures::compress(const vsg::ubvec4Array2D& image)
+{
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    if (image.properties.format == VK_FORMAT_R8G8B8A8_UNORM)
+        format = VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    else if (image.properties.format == VK_FORMAT_R8G8B8A8_SRGB)
+        format = VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+    else
+        return {};
+
+    uint32_t width = image.width();
+    uint32_t height = image.height();
+    if (width == 0 || height == 0 || (width % 4) != 0 || (height % 4) != 0) return {};
+
+    // the VSG steps through the mip levels of block compressed data by halving the block counts, which only matches the texel
+    // sizes of the levels for power of two images, so leave others uncompressed
+    if ((width & (width - 1)) != 0 || (height & (height - 1)) != 0) return {};
+
+    // BC1 without alpha, so leave translucent images alone
+    for (auto& texel : image)
+    {
+        if (texel.a != 255) return {};
+    }
+
+    uint32_t numMipmaps = 1;
+    while ((std::max(width, height) >> numMipmaps) > 0) ++numMipmaps;
+
+    // each level is max(1, size >> level) texels across, rounded up to whole blocks, so the smallest levels are padded out to 4x4
+    auto levelBlocks = [](uint32_t size, uint32_t level) { return (std::max(1u, size >> level) + 3) / 4; };
+
+    uint32_t blocksWide = width / 4;
+    uint32_t blocksHigh = height / 4;
+    size_t numBlocks = 0;
+    for (uint32_t level = 0; level < numMipmaps; ++level)
+    {
+        numBlocks += static_cast<size_t>(levelBlocks(width, level)) * static_cast<size_t>(levelBlocks(height, level));
+    }
+
+    auto blocks = static_cast<uint8_t*>(vsg::allocate(numBlocks * 8, vsg::ALLOCATOR_AFFINITY_DATA));
+    uint8_t* block = blocks;
+
+    std::vector<vsg::ubvec4> texels(image.begin(), image.end());
+    uint32_t levelWidth = width;
+    uint32_t levelHeight = height;
+    for (uint32_t level = 0; level < numMipmaps; ++level)
+    {
+        uint32_t levelBlocksWide = levelBlocks(width, level);
+        uint32_t levelBlocksHigh = levelBlocks(height, level);
+        for (uint32_t br = 0; br < levelBlocksHigh; ++br)
+        {
+            for (uint32_t bc = 0; bc < levelBlocksWide; ++bc)
+            {
+                vsg::ubvec4 blockTexels[16];
+                for (uint32_t i = 0; i < 16; ++i)
+                {
+                    uint32_t r = std::min(br * 4 + i / 4, levelHeight - 1);
+                    uint32_t c = std::min(bc * 4 + i % 4, levelWidth - 1);
+                    blockTexels[i] = texels[r * levelWidth + c];
+                }
+                encodeBlock(blockTexels, block);
+                block += 8;
+            }
+        }
+
+        if (level + 1 < numMipmaps)
+        {
+            uint32_t newWidth = std::max(1u, levelWidth / 2);
+            uint32_t newHeight = std::max(1u, levelHeight / 2);
+            texels = downsample(texels, levelWidth, levelHeight, newWidth, newHeight);
+            levelWidth = newWidth;
+            levelHeight = newHeight;
+        }
+    }
+
+    // the blocks were allocated with vsg::allocate(), whatever allocated the source image's texels
+    auto properties = image.properties;
+    properties.allocatorType = vsg::ALLOCATOR_TYPE_VSG_ALLOCATOR;
+    properties.format = format;
+    properties.blockWidth = 4;
+    properties.blockHeight = 4;
+    properties.maxNumMipmaps = static_cast<uint8_t>(numMipmaps);
+
+    return vsg::block64Array2D::create(blocksWide, blocksHigh, reinterpret_cast<vsg::block64*>(blocks), properties);
+}
+
+void CompressTextures::apply(vsg::Object& object)
+{
+    object.traverse(*this);
+}
+
+void CompressTextures::apply(vsg::StateGroup& stateGroup)
+{
+    for (auto& stateCommand : stateGroup.stateCommands) stateCommand->accept(*this);
+    stateGroup.traverse(*this);
+}
+
+void CompressTextures::apply(vsg::PagedLOD& plod)
+{
+    // only the tile's own geometry, the high resolution children are baked separately
+    if (plod.children[1].node) plod.children[1].node->accept(*this);
+}
+
+void CompressTextures::apply(vsg::DescriptorImage& descriptorImage)
+{
+    for (auto& imageInfo : descriptorImage.imageInfoList)
+    {
+        if (!imageInfo->imageView || !imageInfo->imageView->image) continue;
+
+        auto image = imageInfo->imageView->image;
+        auto source = image->data.cast<vsg::ubvec4Array2D>();
+        if (!source) continue;
+
+        auto& compressed = _compressed[source.get()];
+        if (!compressed)
+        {
+            compressed = compress(*source);
+            if (!compressed) continue;
+
+            ++numCompressed;
+            originalBytes += source->dataSize();
+            for (uint32_t level = 0; level < compressed->properties.maxNumMipmaps; ++level)
+            {
+                compressedBytes += std::max(1u, compressed->width() >> level) * std::max(1u, compressed->height() >> level) * compressed->properties.stride;
+            }
+        }
+
+        imageInfo->imageView = vsg::ImageView::create(vsg::Image::create(compressed));
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <map>
+
+/// CompressTextures replaces the RGBA8 images used by DescriptorImage in a subgraph with BC1 compressed copies that include
+/// a full mipmap chain, so tiles are written to disk GPU ready and no mipmaps need to be generated when they are compiled.
+/// Images with translucent texels or dimensions that aren't a multiple of 4 are left untouched.
+class CompressTextures : public vsg::Visitor
+{
+public:
+    uint64_t numCompressed = 0;
+    uint64_t originalBytes = 0;
+    uint64_t compressedBytes = 0;
+
+    void apply(vsg::Object& object) override;
+    void apply(vsg::StateGroup& stateGroup) override;
+    void apply(vsg::PagedLOD& plod) override;
+    void apply(vsg::DescriptorImage& descriptorImage) override;
+
+    /// return a BC1 compressed copy of the image including all mipmap levels, or null if the image can't be compressed.
+    static vsg::ref_ptr<vsg::Data> compress(const vsg::ubvec4Array2D& image);
+
+protected:
+    std::map<const vsg::Data*, vsg::ref_ptr<vsg::Data>> _compressed;
+};
@@ -0,0 +1,106 @@
+#include "RasterLayer.h"
+#include "TileTemplate.h"
+
+#include <algorithm>
+
+namespace
+{
+    // nearest neighbour resample of the part of the raster covered by the tile extents
+    struct CropRaster : public vsg::ConstVisitor
+    {
+        vsg::dbox rasterExtents;
+        vsg::dbox tileExtents;
+        uint32_t width = 256;
+        uint32_t height = 256;
+        vsg::ref_ptr<vsg::Data> result;
+
+        template<class A>
+        void crop(const A& src)
+        {
+            auto dest = A::create(width, height, src.properties);
+
+            double rasterWidth = rasterExtents.max.x - rasterExtents.min.x;
+            double rasterHeight = rasterExtents.max.y - rasterExtents.min.y;
+            double dx = (tileExtents.max.x - tileExtents.min.x) / static_cast<double>(width);
+            double dy = (tileExtents.max.y - tileExtents.min.y) / static_cast<double>(height);
+            bool topLeft = src.properties.origin == vsg::TOP_LEFT;
+
+            auto clamp_index = [](double value, uint32_t size) -> uint32_t {
+                if (value <= 0.0) return 0;
+                return std::min(static_cast<uint32_t>(value), size - 1);
+            };
+
+            for (uint32_t r = 0; r < height; ++r)
+            {
+                // keep the same row order as the source
+                double latitude = topLeft ? (tileExtents.max.y - (static_cast<double>(r) + 0.5) * dy) : (tileExtents.min.y + (static_cast<double>(r) + 0.5) * dy);
+                double v = (latitude - rasterExtents.min.y) / rasterHeight * static_cast<double>(src.height());
+                uint32_t sr = clamp_index(topLeft ? (static_cast<double>(src.height()) - v) : v, src.height());
+
+                for (uint32_t c = 0; c < width; ++c)
+                {
+                    double longitude = tileExtents.min.x + (static_cast<double>(c) + 0.5) * dx;
+                    uint32_t sc = clamp_index((longitude - rasterExtents.min.x) / rasterWidth * static_cast<double>(src.width()), src.width());
+
+                    dest->set(c, r, src.at(sc, sr));
+                }
+            }
+
+            result = dest;
+        }
+
+        void apply(const vsg::ubyteArray2D& array) override { crop(array); }
+        void apply(const vsg::ushortArray2D& array) override { crop(array); }
+        void apply(const vsg::shortArray2D& array) override { crop(array); }
+        void apply(const vsg::floatArray2D& array) override { crop(array); }
+        void apply(const vsg::ubvec3Array2D& array) override { crop(array); }
+        void apply(const vsg::ubvec4Array2D& array) override { crop(array); }
+    };
+} // namespace
+
+RasterLayer::RasterLayer(const vsg::Path& in_tileLayer, vsg::ref_ptr<vsg::Data> in_raster, vsg::ref_ptr<vsg::TileDatabaseSettings> in_settings) :
+    tileLayer(in_tileLayer),
+    raster(in_raster),
+    settings(in_settings),
+    rasterExtents(in_settings->extents)
+{
+}
+
+vsg::dbox RasterLayer::computeTileExtents(uint32_t x, uint32_t y, uint32_t level) const
+{
+    auto& extents = settings->extents;
+    double multiplier = pow(0.5, double(level));
+    double tileExtentWidth = multiplier * (extents.max.x - extents.min.x) / double(settings->noX);
+    double tileExtentHeight = multiplier * (extents.max.y - extents.min.y) / double(settings->noY);
+
+    vsg::dbox tile_extents;
+    if (settings->originTopLeft)
+    {
+        vsg::dvec3 origin(extents.min.x, extents.max.y, extents.min.z);
+        tile_extents.min = origin + vsg::dvec3(double(x) * tileExtentWidth, -double(y + 1) * tileExtentHeight, 0.0);
+        tile_extents.max = origin + vsg::dvec3(double(x + 1) * tileExtentWidth, -double(y) * tileExtentHeight, 1.0);
+    }
+    else
+    {
+        tile_extents.min = extents.min + vsg::dvec3(double(x) * tileExtentWidth, double(y) * tileExtentHeight, 0.0);
+        tile_extents.max = extents.min + vsg::dvec3(double(x + 1) * tileExtentWidth, double(y + 1) * tileExtentHeight, 1.0);
+    }
+    return tile_extents;
+}
+
+vsg::ref_ptr<vsg::Object> RasterLayer::read(const vsg::Path& filename, vsg::ref_ptr<const vsg::Options>) const
+{
+    uint32_t x = 0, y = 0, level = 0;
+    if (!raster || !matchTileTemplate(tileLayer.string(), filename.string(), x, y, level)) return {};
+
+    CropRaster cropRaster;
+    cropRaster.rasterExtents = rasterExtents;
+    cropRaster.tileExtents = computeTileExtents(x, y, level);
+    cropRaster.width = tileWidth;
+    cropRaster.height = tileHeight;
+    raster->accept(cropRaster);
+
+    if (!cropRaster.result) vsg::warn("RasterLayer : unsupported raster type ", raster->className());
+
+    return cropRaster.result;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vsg/all.h>
+
+/// RasterLayer serves tiles cut from a single georeferenced raster, such as a whole world image or elevation GeoTIFF,
+/// for file names matching the tileLayer template, i.e. raster://image/{z}/{x}/{y}, so local rasters can be used as TileDatabaseSettings layers.
+/// The raster is assumed to be in geographic coordinates covering rasterExtents, tiles are sampled with nearest neighbour filtering.
+class RasterLayer : public vsg::Inherit<vsg::ReaderWriter, RasterLayer>
+{
+public:
+    RasterLayer(const vsg::Path& in_tileLayer, vsg::ref_ptr<vsg::Data> in_raster, vsg::ref_ptr<vsg::TileDatabaseSettings> in_settings);
+
+    vsg::Path tileLayer;
+    vsg::ref_ptr<vsg::Data> raster;
+    vsg::ref_ptr<vsg::TileDatabaseSettings> settings;
+    vsg::dbox rasterExtents;
+    uint32_t tileWidth = 256;
+    uint32_t tileHeight = 256;
+
+    vsg::dbox computeTileExtents(uint32_t x, uint32_t y, uint32_t level) const;
+
+    vsg::ref_ptr<vsg::Object> read(const vsg::Path& filename, vsg::ref_ptr<const vsg::Options> options = {}) const override;
+};
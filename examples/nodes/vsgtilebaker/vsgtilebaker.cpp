@@ -0,0 +1,264 @@
+#include <vsg/all.h>
+
+#include <vsgXchange/all.h>
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "CompressTextures.h"
+#include "ParallelFor.h"
+#include "RasterLayer.h"
+
+// collect the PagedLOD of a tile, their high resolution children are the tiles to bake at the next level.
+struct CollectPagedLODs : public vsg::Visitor
+{
+    std::vector<vsg::ref_ptr<vsg::PagedLOD>> plods;
+
+    void apply(vsg::Node& node) override
+    {
+        node.traverse(*this);
+    }
+
+    void apply(vsg::PagedLOD& plod) override
+    {
+        plods.push_back(vsg::ref_ptr<vsg::PagedLOD>(&plod));
+    }
+};
+
+struct BakeJob
+{
+    vsg::Path filename; // x y level.tile
+    vsg::ref_ptr<vsg::Options> options;
+};
+
+// use a local raster as a layer, either a URL template such as /data/imagery/{z}/{x}/{y}.png that is used directly,
+// or a single georeferenced raster that RasterLayer cuts into tiles.
+vsg::Path setupLayer(const vsg::Path& source, const std::string& name, uint32_t tileSize, vsg::ref_ptr<vsg::TileDatabaseSettings> settings, vsg::ref_ptr<vsg::Options> options)
+{
+    if (source.string().find("{z}") != std::string::npos) return source;
+
+    auto raster = vsg::read_cast<vsg::Data>(source, options);
+    if (!raster)
+    {
+        std::cout << "Unable to read " << name << " raster " << source << std::endl;
+        return {};
+    }
+
+    vsg::Path tileLayer = vsg::make_string("raster://", name, "/{z}/{x}/{y}");
+
+    auto rasterLayer = RasterLayer::create(tileLayer, raster, settings);
+    rasterLayer->tileWidth = tileSize;
+    rasterLayer->tileHeight = tileSize;
+    options->readerWriters.insert(options->readerWriters.begin(), rasterLayer);
+
+    std::cout << "Using " << name << " raster " << source << " " << raster->width() << " x " << raster->height() << std::endl;
+
+    return tileLayer;
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        // set up defaults and read command line arguments to override them
+        vsg::CommandLine arguments(&argc, argv);
+
+        if (int log_level = 0; arguments.read("--log-level", log_level)) vsg::Logger::instance()->level = vsg::Logger::Level(log_level);
+
+        // set up vsg::Options to pass in filepaths, ReaderWriters and other IO related options to use when reading and writing files.
+        auto options = vsg::Options::create();
+        options->sharedObjects = vsg::SharedObjects::create();
+        options->paths = vsg::getEnvPaths("VSG_FILE_PATH");
+
+        // add vsgXchange's support for reading and writing 3rd party file formats
+        options->add(vsgXchange::all::create());
+
+        options->readOptions(arguments);
+
+        auto outputDirectory = arguments.value<vsg::Path>("baked", "-o");
+        auto numThreads = arguments.value<uint32_t>(std::max(1u, std::thread::hardware_concurrency()), "--threads");
+        bool compress = !arguments.read("--no-compress");
+        auto imageTileSize = arguments.value<uint32_t>(256, "--image-tile-size");
+        auto elevationTileSize = arguments.value<uint32_t>(32, "--elevation-tile-size");
+        auto imageSource = arguments.value<vsg::Path>("", "--image");
+        auto elevationSource = arguments.value<vsg::Path>("", "--elevation");
+        if (arguments.read("--rgb")) options->mapRGBtoRGBAHint = false;
+
+        // defaults for a whole earth geographic database
+        auto settings = vsg::TileDatabaseSettings::create();
+        settings->extents = {{-180.0, -90.0, 0.0}, {180.0, 90.0, 1.0}};
+        settings->noX = 2;
+        settings->noY = 1;
+        settings->maxLevel = 6;
+        settings->originTopLeft = false;
+
+        arguments.read("--extents", settings->extents.min.x, settings->extents.min.y, settings->extents.max.x, settings->extents.max.y);
+        arguments.read("--tiles", settings->noX, settings->noY);
+        arguments.read("--elevation-scale", settings->elevationScale);
+        arguments.read("-t", settings->lodTransitionScreenHeightRatio);
+        arguments.read("-m", settings->maxLevel);
+        arguments.read({"--mtd", "--maxTileDimension"}, settings->maxTileDimension);
+        if (arguments.read("--top-left")) settings->originTopLeft = true;
+        if (arguments.read("--no-lighting")) settings->lighting = false;
+
+        if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
+
+        if (!imageSource)
+        {
+            std::cout << "Usage: vsgtilebaker --image <raster|template> [--elevation <raster|template>] [-m maxLevel] [-o directory]" << std::endl;
+            return 1;
+        }
+
+        settings->imageLayer = setupLayer(imageSource, "image", imageTileSize, settings, options);
+        if (!settings->imageLayer) return 1;
+
+        if (elevationSource)
+        {
+            settings->elevationLayer = setupLayer(elevationSource, "elevation", elevationTileSize, settings, options);
+            if (!settings->elevationLayer) return 1;
+        }
+
+        auto startTime = vsg::clock::now();
+
+        // read the root tiles using the standard tile ReaderWriter, later levels are read from the PagedLOD filenames and Options it assigns.
+        auto earth = vsg::TileDatabase::create();
+        earth->settings = settings;
+        if (!earth->readDatabase(options) || !earth->child)
+        {
+            std::cout << "Unable to create the root tiles." << std::endl;
+            return 1;
+        }
+
+        std::mutex statsMutex;
+        uint64_t numFiles = 0;
+        uint64_t numTiles = 0;
+        uint64_t numFailed = 0;
+        uint64_t numBytesWritten = 0;
+        CompressTextures compressStats;
+
+        // detach the PagedLOD from the tile ReaderWriter's Options, returning the jobs that bake their children
+        auto prepareForWrite = [&](vsg::Node& node) -> std::vector<BakeJob> {
+            CollectPagedLODs collect;
+            node.accept(collect);
+
+            std::vector<BakeJob> jobs;
+            for (auto& plod : collect.plods)
+            {
+                jobs.push_back(BakeJob{plod->filename, plod->options});
+                plod->options = {};
+            }
+
+            if (compress)
+            {
+                CompressTextures compressTextures;
+                node.accept(compressTextures);
+
+                std::scoped_lock<std::mutex> lock(statsMutex);
+                compressStats.numCompressed += compressTextures.numCompressed;
+                compressStats.originalBytes += compressTextures.originalBytes;
+                compressStats.compressedBytes += compressTextures.compressedBytes;
+            }
+
+            return jobs;
+        };
+
+        auto writeTile = [&](vsg::ref_ptr<vsg::Node> node, const vsg::Path& filename) -> bool {
+            auto directory = vsg::filePath(filename);
+            if (directory && !vsg::fileExists(directory)) vsg::makeDirectory(directory);
+
+            if (!vsg::write(node, filename, options)) return false;
+
+            std::error_code ec;
+            auto size = std::filesystem::file_size(std::filesystem::path(filename.native()), ec);
+
+            std::scoped_lock<std::mutex> lock(statsMutex);
+            ++numFiles;
+            if (!ec) numBytesWritten += size;
+            return true;
+        };
+
+        auto root = earth->child;
+        auto jobs = prepareForWrite(*root);
+        writeTile(root, outputDirectory / "root.vsgb");
+
+        // the calling thread bakes tiles too, so only numThreads - 1 worker threads are needed
+        vsg::ref_ptr<vsg::OperationThreads> operationThreads;
+        if (numThreads > 1) operationThreads = vsg::OperationThreads::create(numThreads - 1);
+
+        // bake a level at a time, spreading the tiles of each level across all the threads
+        for (uint32_t level = 0; !jobs.empty(); ++level)
+        {
+            auto levelStartTime = vsg::clock::now();
+
+            std::vector<BakeJob> nextJobs;
+
+            // a tile per operation, as tiles vary widely in cost
+            parallelFor(operationThreads, jobs.size(), 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    auto& job = jobs[i];
+
+                    std::basic_stringstream<vsg::Path::value_type> sstr(job.filename.substr(0, job.filename.length() - 5).native());
+                    uint32_t x, y, z;
+                    sstr >> x >> y >> z;
+
+                    // this is where vsg::tile builds the meshes and textures that the viewer would otherwise build at runtime
+                    auto tile = vsg::read_cast<vsg::Node>(job.filename, job.options);
+                    if (!tile)
+                    {
+                        std::scoped_lock<std::mutex> lock(statsMutex);
+                        ++numFailed;
+                        continue;
+                    }
+
+                    auto childJobs = prepareForWrite(*tile);
+
+                    uint64_t tilesInFile = 1;
+                    if (auto group = tile.cast<vsg::Group>()) tilesInFile = group->children.size();
+
+                    bool written = writeTile(tile, outputDirectory / vsg::make_string(z) / vsg::make_string(x) / vsg::make_string(y, ".vsgb"));
+
+                    std::scoped_lock<std::mutex> lock(statsMutex);
+                    if (written)
+                        numTiles += tilesInFile;
+                    else
+                        ++numFailed;
+
+                    nextJobs.insert(nextJobs.end(), childJobs.begin(), childJobs.end());
+                }
+            });
+
+            auto levelTime = std::chrono::duration<double, std::chrono::seconds::period>(vsg::clock::now() - levelStartTime).count();
+            std::cout << "level " << level + 1 << " : " << jobs.size() << " files in " << levelTime << "s" << std::endl;
+
+            jobs.swap(nextJobs);
+        }
+
+        auto totalTime = std::chrono::duration<double, std::chrono::seconds::period>(vsg::clock::now() - startTime).count();
+
+        std::cout << std::endl;
+        std::cout << "threads = " << numThreads << std::endl;
+        std::cout << "files written = " << numFiles << ", bytes = " << numBytesWritten << ", failed = " << numFailed << std::endl;
+        std::cout << "tiles = " << numTiles << " in " << totalTime << "s, " << (static_cast<double>(numTiles) / totalTime) << " tiles/second" << std::endl;
+        if (compress)
+        {
+            std::cout << "textures compressed = " << compressStats.numCompressed << ", " << compressStats.originalBytes << " -> " << compressStats.compressedBytes << " bytes including mipmaps" << std::endl;
+        }
+
+        auto absoluteDirectory = std::filesystem::absolute(std::filesystem::path(outputDirectory.native())).generic_string();
+        std::cout << std::endl
+                  << "view with: vsgtiledatabase --baked file://" << absoluteDirectory << "/{z}/{x}/{y}.vsgb" << std::endl;
+    }
+    catch (const vsg::Exception& ve)
+    {
+        for (int i = 0; i < argc; ++i) std::cerr << argv[i] << " ";
+        std::cerr << "\n[Exception] - " << ve.message << " result = " << ve.result << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
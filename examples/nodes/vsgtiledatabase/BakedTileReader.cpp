@@ -0,0 +1,90 @@
+#include "BakedTileReader.h"
+
+#include <sstream>
+
+namespace
+{
+    // strip any file:// scheme so the path can be passed to vsg::read()
+    vsg::Path localPath(const vsg::Path& path)
+    {
+        auto str = path.string();
+        const std::string scheme("file://");
+        if (str.compare(0, scheme.size(), scheme) == 0) return vsg::Path(str.substr(scheme.size()));
+        return path;
+    }
+} // namespace
+
+BakedTileReader::BakedTileReader(const vsg::Path& in_tileLayer) :
+    tileLayer(in_tileLayer)
+{
+}
+
+vsg::Path BakedTileReader::getRootPath() const
+{
+    auto str = localPath(tileLayer).string();
+    auto pos = str.find("{z}");
+    if (pos == std::string::npos) return {};
+    return vsg::Path(str.substr(0, pos) + "root.vsgb");
+}
+
+vsg::Path BakedTileReader::getTilePath(uint32_t x, uint32_t y, uint32_t level) const
+{
+    auto replace = [](std::string& path, const std::string& match, uint32_t value) {
+        auto pos = path.find(match);
+        if (pos != std::string::npos) path.replace(pos, match.length(), vsg::make_string(value));
+    };
+
+    auto path = localPath(tileLayer).string();
+    replace(path, "{z}", level);
+    replace(path, "{x}", x);
+    replace(path, "{y}", y);
+
+    return vsg::Path(path);
+}
+
+vsg::ref_ptr<vsg::Object> BakedTileReader::read(const vsg::Path& filename, vsg::ref_ptr<const vsg::Options> options) const
+{
+    auto extension = vsg::lowerCaseFileExtension(filename);
+    if (extension != ".tile") return {};
+
+    auto tile_info = filename.substr(0, filename.length() - 5);
+
+    vsg::Path tilePath;
+    if (tile_info == "root")
+    {
+        tilePath = getRootPath();
+    }
+    else
+    {
+        std::basic_stringstream<vsg::Path::value_type> sstr(tile_info.native());
+
+        uint32_t x, y, level;
+        sstr >> x >> y >> level;
+
+        tilePath = getTilePath(x, y, level);
+    }
+
+    auto tile = vsg::read_cast<vsg::Node>(tilePath, options);
+    if (!tile) return {};
+
+    // the baked PagedLOD are written without Options, assign ours so their children are also read via this ReaderWriter
+    struct AssignOptions : public vsg::Visitor
+    {
+        vsg::ref_ptr<vsg::Options> options;
+
+        void apply(vsg::Node& node) override
+        {
+            node.traverse(*this);
+        }
+
+        void apply(vsg::PagedLOD& plod) override
+        {
+            plod.options = options;
+        }
+    } assignOptions;
+
+    assignOptions.options = vsg::Options::create_if(options, *options);
+    tile->accept(assignOptions);
+
+    return tile;
+}
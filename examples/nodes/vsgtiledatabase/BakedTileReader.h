@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vsg/all.h>
+
+/// BakedTileReader serves the "x y level.tile" requests of a tile database baked by vsgtilebaker from pre-built .vsgb files,
+/// so no meshes or textures are built at runtime. The tileLayer is a URL template such as file:///data/earth/{z}/{x}/{y}.vsgb,
+/// with the root tile read from root.vsgb in the directory that holds the {z} directories.
+class BakedTileReader : public vsg::Inherit<vsg::ReaderWriter, BakedTileReader>
+{
+public:
+    explicit BakedTileReader(const vsg::Path& in_tileLayer);
+
+    vsg::Path tileLayer;
+
+    vsg::Path getRootPath() const;
+    vsg::Path getTilePath(uint32_t x, uint32_t y, uint32_t level) const;
+
+    vsg::ref_ptr<vsg::Object> read(const vsg::Path& filename, vsg::ref_ptr<const vsg::Options> options = {}) const override;
+};
@@ -7,6 +7,10 @@
 #include <iostream>
 #include <thread>
 
+#include "BakedTileReader.h"
+#include "ResidencyBudget.h"
+#include "TilePack.h"
+
 int main(int argc, char** argv)
 {
     try
@@ -32,6 +36,7 @@ int main(int argc, char** argv)
         auto numFrames = arguments.value(-1, "-f");
         auto pathFilename = arguments.value<vsg::Path>("", "-p");
         auto maxPagedLOD = arguments.value(0, "--maxPagedLOD");
+        auto residencyBudgetMB = arguments.value<uint64_t>(0, "--budget");
         auto loadLevels = arguments.value(0, "--load-levels");
         auto horizonMountainHeight = arguments.value(0.0, "--hmh");
         bool useEllipsoidPerspective = !arguments.read({"--disble-EllipsoidPerspective", "--dep"});
@@ -137,13 +142,46 @@ int main(int argc, char** argv)
         arguments.read("-m", settings->maxLevel);
         arguments.read({"--mtd", "--maxTileDimension"}, settings->maxTileDimension);
 
+        // serve tiles from a single memory mapped pack file ahead of the URL templates, adding any that are missing as they are downloaded.
+        vsg::ref_ptr<TilePack> tilePack;
+        if (vsg::Path packFilename; arguments.read("--pack", packFilename))
+        {
+            auto packSizeMB = arguments.value<uint64_t>(1024, "--pack-size");
+            tilePack = TilePack::create(packFilename, packSizeMB * 1024 * 1024);
+            if (tilePack->valid())
+            {
+                // the position of each layer in the vector sets the TileKey::layer, so keep the order stable between runs.
+                auto tilePackReaderWriter = TilePackReaderWriter::create(tilePack, std::vector<vsg::Path>{settings->imageLayer, settings->elevationLayer, settings->detailLayer});
+                tilePackReaderWriter->readOnly = arguments.read("--pack-read-only");
+                options->readerWriters.insert(options->readerWriters.begin(), tilePackReaderWriter);
+            }
+        }
+
         auto ellipsoidModel = settings->ellipsoidModel;
 
-        auto earth = vsg::TileDatabase::create();
-        earth->settings = settings;
-        earth->readDatabase(options);
+        vsg::ref_ptr<vsg::Node> vsg_scene;
+        if (vsg::Path bakedLayer; arguments.read("--baked", bakedLayer))
+        {
+            // read the pre-built tiles written by vsgtilebaker, i.e. --baked file:///data/earth/{z}/{x}/{y}.vsgb
+            options->readerWriters.insert(options->readerWriters.begin(), BakedTileReader::create(bakedLayer));
+
+            vsg_scene = vsg::read_cast<vsg::Node>("root.tile", options);
+            if (!vsg_scene)
+            {
+                std::cout << "Unable to read baked tile database " << bakedLayer << std::endl;
+                return 1;
+            }
+
+            if (auto bakedEllipsoidModel = vsg_scene->getRefObject<vsg::EllipsoidModel>("EllipsoidModel")) ellipsoidModel = bakedEllipsoidModel;
+        }
+        else
+        {
+            auto earth = vsg::TileDatabase::create();
+            earth->settings = settings;
+            earth->readDatabase(options);
 
-        auto vsg_scene = earth;
+            vsg_scene = earth;
+        }
 
         const double invalid_value = std::numeric_limits<double>::max();
         double poi_latitude = invalid_value;
@@ -154,6 +192,12 @@ int main(int argc, char** argv)
 
         if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
+        if (residencyBudgetMB > 0 && maxPagedLOD > 0)
+        {
+            std::cout << "--budget sets targetMaxNumPagedLODWithHighResSubgraphs each frame, so can't be combined with --maxPagedLOD." << std::endl;
+            return 1;
+        }
+
         if (outputFilename)
         {
             vsg::write(vsg_scene, outputFilename);
@@ -275,6 +319,8 @@ int main(int argc, char** argv)
             }
         }
 
+        auto residencyBudget = ResidencyBudget::install(*viewer, vsg_scene, residencyBudgetMB * 1024 * 1024);
+
         // rendering main loop
         while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
         {
@@ -283,10 +329,23 @@ int main(int argc, char** argv)
 
             viewer->update();
 
+            if (residencyBudget) residencyBudget->update(viewer->getFrameStamp());
+
             viewer->recordAndSubmit();
 
             viewer->present();
         }
+
+        if (residencyBudget) residencyBudget->report(std::cout);
+
+        if (tilePack)
+        {
+            tilePack->flush();
+
+            auto stats = tilePack->getStats();
+            std::cout << "tilePack hits = " << stats.hits << ", misses = " << stats.misses << ", writes = " << stats.writes << ", evictions = " << stats.evictions << std::endl;
+            std::cout << "tilePack numTiles = " << stats.numTiles << ", liveBytes = " << stats.liveBytes << ", fileSize = " << stats.fileSize << std::endl;
+        }
     }
     catch (const vsg::Exception& ve)
     {
@@ -0,0 +1,70 @@
+#include "BVHLineSegmentIntersector.h"
+
+BVHLineSegmentIntersector::BVHLineSegmentIntersector(const vsg::dvec3& s, const vsg::dvec3& e, vsg::ref_ptr<vsg::ArrayState> initialArrayData) :
+    Inherit(s, e, initialArrayData)
+{
+}
+
+BVHLineSegmentIntersector::BVHLineSegmentIntersector(const vsg::Camera& camera, int32_t x, int32_t y, vsg::ref_ptr<vsg::ArrayState> initialArrayData) :
+    Inherit(camera, x, y, initialArrayData)
+{
+}
+
+void BVHLineSegmentIntersector::apply(const vsg::VertexIndexDraw& vid)
+{
+    // let the base class set up the ArrayState and node path, then pick up the draw in intersectDrawIndexed()
+    _currentVertexIndexDraw = &vid;
+    vsg::LineSegmentIntersector::apply(vid);
+    _currentVertexIndexDraw = nullptr;
+}
+
+bool BVHLineSegmentIntersector::intersectDrawIndexed(uint32_t firstIndex, uint32_t indexCount, uint32_t firstInstance, uint32_t instanceCount)
+{
+    auto vid = _currentVertexIndexDraw;
+    auto& arrayState = *arrayStateStack.back();
+    if (!vid || arrayState.topology != VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST || instanceCount > 1)
+    {
+        ++numFallbackTests;
+        return vsg::LineSegmentIntersector::intersectDrawIndexed(firstIndex, indexCount, firstInstance, instanceCount);
+    }
+
+    // only use the BVH when the ArrayState passes the vertex array through unmodified, rather than generating per instance positions
+    auto vertices = arrayState.vertexArray(firstInstance);
+    bool sourceVertices = false;
+    for (auto& bufferInfo : vid->arrays)
+    {
+        if (bufferInfo && bufferInfo->data.get() == vertices.get()) sourceVertices = true;
+    }
+
+    if (!sourceVertices)
+    {
+        ++numFallbackTests;
+        return vsg::LineSegmentIntersector::intersectDrawIndexed(firstIndex, indexCount, firstInstance, instanceCount);
+    }
+
+    auto previous = TriangleBVH::find(*vid, firstIndex, indexCount);
+    auto bvh = TriangleBVH::get(*vid, vertices, firstIndex, indexCount);
+    if (!bvh)
+    {
+        ++numFallbackTests;
+        return vsg::LineSegmentIntersector::intersectDrawIndexed(firstIndex, indexCount, firstInstance, instanceCount);
+    }
+
+    ++numBVHTests;
+    if (bvh != previous)
+    {
+        ++numBVHBuilt;
+        bvhBuildTime += bvh->buildTime;
+    }
+
+    const auto& ls = _lineSegmentStack.back();
+    const vsg::dvec3 d = ls.end - ls.start;
+    size_t previousSize = intersections.size();
+
+    bvh->intersect(ls.start, ls.end, [&](uint32_t i0, uint32_t i1, uint32_t i2, double t, double u, double v) {
+        vsg::IndexRatios indexRatios{{i0, 1.0 - u - v}, {i1, u}, {i2, v}};
+        add(ls.start + d * t, t, indexRatios, firstInstance);
+    });
+
+    return intersections.size() != previousSize;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "TriangleBVH.h"
+
+/// BVHLineSegmentIntersector is a drop in replacement for vsg::LineSegmentIntersector that tests the triangles of each VertexIndexDraw
+/// through a TriangleBVH cached on the node, built on the first query and rebuilt when the vertex or index arrays are dirtied.
+/// Draws the BVH can't represent, such as instanced or non triangle list geometry, fall back to the standard per triangle tests.
+class BVHLineSegmentIntersector : public vsg::Inherit<vsg::LineSegmentIntersector, BVHLineSegmentIntersector>
+{
+public:
+    BVHLineSegmentIntersector(const vsg::dvec3& s, const vsg::dvec3& e, vsg::ref_ptr<vsg::ArrayState> initialArrayData = {});
+    BVHLineSegmentIntersector(const vsg::Camera& camera, int32_t x, int32_t y, vsg::ref_ptr<vsg::ArrayState> initialArrayData = {});
+
+    using vsg::LineSegmentIntersector::apply;
+
+    void apply(const vsg::VertexIndexDraw& vid) override;
+
+    bool intersectDrawIndexed(uint32_t firstIndex, uint32_t indexCount, uint32_t firstInstance, uint32_t instanceCount) override;
+
+    // stats
+    uint32_t numBVHTests = 0;     // draws tested via their BVH
+    uint32_t numFallbackTests = 0; // draws tested triangle by triangle
+    uint32_t numBVHBuilt = 0;
+    double bvhBuildTime = 0.0; // milliseconds spent building BVHs during this traversal
+
+protected:
+    const vsg::VertexIndexDraw* _currentVertexIndexDraw = nullptr;
+};
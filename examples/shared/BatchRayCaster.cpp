@@ -0,0 +1,314 @@
+#include "BatchRayCaster.h"
+
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+    // collect the triangle list VertexIndexDraw of a scene graph with their world transforms, using the Intersector's ArrayState handling to find the vertex arrays.
+    class CollectMeshes : public vsg::Inherit<vsg::Intersector, CollectMeshes>
+    {
+    public:
+        std::vector<BatchRayCaster::Mesh> meshes;
+        size_t numTriangles = 0;
+
+        using vsg::Intersector::apply;
+
+        void apply(const vsg::VertexIndexDraw& vid) override
+        {
+            _currentVertexIndexDraw = &vid;
+            vsg::Intersector::apply(vid);
+            _currentVertexIndexDraw = nullptr;
+        }
+
+        void pushTransform(const vsg::Transform& transform) override
+        {
+            _matrixStack.push_back(transform.transform(_matrixStack.back()));
+        }
+
+        void popTransform() override
+        {
+            _matrixStack.pop_back();
+        }
+
+        bool intersects(const vsg::dsphere& /*sphere*/) override
+        {
+            // collect everything, each ray packet is culled against the mesh bounds instead
+            return true;
+        }
+
+        bool intersectDraw(uint32_t /*firstVertex*/, uint32_t /*vertexCount*/, uint32_t /*firstInstance*/, uint32_t /*instanceCount*/) override
+        {
+            // non indexed draws aren't supported by TriangleBVH
+            return false;
+        }
+
+        bool intersectDrawIndexed(uint32_t firstIndex, uint32_t indexCount, uint32_t firstInstance, uint32_t instanceCount) override
+        {
+            auto vid = _currentVertexIndexDraw;
+            auto& arrayState = *arrayStateStack.back();
+            if (!vid || arrayState.topology != VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST || instanceCount > 1) return false;
+
+            auto vertices = arrayState.vertexArray(firstInstance);
+            auto bvh = TriangleBVH::get(*vid, vertices, firstIndex, indexCount);
+            if (!bvh) return false;
+
+            BatchRayCaster::Mesh mesh;
+            mesh.drawable = vsg::ref_ptr<const vsg::VertexIndexDraw>(vid);
+            mesh.bvh = bvh;
+            mesh.localToWorld = _matrixStack.back();
+            mesh.worldToLocal = vsg::inverse(mesh.localToWorld);
+
+            auto& root = bvh->nodes.front();
+            for (int c = 0; c < 8; ++c)
+            {
+                vsg::dvec3 corner((c & 1) ? root.max.x : root.min.x, (c & 2) ? root.max.y : root.min.y, (c & 4) ? root.max.z : root.min.z);
+                mesh.worldBounds.add(mesh.localToWorld * corner);
+            }
+
+            meshes.push_back(mesh);
+            numTriangles += bvh->numPrimitives();
+            return true;
+        }
+
+    protected:
+        std::vector<vsg::dmat4> _matrixStack{vsg::dmat4()};
+        const vsg::VertexIndexDraw* _currentVertexIndexDraw = nullptr;
+    };
+
+    constexpr uint32_t N = BatchRayCaster::packetSize;
+
+    // rays of a packet in a mesh's local coordinates, stored as a structure of arrays so each test is a loop over the packet the compiler can vectorize
+    struct Packet
+    {
+        alignas(64) float ox[N], oy[N], oz[N];
+        alignas(64) float dx[N], dy[N], dz[N];
+        alignas(64) float idx[N], idy[N], idz[N];
+        alignas(64) float tmax[N]; // nearest hit so far, shared across meshes as the segment ratio is unchanged by the transform
+        alignas(64) float u[N], v[N];
+        alignas(64) uint32_t mesh[N];
+        alignas(64) uint32_t triangle[N];
+    };
+
+    inline float safeInverse(float d)
+    {
+        const float epsilon = 1e-20f;
+        return 1.0f / (std::abs(d) > epsilon ? d : std::copysign(epsilon, d));
+    }
+
+    inline bool packetOverlaps(const Packet& p, const TriangleBVH::Node& node)
+    {
+        int any = 0;
+        for (uint32_t i = 0; i < N; ++i)
+        {
+            float tx0 = (node.min.x - p.ox[i]) * p.idx[i];
+            float tx1 = (node.max.x - p.ox[i]) * p.idx[i];
+            float ty0 = (node.min.y - p.oy[i]) * p.idy[i];
+            float ty1 = (node.max.y - p.oy[i]) * p.idy[i];
+            float tz0 = (node.min.z - p.oz[i]) * p.idz[i];
+            float tz1 = (node.max.z - p.oz[i]) * p.idz[i];
+
+            float tmin = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::max(std::min(tz0, tz1), 0.0f));
+            float tmax = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::min(std::max(tz0, tz1), p.tmax[i]));
+            any |= (tmin <= tmax) ? 1 : 0;
+        }
+        return any != 0;
+    }
+
+    inline void packetIntersectTriangle(Packet& p, const vsg::vec3& v0, const vsg::vec3& v1, const vsg::vec3& v2, uint32_t meshIndex, uint32_t triangleIndex)
+    {
+        const vsg::vec3 e1 = v1 - v0;
+        const vsg::vec3 e2 = v2 - v0;
+
+        // Möller–Trumbore, double sided to match LineSegmentIntersector, with branch free selects so the loop vectorizes
+        for (uint32_t i = 0; i < N; ++i)
+        {
+            float px = p.dy[i] * e2.z - p.dz[i] * e2.y;
+            float py = p.dz[i] * e2.x - p.dx[i] * e2.z;
+            float pz = p.dx[i] * e2.y - p.dy[i] * e2.x;
+            float det = e1.x * px + e1.y * py + e1.z * pz;
+            float invDet = 1.0f / det;
+
+            float sx = p.ox[i] - v0.x;
+            float sy = p.oy[i] - v0.y;
+            float sz = p.oz[i] - v0.z;
+            float u = (sx * px + sy * py + sz * pz) * invDet;
+
+            float qx = sy * e1.z - sz * e1.y;
+            float qy = sz * e1.x - sx * e1.z;
+            float qz = sx * e1.y - sy * e1.x;
+            float v = (p.dx[i] * qx + p.dy[i] * qy + p.dz[i] * qz) * invDet;
+            float t = (e2.x * qx + e2.y * qy + e2.z * qz) * invDet;
+
+            bool hit = (det != 0.0f) & (u >= 0.0f) & (v >= 0.0f) & (u + v <= 1.0f) & (t >= 0.0f) & (t < p.tmax[i]);
+
+            p.tmax[i] = hit ? t : p.tmax[i];
+            p.u[i] = hit ? u : p.u[i];
+            p.v[i] = hit ? v : p.v[i];
+            p.mesh[i] = hit ? meshIndex : p.mesh[i];
+            p.triangle[i] = hit ? triangleIndex : p.triangle[i];
+        }
+    }
+} // namespace
+
+BatchRayCaster::BatchRayCaster(vsg::ref_ptr<vsg::Node> in_scene, vsg::ref_ptr<vsg::OperationThreads> in_operationThreads) :
+    scene(in_scene),
+    operationThreads(in_operationThreads)
+{
+}
+
+void BatchRayCaster::update()
+{
+    auto startTime = vsg::clock::now();
+
+    CollectMeshes collect;
+    if (scene) scene->accept(collect);
+
+    meshes.swap(collect.meshes);
+    numTriangles = collect.numTriangles;
+
+    updateTime = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+}
+
+std::vector<BatchRayCaster::Hit> BatchRayCaster::intersect(const std::vector<Ray>& rays) const
+{
+    std::vector<Hit> hits(rays.size());
+    if (rays.empty()) return hits;
+
+    size_t raysPerOperation = static_cast<size_t>(packetSize) * std::max(1u, packetsPerOperation);
+    parallelFor(operationThreads, rays.size(), raysPerOperation, [&](size_t begin, size_t end) {
+        intersectPackets(rays.data() + begin, hits.data() + begin, end - begin);
+    });
+
+    return hits;
+}
+
+void BatchRayCaster::intersectPackets(const Ray* rays, Hit* hits, size_t numRays) const
+{
+    Packet p;
+
+    for (size_t base = 0; base < numRays; base += N)
+    {
+        uint32_t count = static_cast<uint32_t>(std::min<size_t>(N, numRays - base));
+        const Ray* packetRays = rays + base;
+
+        // world space bounds of the packet's segments, used to skip meshes it can't reach
+        vsg::dbox packetBounds;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            packetBounds.add(packetRays[i].start);
+            packetBounds.add(packetRays[i].end);
+        }
+
+        for (uint32_t i = 0; i < N; ++i)
+        {
+            // unused lanes are given an empty range so they never register hits
+            p.tmax[i] = (i < count) ? 1.0f : -1.0f;
+            p.mesh[i] = std::numeric_limits<uint32_t>::max();
+            p.triangle[i] = 0;
+            p.u[i] = p.v[i] = 0.0f;
+        }
+
+        for (uint32_t m = 0; m < meshes.size(); ++m)
+        {
+            auto& mesh = meshes[m];
+            if (packetBounds.max.x < mesh.worldBounds.min.x || packetBounds.min.x > mesh.worldBounds.max.x ||
+                packetBounds.max.y < mesh.worldBounds.min.y || packetBounds.min.y > mesh.worldBounds.max.y ||
+                packetBounds.max.z < mesh.worldBounds.min.z || packetBounds.min.z > mesh.worldBounds.max.z) continue;
+
+            for (uint32_t i = 0; i < N; ++i)
+            {
+                const Ray& ray = packetRays[std::min(i, count - 1)];
+                auto start = mesh.worldToLocal * ray.start;
+                auto d = mesh.worldToLocal * ray.end - start;
+
+                p.ox[i] = static_cast<float>(start.x);
+                p.oy[i] = static_cast<float>(start.y);
+                p.oz[i] = static_cast<float>(start.z);
+                p.dx[i] = static_cast<float>(d.x);
+                p.dy[i] = static_cast<float>(d.y);
+                p.dz[i] = static_cast<float>(d.z);
+                p.idx[i] = safeInverse(p.dx[i]);
+                p.idy[i] = safeInverse(p.dy[i]);
+                p.idz[i] = safeInverse(p.dz[i]);
+            }
+
+            const auto& bvh = *mesh.bvh;
+            const auto& vertices = *bvh.vertices;
+
+            uint32_t stack[64];
+            uint32_t stackSize = 0;
+            stack[stackSize++] = 0;
+
+            while (stackSize > 0)
+            {
+                uint32_t nodeIndex = stack[--stackSize];
+                const auto& node = bvh.nodes[nodeIndex];
+                if (!packetOverlaps(p, node)) continue;
+
+                if (!node.leaf())
+                {
+                    stack[stackSize++] = node.first;
+                    stack[stackSize++] = nodeIndex + 1;
+                    continue;
+                }
+
+                const uint32_t* tri = bvh.indices.data() + node.first * 3;
+                for (uint32_t t = 0; t < node.count; ++t, tri += 3)
+                {
+                    packetIntersectTriangle(p, vertices[tri[0]], vertices[tri[1]], vertices[tri[2]], m, node.first + t);
+                }
+            }
+        }
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            Hit& hit = hits[base + i];
+            if (p.mesh[i] == std::numeric_limits<uint32_t>::max())
+            {
+                hit = Hit{};
+                continue;
+            }
+
+            const Ray& ray = packetRays[i];
+            const uint32_t* tri = meshes[p.mesh[i]].bvh->indices.data() + p.triangle[i] * 3;
+
+            hit.ratio = p.tmax[i];
+            hit.worldIntersection = ray.start + (ray.end - ray.start) * hit.ratio;
+            hit.mesh = p.mesh[i];
+            hit.indices[0] = tri[0];
+            hit.indices[1] = tri[1];
+            hit.indices[2] = tri[2];
+            hit.u = p.u[i];
+            hit.v = p.v[i];
+        }
+    }
+}
+
+std::vector<BatchRayCaster::Ray> BatchRayCaster::createLidarSweep(const vsg::dvec3& origin, const vsg::dvec3& forward, const vsg::dvec3& up, uint32_t numBeams, uint32_t numColumns, double minElevation, double maxElevation, double range)
+{
+    auto z = vsg::normalize(up);
+    auto x = vsg::normalize(forward - z * vsg::dot(forward, z));
+    auto y = vsg::cross(z, x);
+
+    std::vector<Ray> rays;
+    rays.reserve(static_cast<size_t>(numBeams) * numColumns);
+
+    for (uint32_t c = 0; c < numColumns; ++c)
+    {
+        double azimuth = 2.0 * vsg::PI * static_cast<double>(c) / static_cast<double>(numColumns);
+        auto horizontal = x * std::cos(azimuth) + y * std::sin(azimuth);
+
+        for (uint32_t b = 0; b < numBeams; ++b)
+        {
+            double elevation = vsg::radians(numBeams > 1 ? minElevation + (maxElevation - minElevation) * static_cast<double>(b) / static_cast<double>(numBeams - 1) : minElevation);
+            auto direction = horizontal * std::cos(elevation) + z * std::sin(elevation);
+            rays.push_back(Ray{origin, origin + direction * range});
+        }
+    }
+
+    return rays;
+}
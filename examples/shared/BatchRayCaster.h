@@ -0,0 +1,65 @@
+#pragma once
+
+#include "TriangleBVH.h"
+
+/// BatchRayCaster casts large batches of rays, such as lidar sweeps or line of sight queries, against a scene graph.
+/// The scene is traversed once by update() to collect each VertexIndexDraw with its world transform and TriangleBVH,
+/// then intersect() splits the rays into fixed size packets that are traced through each mesh's BVH together,
+/// spreading the packets across OperationThreads and returning the nearest hit of every ray in a flat array.
+class BatchRayCaster : public vsg::Inherit<vsg::Object, BatchRayCaster>
+{
+public:
+    explicit BatchRayCaster(vsg::ref_ptr<vsg::Node> in_scene, vsg::ref_ptr<vsg::OperationThreads> in_operationThreads = {});
+
+    /// number of rays traced together, each packet is tested against a BVH node or triangle in a single loop the compiler can vectorize.
+    static constexpr uint32_t packetSize = 16;
+
+    struct Ray
+    {
+        vsg::dvec3 start;
+        vsg::dvec3 end;
+    };
+
+    struct Hit
+    {
+        double ratio = -1.0; // position along the ray's start to end segment, negative for a miss
+        vsg::dvec3 worldIntersection;
+        uint32_t mesh = 0;             // index into meshes
+        uint32_t indices[3] = {0, 0, 0}; // vertex indices of the triangle hit
+        float u = 0.0f, v = 0.0f;      // barycentric coordinates of the hit relative to indices[1] and indices[2]
+
+        bool valid() const { return ratio >= 0.0; }
+    };
+
+    struct Mesh
+    {
+        vsg::ref_ptr<const vsg::VertexIndexDraw> drawable;
+        vsg::ref_ptr<TriangleBVH> bvh;
+        vsg::dmat4 localToWorld;
+        vsg::dmat4 worldToLocal;
+        vsg::dbox worldBounds;
+    };
+
+    vsg::ref_ptr<vsg::Node> scene;
+    vsg::ref_ptr<vsg::OperationThreads> operationThreads;
+    uint32_t packetsPerOperation = 8;
+
+    std::vector<Mesh> meshes;
+
+    /// collect the meshes of the scene graph and build any BVH not already cached, call again after the scene graph changes.
+    void update();
+
+    /// return the nearest hit of each ray, in the same order as the rays.
+    std::vector<Hit> intersect(const std::vector<Ray>& rays) const;
+
+    /// cast numRays consecutive rays a packet at a time, writing their nearest hits, used by the operations intersect() dispatches.
+    void intersectPackets(const Ray* rays, Hit* hits, size_t numRays) const;
+
+    /// create the rays of a lidar sweep, numBeams between minElevation and maxElevation (degrees) at each of numColumns azimuth steps,
+    /// ordered column by column so each packet holds neighbouring beams.
+    static std::vector<Ray> createLidarSweep(const vsg::dvec3& origin, const vsg::dvec3& forward, const vsg::dvec3& up, uint32_t numBeams, uint32_t numColumns, double minElevation, double maxElevation, double range);
+
+    // stats from the last update()
+    size_t numTriangles = 0;
+    double updateTime = 0.0; // milliseconds
+};
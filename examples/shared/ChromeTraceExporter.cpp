@@ -0,0 +1,235 @@
+#include "ChromeTraceExporter.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+    constexpr uint32_t gpuTrack = 0;
+
+    std::string escape(const std::string& str)
+    {
+        std::string result;
+        result.reserve(str.size());
+        for (char c : str)
+        {
+            switch (c)
+            {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\t': result += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) >= 0x20) result += c;
+                break;
+            }
+        }
+        return result;
+    }
+
+    std::string entryName(const vsg::ProfileLog::Entry& entry)
+    {
+        if (entry.sourceLocation)
+        {
+            if (entry.sourceLocation->name && *entry.sourceLocation->name) return entry.sourceLocation->name;
+            if (entry.sourceLocation->function) return entry.sourceLocation->function;
+        }
+        if (entry.object) return entry.object->className();
+        return "unknown";
+    }
+
+    std::string entryArgs(const vsg::ProfileLog::Entry& entry)
+    {
+        std::ostringstream args;
+        bool first = true;
+        if (entry.object)
+        {
+            args << "\"className\":\"" << escape(entry.object->className()) << "\"";
+            first = false;
+        }
+        if (entry.sourceLocation && entry.sourceLocation->file)
+        {
+            if (!first) args << ",";
+            args << "\"source\":\"" << escape(entry.sourceLocation->file) << ":" << entry.sourceLocation->line << "\"";
+        }
+        return args.str();
+    }
+} // namespace
+
+ChromeTraceExporter::ChromeTraceExporter(vsg::ref_ptr<vsg::Profiler> in_profiler, const vsg::Path& in_filename) :
+    profiler(in_profiler),
+    filename(in_filename),
+    _fout(in_filename.native()),
+    _startTime(vsg::clock::now())
+{
+    // JSON array format, the closing bracket is optional so a capture cut short by a crash can still be loaded
+    _fout << "[\n";
+    _fout << std::fixed << std::setprecision(3);
+
+    _writeEvent("M", "process_name", 1, 0, 0.0, "\"name\":\"vsg::Profiler\"");
+    _writeEvent("M", "thread_name", 1, gpuTrack, 0.0, "\"name\":\"GPU\"");
+}
+
+ChromeTraceExporter::~ChromeTraceExporter()
+{
+    finish();
+}
+
+void ChromeTraceExporter::_writeEvent(const char* phase, const std::string& name, uint32_t pid, uint32_t tid, double timestamp, const std::string& args)
+{
+    if (!_first) _fout << ",\n";
+    _first = false;
+
+    _fout << "{\"name\":\"" << escape(name) << "\",\"ph\":\"" << phase << "\",\"pid\":" << pid << ",\"tid\":" << tid << ",\"ts\":" << timestamp;
+    if (phase[0] == 'i') _fout << ",\"s\":\"g\"";
+    if (!args.empty()) _fout << ",\"args\":{" << args << "}";
+    _fout << "}";
+
+    ++numEvents;
+}
+
+uint32_t ChromeTraceExporter::_tid(std::thread::id id)
+{
+    auto itr = _threadIDs.find(id);
+    if (itr != _threadIDs.end()) return itr->second;
+
+    uint32_t tid = static_cast<uint32_t>(_threadIDs.size()) + 1;
+    _threadIDs[id] = tid;
+
+    std::string name = vsg::make_string("thread ", tid);
+    auto& threadNames = profiler->log->threadNames;
+    if (auto name_itr = threadNames.find(id); name_itr != threadNames.end()) name = name_itr->second;
+
+    _writeEvent("M", "thread_name", 1, tid, 0.0, "\"name\":\"" + escape(name) + "\"");
+
+    return tid;
+}
+
+void ChromeTraceExporter::update()
+{
+    if (!profiler || !profiler->log || _finished) return;
+
+    auto& log = *profiler->log;
+    size_t numLogFrames = log.frameIndices.size();
+    if (numLogFrames < _exportedFrames) _exportedFrames = 0; // log has been reset
+
+    if (numLogFrames <= lag) return;
+
+    size_t frame = numLogFrames - lag;
+    if (frame <= _exportedFrames) return;
+
+    _export(log.frameIndices[frame]);
+    _exportedFrames = frame;
+
+    _fout.flush();
+}
+
+void ChromeTraceExporter::exportRange(uint64_t beginIndex, uint64_t endIndex)
+{
+    if (!profiler || !profiler->log || _finished) return;
+
+    if (_exportedIndex == 0 && beginIndex < profiler->log->index.load())
+    {
+        // nothing exported yet so start the timeline at the window rather than when the exporter was created
+        _startTime = profiler->log->entry(beginIndex).cpuTime;
+        _beginIndex = beginIndex;
+    }
+
+    _exportedIndex = std::max(_exportedIndex, beginIndex);
+    _export(endIndex);
+
+    _fout.flush();
+}
+
+void ChromeTraceExporter::finish()
+{
+    if (_finished) return;
+
+    if (profiler && profiler->log) _export(profiler->log->index.load());
+
+    _fout << "\n]\n";
+    _fout.close();
+    _finished = true;
+}
+
+void ChromeTraceExporter::_export(uint64_t endIndex)
+{
+    if (endIndex <= _exportedIndex || !_fout) return;
+
+    auto& log = *profiler->log;
+    uint64_t logSize = log.entries.size();
+    if (logSize == 0) return;
+
+    // entries older than one log_size have been overwritten
+    if (endIndex - _exportedIndex > logSize)
+    {
+        numLost += (endIndex - logSize) - _exportedIndex;
+        _exportedIndex = endIndex - logSize;
+    }
+
+    double gpuScale = log.timestampScaleToMilliseconds * 1000.0; // GPU ticks to microseconds
+    uint64_t oldestIndex = std::max(_beginIndex, endIndex - std::min(endIndex, logSize));
+
+    // GPU scopes are written as a B/E pair once their exit entry is reached, so a scope missing either timestamp is dropped rather than left unbalanced
+    auto writeGpuScope = [&](const vsg::ProfileLog::Entry& exitEntry) {
+        if (exitEntry.enter || !_gpuOffsetSet) return;
+
+        if (exitEntry.reference < oldestIndex || exitEntry.reference >= endIndex)
+        {
+            ++numDroppedGpuScopes;
+            return;
+        }
+
+        auto& enterEntry = log.entry(exitEntry.reference);
+        if (enterEntry.gpuTime == 0 || exitEntry.gpuTime == 0)
+        {
+            ++numDroppedGpuScopes;
+            return;
+        }
+
+        auto name = entryName(enterEntry);
+        _writeEvent("B", name, 1, gpuTrack, static_cast<double>(enterEntry.gpuTime) * gpuScale + _gpuOffset, entryArgs(enterEntry));
+        _writeEvent("E", name, 1, gpuTrack, static_cast<double>(exitEntry.gpuTime) * gpuScale + _gpuOffset);
+    };
+
+    for (uint64_t i = _exportedIndex; i < endIndex; ++i)
+    {
+        auto& entry = log.entry(i);
+        const char* phase = entry.enter ? "B" : "E";
+        double cpuTimestamp = std::chrono::duration<double, std::chrono::microseconds::period>(entry.cpuTime - _startTime).count();
+
+        switch (entry.type)
+        {
+        case vsg::ProfileLog::FRAME: {
+            uint32_t tid = _tid(entry.thread_id);
+            if (entry.enter) ++numFrames;
+
+            uint64_t frameNumber = frameNumberOffset + (numFrames > 0 ? numFrames - 1 : 0);
+            if (entry.enter) _writeEvent("i", vsg::make_string("frame ", frameNumber), 1, tid, cpuTimestamp);
+            _writeEvent(phase, vsg::make_string("Frame ", frameNumber), 1, tid, cpuTimestamp);
+            break;
+        }
+        case vsg::ProfileLog::CPU:
+            _writeEvent(phase, entryName(entry), 1, _tid(entry.thread_id), cpuTimestamp, entry.enter ? entryArgs(entry) : std::string());
+            break;
+        case vsg::ProfileLog::COMMAND_BUFFER:
+            // recorded on the CPU and timestamped on the GPU, also used to align the GPU clock with the CPU clock
+            if (entry.gpuTime != 0 && !_gpuOffsetSet)
+            {
+                _gpuOffset = cpuTimestamp - static_cast<double>(entry.gpuTime) * gpuScale;
+                _gpuOffsetSet = true;
+            }
+            _writeEvent(phase, entryName(entry), 1, _tid(entry.thread_id), cpuTimestamp);
+            writeGpuScope(entry);
+            break;
+        case vsg::ProfileLog::GPU:
+            writeGpuScope(entry);
+            break;
+        default:
+            break;
+        }
+    }
+
+    _exportedIndex = endIndex;
+}
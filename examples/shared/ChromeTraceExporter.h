@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <fstream>
+#include <map>
+#include <thread>
+
+/// ChromeTraceExporter streams the entries of a vsg::Profiler's ProfileLog to a Chrome trace event JSON file while the application runs,
+/// so captures aren't limited by the ProfileLog's log_size and can be opened in chrome://tracing, Perfetto UI or Speedscope.
+/// Call update() once per frame, entries are written once they are lag frames old so the GPU timestamps have been read back,
+/// CPU scopes appear on a track per thread using the Profiler's thread names, GPU scopes on a separate GPU track, and each frame is marked.
+class ChromeTraceExporter : public vsg::Inherit<vsg::Object, ChromeTraceExporter>
+{
+public:
+    ChromeTraceExporter(vsg::ref_ptr<vsg::Profiler> in_profiler, const vsg::Path& in_filename);
+    ~ChromeTraceExporter();
+
+    vsg::ref_ptr<vsg::Profiler> profiler;
+    vsg::Path filename;
+    uint32_t lag = 8;                 // frames to wait before exporting so GPU timestamps are available
+    uint64_t frameNumberOffset = 0;   // added to the frame numbers in the trace, used when exporting a window of a longer run
+
+    bool valid() const { return _fout.good(); }
+
+    /// export the entries of all frames completed at least lag frames ago, call once per frame after Viewer::present().
+    void update();
+
+    /// export the log entries in the range [beginIndex, endIndex), used to write a window of the log rather than stream it.
+    void exportRange(uint64_t beginIndex, uint64_t endIndex);
+
+    /// export everything remaining and close the JSON array, call after Profiler::finish().
+    void finish();
+
+    // stats
+    uint64_t numEvents = 0;
+    uint64_t numFrames = 0;
+    uint64_t numLost = 0;             // entries overwritten in the ProfileLog before they could be exported, increase log_size or call update() more often
+    uint64_t numDroppedGpuScopes = 0; // GPU scopes not written because an entry or timestamp at one end wasn't available
+
+protected:
+    void _export(uint64_t endIndex);
+    void _writeEvent(const char* phase, const std::string& name, uint32_t pid, uint32_t tid, double timestamp, const std::string& args = {});
+    uint32_t _tid(std::thread::id id);
+
+    std::ofstream _fout;
+    bool _first = true;
+    bool _finished = false;
+    vsg::time_point _startTime;
+
+    uint64_t _beginIndex = 0; // first entry of the window passed to exportRange(), GPU scopes entered before it are dropped
+    uint64_t _exportedIndex = 0;
+    size_t _exportedFrames = 0;
+
+    std::map<std::thread::id, uint32_t> _threadIDs;
+    bool _gpuOffsetSet = false;
+    double _gpuOffset = 0.0; // microseconds added to GPU timestamps to align them with the CPU timeline
+};
@@ -0,0 +1,435 @@
+#include "DirtyRegionUpload.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+namespace
+{
+    // buffer offsets for image copies have to be a multiple of the texel size and of 4
+    VkDeviceSize copyAlignment(const vsg::Data& data)
+    {
+        return std::lcm(static_cast<VkDeviceSize>(std::max(data.properties.stride, 1u)), VkDeviceSize(4));
+    }
+
+    VkDeviceSize copyAlignment(const vsg::ImageInfoList& imageInfos)
+    {
+        VkDeviceSize alignment = 4;
+        for (auto& imageInfo : imageInfos) alignment = std::lcm(alignment, copyAlignment(*imageInfo->imageView->image->data));
+        return alignment;
+    }
+
+    VkDeviceSize align(VkDeviceSize offset, VkDeviceSize alignment)
+    {
+        return ((offset + alignment - 1) / alignment) * alignment;
+    }
+
+    // first of count rows, layers or elements to copy out of the total starting at begin, resuming from where the last partial copy stopped
+    uint32_t resumeFrom(uint32_t resume, uint32_t begin, uint32_t total, uint32_t count)
+    {
+        uint32_t end = begin + total;
+        return (resume > begin && resume < end) ? std::min(resume, end - count) : begin;
+    }
+} // namespace
+
+DirtyRegionUpload::DirtyRegionUpload(const vsg::ImageInfoList& in_imageInfos, uint32_t in_ringSize, VkDeviceSize in_frameCapacity) :
+    ringSize(std::max(in_ringSize, 2u)),
+    frameCapacity(align(in_frameCapacity, copyAlignment(in_imageInfos))),
+    _alignment(copyAlignment(in_imageInfos))
+{
+    for (auto& imageInfo : in_imageInfos)
+    {
+        auto& image = imageInfo->imageView->image;
+        _targets.push_back(Target{image->data, imageInfo, {}, image->imageType == VK_IMAGE_TYPE_3D});
+    }
+    _imageCopies.resize(_targets.size());
+    _bufferCopies.resize(_targets.size());
+    _resumeLayers.resize(_targets.size(), 0);
+    _resumeElements.resize(_targets.size(), 0);
+}
+
+DirtyRegionUpload::DirtyRegionUpload(const vsg::BufferInfoList& in_bufferInfos, uint32_t in_ringSize, VkDeviceSize in_frameCapacity) :
+    ringSize(std::max(in_ringSize, 2u)),
+    frameCapacity(align(in_frameCapacity, 4)),
+    _alignment(4)
+{
+    for (auto& bufferInfo : in_bufferInfos)
+    {
+        _targets.push_back(Target{bufferInfo->data, {}, bufferInfo, false});
+    }
+    _imageCopies.resize(_targets.size());
+    _bufferCopies.resize(_targets.size());
+    _resumeLayers.resize(_targets.size(), 0);
+    _resumeElements.resize(_targets.size(), 0);
+}
+
+DirtyRegionUpload::DirtyRegionUpload(vsg::ref_ptr<vsg::BufferInfo> in_bufferInfo, uint32_t in_ringSize, VkDeviceSize in_frameCapacity) :
+    DirtyRegionUpload(vsg::BufferInfoList{in_bufferInfo}, in_ringSize, in_frameCapacity)
+{
+}
+
+void DirtyRegionUpload::dirty(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t layer, uint32_t image)
+{
+    dirty(vsg::uivec3(x, y, layer), vsg::uivec3(width, height, 1), image);
+}
+
+void DirtyRegionUpload::dirty(const vsg::uivec3& offset, const vsg::uivec3& extent, uint32_t image)
+{
+    if (image >= _targets.size() || extent.x == 0 || extent.y == 0 || extent.z == 0) return;
+
+    auto& data = *_targets[image].data;
+    if (offset.x >= data.width() || offset.y >= data.height() || offset.z >= data.depth()) return;
+
+    Region region{offset.x, offset.y, offset.z, std::min(extent.x, data.width() - offset.x), std::min(extent.y, data.height() - offset.y), std::min(extent.z, data.depth() - offset.z), image};
+
+    if (_targets[image].bufferInfo)
+    {
+        // buffers are updated by whole rows, so each layer's band of rows is one span of elements
+        for (uint32_t layer = region.layer; layer < region.layer + region.depth; ++layer)
+        {
+            dirtyRange((layer * data.height() + region.y) * data.width(), region.height * data.width(), image);
+        }
+        return;
+    }
+
+    // merge with any regions it overlaps or touches, repeating as the grown region may now reach others
+    bool merged = true;
+    while (merged)
+    {
+        merged = false;
+        for (auto itr = _dirty.begin(); itr != _dirty.end(); ++itr)
+        {
+            if (itr->image != region.image) continue;
+            if (itr->x > region.x + region.width || region.x > itr->x + itr->width) continue;
+            if (itr->y > region.y + region.height || region.y > itr->y + itr->height) continue;
+            if (itr->layer > region.layer + region.depth || region.layer > itr->layer + itr->depth) continue;
+
+            uint32_t x0 = std::min(itr->x, region.x), y0 = std::min(itr->y, region.y), z0 = std::min(itr->layer, region.layer);
+            uint32_t x1 = std::max(itr->x + itr->width, region.x + region.width), y1 = std::max(itr->y + itr->height, region.y + region.height);
+            uint32_t z1 = std::max(itr->layer + itr->depth, region.layer + region.depth);
+            region = Region{x0, y0, z0, x1 - x0, y1 - y0, z1 - z0, region.image};
+
+            _dirty.erase(itr);
+            merged = true;
+            break;
+        }
+    }
+
+    _dirty.push_back(region);
+}
+
+void DirtyRegionUpload::dirtyRange(uint32_t first, uint32_t count, uint32_t buffer)
+{
+    if (buffer >= _targets.size() || !_targets[buffer].bufferInfo || count == 0) return;
+
+    auto size = static_cast<uint32_t>(_targets[buffer].data->valueCount());
+    if (first >= size) return;
+
+    _dirtySpans.push_back(Span{first, std::min(count, size - first), buffer});
+    ++numSpans;
+}
+
+void DirtyRegionUpload::dirtyAll(uint32_t image)
+{
+    if (image >= _targets.size()) return;
+
+    auto& data = *_targets[image].data;
+    dirty(vsg::uivec3(0, 0, 0), vsg::uivec3(data.width(), data.height(), data.depth()), image);
+}
+
+void DirtyRegionUpload::compile(vsg::Context& context)
+{
+    if (_staging) return;
+
+    _staging = vsg::createBufferAndMemory(context.device, frameCapacity * ringSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    // keep the staging ring mapped for the lifetime of the command
+    auto deviceID = context.deviceID;
+    void* ptr = nullptr;
+    if (_staging->getDeviceMemory(deviceID)->map(_staging->getMemoryOffset(deviceID), frameCapacity * ringSize, 0, &ptr) == VK_SUCCESS)
+    {
+        _mapped = static_cast<uint8_t*>(ptr);
+    }
+    else
+    {
+        vsg::warn("DirtyRegionUpload::compile() unable to map staging buffer.");
+    }
+}
+
+void DirtyRegionUpload::update()
+{
+    for (auto& copies : _imageCopies) copies.clear();
+    for (auto& copies : _bufferCopies) copies.clear();
+
+    if (!_mapped || (_dirty.empty() && _dirtySpans.empty())) return;
+
+    auto startTime = vsg::clock::now();
+
+    VkDeviceSize segmentOffset = _segment * frameCapacity;
+    VkDeviceSize offset = 0;
+    uint8_t* segment = _mapped + segmentOffset;
+
+    _packSpans(segment, segmentOffset, offset);
+    _packRegions(segment, segmentOffset, offset);
+
+    _segment = (_segment + 1) % ringSize;
+    ++numFrames;
+
+    packTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+}
+
+void DirtyRegionUpload::_packSpans(uint8_t* segment, VkDeviceSize segmentOffset, VkDeviceSize& offset)
+{
+    if (_dirtySpans.empty()) return;
+
+    // sort by buffer then position so overlapping, adjacent and nearby spans can be coalesced in a single pass
+    std::sort(_dirtySpans.begin(), _dirtySpans.end(), [](const Span& lhs, const Span& rhs) {
+        return lhs.buffer < rhs.buffer || (lhs.buffer == rhs.buffer && lhs.first < rhs.first);
+    });
+
+    std::vector<Span> coalesced;
+    coalesced.reserve(_dirtySpans.size());
+    for (auto& span : _dirtySpans)
+    {
+        if (!coalesced.empty())
+        {
+            auto& previous = coalesced.back();
+            uint64_t previousEnd = uint64_t(previous.first) + previous.count;
+            if (previous.buffer == span.buffer && uint64_t(span.first) <= previousEnd + coalesceGap)
+            {
+                previous.count = static_cast<uint32_t>(std::max(previousEnd, uint64_t(span.first) + span.count) - previous.first);
+                continue;
+            }
+        }
+        coalesced.push_back(span);
+    }
+
+    std::vector<Span> deferred;
+    for (auto& span : coalesced)
+    {
+        auto& target = _targets[span.buffer];
+        auto& data = *target.data;
+        size_t stride = data.properties.stride;
+        if (stride > frameCapacity)
+        {
+            throw vsg::Exception{vsg::make_string("Error: DirtyRegionUpload element of ", stride, " bytes is larger than the frameCapacity of ", frameCapacity, " bytes.")};
+        }
+
+        Span part = span;
+        size_t available = offset < frameCapacity ? frameCapacity - offset : 0;
+        if (static_cast<size_t>(span.count) * stride > available)
+        {
+            // copy the elements that fit and defer the rest, resuming after the last part copied so a span that is dirtied again
+            // every frame is still copied in full over several frames
+            auto count = static_cast<uint32_t>(available / stride);
+            if (count == 0)
+            {
+                deferred.push_back(span);
+                continue;
+            }
+
+            uint32_t& resume = _resumeElements[span.buffer];
+            uint32_t end = span.first + span.count;
+            part.first = resumeFrom(resume, span.first, span.count, count);
+            part.count = count;
+            resume = part.first + count;
+
+            if (part.first > span.first) deferred.push_back(Span{span.first, part.first - span.first, span.buffer});
+            if (resume < end) deferred.push_back(Span{resume, end - resume, span.buffer});
+        }
+
+        size_t begin = static_cast<size_t>(part.first) * stride;
+        size_t size = static_cast<size_t>(part.count) * stride;
+        std::memcpy(segment + offset, static_cast<const uint8_t*>(data.dataPointer()) + begin, size);
+        _bufferCopies[span.buffer].push_back(VkBufferCopy{segmentOffset + offset, target.bufferInfo->offset + begin, size});
+        offset = align(offset + size, _alignment);
+
+        ++numRegions;
+        numBytes += size;
+    }
+
+    numDeferred += deferred.size();
+    _dirtySpans.swap(deferred);
+}
+
+void DirtyRegionUpload::_packRegions(uint8_t* segment, VkDeviceSize segmentOffset, VkDeviceSize& offset)
+{
+    if (_dirty.empty()) return;
+
+    std::vector<Region> deferred;
+    for (auto& dirtyRegion : _dirty)
+    {
+        auto& data = *_targets[dirtyRegion.image].data;
+        size_t rowSize = static_cast<size_t>(dirtyRegion.width) * data.properties.stride;
+        size_t layerSize = rowSize * dirtyRegion.height;
+        if (rowSize > frameCapacity)
+        {
+            throw vsg::Exception{vsg::make_string("Error: DirtyRegionUpload row of ", rowSize, " bytes is larger than the frameCapacity of ", frameCapacity, " bytes.")};
+        }
+
+        Region region = dirtyRegion;
+        size_t available = offset < frameCapacity ? frameCapacity - offset : 0;
+        if (layerSize * dirtyRegion.depth > available)
+        {
+            // copy the layers that fit, or a band of the rows of one layer if a whole layer doesn't, and defer the rest. Each resumes after
+            // the last copied, so a region that is dirtied again every frame is still copied in full over several frames
+            uint32_t& resumeLayer = _resumeLayers[dirtyRegion.image];
+            auto numLayers = static_cast<uint32_t>(std::min<size_t>(dirtyRegion.depth, available / layerSize));
+            region.layer = resumeFrom(resumeLayer, dirtyRegion.layer, dirtyRegion.depth, std::max(numLayers, 1u));
+            region.depth = std::max(numLayers, 1u);
+
+            if (numLayers > 0)
+            {
+                resumeLayer = region.layer + region.depth;
+            }
+            else
+            {
+                auto numRows = static_cast<uint32_t>(available / rowSize);
+                if (numRows == 0)
+                {
+                    deferred.push_back(dirtyRegion);
+                    continue;
+                }
+
+                uint32_t rowEnd = dirtyRegion.y + dirtyRegion.height;
+                uint32_t& resumeRow = _resumeRows[{dirtyRegion.image, region.layer}];
+                region.y = resumeFrom(resumeRow, dirtyRegion.y, dirtyRegion.height, numRows);
+                region.height = numRows;
+                resumeRow = region.y + numRows;
+
+                // move on to the next layer once the last rows of this one have been copied
+                resumeLayer = resumeRow < rowEnd ? region.layer : region.layer + 1;
+
+                if (region.y > dirtyRegion.y) deferred.push_back(Region{dirtyRegion.x, dirtyRegion.y, region.layer, dirtyRegion.width, region.y - dirtyRegion.y, 1, dirtyRegion.image});
+                if (resumeRow < rowEnd) deferred.push_back(Region{dirtyRegion.x, resumeRow, region.layer, dirtyRegion.width, rowEnd - resumeRow, 1, dirtyRegion.image});
+            }
+
+            uint32_t layerEnd = dirtyRegion.layer + dirtyRegion.depth;
+            uint32_t copiedEnd = region.layer + region.depth;
+            if (region.layer > dirtyRegion.layer) deferred.push_back(Region{dirtyRegion.x, dirtyRegion.y, dirtyRegion.layer, dirtyRegion.width, dirtyRegion.height, region.layer - dirtyRegion.layer, dirtyRegion.image});
+            if (copiedEnd < layerEnd) deferred.push_back(Region{dirtyRegion.x, dirtyRegion.y, copiedEnd, dirtyRegion.width, dirtyRegion.height, layerEnd - copiedEnd, dirtyRegion.image});
+        }
+
+        size_t size = rowSize * region.height * region.depth;
+        _copy(region, rowSize, segment + offset, segmentOffset + offset);
+        offset = align(offset + size, _alignment);
+
+        ++numRegions;
+        numBytes += size;
+    }
+
+    numDeferred += deferred.size();
+    _dirty.swap(deferred);
+}
+
+void DirtyRegionUpload::_copy(const Region& region, size_t rowSize, uint8_t* dest, VkDeviceSize bufferOffset)
+{
+    auto& target = _targets[region.image];
+    auto& data = *target.data;
+    size_t stride = data.properties.stride;
+    const uint8_t* source = static_cast<const uint8_t*>(data.dataPointer());
+
+    // pack the rows tightly so the copy's bufferRowLength and bufferImageHeight can be left at 0
+    for (uint32_t layer = region.layer; layer < region.layer + region.depth; ++layer)
+    {
+        for (uint32_t r = 0; r < region.height; ++r)
+        {
+            size_t index = (static_cast<size_t>(layer) * data.height() + region.y + r) * data.width() + region.x;
+            std::memcpy(dest, source + index * stride, rowSize);
+            dest += rowSize;
+        }
+    }
+
+    VkBufferImageCopy copy = {};
+    copy.bufferOffset = bufferOffset;
+    copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copy.imageSubresource.mipLevel = 0;
+    if (target.volume)
+    {
+        // the layers of a 3D image are its slices
+        copy.imageSubresource.baseArrayLayer = 0;
+        copy.imageSubresource.layerCount = 1;
+        copy.imageOffset = VkOffset3D{static_cast<int32_t>(region.x), static_cast<int32_t>(region.y), static_cast<int32_t>(region.layer)};
+        copy.imageExtent = VkExtent3D{region.width, region.height, region.depth};
+    }
+    else
+    {
+        copy.imageSubresource.baseArrayLayer = region.layer;
+        copy.imageSubresource.layerCount = region.depth;
+        copy.imageOffset = VkOffset3D{static_cast<int32_t>(region.x), static_cast<int32_t>(region.y), 0};
+        copy.imageExtent = VkExtent3D{region.width, region.height, 1};
+    }
+    _imageCopies[region.image].push_back(copy);
+}
+
+void DirtyRegionUpload::record(vsg::CommandBuffer& commandBuffer) const
+{
+    if (!_staging) return;
+
+    auto deviceID = commandBuffer.deviceID;
+    VkBuffer stagingBuffer = _staging->vk(deviceID);
+
+    bool hasBufferCopies = false;
+    for (auto& copies : _bufferCopies) hasBufferCopies = hasBufferCopies || !copies.empty();
+
+    if (hasBufferCopies)
+    {
+        // wait for the previous frame's reads before overwriting, then make the writes visible to the readers. A single global barrier
+        // either side covers all the buffers, rather than a buffer barrier per buffer
+        VkMemoryBarrier barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr, dstAccessMask, VK_ACCESS_TRANSFER_WRITE_BIT};
+        vkCmdPipelineBarrier(commandBuffer, dstStageMask, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        for (size_t ti = 0; ti < _targets.size(); ++ti)
+        {
+            auto& copies = _bufferCopies[ti];
+            if (copies.empty()) continue;
+
+            vkCmdCopyBuffer(commandBuffer, stagingBuffer, _targets[ti].bufferInfo->buffer->vk(deviceID), static_cast<uint32_t>(copies.size()), copies.data());
+        }
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = dstAccessMask;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    for (size_t ti = 0; ti < _targets.size(); ++ti)
+    {
+        auto& copies = _imageCopies[ti];
+        if (copies.empty()) continue;
+
+        auto& imageInfo = *_targets[ti].imageInfo;
+        auto& image = *imageInfo.imageView->image;
+        VkImage vkImage = image.vk(deviceID);
+
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = dstAccessMask;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = imageInfo.imageLayout;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = vkImage;
+        barrier.subresourceRange = VkImageSubresourceRange{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, image.arrayLayers};
+        vkCmdPipelineBarrier(commandBuffer, dstStageMask, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, vkImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copies.size()), copies.data());
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = dstAccessMask;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = imageInfo.imageLayout;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+}
+
+void DirtyRegionUpload::report(std::ostream& out) const
+{
+    out << "DirtyRegionUpload targets = " << _targets.size() << ", staging ring = " << ringSize << " x " << (static_cast<double>(frameCapacity) / (1024.0 * 1024.0)) << "MB"
+        << ", coalesceGap = " << coalesceGap << std::endl;
+    if (numFrames == 0) return;
+
+    double frames = static_cast<double>(numFrames);
+    out << "    spans per frame = " << (static_cast<double>(numSpans) / frames) << ", regions per frame = " << (static_cast<double>(numRegions) / frames) << ", upload = " << (static_cast<double>(numBytes) / (1024.0 * frames)) << "KB/frame"
+        << ", deferred = " << numDeferred << ", pack = " << (packTime / frames) << "ms/frame" << std::endl;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <ostream>
+
+/// DirtyRegionUpload copies just the modified parts of image and buffer data to the GPU, rather than the whole of the data that Data::dirty() uploads.
+/// Image regions are tracked per image as boxes of rows and layers, with overlapping boxes merged, where an image's layers are its array layers
+/// or, for a 3D image, its slices. Buffer data is tracked as spans of elements, which update() sorts and coalesces when adjacent or separated by
+/// no more than coalesceGap elements. Each frame update() packs the dirty regions and spans into the next segment of a persistently mapped
+/// staging ring, and the command records the copies, so it should be placed in the CommandGraph ahead of the RenderGraph or compute dispatch
+/// that reads the data. Regions and spans too large for the space left in a segment are split, image regions into bands of rows, with the
+/// remainder deferred to the following frames. The data must be left as STATIC_DATA so it isn't also uploaded by the TransferTask, and its
+/// images shouldn't be mipmapped as only the base level is updated.
+class DirtyRegionUpload : public vsg::Inherit<vsg::Command, DirtyRegionUpload>
+{
+public:
+    /// upload regions of the images' data, each image's layers are the depth of its data
+    explicit DirtyRegionUpload(const vsg::ImageInfoList& in_imageInfos, uint32_t in_ringSize = 4, VkDeviceSize in_frameCapacity = 16 * 1024 * 1024);
+
+    /// upload spans of the buffers' data
+    explicit DirtyRegionUpload(const vsg::BufferInfoList& in_bufferInfos, uint32_t in_ringSize = 4, VkDeviceSize in_frameCapacity = 16 * 1024 * 1024);
+
+    /// upload spans of a single buffer's data
+    explicit DirtyRegionUpload(vsg::ref_ptr<vsg::BufferInfo> in_bufferInfo, uint32_t in_ringSize = 4, VkDeviceSize in_frameCapacity = 16 * 1024 * 1024);
+
+    /// number of segments in the staging ring, must be more than the number of frames in flight so a segment isn't written while the GPU reads it
+    const uint32_t ringSize;
+    const VkDeviceSize frameCapacity; // rows and elements beyond this are deferred to later frames, a single image row must fit
+
+    /// buffer spans separated by no more than this many elements are copied as one, trading a few redundant bytes for fewer copy regions
+    uint32_t coalesceGap = 0;
+
+    /// stages and accesses that read the data, the copies wait for them and they wait for the copies
+    VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    VkAccessFlags dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    /// mark a rectangle of a layer of an image as modified, for a buffer the whole of the rows are marked
+    void dirty(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t layer = 0, uint32_t image = 0);
+
+    /// mark a box of consecutive layers of an image as modified, the z of offset and extent being the first layer and number of layers
+    void dirty(const vsg::uivec3& offset, const vsg::uivec3& extent, uint32_t image = 0);
+
+    /// mark count elements from first of a buffer's data as modified
+    void dirtyRange(uint32_t first, uint32_t count, uint32_t buffer = 0);
+
+    /// mark the whole of an image or buffer's data as modified
+    void dirtyAll(uint32_t image = 0);
+
+    /// pack the dirty regions into this frame's staging segment, call after modifying the data and before Viewer::recordAndSubmit()
+    void update();
+
+    void compile(vsg::Context& context) override;
+    void record(vsg::CommandBuffer& commandBuffer) const override;
+
+    void report(std::ostream& out) const;
+
+    // stats
+    uint64_t numFrames = 0;
+    uint64_t numSpans = 0;   // buffer spans passed to dirtyRange()
+    uint64_t numRegions = 0; // copies recorded, after merging and coalescing
+    uint64_t numBytes = 0;
+    uint64_t numDeferred = 0; // regions and spans, or their remaining parts, that didn't fit in a frame's segment
+    double packTime = 0.0;    // milliseconds spent packing regions and spans into the staging ring
+
+protected:
+    struct Region
+    {
+        uint32_t x, y, layer, width, height, depth, image;
+    };
+
+    struct Span
+    {
+        uint32_t first, count, buffer;
+    };
+
+    struct Target
+    {
+        vsg::ref_ptr<vsg::Data> data;
+        vsg::ref_ptr<vsg::ImageInfo> imageInfo;
+        vsg::ref_ptr<vsg::BufferInfo> bufferInfo;
+        bool volume; // 3D image, layers are slices rather than array layers
+    };
+
+    std::vector<Target> _targets;
+    std::vector<Region> _dirty;
+    std::vector<Span> _dirtySpans;
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t> _resumeRows; // row after the last band copied, per image and layer
+    std::vector<uint32_t> _resumeLayers;                           // layer after the last layers copied, per image
+    std::vector<uint32_t> _resumeElements;                         // element after the last part of a span copied, per buffer
+
+    const VkDeviceSize _alignment; // multiple of every target's texel size and of 4
+
+    vsg::ref_ptr<vsg::Buffer> _staging;
+    uint8_t* _mapped = nullptr;
+    uint32_t _segment = 0;
+
+    // copies packed by update() for record()
+    std::vector<std::vector<VkBufferImageCopy>> _imageCopies; // per target
+    std::vector<std::vector<VkBufferCopy>> _bufferCopies;     // per target
+
+    void _packSpans(uint8_t* segment, VkDeviceSize segmentOffset, VkDeviceSize& offset);
+    void _packRegions(uint8_t* segment, VkDeviceSize segmentOffset, VkDeviceSize& offset);
+    void _copy(const Region& region, size_t rowSize, uint8_t* dest, VkDeviceSize bufferOffset);
+};
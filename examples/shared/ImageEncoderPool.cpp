@@ -0,0 +1,139 @@
+#include "ImageEncoderPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+ImageEncoderPool::ImageEncoderPool(uint32_t numThreads, size_t in_maxQueueSize, vsg::ref_ptr<vsg::Options> in_options) :
+    maxQueueSize(std::max(in_maxQueueSize, size_t(1))),
+    options(in_options)
+{
+    numThreads = std::max(numThreads, 1u);
+    for (uint32_t i = 0; i < numThreads; ++i)
+    {
+        _threads.emplace_back([this]() { _run(); });
+    }
+}
+
+ImageEncoderPool::~ImageEncoderPool()
+{
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        _done = true;
+    }
+    _jobAdded.notify_all();
+
+    // workers finish any queued jobs before exiting
+    for (auto& thread : _threads) thread.join();
+}
+
+bool ImageEncoderPool::add(vsg::ref_ptr<vsg::Data> data, const vsg::Path& filename, Converter converter)
+{
+    if (!data) return false;
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_jobs.size() >= maxQueueSize)
+        {
+            if (dropWhenFull)
+            {
+                ++numDropped;
+                return false;
+            }
+
+            // back-pressure, wait for a worker to take a job
+            ++numStalls;
+            auto startTime = vsg::clock::now();
+            _jobTaken.wait(lock, [&]() { return _jobs.size() < maxQueueSize; });
+            stallTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+        }
+
+        _jobs.push_back(Job{data, filename, converter});
+        ++numQueued;
+        maxQueueDepth = std::max(maxQueueDepth, _jobs.size());
+    }
+
+    _jobAdded.notify_one();
+    return true;
+}
+
+void ImageEncoderPool::flush()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _idle.wait(lock, [&]() { return _jobs.empty() && _numActive == 0; });
+}
+
+void ImageEncoderPool::_run()
+{
+    for (;;)
+    {
+        Job job;
+        {
+            // take the oldest job whose file isn't already being written by another worker, so repeated captures to one filename are written in order
+            std::unique_lock<std::mutex> lock(_mutex);
+            auto itr = _jobs.end();
+            _jobAdded.wait(lock, [&]() {
+                itr = std::find_if(_jobs.begin(), _jobs.end(), [&](const Job& candidate) { return _activeFilenames.count(candidate.filename.string()) == 0; });
+                return itr != _jobs.end() || (_done && _jobs.empty());
+            });
+            if (itr == _jobs.end()) return;
+
+            job = std::move(*itr);
+            _jobs.erase(itr);
+            _activeFilenames.insert(job.filename.string());
+            ++_numActive;
+        }
+        _jobTaken.notify_one();
+
+        auto startTime = vsg::clock::now();
+
+        auto data = job.converter ? job.converter(job.data) : job.data;
+        bool written = data && vsg::write(data, job.filename, options);
+
+        // release the mapped memory before reporting completion so the caller can reuse it
+        job.data = {};
+        data = {};
+
+        double duration = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+
+        {
+            std::scoped_lock<std::mutex> lock(_mutex);
+            if (written)
+                ++numWritten;
+            else
+                ++numFailed;
+            encodeTime += duration;
+            _activeFilenames.erase(job.filename.string());
+            --_numActive;
+        }
+        _idle.notify_all();
+        _jobAdded.notify_all();
+
+        if (!written) vsg::warn("ImageEncoderPool : failed to write ", job.filename);
+    }
+}
+
+ImageEncoderPool::Converter ImageEncoderPool::repackRows(uint32_t width, uint32_t height, size_t rowPitch, VkFormat format)
+{
+    return [width, height, rowPitch, format](vsg::ref_ptr<vsg::Data> mappedData) -> vsg::ref_ptr<vsg::Data> {
+        size_t destRowWidth = width * sizeof(vsg::ubvec4);
+        if (mappedData->dataSize() < rowPitch * (height - 1) + destRowWidth) return {};
+
+        auto source = static_cast<const uint8_t*>(mappedData->dataPointer());
+        auto imageData = vsg::ubvec4Array2D::create(width, height, vsg::Data::Properties{format});
+        for (uint32_t row = 0; row < height; ++row)
+        {
+            std::memcpy(imageData->dataPointer(row * width), source + row * rowPitch, destRowWidth);
+        }
+        return imageData;
+    };
+}
+
+void ImageEncoderPool::report(std::ostream& out) const
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    out << "ImageEncoderPool threads = " << _threads.size() << ", maxQueueSize = " << maxQueueSize << std::endl;
+    out << "    queued = " << numQueued << ", written = " << numWritten << ", failed = " << numFailed << ", dropped = " << numDropped << std::endl;
+    out << "    stalls = " << numStalls << ", stall time = " << stallTime << "ms, max queue depth = " << maxQueueDepth << std::endl;
+    if (numWritten > 0) out << "    average encode time = " << (encodeTime / static_cast<double>(numWritten + numFailed)) << "ms" << std::endl;
+}
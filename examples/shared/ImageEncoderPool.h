@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <thread>
+
+/// ImageEncoderPool converts and writes captured images on worker threads so the frame thread only has to map the image and queue it.
+/// The queued vsg::Data, typically a vsg::MappedData, keeps its image memory alive via ref_ptr until written, so the caller must not reuse
+/// that image for a later capture until then. When maxQueueSize images are waiting add() blocks, or drops the image if dropWhenFull is set.
+class ImageEncoderPool : public vsg::Inherit<vsg::Object, ImageEncoderPool>
+{
+public:
+    ImageEncoderPool(uint32_t numThreads, size_t in_maxQueueSize = 8, vsg::ref_ptr<vsg::Options> in_options = {});
+    ~ImageEncoderPool();
+
+    /// convert the data prior to writing, run on the worker thread
+    using Converter = std::function<vsg::ref_ptr<vsg::Data>(vsg::ref_ptr<vsg::Data>)>;
+
+    size_t maxQueueSize = 8;
+    bool dropWhenFull = false;
+    vsg::ref_ptr<vsg::Options> options;
+
+    /// queue data to be converted and written to filename, returns false if it was dropped.
+    bool add(vsg::ref_ptr<vsg::Data> data, const vsg::Path& filename, Converter converter = {});
+
+    /// wait until all queued images have been written.
+    void flush();
+
+    /// Converter that copies the rows of a mapped ubyteArray with rowPitch bytes per row into a tightly packed ubvec4Array2D.
+    static Converter repackRows(uint32_t width, uint32_t height, size_t rowPitch, VkFormat format);
+
+    void report(std::ostream& out) const;
+
+    // stats
+    uint64_t numQueued = 0;
+    uint64_t numWritten = 0;
+    uint64_t numFailed = 0;
+    uint64_t numDropped = 0;
+    uint64_t numStalls = 0; // calls to add() that had to wait for the queue to drain
+    double stallTime = 0.0; // milliseconds the frame thread spent waiting in add()
+    double encodeTime = 0.0; // milliseconds spent by the workers converting and writing
+    size_t maxQueueDepth = 0;
+
+protected:
+    struct Job
+    {
+        vsg::ref_ptr<vsg::Data> data;
+        vsg::Path filename;
+        Converter converter;
+    };
+
+    void _run();
+
+    mutable std::mutex _mutex;
+    std::condition_variable _jobAdded;
+    std::condition_variable _jobTaken;
+    std::condition_variable _idle;
+    std::deque<Job> _jobs;
+    std::set<std::string> _activeFilenames;
+    size_t _numActive = 0;
+    bool _done = false;
+    std::vector<std::thread> _threads;
+};
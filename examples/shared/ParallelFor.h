@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <algorithm>
+#include <functional>
+
+/// RunRange is the vsg::Operation that parallelFor() adds to the OperationThreads' queue for each range.
+struct RunRange : public vsg::Inherit<vsg::Operation, RunRange>
+{
+    RunRange(const std::function<void(size_t, size_t)>& in_function, size_t in_begin, size_t in_end, vsg::ref_ptr<vsg::Latch> in_latch) :
+        function(in_function),
+        begin(in_begin),
+        end(in_end),
+        latch(in_latch) {}
+
+    const std::function<void(size_t, size_t)>& function;
+    size_t begin;
+    size_t end;
+    vsg::ref_ptr<vsg::Latch> latch;
+
+    void run() override
+    {
+        function(begin, end);
+        latch->count_down();
+    }
+};
+
+/// call function(begin, end) for consecutive ranges of up to chunkSize items covering 0 to count, spread across the OperationThreads,
+/// returning once all of them have completed. Without OperationThreads, or with a single range, function is called for the whole range
+/// on the calling thread.
+inline void parallelFor(const vsg::ref_ptr<vsg::OperationThreads>& operationThreads, size_t count, size_t chunkSize, const std::function<void(size_t, size_t)>& function)
+{
+    chunkSize = std::max(chunkSize, size_t(1));
+    size_t numOperations = (count + chunkSize - 1) / chunkSize;
+
+    if (!operationThreads || numOperations <= 1)
+    {
+        if (count > 0) function(0, count);
+        return;
+    }
+
+    auto latch = vsg::Latch::create(static_cast<int>(numOperations));
+    for (size_t begin = 0; begin < count; begin += chunkSize)
+    {
+        operationThreads->add(RunRange::create(function, begin, std::min(begin + chunkSize, count), latch));
+    }
+
+    // help the worker threads with the queue, then wait for the operations they are still working on
+    operationThreads->run();
+    latch->wait();
+}
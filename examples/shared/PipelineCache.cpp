@@ -0,0 +1,239 @@
+#include "PipelineCache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+    constexpr char pipelineCacheMagic[8] = "vsgpc01";
+
+    // number of bytes between the read position and the end of the file
+    uint64_t remainingLength(std::ifstream& fin)
+    {
+        auto position = fin.tellg();
+        fin.seekg(0, std::ios::end);
+        auto end = fin.tellg();
+        fin.seekg(position);
+        return (position < 0 || end < position) ? 0 : static_cast<uint64_t>(end - position);
+    }
+} // namespace
+
+PipelineCache::PipelineCache(vsg::ref_ptr<vsg::Device> in_device, const vsg::Path& in_filename) :
+    device(in_device),
+    filename(in_filename)
+{
+    std::vector<uint8_t> initialData;
+
+    std::ifstream fin(filename.string(), std::ios::in | std::ios::binary);
+    if (!fin)
+    {
+        loadStatus = "no cache file, starting cold";
+    }
+    else
+    {
+        FileHeader header;
+        auto expected = _header();
+        if (!fin.read(reinterpret_cast<char*>(&header), sizeof(FileHeader)) || std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0)
+        {
+            loadStatus = "unrecognized cache file, starting cold";
+        }
+        else if (header.vendorID != expected.vendorID || header.deviceID != expected.deviceID || header.driverVersion != expected.driverVersion ||
+                 std::memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) != 0 || std::memcmp(header.driverUUID, expected.driverUUID, VK_UUID_SIZE) != 0)
+        {
+            loadStatus = "cache file written by a different device or driver, starting cold";
+        }
+        else if (header.dataSize > remainingLength(fin))
+        {
+            loadStatus = "truncated cache file, starting cold";
+        }
+        else
+        {
+            initialData.resize(header.dataSize);
+            if (fin.read(reinterpret_cast<char*>(initialData.data()), static_cast<std::streamsize>(initialData.size())))
+            {
+                numBytesLoaded = initialData.size();
+                loadStatus = "loaded, starting warm";
+                warm = true;
+            }
+            else
+            {
+                initialData.clear();
+                loadStatus = "truncated cache file, starting cold";
+            }
+        }
+    }
+
+    VkPipelineCacheCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = initialData.size();
+    createInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+    if (VkResult result = vkCreatePipelineCache(*device, &createInfo, device->getAllocationCallbacks(), &_pipelineCache); result != VK_SUCCESS)
+    {
+        throw vsg::Exception{"Error: vsg::PipelineCache failed to create VkPipelineCache.", result};
+    }
+}
+
+PipelineCache::~PipelineCache()
+{
+    if (_pipelineCache) vkDestroyPipelineCache(*device, _pipelineCache, device->getAllocationCallbacks());
+}
+
+PipelineCache::FileHeader PipelineCache::_header() const
+{
+    FileHeader header = {};
+    std::memcpy(header.magic, pipelineCacheMagic, sizeof(header.magic));
+
+    auto physicalDevice = device->getPhysicalDevice();
+    auto& properties = physicalDevice->getProperties();
+    header.vendorID = properties.vendorID;
+    header.deviceID = properties.deviceID;
+    header.driverVersion = properties.driverVersion;
+    std::memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+    // the driverUUID catches driver updates that leave driverVersion unchanged
+    auto idProperties = physicalDevice->getProperties<VkPhysicalDeviceIDProperties, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES>();
+    std::memcpy(header.driverUUID, idProperties.driverUUID, VK_UUID_SIZE);
+
+    return header;
+}
+
+vsg::ref_ptr<BindCachedGraphicsPipeline> PipelineCache::replacement(const vsg::BindGraphicsPipeline& bindGraphicsPipeline)
+{
+    std::scoped_lock<std::mutex> lock(_replacementsMutex);
+
+    auto& observer = _replacements[bindGraphicsPipeline.pipeline.get()];
+    if (auto existing = observer.ref_ptr()) return existing;
+
+    vsg::ref_ptr<BindCachedGraphicsPipeline> created = BindCachedGraphicsPipeline::create(bindGraphicsPipeline.pipeline, vsg::ref_ptr<PipelineCache>(this));
+    observer = created;
+    return created;
+}
+
+bool PipelineCache::save()
+{
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(*device, _pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) return false;
+
+    std::vector<uint8_t> data(dataSize);
+    if (vkGetPipelineCacheData(*device, _pipelineCache, &dataSize, data.data()) != VK_SUCCESS) return false;
+
+    auto header = _header();
+    header.dataSize = dataSize;
+
+    // write to a temporary file then rename it over the original, so readers only ever see a complete cache file
+    auto tempFilename = filename.string() + ".tmp";
+    {
+        std::ofstream fout(tempFilename, std::ios::out | std::ios::binary | std::ios::trunc);
+        fout.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+        fout.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(dataSize));
+        if (!fout.good())
+        {
+            vsg::warn("PipelineCache::save() failed to write ", tempFilename);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempFilename, filename.string(), ec);
+    if (ec)
+    {
+        vsg::warn("PipelineCache::save() failed to rename ", tempFilename, " to ", filename, ", ", ec.message());
+        std::filesystem::remove(tempFilename, ec);
+        return false;
+    }
+
+    numBytesSaved = dataSize;
+    return true;
+}
+
+void PipelineCache::report(std::ostream& out) const
+{
+    out << "PipelineCache " << filename << " : " << loadStatus << std::endl;
+    out << "    bytes loaded = " << numBytesLoaded << ", pipelines created = " << numPipelinesCreated << ", pipeline creation time = " << (static_cast<double>(pipelineCreationTime) / 1.0e6) << "ms"
+        << ", bytes saved = " << numBytesSaved << std::endl;
+}
+
+BindCachedGraphicsPipeline::BindCachedGraphicsPipeline(vsg::ref_ptr<vsg::GraphicsPipeline> in_pipeline, vsg::ref_ptr<PipelineCache> in_pipelineCache) :
+    Inherit(in_pipeline),
+    pipelineCache(in_pipelineCache)
+{
+}
+
+BindCachedGraphicsPipeline::~BindCachedGraphicsPipeline()
+{
+    auto device = pipelineCache->device;
+    for (auto vk_pipeline : _pipelines)
+    {
+        if (vk_pipeline) vkDestroyPipeline(*device, vk_pipeline, device->getAllocationCallbacks());
+    }
+}
+
+void BindCachedGraphicsPipeline::compile(vsg::Context& context)
+{
+    uint32_t viewID = context.viewID;
+    if (viewID < _pipelines.size() && _pipelines[viewID]) return;
+    if (viewID >= _pipelines.size()) _pipelines.resize(viewID + 1, VK_NULL_HANDLE);
+
+    auto& graphicsPipeline = *pipeline;
+    graphicsPipeline.layout->compile(context);
+    for (auto& shaderStage : graphicsPipeline.stages) shaderStage->compile(context);
+
+    // set up the create info the same way GraphicsPipeline does, combining the context's default and override states with the pipeline's own
+    VkGraphicsPipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.layout = graphicsPipeline.layout->vk(context.deviceID);
+    pipelineInfo.renderPass = *context.renderPass;
+    pipelineInfo.subpass = graphicsPipeline.subpass;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1;
+
+    std::vector<VkPipelineShaderStageCreateInfo> shaderStageCreateInfo(graphicsPipeline.stages.size());
+    for (size_t i = 0; i < graphicsPipeline.stages.size(); ++i)
+    {
+        shaderStageCreateInfo[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStageCreateInfo[i].pNext = nullptr;
+        graphicsPipeline.stages[i]->apply(context, shaderStageCreateInfo[i]);
+    }
+    pipelineInfo.stageCount = static_cast<uint32_t>(shaderStageCreateInfo.size());
+    pipelineInfo.pStages = shaderStageCreateInfo.data();
+
+    for (auto& pipelineState : context.defaultPipelineStates) pipelineState->apply(context, pipelineInfo);
+    for (auto& pipelineState : graphicsPipeline.pipelineStates) pipelineState->apply(context, pipelineInfo);
+    for (auto& pipelineState : context.overridePipelineStates) pipelineState->apply(context, pipelineInfo);
+
+    auto device = context.device;
+    auto startTime = vsg::clock::now();
+    if (VkResult result = vkCreateGraphicsPipelines(*device, pipelineCache->vk(), 1, &pipelineInfo, device->getAllocationCallbacks(), &_pipelines[viewID]); result != VK_SUCCESS)
+    {
+        throw vsg::Exception{"Error: BindCachedGraphicsPipeline failed to create VkPipeline.", result};
+    }
+
+    ++(pipelineCache->numPipelinesCreated);
+    pipelineCache->pipelineCreationTime += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(vsg::clock::now() - startTime).count());
+}
+
+void BindCachedGraphicsPipeline::record(vsg::CommandBuffer& commandBuffer) const
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelines[commandBuffer.viewID]);
+    commandBuffer.setCurrentPipelineLayout(pipeline->layout);
+}
+
+void UsePipelineCache::apply(vsg::Node& node)
+{
+    node.traverse(*this);
+}
+
+void UsePipelineCache::apply(vsg::StateGroup& stateGroup)
+{
+    for (auto& stateCommand : stateGroup.stateCommands)
+    {
+        auto bindGraphicsPipeline = stateCommand.cast<vsg::BindGraphicsPipeline>();
+        if (!bindGraphicsPipeline || bindGraphicsPipeline->is_compatible(typeid(BindCachedGraphicsPipeline))) continue;
+
+        stateCommand = pipelineCache->replacement(*bindGraphicsPipeline);
+    }
+
+    stateGroup.traverse(*this);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <mutex>
+#include <ostream>
+
+class BindCachedGraphicsPipeline;
+
+/// PipelineCache wraps a VkPipelineCache that persists across runs. The cache file is loaded when the cache is created for a Device,
+/// and is used only if it was written by the same device and driver; otherwise the cache starts empty. save() writes to a temporary
+/// file and renames it over the original, so an interrupted save never leaves a truncated cache behind. The cache also holds the
+/// BindCachedGraphicsPipeline that replace each GraphicsPipeline, so subgraphs compiled by different threads share their replacements.
+class PipelineCache : public vsg::Inherit<vsg::Object, PipelineCache>
+{
+public:
+    PipelineCache(vsg::ref_ptr<vsg::Device> in_device, const vsg::Path& in_filename);
+
+    const vsg::ref_ptr<vsg::Device> device;
+    const vsg::Path filename;
+
+    VkPipelineCache vk() const { return _pipelineCache; }
+
+    /// return the BindCachedGraphicsPipeline that replaces bindGraphicsPipeline, creating it for the first use of its GraphicsPipeline
+    vsg::ref_ptr<BindCachedGraphicsPipeline> replacement(const vsg::BindGraphicsPipeline& bindGraphicsPipeline);
+
+    /// write the cache contents to filename, return true on success
+    bool save();
+
+    void report(std::ostream& out) const;
+
+    // stats
+    size_t numBytesLoaded = 0;
+    size_t numBytesSaved = 0;
+    std::atomic_uint numPipelinesCreated{0};
+    std::atomic_uint64_t pipelineCreationTime{0}; // nanoseconds spent in vkCreateGraphicsPipelines
+    std::string loadStatus;
+    bool warm = false; // true when the cache file was loaded
+
+protected:
+    virtual ~PipelineCache();
+
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint8_t driverUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+    };
+
+    FileHeader _header() const;
+
+    VkPipelineCache _pipelineCache = VK_NULL_HANDLE;
+
+    // the replacements only observe so they're released along with the subgraphs using them, their pipeline keeps the key's address in use
+    std::mutex _replacementsMutex;
+    std::map<const vsg::GraphicsPipeline*, vsg::observer_ptr<BindCachedGraphicsPipeline>> _replacements;
+};
+
+/// label for time to first frame measurements, so cold and warm runs can be told apart
+inline const char* pipelineCacheState(const vsg::ref_ptr<PipelineCache>& pipelineCache)
+{
+    if (!pipelineCache) return "";
+    return pipelineCache->warm ? " (warm pipeline cache)" : " (cold pipeline cache)";
+}
+
+/// BindCachedGraphicsPipeline creates its GraphicsPipeline's VkPipeline through a PipelineCache, rather than through the
+/// GraphicsPipeline's own compile() which doesn't use a VkPipelineCache. As the PipelineCache is shared, pipelines compiled
+/// by the Viewer's compile traversal and by the CompileManager both populate and hit the same cache.
+class BindCachedGraphicsPipeline : public vsg::Inherit<vsg::BindGraphicsPipeline, BindCachedGraphicsPipeline>
+{
+public:
+    BindCachedGraphicsPipeline(vsg::ref_ptr<vsg::GraphicsPipeline> in_pipeline, vsg::ref_ptr<PipelineCache> in_pipelineCache);
+
+    vsg::ref_ptr<PipelineCache> pipelineCache;
+
+    void compile(vsg::Context& context) override;
+    void record(vsg::CommandBuffer& commandBuffer) const override;
+
+protected:
+    virtual ~BindCachedGraphicsPipeline();
+
+    std::vector<VkPipeline> _pipelines; // per viewID
+};
+
+/// UsePipelineCache replaces the BindGraphicsPipeline in a subgraph with the PipelineCache's BindCachedGraphicsPipeline, call before compiling the subgraph.
+class UsePipelineCache : public vsg::Inherit<vsg::Visitor, UsePipelineCache>
+{
+public:
+    explicit UsePipelineCache(vsg::ref_ptr<PipelineCache> in_pipelineCache) :
+        pipelineCache(in_pipelineCache) {}
+
+    vsg::ref_ptr<PipelineCache> pipelineCache;
+
+    void apply(vsg::Node& node) override;
+    void apply(vsg::StateGroup& stateGroup) override;
+};
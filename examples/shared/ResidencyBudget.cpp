@@ -0,0 +1,231 @@
+#include "ResidencyBudget.h"
+
+#include <algorithm>
+#include <limits>
+#include <set>
+
+namespace
+{
+    // the CPU and GPU bytes of a loaded subgraph, attached to the subgraph so they go when the pager releases it
+    class SubgraphSizes : public vsg::Inherit<vsg::Object, SubgraphSizes>
+    {
+    public:
+        uint64_t cpuBytes = 0;
+        uint64_t gpuBytes = 0;
+        bool gpuMeasured = false; // GPU memory requirements are only available once the subgraph has been compiled
+    };
+
+    const char* const subgraphSizesKey = "ResidencyBudget";
+
+    // sum the CPU and GPU bytes of a loaded subgraph, stopping at nested PagedLOD high resolution children as they are accounted for separately.
+    class MeasureSubgraph : public vsg::ConstVisitor
+    {
+    public:
+        explicit MeasureSubgraph(uint32_t in_deviceID) :
+            deviceID(in_deviceID) {}
+
+        const uint32_t deviceID;
+        uint64_t cpuBytes = 0;
+        uint64_t gpuBytes = 0;
+        bool compiled = true;
+
+        void apply(const vsg::Object& object) override
+        {
+            object.traverse(*this);
+        }
+
+        void apply(const vsg::StateGroup& stateGroup) override
+        {
+            for (auto& stateCommand : stateGroup.stateCommands) stateCommand->accept(*this);
+            stateGroup.traverse(*this);
+        }
+
+        void apply(const vsg::PagedLOD& plod) override
+        {
+            if (plod.children[1].node) plod.children[1].node->accept(*this);
+        }
+
+        void apply(const vsg::BindVertexBuffers& bvb) override
+        {
+            for (auto& bufferInfo : bvb.arrays) measure(bufferInfo);
+        }
+
+        void apply(const vsg::BindIndexBuffer& bib) override
+        {
+            measure(bib.indices);
+        }
+
+        void apply(const vsg::VertexIndexDraw& vid) override
+        {
+            for (auto& bufferInfo : vid.arrays) measure(bufferInfo);
+            measure(vid.indices);
+        }
+
+        void apply(const vsg::Geometry& geometry) override
+        {
+            for (auto& bufferInfo : geometry.arrays) measure(bufferInfo);
+            measure(geometry.indices);
+            geometry.traverse(*this);
+        }
+
+        void apply(const vsg::DescriptorBuffer& descriptorBuffer) override
+        {
+            for (auto& bufferInfo : descriptorBuffer.bufferInfoList) measure(bufferInfo);
+        }
+
+        void apply(const vsg::DescriptorImage& descriptorImage) override
+        {
+            for (auto& imageInfo : descriptorImage.imageInfoList)
+            {
+                if (!imageInfo->imageView || !imageInfo->imageView->image) continue;
+
+                auto image = imageInfo->imageView->image;
+                if (!_visited.insert(image.get()).second) continue;
+
+                if (image->data) cpuBytes += image->data->dataSize();
+
+                if (image->vk(deviceID) != VK_NULL_HANDLE)
+                    gpuBytes += image->getMemoryRequirements(deviceID).size;
+                else
+                    compiled = false;
+            }
+        }
+
+    protected:
+        void measure(const vsg::ref_ptr<vsg::BufferInfo>& bufferInfo)
+        {
+            if (!bufferInfo || !_visited.insert(bufferInfo.get()).second) return;
+
+            if (bufferInfo->data) cpuBytes += bufferInfo->data->dataSize();
+
+            if (bufferInfo->buffer)
+                gpuBytes += bufferInfo->range;
+            else
+                compiled = false;
+        }
+
+        std::set<const void*> _visited;
+    };
+
+    // collect the PagedLOD that currently have their high resolution child resident
+    class CollectResident : public vsg::Visitor
+    {
+    public:
+        std::vector<vsg::PagedLOD*> resident;
+
+        void apply(vsg::Node& node) override
+        {
+            node.traverse(*this);
+        }
+
+        void apply(vsg::PagedLOD& plod) override
+        {
+            if (plod.children[0].node)
+            {
+                resident.push_back(&plod);
+                plod.children[0].node->accept(*this);
+            }
+        }
+    };
+} // namespace
+
+ResidencyBudget::ResidencyBudget(vsg::ref_ptr<vsg::Node> in_scene, vsg::ref_ptr<vsg::DatabasePager> in_databasePager, uint64_t in_maxBytes) :
+    scene(in_scene),
+    databasePager(in_databasePager),
+    maxBytes(in_maxBytes)
+{
+}
+
+vsg::ref_ptr<ResidencyBudget> ResidencyBudget::install(vsg::Viewer& viewer, vsg::ref_ptr<vsg::Node> in_scene, uint64_t in_maxBytes)
+{
+    if (in_maxBytes == 0) return {};
+
+    // bound the loaded tiles by CPU + GPU bytes rather than count
+    for (auto& task : viewer.recordAndSubmitTasks)
+    {
+        if (task->databasePager) return ResidencyBudget::create(in_scene, task->databasePager, in_maxBytes);
+    }
+    return {};
+}
+
+void ResidencyBudget::update(vsg::ref_ptr<vsg::FrameStamp> frameStamp)
+{
+    if (!scene || !databasePager || !frameStamp) return;
+    if ((frameStamp->frameCount % updateInterval) != 0) return;
+
+    CollectResident collect;
+    scene->accept(collect);
+
+    struct Candidate
+    {
+        uint64_t lastUsed;
+        uint64_t bytes;
+    };
+    std::vector<Candidate> candidates;
+    candidates.reserve(collect.resident.size());
+
+    numResident = collect.resident.size();
+    residentCPUBytes = 0;
+    residentGPUBytes = 0;
+
+    for (auto plod : collect.resident)
+    {
+        auto& subgraph = *plod->children[0].node;
+        auto sizes = subgraph.getObject<SubgraphSizes>(subgraphSizesKey);
+        if (!sizes || !sizes->gpuMeasured)
+        {
+            MeasureSubgraph measure(deviceID);
+            subgraph.accept(measure);
+
+            if (!sizes)
+            {
+                auto measured = SubgraphSizes::create();
+                subgraph.setObject(subgraphSizesKey, measured);
+                sizes = measured.get();
+            }
+            sizes->cpuBytes = measure.cpuBytes;
+            sizes->gpuBytes = measure.gpuBytes;
+            sizes->gpuMeasured = measure.compiled;
+        }
+
+        residentCPUBytes += sizes->cpuBytes;
+        residentGPUBytes += sizes->gpuBytes;
+        candidates.push_back(Candidate{plod->frameHighResLastUsed.load(), sizes->cpuBytes + sizes->gpuBytes});
+    }
+
+    peakResidentBytes = std::max(peakResidentBytes, residentBytes());
+
+    // keep the most recently visible subgraphs that fit in the budget, the pager expires the least recently visible beyond the target
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& lhs, const Candidate& rhs) { return lhs.lastUsed > rhs.lastUsed; });
+
+    uint64_t total = 0;
+    uint32_t numWithinBudget = 0;
+    for (auto& candidate : candidates)
+    {
+        total += candidate.bytes;
+        if (total > maxBytes) break;
+        ++numWithinBudget;
+    }
+
+    // while under budget allow room for the pager to load more, based on the average size of what is resident
+    if (candidates.empty())
+    {
+        numWithinBudget = std::numeric_limits<uint32_t>::max();
+    }
+    else if (numWithinBudget == candidates.size())
+    {
+        uint64_t averageBytes = std::max<uint64_t>(1, total / candidates.size());
+        uint64_t numMore = (maxBytes - total) / averageBytes;
+        numWithinBudget = static_cast<uint32_t>(std::min<uint64_t>(numWithinBudget + numMore, std::numeric_limits<uint32_t>::max()));
+    }
+
+    targetMaxNumPagedLOD = std::max(minPagedLOD, numWithinBudget);
+    databasePager->targetMaxNumPagedLODWithHighResSubgraphs = targetMaxNumPagedLOD;
+}
+
+void ResidencyBudget::report(std::ostream& out) const
+{
+    out << "residency budget = " << maxBytes << " bytes" << std::endl;
+    out << "    numResident = " << numResident << ", targetMaxNumPagedLODWithHighResSubgraphs = " << targetMaxNumPagedLOD << std::endl;
+    out << "    resident bytes = " << residentBytes() << " (CPU " << residentCPUBytes << ", GPU " << residentGPUBytes << "), peak = " << peakResidentBytes << std::endl;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <ostream>
+
+/// ResidencyBudget bounds the memory used by the high resolution subgraphs loaded by a DatabasePager by bytes rather than tile count.
+/// It measures the CPU and GPU bytes of each loaded subgraph, ranks them by when they were last visible, and sets the pager's
+/// targetMaxNumPagedLODWithHighResSubgraphs to the number of most recently visible subgraphs that fit within maxBytes,
+/// so the pager's own least recently used expiry evicts the rest without the policy having to touch the scene graph.
+/// The measured sizes are attached to each loaded subgraph, so they are released along with it.
+class ResidencyBudget : public vsg::Inherit<vsg::Object, ResidencyBudget>
+{
+public:
+    ResidencyBudget(vsg::ref_ptr<vsg::Node> in_scene, vsg::ref_ptr<vsg::DatabasePager> in_databasePager, uint64_t in_maxBytes);
+
+    /// create a ResidencyBudget for the DatabasePager of the viewer's RecordAndSubmitTasks, overriding its --maxPagedLOD target each update,
+    /// call after Viewer::compile() has assigned the DatabasePager. Returns null if maxBytes is 0 or the scene has no PagedLOD to page.
+    static vsg::ref_ptr<ResidencyBudget> install(vsg::Viewer& viewer, vsg::ref_ptr<vsg::Node> in_scene, uint64_t in_maxBytes);
+
+    vsg::ref_ptr<vsg::Node> scene;
+    vsg::ref_ptr<vsg::DatabasePager> databasePager;
+    uint64_t maxBytes = 0;           // combined CPU and GPU budget
+    uint32_t deviceID = 0;           // device used to query GPU memory requirements
+    uint32_t minPagedLOD = 16;       // lower bound for the pager's target so the visible set can always be kept
+    uint32_t updateInterval = 10;    // frames between re-evaluation of the resident set
+
+    /// call once per frame after Viewer::update() so newly merged subgraphs are accounted for.
+    void update(vsg::ref_ptr<vsg::FrameStamp> frameStamp);
+
+    void report(std::ostream& out) const;
+
+    // stats from the last update
+    uint64_t numResident = 0;
+    uint64_t residentCPUBytes = 0;
+    uint64_t residentGPUBytes = 0;
+    uint64_t peakResidentBytes = 0;
+    uint32_t targetMaxNumPagedLOD = 0;
+
+    uint64_t residentBytes() const { return residentCPUBytes + residentGPUBytes; }
+};
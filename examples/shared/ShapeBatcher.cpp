@@ -0,0 +1,271 @@
+#include "ShapeBatcher.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    /// find the StateGroup, CullNode and VertexIndexDraw of a subgraph created by the Builder
+    class FindBuilderDraw : public vsg::Inherit<vsg::Visitor, FindBuilderDraw>
+    {
+    public:
+        vsg::StateGroup* stateGroup = nullptr;
+        vsg::CullNode* cullNode = nullptr;
+        vsg::VertexIndexDraw* vid = nullptr;
+
+        void apply(vsg::Node& node) override
+        {
+            node.traverse(*this);
+        }
+
+        void apply(vsg::StateGroup& sg) override
+        {
+            if (!stateGroup) stateGroup = &sg;
+            sg.traverse(*this);
+        }
+
+        void apply(vsg::CullNode& cn) override
+        {
+            if (!cullNode) cullNode = &cn;
+            cn.traverse(*this);
+        }
+
+        void apply(vsg::VertexIndexDraw& in_vid) override
+        {
+            if (!vid) vid = &in_vid;
+        }
+    };
+} // namespace
+
+ShapeBatcher::ShapeBatcher(vsg::ref_ptr<vsg::Builder> in_builder) :
+    builder(in_builder),
+    shapeCache(ShapeCache::create(in_builder))
+{
+}
+
+void ShapeBatcher::add(ShapeCache::Shape shape, const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo)
+{
+    ++numShapes;
+
+    if (info.positions || info.colors || stateInfo.billboard)
+    {
+        _individual.push_back(shapeCache->create(shape, info, stateInfo));
+        ++numIndividual;
+        return;
+    }
+
+    // batch on everything but the placement and color, which become per instance data
+    vsg::GeometryInfo localInfo = info;
+    localInfo.position.set(0.0f, 0.0f, 0.0f);
+    localInfo.transform = vsg::mat4();
+    localInfo.color.set(1.0f, 1.0f, 1.0f, 1.0f);
+
+    _batches[Key(shape, localInfo, stateInfo)].push_back(Instance{vsg::dmat4(info.transform) * vsg::translate(vsg::dvec3(info.position)), info.color});
+}
+
+vsg::ref_ptr<vsg::Node> ShapeBatcher::build()
+{
+    auto startTime = vsg::clock::now();
+
+    auto group = vsg::Group::create();
+    for (auto& node : _individual) group->addChild(node);
+
+    for (auto& [key, instances] : _batches)
+    {
+        if (instances.size() >= minInstances)
+        {
+            if (auto node = _buildInstanced(key, instances))
+            {
+                group->addChild(node);
+                ++numInstancedDraws;
+                numInstances += instances.size();
+                continue;
+            }
+        }
+
+        // place each shape with a transform over the ShapeCache's shared geometry
+        auto info = std::get<1>(key);
+        for (auto& instance : instances)
+        {
+            info.transform = vsg::mat4(instance.matrix);
+            info.color = instance.color;
+            group->addChild(shapeCache->create(std::get<0>(key), info, std::get<2>(key)));
+            ++numIndividual;
+        }
+    }
+
+    _individual.clear();
+    _batches.clear();
+
+    buildTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+
+    if (group->children.size() == 1) return group->children.front();
+    return group;
+}
+
+vsg::ref_ptr<vsg::Node> ShapeBatcher::_buildInstanced(const Key& key, const std::vector<Instance>& instances)
+{
+    auto numInstances = static_cast<uint32_t>(instances.size());
+    auto translations = vsg::vec3Array::create(numInstances);
+    auto rotations = vsg::quatArray::create(numInstances);
+    auto scales = vsg::vec3Array::create(numInstances);
+    auto colors = vsg::vec4Array::create(numInstances);
+
+    const double epsilon = 1e-6;
+    bool rotated = false;
+    bool scaled = false;
+    for (uint32_t i = 0; i < numInstances; ++i)
+    {
+        vsg::dvec3 translation, scale;
+        vsg::dquat rotation;
+        if (!vsg::decompose(instances[i].matrix, translation, rotation, scale)) return {};
+
+        translations->at(i) = vsg::vec3(translation);
+        rotations->at(i) = vsg::quat(rotation);
+        scales->at(i) = vsg::vec3(scale);
+        colors->at(i) = instances[i].color;
+
+        if (std::abs(rotation.x) > epsilon || std::abs(rotation.y) > epsilon || std::abs(rotation.z) > epsilon) rotated = true;
+        if (std::abs(scale.x - 1.0) > epsilon || std::abs(scale.y - 1.0) > epsilon || std::abs(scale.z - 1.0) > epsilon) scaled = true;
+    }
+
+    // let the Builder set up the instanced translations and colors, it already supports these through GeometryInfo::positions and colors
+    auto info = std::get<1>(key);
+    info.positions = translations;
+    info.colors = colors;
+
+    auto stateInfo = std::get<2>(key);
+    stateInfo.instance_positions_vec3 = true;
+    stateInfo.instance_colors_vec4 = true;
+
+    auto node = shapeCache->build(std::get<0>(key), info, stateInfo);
+    if (!node) return {};
+
+    if ((rotated || scaled) && !_addRotationsAndScales(*node, *translations, rotations, scales)) return {};
+
+    return node;
+}
+
+bool ShapeBatcher::_addRotationsAndScales(vsg::Node& node, const vsg::vec3Array& translations, vsg::ref_ptr<vsg::quatArray> rotations, vsg::ref_ptr<vsg::vec3Array> scales)
+{
+    auto draw = vsg::visit<FindBuilderDraw>(node);
+    if (!draw.stateGroup || !draw.vid) return false;
+
+    auto& stateCommands = draw.stateGroup->stateCommands;
+    auto itr = std::find_if(stateCommands.begin(), stateCommands.end(), [](const vsg::ref_ptr<vsg::StateCommand>& stateCommand) { return stateCommand->is_compatible(typeid(vsg::BindGraphicsPipeline)); });
+    if (itr == stateCommands.end()) return false;
+
+    // the per instance rotations and scales go in the bindings following the Builder's vertex arrays
+    auto& vid = *draw.vid;
+    uint32_t rotationBinding = vid.firstBinding + static_cast<uint32_t>(vid.arrays.size());
+
+    // the Builder shares pipelines between shapes, so share the instanced variant of each pipeline the same way
+    auto pipeline = itr->cast<vsg::BindGraphicsPipeline>()->pipeline;
+    auto [cacheItr, inserted] = _instancedPipelines.try_emplace(std::make_pair(pipeline, rotationBinding));
+    if (inserted) cacheItr->second = _createInstancedPipeline(*pipeline, rotationBinding);
+    if (!cacheItr->second) return false;
+
+    // replace the pipeline in this StateGroup rather than modifying the shared one
+    *itr = cacheItr->second;
+
+    vsg::DataList arrays;
+    for (auto& bufferInfo : vid.arrays) arrays.push_back(bufferInfo->data);
+    arrays.push_back(rotations);
+    arrays.push_back(scales);
+    vid.assignArrays(arrays);
+
+    // the Builder bounded the instances by their translations alone, so enlarge the bound to cover the rotated and scaled shapes
+    vsg::ref_ptr<vsg::vec3Array> vertices;
+    if (!vid.arrays.empty()) vertices = vid.arrays.front()->data.cast<vsg::vec3Array>();
+    if (draw.cullNode && vertices && !vertices->empty())
+    {
+        vsg::dbox localBounds;
+        for (auto& vertex : *vertices) localBounds.add(vertex);
+        vsg::dvec3 localCentre = (localBounds.min + localBounds.max) * 0.5;
+        double localRadius = vsg::length(localBounds.max - localBounds.min) * 0.5;
+
+        vsg::dbox bounds;
+        for (size_t i = 0; i < translations.size(); ++i)
+        {
+            vsg::dvec3 scale(scales->at(i));
+            vsg::dvec3 centre = vsg::dvec3(translations.at(i)) + vsg::dquat(rotations->at(i)) * (localCentre * scale);
+            double radius = localRadius * std::max({std::abs(scale.x), std::abs(scale.y), std::abs(scale.z)});
+            bounds.add(centre - vsg::dvec3(radius, radius, radius));
+            bounds.add(centre + vsg::dvec3(radius, radius, radius));
+        }
+        draw.cullNode->bound.set((bounds.min + bounds.max) * 0.5, vsg::length(bounds.max - bounds.min) * 0.5);
+    }
+
+    return true;
+}
+
+vsg::ref_ptr<vsg::BindGraphicsPipeline> ShapeBatcher::_createInstancedPipeline(const vsg::GraphicsPipeline& pipeline, uint32_t rotationBinding)
+{
+    vsg::ref_ptr<vsg::VertexInputState> vertexInputState;
+    for (auto& pipelineState : pipeline.pipelineStates)
+    {
+        if (auto vis = pipelineState.cast<vsg::VertexInputState>()) vertexInputState = vis;
+    }
+    if (!vertexInputState) return {};
+
+    // take the instance attribute locations and formats from the ShaderSet the Builder uses, flat and phong share the standard vertex shader
+    auto shaderSet = builder->shaderSet ? builder->shaderSet : vsg::createPhongShaderSet(builder->options);
+    const auto& rotationAttribute = shaderSet->getAttributeBinding("vsg_Rotation");
+    const auto& scaleAttribute = shaderSet->getAttributeBinding("vsg_Scale");
+    if (rotationAttribute.name.empty() || scaleAttribute.name.empty()) return {};
+
+    for (auto& attribute : vertexInputState->vertexAttributeDescriptions)
+    {
+        if (attribute.location == rotationAttribute.location || attribute.location == scaleAttribute.location) return {};
+    }
+
+    // the variant of the vertex shader has to be compiled from source
+    vsg::ShaderStages shaderStages;
+    for (auto& shaderStage : pipeline.stages)
+    {
+        if (shaderStage->stage != VK_SHADER_STAGE_VERTEX_BIT)
+        {
+            shaderStages.push_back(shaderStage);
+            continue;
+        }
+
+        if (!shaderStage->module || shaderStage->module->source.empty()) return {};
+
+        // same defines as the original, so the descriptor set layouts and the outputs to the fragment shader are unchanged
+        auto hints = vsg::ShaderCompileSettings::create();
+        if (shaderStage->module->hints) hints->defines = shaderStage->module->hints->defines;
+        hints->defines.insert("VSG_INSTANCE_ROTATION");
+        hints->defines.insert("VSG_INSTANCE_SCALE");
+
+        auto vertexShader = vsg::ShaderStage::create(VK_SHADER_STAGE_VERTEX_BIT, shaderStage->entryPointName, shaderStage->module->source, hints);
+        vertexShader->specializationConstants = shaderStage->specializationConstants;
+        shaderStages.push_back(vertexShader);
+    }
+
+    uint32_t scaleBinding = rotationBinding + 1;
+
+    auto vertexBindings = vertexInputState->vertexBindingDescriptions;
+    auto vertexAttributes = vertexInputState->vertexAttributeDescriptions;
+    vertexBindings.push_back(VkVertexInputBindingDescription{rotationBinding, sizeof(vsg::quat), VK_VERTEX_INPUT_RATE_INSTANCE});
+    vertexAttributes.push_back(VkVertexInputAttributeDescription{rotationAttribute.location, rotationBinding, rotationAttribute.format, 0});
+    vertexBindings.push_back(VkVertexInputBindingDescription{scaleBinding, sizeof(vsg::vec3), VK_VERTEX_INPUT_RATE_INSTANCE});
+    vertexAttributes.push_back(VkVertexInputAttributeDescription{scaleAttribute.location, scaleBinding, scaleAttribute.format, 0});
+
+    vsg::GraphicsPipelineStates pipelineStates;
+    for (auto& pipelineState : pipeline.pipelineStates)
+    {
+        if (pipelineState == vertexInputState)
+            pipelineStates.push_back(vsg::VertexInputState::create(vertexBindings, vertexAttributes));
+        else
+            pipelineStates.push_back(pipelineState);
+    }
+
+    ++numInstancedPipelines;
+    return vsg::BindGraphicsPipeline::create(vsg::GraphicsPipeline::create(pipeline.layout, shaderStages, pipelineStates, pipeline.subpass));
+}
+
+void ShapeBatcher::report(std::ostream& out) const
+{
+    out << "ShapeBatcher : shapes = " << numShapes << ", instanced draws = " << numInstancedDraws << ", instances = " << numInstances << ", individual shapes = " << numIndividual
+        << ", instanced pipelines = " << numInstancedPipelines << ", build time = " << buildTime << "ms" << std::endl;
+}
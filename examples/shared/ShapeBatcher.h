@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ShapeCache.h"
+
+#include <ostream>
+
+/// ShapeBatcher collects Builder shapes and replaces each set of repeated shapes, ones that differ only in their placement and color,
+/// with a single instanced draw. The placements go into per instance arrays: translations through the Builder's own GeometryInfo::positions
+/// support (VSG_INSTANCE_TRANSLATION) and colors through GeometryInfo::colors. When a batch includes rotated or scaled shapes, the pipeline
+/// the Builder created is cloned with VSG_INSTANCE_ROTATION and VSG_INSTANCE_SCALE enabled, once per pipeline and shared between the batches
+/// using it, and the rotations and scales are appended as further per instance arrays. Shapes that aren't repeated often enough, or can't be instanced, are built individually through a ShapeCache.
+/// The instanced pipelines are modified before compilation, so the Builder must not have a CompileTraversal assigned.
+class ShapeBatcher : public vsg::Inherit<vsg::Object, ShapeBatcher>
+{
+public:
+    explicit ShapeBatcher(vsg::ref_ptr<vsg::Builder> in_builder);
+
+    vsg::ref_ptr<vsg::Builder> builder;
+    vsg::ref_ptr<ShapeCache> shapeCache; // builds the shapes that aren't instanced
+    uint32_t minInstances = 2;          // shapes repeated fewer times than this are built individually
+
+    /// add a shape to be built by the next call to build(), parameters are as for the vsg::Builder create methods
+    void add(ShapeCache::Shape shape, const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo);
+
+    /// build all the shapes added since the last call to build()
+    vsg::ref_ptr<vsg::Node> build();
+
+    void report(std::ostream& out) const;
+
+    // stats
+    size_t numShapes = 0;
+    size_t numInstancedDraws = 0;
+    size_t numInstances = 0;
+    size_t numIndividual = 0;
+    size_t numInstancedPipelines = 0; // pipelines cloned with per instance rotations and scales
+    double buildTime = 0.0; // milliseconds spent in build()
+
+protected:
+    struct Instance
+    {
+        vsg::dmat4 matrix;
+        vsg::vec4 color;
+    };
+
+    using Key = std::tuple<ShapeCache::Shape, vsg::GeometryInfo, vsg::StateInfo>;
+
+    std::map<Key, std::vector<Instance>> _batches;
+    std::vector<vsg::ref_ptr<vsg::Node>> _individual; // shapes with their own per instance data, built when added
+
+    // instanced variants of the Builder's pipelines, keyed by the original and the binding of the rotations, null where one can't be created
+    std::map<std::pair<vsg::ref_ptr<vsg::GraphicsPipeline>, uint32_t>, vsg::ref_ptr<vsg::BindGraphicsPipeline>> _instancedPipelines;
+
+    vsg::ref_ptr<vsg::Node> _buildInstanced(const Key& key, const std::vector<Instance>& instances);
+    bool _addRotationsAndScales(vsg::Node& node, const vsg::vec3Array& translations, vsg::ref_ptr<vsg::quatArray> rotations, vsg::ref_ptr<vsg::vec3Array> scales);
+    vsg::ref_ptr<vsg::BindGraphicsPipeline> _createInstancedPipeline(const vsg::GraphicsPipeline& pipeline, uint32_t rotationBinding);
+};
@@ -0,0 +1,104 @@
+#include "ShapeCache.h"
+
+vsg::ref_ptr<vsg::Node> ShapeCache::build(Shape shape, const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo)
+{
+    switch (shape)
+    {
+    case (BOX): return builder->createBox(info, stateInfo);
+    case (CAPSULE): return builder->createCapsule(info, stateInfo);
+    case (CONE): return builder->createCone(info, stateInfo);
+    case (CYLINDER): return builder->createCylinder(info, stateInfo);
+    case (DISK): return builder->createDisk(info, stateInfo);
+    case (QUAD): return builder->createQuad(info, stateInfo);
+    case (SPHERE): return builder->createSphere(info, stateInfo);
+    case (HEIGHTFIELD): return builder->createHeightField(info, stateInfo);
+    }
+    return {};
+}
+
+vsg::ref_ptr<vsg::Node> ShapeCache::create(Shape shape, const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo)
+{
+    // per instance data is positioned by the instance arrays rather than the transform, so can't be shared this way
+    if (info.positions || info.colors || stateInfo.billboard)
+    {
+        ++numPassThrough;
+        return build(shape, info, stateInfo);
+    }
+
+    // build at the origin and move the position and transform into a MatrixTransform
+    vsg::GeometryInfo localInfo = info;
+    localInfo.position.set(0.0f, 0.0f, 0.0f);
+    localInfo.transform = vsg::mat4();
+
+    auto& prototype = _prototypes[std::make_tuple(shape, localInfo, stateInfo)];
+    if (prototype)
+    {
+        ++numHits;
+    }
+    else
+    {
+        auto startTime = vsg::clock::now();
+        prototype = build(shape, localInfo, stateInfo);
+        buildTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+        ++numMisses;
+    }
+
+    auto matrix = vsg::dmat4(info.transform) * vsg::translate(vsg::dvec3(info.position));
+    if (matrix == vsg::dmat4()) return prototype;
+
+    auto transform = vsg::MatrixTransform::create(matrix);
+    transform->addChild(prototype);
+    return transform;
+}
+
+void ShapeCache::report(std::ostream& out) const
+{
+    out << "ShapeCache : unique shapes = " << _prototypes.size() << ", hits = " << numHits << ", misses = " << numMisses << ", passed through = " << numPassThrough
+        << ", build time = " << buildTime << "ms" << std::endl;
+}
+
+void CollectGeometryStats::apply(const vsg::Node& node)
+{
+    if (_firstVisit(node)) ++numNodes;
+    node.traverse(*this);
+}
+
+void CollectGeometryStats::apply(const vsg::VertexIndexDraw& vid)
+{
+    _countDraw(vid, vid.arrays, vid.indices);
+}
+
+void CollectGeometryStats::apply(const vsg::VertexDraw& vd)
+{
+    _countDraw(vd, vd.arrays, {});
+}
+
+void CollectGeometryStats::apply(const vsg::Geometry& geometry)
+{
+    _countDraw(geometry, geometry.arrays, geometry.indices);
+}
+
+void CollectGeometryStats::_countDraw(const vsg::Node& node, const vsg::BufferInfoList& arrays, const vsg::ref_ptr<vsg::BufferInfo>& indices)
+{
+    ++numDraws;
+    if (!_firstVisit(node)) return;
+
+    ++numNodes;
+    ++numUniqueDraws;
+    for (auto& bufferInfo : arrays) _countData(bufferInfo);
+    _countData(indices);
+}
+
+void CollectGeometryStats::_countData(const vsg::ref_ptr<vsg::BufferInfo>& bufferInfo)
+{
+    if (!bufferInfo || !bufferInfo->data || !_firstVisit(*bufferInfo->data)) return;
+
+    ++numArrays;
+    numArrayBytes += bufferInfo->data->dataSize();
+}
+
+void CollectGeometryStats::report(std::ostream& out) const
+{
+    out << "nodes = " << numNodes << ", draws = " << numDraws << ", unique draws = " << numUniqueDraws << ", arrays = " << numArrays
+        << ", array memory = " << (double(numArrayBytes) / (1024.0 * 1024.0)) << "MB" << std::endl;
+}
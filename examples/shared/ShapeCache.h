@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <ostream>
+
+/// ShapeCache sits in front of a vsg::Builder so that shapes which differ only in where they are placed share one tessellated
+/// subgraph. The Builder bakes GeometryInfo::position and GeometryInfo::transform into the vertex arrays, so every call with a new
+/// position tessellates and allocates new arrays. ShapeCache instead builds the shape once at the origin for each distinct set of
+/// remaining GeometryInfo parameters and StateInfo, and returns a MatrixTransform placing that shared subgraph.
+/// Shapes using per instance positions or colors, or billboarding, are passed straight through to the Builder.
+class ShapeCache : public vsg::Inherit<vsg::Object, ShapeCache>
+{
+public:
+    explicit ShapeCache(vsg::ref_ptr<vsg::Builder> in_builder) :
+        builder(in_builder) {}
+
+    enum Shape
+    {
+        BOX,
+        CAPSULE,
+        CONE,
+        CYLINDER,
+        DISK,
+        QUAD,
+        SPHERE,
+        HEIGHTFIELD
+    };
+
+    vsg::ref_ptr<vsg::Builder> builder;
+
+    vsg::ref_ptr<vsg::Node> create(Shape shape, const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo);
+
+    vsg::ref_ptr<vsg::Node> createBox(const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo) { return create(BOX, info, stateInfo); }
+    vsg::ref_ptr<vsg::Node> createCapsule(const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo) { return create(CAPSULE, info, stateInfo); }
+    vsg::ref_ptr<vsg::Node> createCone(const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo) { return create(CONE, info, stateInfo); }
+    vsg::ref_ptr<vsg::Node> createCylinder(const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo) { return create(CYLINDER, info, stateInfo); }
+    vsg::ref_ptr<vsg::Node> createDisk(const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo) { return create(DISK, info, stateInfo); }
+    vsg::ref_ptr<vsg::Node> createQuad(const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo) { return create(QUAD, info, stateInfo); }
+    vsg::ref_ptr<vsg::Node> createSphere(const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo) { return create(SPHERE, info, stateInfo); }
+    vsg::ref_ptr<vsg::Node> createHeightField(const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo) { return create(HEIGHTFIELD, info, stateInfo); }
+
+    /// create the shape with the Builder, bypassing the cache
+    vsg::ref_ptr<vsg::Node> build(Shape shape, const vsg::GeometryInfo& info, const vsg::StateInfo& stateInfo);
+
+    /// release the cached subgraphs, subgraphs already returned remain valid
+    void clear() { _prototypes.clear(); }
+
+    void report(std::ostream& out) const;
+
+    // stats
+    size_t numHits = 0;
+    size_t numMisses = 0;
+    size_t numPassThrough = 0;
+    double buildTime = 0.0; // milliseconds spent in the Builder
+
+protected:
+    std::map<std::tuple<Shape, vsg::GeometryInfo, vsg::StateInfo>, vsg::ref_ptr<vsg::Node>> _prototypes;
+};
+
+/// CollectGeometryStats counts the nodes, draws and vertex/index data in a scene graph, counting shared objects once,
+/// to compare the memory footprint of scene graphs built with and without sharing.
+class CollectGeometryStats : public vsg::Inherit<vsg::ConstVisitor, CollectGeometryStats>
+{
+public:
+    size_t numNodes = 0;     // unique nodes
+    size_t numDraws = 0;     // draws recorded per frame, shared draws are counted for every path to them
+    size_t numUniqueDraws = 0;
+    size_t numArrays = 0;    // unique vertex and index arrays
+    size_t numArrayBytes = 0;
+
+    void apply(const vsg::Node& node) override;
+    void apply(const vsg::VertexIndexDraw& vid) override;
+    void apply(const vsg::VertexDraw& vd) override;
+    void apply(const vsg::Geometry& geometry) override;
+
+    void report(std::ostream& out) const;
+
+protected:
+    std::set<const vsg::Object*> _visited;
+
+    bool _firstVisit(const vsg::Object& object) { return _visited.insert(&object).second; }
+    void _countDraw(const vsg::Node& node, const vsg::BufferInfoList& arrays, const vsg::ref_ptr<vsg::BufferInfo>& indices);
+    void _countData(const vsg::ref_ptr<vsg::BufferInfo>& bufferInfo);
+};
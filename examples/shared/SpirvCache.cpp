@@ -0,0 +1,193 @@
+#include "SpirvCache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+    constexpr uint32_t spirvCacheMagic = 0x56505331; // "VPS1"
+
+    // FNV-1a, stable across platforms and runs unlike std::hash
+    uint64_t hash64(const std::string& str)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : str)
+        {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+} // namespace
+
+SpirvCache::SpirvCache(const vsg::Path& in_directory) :
+    directory(in_directory)
+{
+    vsg::makeDirectory(directory);
+}
+
+std::string SpirvCache::key(const vsg::ShaderStage& stage)
+{
+    if (!stage.module || stage.module->source.empty()) return {};
+
+    std::ostringstream str;
+    str << "vsg " << VSG_VERSION_STRING << "\n";
+    str << "stage " << stage.stage << " entry " << stage.entryPointName << "\n";
+
+    if (auto& settings = stage.module->hints)
+    {
+        str << "vulkanVersion " << settings->vulkanVersion << " clientInputVersion " << settings->clientInputVersion << " language " << static_cast<int>(settings->language)
+            << " defaultVersion " << settings->defaultVersion << " target " << static_cast<int>(settings->target) << " forwardCompatible " << settings->forwardCompatible
+            << " generateDebugInfo " << settings->generateDebugInfo << " optimize " << settings->optimize << "\n";
+
+        // defines is a std::set so is already in a deterministic order
+        str << "defines";
+        for (auto& define : settings->defines) str << " " << define;
+        str << "\n";
+    }
+
+    str << "source\n"
+        << stage.module->source;
+    return str.str();
+}
+
+vsg::Path SpirvCache::_filename(const std::string& key) const
+{
+    std::ostringstream str;
+    str << std::hex << std::setw(16) << std::setfill('0') << hash64(key) << ".spv";
+    return directory / str.str();
+}
+
+bool SpirvCache::read(vsg::ShaderStage& stage)
+{
+    auto stageKey = key(stage);
+    if (stageKey.empty()) return false;
+
+    auto startTime = vsg::clock::now();
+
+    std::ifstream fin(_filename(stageKey).string(), std::ios::in | std::ios::binary | std::ios::ate);
+    if (!fin) return false;
+
+    size_t fileSize = static_cast<size_t>(fin.tellg());
+    fin.seekg(0);
+
+    uint32_t header[2] = {0, 0};
+    if (fileSize < sizeof(header) || !fin.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != spirvCacheMagic) return false;
+    if (fileSize < sizeof(header) + header[1] || (fileSize - sizeof(header) - header[1]) % sizeof(uint32_t) != 0) return false;
+
+    std::string storedKey(header[1], '\0');
+    if (!fin.read(storedKey.data(), header[1]) || storedKey != stageKey) return false;
+
+    vsg::ShaderModule::SPIRV code((fileSize - sizeof(header) - header[1]) / sizeof(uint32_t));
+    if (code.empty() || !fin.read(reinterpret_cast<char*>(code.data()), static_cast<std::streamsize>(code.size() * sizeof(uint32_t)))) return false;
+
+    stage.module->code = std::move(code);
+
+    std::scoped_lock<std::mutex> lock(_statsMutex);
+    readTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+    return true;
+}
+
+bool SpirvCache::write(const vsg::ShaderStage& stage)
+{
+    auto stageKey = key(stage);
+    if (stageKey.empty() || stage.module->code.empty()) return false;
+
+    uint32_t header[2] = {spirvCacheMagic, static_cast<uint32_t>(stageKey.size())};
+    auto& code = stage.module->code;
+
+    // write to a temporary file, named per thread, then rename, so concurrent readers never see a partial file
+    auto filename = _filename(stageKey);
+    auto tempFilename = filename.string() + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+    {
+        std::ofstream fout(tempFilename, std::ios::out | std::ios::binary | std::ios::trunc);
+        fout.write(reinterpret_cast<const char*>(header), sizeof(header));
+        fout.write(stageKey.data(), static_cast<std::streamsize>(stageKey.size()));
+        fout.write(reinterpret_cast<const char*>(code.data()), static_cast<std::streamsize>(code.size() * sizeof(uint32_t)));
+        if (!fout.good()) return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempFilename, filename.string(), ec);
+    if (ec)
+    {
+        std::filesystem::remove(tempFilename, ec);
+        return false;
+    }
+    return true;
+}
+
+bool SpirvCache::compile(vsg::ShaderStages& stages, vsg::ref_ptr<vsg::ShaderCompiler> shaderCompiler, vsg::ref_ptr<const vsg::Options> options)
+{
+    vsg::ShaderStages stagesToCompile;
+    size_t hits = 0;
+    for (auto& stage : stages)
+    {
+        if (!stage->module || !stage->module->code.empty() || stage->module->source.empty()) continue;
+
+        if (read(*stage))
+            ++hits;
+        else
+            stagesToCompile.push_back(stage);
+    }
+
+    {
+        std::scoped_lock<std::mutex> lock(_statsMutex);
+        numHits += hits;
+        numMisses += stagesToCompile.size();
+    }
+
+    if (stagesToCompile.empty()) return true;
+    if (!shaderCompiler || !shaderCompiler->supported()) return false;
+
+    auto startTime = vsg::clock::now();
+    bool result = shaderCompiler->compile(stagesToCompile, {}, options);
+    {
+        std::scoped_lock<std::mutex> lock(_statsMutex);
+        compileTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+    }
+
+    if (result)
+    {
+        for (auto& stage : stagesToCompile) write(*stage);
+    }
+    return result;
+}
+
+void SpirvCache::report(std::ostream& out) const
+{
+    out << "SpirvCache " << directory << " : hits = " << numHits << ", misses = " << numMisses << ", read = " << readTime << "ms, compile = " << compileTime << "ms" << std::endl;
+}
+
+void CollectShaderStages::apply(vsg::Node& node)
+{
+    node.traverse(*this);
+}
+
+void CollectShaderStages::apply(vsg::StateGroup& stateGroup)
+{
+    for (auto& stateCommand : stateGroup.stateCommands) stateCommand->accept(*this);
+    stateGroup.traverse(*this);
+}
+
+void CollectShaderStages::apply(vsg::BindGraphicsPipeline& bindGraphicsPipeline)
+{
+    if (bindGraphicsPipeline.pipeline) _add(bindGraphicsPipeline.pipeline->stages);
+}
+
+void CollectShaderStages::apply(vsg::BindComputePipeline& bindComputePipeline)
+{
+    if (bindComputePipeline.pipeline && bindComputePipeline.pipeline->stage) _add(vsg::ShaderStages{bindComputePipeline.pipeline->stage});
+}
+
+void CollectShaderStages::_add(const vsg::ShaderStages& in_stages)
+{
+    for (auto& stage : in_stages)
+    {
+        if (_visited.insert(stage.get()).second) stages.push_back(stage);
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <mutex>
+#include <ostream>
+
+/// SpirvCache is a content addressed on disk cache of compiled SPIR-V, so ShaderSet variants are compiled once rather than on every run.
+/// Each ShaderStage is keyed on its GLSL source, stage, entry point and the ShaderCompileSettings (including defines) held in its
+/// ShaderModule's hints, along with the VSG version. The key's 64 bit hash names the file, while the full key is stored in the file
+/// and compared on load so a hash collision is treated as a miss. Files #included by the source aren't part of the key, so the cache
+/// directory should be cleared when shared include files change. read(), write() and compile() may be called from multiple threads.
+class SpirvCache : public vsg::Inherit<vsg::Object, SpirvCache>
+{
+public:
+    explicit SpirvCache(const vsg::Path& in_directory);
+
+    const vsg::Path directory;
+
+    /// full key for a stage, empty if the stage has no source to compile
+    static std::string key(const vsg::ShaderStage& stage);
+
+    /// assign the cached SPIR-V to stage's module, return true on a hit
+    bool read(vsg::ShaderStage& stage);
+
+    /// store the compiled SPIR-V of stage's module, return true on success
+    bool write(const vsg::ShaderStage& stage);
+
+    /// fill in stages from the cache, compiling and storing those that miss, return false if compilation fails
+    bool compile(vsg::ShaderStages& stages, vsg::ref_ptr<vsg::ShaderCompiler> shaderCompiler, vsg::ref_ptr<const vsg::Options> options);
+
+    void report(std::ostream& out) const;
+
+    // stats
+    size_t numHits = 0;
+    size_t numMisses = 0;
+    double readTime = 0.0;    // milliseconds spent reading cached SPIR-V
+    double compileTime = 0.0; // milliseconds spent compiling misses
+
+protected:
+    vsg::Path _filename(const std::string& key) const;
+
+    std::mutex _statsMutex;
+};
+
+/// CollectShaderStages gathers the ShaderStages referenced by a scene graph's graphics and compute pipelines.
+class CollectShaderStages : public vsg::Inherit<vsg::Visitor, CollectShaderStages>
+{
+public:
+    vsg::ShaderStages stages;
+
+    void apply(vsg::Node& node) override;
+    void apply(vsg::StateGroup& stateGroup) override;
+    void apply(vsg::BindGraphicsPipeline& bindGraphicsPipeline) override;
+    void apply(vsg::BindComputePipeline& bindComputePipeline) override;
+
+protected:
+    std::set<vsg::ShaderStage*> _visited;
+    void _add(const vsg::ShaderStages& in_stages);
+};
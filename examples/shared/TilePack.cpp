@@ -0,0 +1,568 @@
+#include "TilePack.h"
+#include "TileTemplate.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+#if defined(_WIN32)
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+namespace
+{
+    const uint32_t recordMagic = 0x4b505456; // "VTPK"
+    const char indexMagic[8] = {'V', 'S', 'G', 'T', 'P', 'I', 'D', 'X'};
+    const uint32_t indexVersion = 1;
+
+    struct RecordHeader
+    {
+        uint32_t magic = recordMagic;
+        uint32_t x = 0;
+        uint32_t y = 0;
+        uint32_t level = 0;
+        uint32_t layer = 0;
+        uint32_t padding = 0;
+        uint64_t size = 0;
+    };
+
+    struct IndexHeader
+    {
+        char magic[8];
+        uint32_t version = indexVersion;
+        uint32_t padding = 0;
+        uint64_t dataSize = 0;
+        uint64_t numEntries = 0;
+    };
+
+    struct IndexRecord
+    {
+        TileKey key;
+        uint64_t offset = 0;
+        uint64_t size = 0;
+    };
+
+    // read only std::streambuf over a block of memory so tiles can be deserialized directly from the mapped data file.
+    struct MemoryStreamBuffer : public std::streambuf
+    {
+        MemoryStreamBuffer(const uint8_t* ptr, size_t size)
+        {
+            auto begin = reinterpret_cast<char*>(const_cast<uint8_t*>(ptr));
+            setg(begin, begin, begin + size);
+        }
+    };
+
+    std::filesystem::path toFilesystemPath(const vsg::Path& path)
+    {
+        return std::filesystem::path(path.native());
+    }
+} // namespace
+
+/// read only memory mapping of a whole file, kept alive by ref_ptr<> so readers can carry on using a mapping while the TilePack remaps a grown data file.
+class MappedFile : public vsg::Inherit<vsg::Object, MappedFile>
+{
+public:
+    explicit MappedFile(const vsg::Path& filename)
+    {
+#if defined(_WIN32)
+        _file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (_file == INVALID_HANDLE_VALUE) return;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(_file, &fileSize) || fileSize.QuadPart == 0) return;
+
+        _mappingHandle = CreateFileMappingW(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!_mappingHandle) return;
+
+        auto ptr = MapViewOfFile(_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+        if (!ptr) return;
+
+        _data = static_cast<const uint8_t*>(ptr);
+        _size = static_cast<uint64_t>(fileSize.QuadPart);
+#else
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return;
+
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0)
+        {
+            auto ptr = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_SHARED, fd, 0);
+            if (ptr != MAP_FAILED)
+            {
+                _data = static_cast<const uint8_t*>(ptr);
+                _size = static_cast<uint64_t>(fileStat.st_size);
+            }
+        }
+
+        // the mapping remains valid after the file descriptor is closed
+        close(fd);
+#endif
+    }
+
+    const uint8_t* data() const { return _data; }
+    uint64_t size() const { return _size; }
+
+protected:
+    virtual ~MappedFile()
+    {
+#if defined(_WIN32)
+        if (_data) UnmapViewOfFile(_data);
+        if (_mappingHandle) CloseHandle(_mappingHandle);
+        if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+#else
+        if (_data) munmap(const_cast<uint8_t*>(_data), static_cast<size_t>(_size));
+#endif
+    }
+
+    const uint8_t* _data = nullptr;
+    uint64_t _size = 0;
+#if defined(_WIN32)
+    HANDLE _file = INVALID_HANDLE_VALUE;
+    HANDLE _mappingHandle = nullptr;
+#endif
+};
+
+TilePack::TilePack(const vsg::Path& in_filename, uint64_t in_maxSize) :
+    filename(in_filename),
+    maxSize(in_maxSize)
+{
+    auto directory = vsg::filePath(filename);
+    if (directory && !vsg::fileExists(directory)) vsg::makeDirectory(directory);
+
+    _dataFile = vsg::fopen(filename, "ab");
+    if (!_dataFile)
+    {
+        vsg::warn("TilePack : unable to open ", filename);
+        return;
+    }
+
+    std::error_code ec;
+    _fileSize = std::filesystem::file_size(toFilesystemPath(filename), ec);
+    if (ec) _fileSize = 0;
+
+    if (!_readIndex()) _rebuildIndex();
+
+    vsg::info("TilePack : opened ", filename, " with ", _entries.size(), " tiles, ", _stats.liveBytes, " live bytes, file size ", _fileSize);
+}
+
+TilePack::~TilePack()
+{
+    flush();
+
+    if (_dataFile) fclose(_dataFile);
+}
+
+bool TilePack::contains(const TileKey& key) const
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    return _entries.count(key) != 0;
+}
+
+vsg::ref_ptr<vsg::Data> TilePack::read(const TileKey& key, vsg::ref_ptr<const vsg::Options> options)
+{
+    vsg::ref_ptr<MappedFile> mapping;
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+
+        auto itr = _entries.find(key);
+        if (itr == _entries.end())
+        {
+            ++_stats.misses;
+            return {};
+        }
+
+        auto& entry = itr->second;
+        offset = entry.offset + sizeof(RecordHeader);
+        size = entry.size;
+
+        mapping = _map(offset + size);
+        if (!mapping)
+        {
+            ++_stats.misses;
+            return {};
+        }
+
+        // mark as most recently used, the access order is only kept in memory so a hit doesn't require the index to be rewritten
+        _lru.splice(_lru.end(), _lru, entry.lru);
+
+        ++_stats.hits;
+        ++_activeReads;
+    }
+
+    // deserialize outside the lock, the mapping is kept alive by the local ref_ptr<> even if the TilePack remaps in the meantime,
+    // while compaction is deferred until no reads are active so that the data file isn't replaced while still mapped.
+    auto streamOptions = options ? vsg::Options::create(*options) : vsg::Options::create();
+    streamOptions->extensionHint = ".vsgb";
+
+    MemoryStreamBuffer buffer(mapping->data() + offset, static_cast<size_t>(size));
+    std::istream fin(&buffer);
+
+    vsg::VSG vsgReaderWriter;
+    auto data = vsgReaderWriter.read(fin, streamOptions).cast<vsg::Data>();
+
+    mapping = {};
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        --_activeReads;
+    }
+
+    return data;
+}
+
+bool TilePack::write(const TileKey& key, vsg::ref_ptr<vsg::Data> data, vsg::ref_ptr<const vsg::Options> options)
+{
+    if (!data) return false;
+
+    // serialize outside the lock
+    auto streamOptions = options ? vsg::Options::create(*options) : vsg::Options::create();
+    streamOptions->extensionHint = ".vsgb";
+
+    std::ostringstream sstr;
+    vsg::VSG vsgReaderWriter;
+    if (!vsgReaderWriter.write(data, sstr, streamOptions)) return false;
+
+    auto payload = sstr.str();
+
+    RecordHeader header;
+    header.x = key.x;
+    header.y = key.y;
+    header.level = key.level;
+    header.layer = key.layer;
+    header.size = payload.size();
+
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    if (!_dataFile) return false;
+
+    if (fwrite(&header, sizeof(RecordHeader), 1, _dataFile) != 1 ||
+        fwrite(payload.data(), 1, payload.size(), _dataFile) != payload.size())
+    {
+        vsg::warn("TilePack : failed to append to ", filename);
+        return false;
+    }
+
+    _insert(key, _fileSize, payload.size());
+    _fileSize += sizeof(RecordHeader) + payload.size();
+    ++_stats.writes;
+
+    _evict();
+
+    // once most of the data file is taken by evicted records rewrite it.
+    uint64_t garbageBytes = _fileSize - _stats.liveBytes;
+    if (garbageBytes > _stats.liveBytes && garbageBytes > maxSize / 2) _compact();
+
+    return true;
+}
+
+bool TilePack::flush()
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    if (!_dataFile) return false;
+
+    fflush(_dataFile);
+
+    if (!_indexDirty) return true;
+
+    vsg::Path indexFilename = filename.string() + ".index";
+    vsg::Path tmpFilename = filename.string() + ".index.tmp";
+
+    auto file = vsg::fopen(tmpFilename, "wb");
+    if (!file) return false;
+
+    IndexHeader header;
+    std::memcpy(header.magic, indexMagic, sizeof(indexMagic));
+    header.dataSize = _fileSize;
+    header.numEntries = _entries.size();
+
+    bool result = fwrite(&header, sizeof(IndexHeader), 1, file) == 1;
+
+    // write in least to most recently used order so the LRU order as of the last change to the entries survives between runs
+    for (auto& key : _lru)
+    {
+        auto& entry = _entries[key];
+        IndexRecord record{key, entry.offset, entry.size};
+        result = result && fwrite(&record, sizeof(IndexRecord), 1, file) == 1;
+    }
+
+    fclose(file);
+
+    // replace the index in one step so an interrupted flush leaves the previous index intact
+    std::error_code ec;
+    if (result) std::filesystem::rename(toFilesystemPath(tmpFilename), toFilesystemPath(indexFilename), ec);
+
+    if (!result || ec)
+    {
+        vsg::warn("TilePack : failed to write index ", indexFilename);
+        std::filesystem::remove(toFilesystemPath(tmpFilename), ec);
+        return false;
+    }
+
+    _indexDirty = false;
+    return true;
+}
+
+bool TilePack::compact()
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    return _compact();
+}
+
+TilePack::Stats TilePack::getStats() const
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    auto stats = _stats;
+    stats.numTiles = _entries.size();
+    stats.fileSize = _fileSize;
+    return stats;
+}
+
+bool TilePack::_readIndex()
+{
+    vsg::Path indexFilename = filename.string() + ".index";
+
+    auto file = vsg::fopen(indexFilename, "rb");
+    if (!file) return false;
+
+    IndexHeader header;
+    bool result = fread(&header, sizeof(IndexHeader), 1, file) == 1 &&
+                  std::memcmp(header.magic, indexMagic, sizeof(indexMagic)) == 0 &&
+                  header.version == indexVersion &&
+                  header.dataSize == _fileSize; // appends made after the last flush() require a rescan
+
+    for (uint64_t i = 0; result && i < header.numEntries; ++i)
+    {
+        IndexRecord record;
+        result = fread(&record, sizeof(IndexRecord), 1, file) == 1 &&
+                 (record.offset + sizeof(RecordHeader) + record.size) <= _fileSize;
+
+        if (result) _insert(record.key, record.offset, record.size);
+    }
+
+    fclose(file);
+
+    if (!result)
+    {
+        vsg::info("TilePack : index ", indexFilename, " out of date, rebuilding from data file.");
+
+        _entries.clear();
+        _lru.clear();
+        _stats.liveBytes = 0;
+        return false;
+    }
+
+    // the maxSize may be smaller than the one the pack was written with
+    _evict();
+
+    _indexDirty = _stats.evictions > 0;
+    return true;
+}
+
+bool TilePack::_rebuildIndex()
+{
+    _entries.clear();
+    _lru.clear();
+    _stats.liveBytes = 0;
+    _indexDirty = true;
+
+    if (_fileSize == 0) return true;
+
+    auto mapping = _map(_fileSize);
+    if (!mapping) return false;
+
+    uint64_t offset = 0;
+    while (offset + sizeof(RecordHeader) <= _fileSize)
+    {
+        RecordHeader header;
+        std::memcpy(&header, mapping->data() + offset, sizeof(RecordHeader));
+        if (header.magic != recordMagic || (offset + sizeof(RecordHeader) + header.size) > _fileSize) break;
+
+        // later records for the same key replace earlier ones
+        _insert(TileKey{header.x, header.y, header.level, header.layer}, offset, header.size);
+
+        offset += sizeof(RecordHeader) + header.size;
+    }
+
+    _evict();
+
+    if (offset != _fileSize)
+    {
+        // the tail of the data file is a partially written record, rewrite the file without it
+        vsg::warn("TilePack : discarding ", _fileSize - offset, " bytes of incomplete records from ", filename);
+        return _compact();
+    }
+
+    return true;
+}
+
+void TilePack::_insert(const TileKey& key, uint64_t offset, uint64_t size)
+{
+    auto itr = _entries.find(key);
+    if (itr != _entries.end())
+    {
+        _stats.liveBytes -= sizeof(RecordHeader) + itr->second.size;
+        _lru.erase(itr->second.lru);
+        _entries.erase(itr);
+    }
+
+    auto& entry = _entries[key];
+    entry.offset = offset;
+    entry.size = size;
+    entry.lru = _lru.insert(_lru.end(), key);
+
+    _stats.liveBytes += sizeof(RecordHeader) + size;
+    _indexDirty = true;
+}
+
+void TilePack::_evict()
+{
+    // always keep the most recently used tile even if on its own it exceeds maxSize
+    while (_stats.liveBytes > maxSize && _lru.size() > 1)
+    {
+        auto itr = _entries.find(_lru.front());
+        _stats.liveBytes -= sizeof(RecordHeader) + itr->second.size;
+        _entries.erase(itr);
+        _lru.pop_front();
+
+        ++_stats.evictions;
+        _indexDirty = true;
+    }
+}
+
+bool TilePack::_compact()
+{
+    // readers may still be deserializing from a mapping of the data file, leave the garbage in place until a later write
+    if (_activeReads > 0)
+    {
+        vsg::debug("TilePack : deferring compaction of ", filename, " as ", _activeReads, " reads are active.");
+        return false;
+    }
+
+    auto mapping = _map(_fileSize);
+    if (!mapping && _fileSize > 0) return false;
+
+    vsg::Path tmpFilename = filename.string() + ".tmp";
+    auto file = vsg::fopen(tmpFilename, "wb");
+    if (!file) return false;
+
+    // copy the live records in LRU order, recording their new offsets to apply once the new file is in place
+    std::vector<uint64_t> offsets;
+    offsets.reserve(_lru.size());
+
+    bool result = true;
+    uint64_t newFileSize = 0;
+    for (auto& key : _lru)
+    {
+        auto& entry = _entries[key];
+        uint64_t recordSize = sizeof(RecordHeader) + entry.size;
+        result = result && fwrite(mapping->data() + entry.offset, 1, recordSize, file) == recordSize;
+
+        offsets.push_back(newFileSize);
+        newFileSize += recordSize;
+    }
+
+    fclose(file);
+
+    std::error_code ec;
+    if (result)
+    {
+        // close the append handle and unmap the data file before replacing it, with no reads active ours is the only mapping
+        fclose(_dataFile);
+        _mapping = {};
+        mapping = {};
+
+        std::filesystem::rename(toFilesystemPath(tmpFilename), toFilesystemPath(filename), ec);
+
+        _dataFile = vsg::fopen(filename, "ab");
+    }
+
+    if (!result || ec || !_dataFile)
+    {
+        vsg::warn("TilePack : failed to compact ", filename);
+        std::filesystem::remove(toFilesystemPath(tmpFilename), ec);
+        if (_dataFile && _fileSize > 0) _map(_fileSize);
+        return false;
+    }
+
+    auto offset_itr = offsets.begin();
+    for (auto& key : _lru)
+    {
+        _entries[key].offset = *(offset_itr++);
+    }
+
+    vsg::debug("TilePack : compacted ", filename, " from ", _fileSize, " to ", newFileSize, " bytes.");
+
+    _fileSize = newFileSize;
+    _indexDirty = true;
+
+    // remap the replacement data file
+    if (_fileSize > 0) _map(_fileSize);
+
+    return true;
+}
+
+vsg::ref_ptr<MappedFile> TilePack::_map(uint64_t requiredSize)
+{
+    if (!_mapping || _mapping->size() < requiredSize)
+    {
+        // make sure appended records are visible to the new mapping
+        if (_dataFile) fflush(_dataFile);
+
+        _mapping = MappedFile::create(filename);
+    }
+
+    if (_mapping->size() < requiredSize) return {};
+
+    return _mapping;
+}
+
+TilePackReaderWriter::TilePackReaderWriter(vsg::ref_ptr<TilePack> in_tilePack, const std::vector<vsg::Path>& in_layers) :
+    tilePack(in_tilePack),
+    layers(in_layers)
+{
+}
+
+bool TilePackReaderWriter::match(const vsg::Path& filename, TileKey& key) const
+{
+    auto str = filename.string();
+    for (uint32_t layer = 0; layer < static_cast<uint32_t>(layers.size()); ++layer)
+    {
+        if (layers[layer] && matchTileTemplate(layers[layer].string(), str, key.x, key.y, key.level))
+        {
+            key.layer = layer;
+            return true;
+        }
+    }
+    return false;
+}
+
+vsg::ref_ptr<vsg::Object> TilePackReaderWriter::read(const vsg::Path& filename, vsg::ref_ptr<const vsg::Options> options) const
+{
+    TileKey key;
+    if (!tilePack || !match(filename, key)) return {};
+
+    if (auto data = tilePack->read(key, options)) return data;
+
+    if (!options) return {};
+
+    // fall back to the remaining ReaderWriters, i.e. the URL template, leaving this ReaderWriter out to avoid recursion.
+    auto fallbackOptions = vsg::Options::create(*options);
+    auto& readerWriters = fallbackOptions->readerWriters;
+    readerWriters.erase(std::remove_if(readerWriters.begin(), readerWriters.end(), [this](const vsg::ref_ptr<vsg::ReaderWriter>& rw) { return rw.get() == this; }), readerWriters.end());
+
+    auto data = vsg::read_cast<vsg::Data>(filename, fallbackOptions);
+    if (data && !readOnly) tilePack->write(key, data, options);
+
+    return data;
+}
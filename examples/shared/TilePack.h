@@ -0,0 +1,120 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+struct TileKey
+{
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t level = 0;
+    uint32_t layer = 0;
+
+    bool operator==(const TileKey& rhs) const { return x == rhs.x && y == rhs.y && level == rhs.level && layer == rhs.layer; }
+};
+
+struct TileKeyHash
+{
+    size_t operator()(const TileKey& key) const
+    {
+        // FNV-1a over the four components
+        uint64_t hash = 14695981039346656037ull;
+        for (uint32_t value : {key.x, key.y, key.level, key.layer})
+        {
+            hash = (hash ^ value) * 1099511628211ull;
+        }
+        return static_cast<size_t>(hash);
+    }
+};
+
+class MappedFile;
+
+/// TilePack stores tiles in a single append-only data file with a hashed index keyed by (x, y, level, layer).
+/// The data file is memory mapped for reads, and once the live tiles exceed maxSize the least recently used are evicted.
+/// Evicted records are left in the data file until compact() rewrites it, which write() does automatically once they dominate the file
+/// and no reads are active. The access order is kept in memory, the index file only records it when the entries themselves change.
+class TilePack : public vsg::Inherit<vsg::Object, TilePack>
+{
+public:
+    TilePack(const vsg::Path& in_filename, uint64_t in_maxSize);
+
+    const vsg::Path filename;
+    const uint64_t maxSize;
+
+    /// return true if the data file could be opened for appending
+    bool valid() const { return _dataFile != nullptr; }
+
+    bool contains(const TileKey& key) const;
+
+    vsg::ref_ptr<vsg::Data> read(const TileKey& key, vsg::ref_ptr<const vsg::Options> options = {});
+    bool write(const TileKey& key, vsg::ref_ptr<vsg::Data> data, vsg::ref_ptr<const vsg::Options> options = {});
+
+    /// write the index file so the next run doesn't have to rescan the data file.
+    bool flush();
+
+    /// rewrite the data file without the records of evicted tiles, returns false if it failed or was deferred as reads are active.
+    bool compact();
+
+    struct Stats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t writes = 0;
+        uint64_t evictions = 0;
+        uint64_t numTiles = 0;
+        uint64_t liveBytes = 0;
+        uint64_t fileSize = 0;
+    };
+
+    Stats getStats() const;
+
+protected:
+    virtual ~TilePack();
+
+    struct Entry
+    {
+        uint64_t offset = 0; // offset of the record header in the data file
+        uint64_t size = 0;   // size of the serialized tile that follows the record header
+        std::list<TileKey>::iterator lru;
+    };
+
+    bool _readIndex();
+    bool _rebuildIndex();
+    void _insert(const TileKey& key, uint64_t offset, uint64_t size);
+    void _evict();
+    bool _compact();
+    vsg::ref_ptr<MappedFile> _map(uint64_t requiredSize);
+
+    mutable std::mutex _mutex;
+    std::unordered_map<TileKey, Entry, TileKeyHash> _entries;
+    std::list<TileKey> _lru; // front is least recently used
+    FILE* _dataFile = nullptr;
+    uint64_t _fileSize = 0;
+    vsg::ref_ptr<MappedFile> _mapping;
+    bool _indexDirty = false; // set when entries are added, evicted or moved, not on reads
+    uint32_t _activeReads = 0; // reads deserializing from a mapping outside the lock
+    Stats _stats;
+};
+
+/// TilePackReaderWriter serves tiles whose file names match one of the layer URL templates from a TilePack,
+/// falling back to the remaining ReaderWriters for tiles not yet in the pack and adding what they return to it.
+class TilePackReaderWriter : public vsg::Inherit<vsg::ReaderWriter, TilePackReaderWriter>
+{
+public:
+    explicit TilePackReaderWriter(vsg::ref_ptr<TilePack> in_tilePack, const std::vector<vsg::Path>& in_layers = {});
+
+    vsg::ref_ptr<TilePack> tilePack;
+
+    /// URL templates containing {x}, {y} and {z}, the position in the vector is used as the TileKey::layer.
+    std::vector<vsg::Path> layers;
+
+    /// don't add tiles read via the fallback ReaderWriters to the pack.
+    bool readOnly = false;
+
+    bool match(const vsg::Path& filename, TileKey& key) const;
+
+    vsg::ref_ptr<vsg::Object> read(const vsg::Path& filename, vsg::ref_ptr<const vsg::Options> options = {}) const override;
+};
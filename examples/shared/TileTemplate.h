@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cctype>
+#include <cstdint>
+#include <string>
+
+/// parse the {x}, {y} and {z} values out of str when it matches the tile layer template pattern, i.e. raster://image/{z}/{x}/{y}
+inline bool matchTileTemplate(const std::string& pattern, const std::string& str, uint32_t& x, uint32_t& y, uint32_t& z)
+{
+    size_t p = 0;
+    size_t s = 0;
+    while (p < pattern.size())
+    {
+        if (pattern[p] == '{')
+        {
+            auto end = pattern.find('}', p);
+            if (end == std::string::npos) return false;
+
+            auto name = pattern.substr(p + 1, end - p - 1);
+            uint32_t* value = (name == "x") ? &x : ((name == "y") ? &y : ((name == "z") ? &z : nullptr));
+            if (!value || s >= str.size() || !std::isdigit(static_cast<unsigned char>(str[s]))) return false;
+
+            *value = 0;
+            while (s < str.size() && std::isdigit(static_cast<unsigned char>(str[s])))
+            {
+                *value = (*value) * 10 + static_cast<uint32_t>(str[s++] - '0');
+            }
+
+            p = end + 1;
+        }
+        else if (s < str.size() && pattern[p] == str[s])
+        {
+            ++p;
+            ++s;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return s == str.size();
+}
@@ -0,0 +1,339 @@
+#include "TriangleBVH.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+const char* const TriangleBVH::key = "TriangleBVH";
+
+namespace
+{
+    /// the BVHs of a draw node, one per range and primitive size queried, so draw nodes with several draws or queried by both the line and polytope intersectors keep all of theirs
+    class TriangleBVHCache : public vsg::Inherit<vsg::Object, TriangleBVHCache>
+    {
+    public:
+        using Key = std::tuple<uint32_t, uint32_t, uint32_t>; // firstIndex, indexCount, primitiveSize
+
+        std::mutex mutex; // guards bvhs, held to look up or publish a BVH but never while one is built
+        std::map<Key, vsg::ref_ptr<TriangleBVH>> bvhs;
+    };
+
+    // a node's auxiliary objects aren't thread safe, so finding and attaching the caches is serialized, which is just a map lookup
+    std::mutex s_attachMutex;
+
+    vsg::ref_ptr<TriangleBVHCache> getCache(const vsg::Object& drawNode, bool create)
+    {
+        std::scoped_lock<std::mutex> lock(s_attachMutex);
+
+        // the BVHs are a cache rather than part of the node's state, so they're attached to the const node being traversed
+        auto& node = const_cast<vsg::Object&>(drawNode);
+
+        auto cache = node.getRefObject<TriangleBVHCache>(TriangleBVH::key);
+        if (!cache && create)
+        {
+            cache = TriangleBVHCache::create();
+            node.setObject(TriangleBVH::key, cache);
+        }
+        return cache;
+    }
+
+    struct Bounds
+    {
+        vsg::vec3 min{std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+        vsg::vec3 max{std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()};
+
+        void add(const vsg::vec3& v)
+        {
+            for (int a = 0; a < 3; ++a)
+            {
+                min[a] = std::min(min[a], v[a]);
+                max[a] = std::max(max[a], v[a]);
+            }
+        }
+
+        void add(const Bounds& b)
+        {
+            if (b.min.x > b.max.x) return;
+            add(b.min);
+            add(b.max);
+        }
+
+        float area() const
+        {
+            if (min.x > max.x) return 0.0f;
+            auto e = max - min;
+            return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+        }
+    };
+
+    class Builder
+    {
+    public:
+        Builder(TriangleBVH& in_bvh, const vsg::vec3Array& in_vertices) :
+            bvh(in_bvh),
+            vertices(in_vertices)
+        {
+            size_t numPrimitives = bvh.numPrimitives();
+            primitiveBounds.resize(numPrimitives);
+            centroids.resize(numPrimitives);
+            order.resize(numPrimitives);
+
+            for (size_t t = 0; t < numPrimitives; ++t)
+            {
+                const uint32_t* primitive = bvh.indices.data() + t * bvh.primitiveSize;
+                Bounds& b = primitiveBounds[t];
+                for (uint32_t i = 0; i < bvh.primitiveSize; ++i) b.add(vertices[primitive[i]]);
+                centroids[t] = (b.min + b.max) * 0.5f;
+                order[t] = static_cast<uint32_t>(t);
+            }
+        }
+
+        void build()
+        {
+            bvh.nodes.clear();
+            bvh.nodes.reserve(2 * order.size() / bvh.maxLeafSize + 1);
+            subdivide(0, static_cast<uint32_t>(order.size()), 0);
+
+            // reorder the primitives to match the leaves
+            const size_t primitiveSize = bvh.primitiveSize;
+            std::vector<uint32_t> sorted(bvh.indices.size());
+            for (size_t i = 0; i < order.size(); ++i)
+            {
+                std::copy_n(bvh.indices.data() + order[i] * primitiveSize, primitiveSize, sorted.data() + i * primitiveSize);
+            }
+            bvh.indices.swap(sorted);
+        }
+
+    protected:
+        static constexpr uint32_t numBins = 12;
+        static constexpr uint32_t maxDepth = 60; // traversal stack in TriangleBVH::intersect() is 64 deep
+
+        TriangleBVH& bvh;
+        const vsg::vec3Array& vertices;
+        std::vector<Bounds> primitiveBounds;
+        std::vector<vsg::vec3> centroids;
+        std::vector<uint32_t> order;
+
+        uint32_t makeLeaf(uint32_t nodeIndex, uint32_t begin, uint32_t end)
+        {
+            auto& node = bvh.nodes[nodeIndex];
+            node.first = begin;
+            node.count = end - begin;
+            return nodeIndex;
+        }
+
+        uint32_t subdivide(uint32_t begin, uint32_t end, uint32_t depth)
+        {
+            uint32_t nodeIndex = static_cast<uint32_t>(bvh.nodes.size());
+            bvh.nodes.emplace_back();
+
+            Bounds bounds, centroidBounds;
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                bounds.add(primitiveBounds[order[i]]);
+                centroidBounds.add(centroids[order[i]]);
+            }
+            bvh.nodes[nodeIndex].min = bounds.min;
+            bvh.nodes[nodeIndex].max = bounds.max;
+
+            uint32_t count = end - begin;
+            if (count <= bvh.maxLeafSize || depth >= maxDepth) return makeLeaf(nodeIndex, begin, end);
+
+            // split along the axis with the largest spread of centroids
+            auto extent = centroidBounds.max - centroidBounds.min;
+            int axis = 0;
+            if (extent.y > extent[axis]) axis = 1;
+            if (extent.z > extent[axis]) axis = 2;
+            if (extent[axis] <= 0.0f) return makeLeaf(nodeIndex, begin, end);
+
+            // binned surface area heuristic
+            float scale = static_cast<float>(numBins) / extent[axis];
+            auto binOf = [&](uint32_t t) { return std::min(numBins - 1, static_cast<uint32_t>((centroids[t][axis] - centroidBounds.min[axis]) * scale)); };
+
+            Bounds binBounds[numBins];
+            uint32_t binCounts[numBins] = {};
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                uint32_t b = binOf(order[i]);
+                binBounds[b].add(primitiveBounds[order[i]]);
+                ++binCounts[b];
+            }
+
+            float rightAreas[numBins];
+            uint32_t rightCounts[numBins];
+            Bounds right;
+            uint32_t rightCount = 0;
+            for (uint32_t b = numBins - 1; b > 0; --b)
+            {
+                right.add(binBounds[b]);
+                rightCount += binCounts[b];
+                rightAreas[b] = right.area();
+                rightCounts[b] = rightCount;
+            }
+
+            float bestCost = std::numeric_limits<float>::max();
+            uint32_t bestSplit = 0;
+            Bounds left;
+            uint32_t leftCount = 0;
+            for (uint32_t b = 1; b < numBins; ++b)
+            {
+                left.add(binBounds[b - 1]);
+                leftCount += binCounts[b - 1];
+                if (leftCount == 0 || rightCounts[b] == 0) continue;
+
+                float cost = left.area() * static_cast<float>(leftCount) + rightAreas[b] * static_cast<float>(rightCounts[b]);
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestSplit = b;
+                }
+            }
+
+            uint32_t mid = begin;
+            if (bestSplit > 0)
+            {
+                mid = static_cast<uint32_t>(std::partition(order.begin() + begin, order.begin() + end, [&](uint32_t t) { return binOf(t) < bestSplit; }) - order.begin());
+            }
+
+            // fall back to a median split when the bins can't separate the primitives
+            if (mid == begin || mid == end)
+            {
+                mid = begin + count / 2;
+                std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end, [&](uint32_t lhs, uint32_t rhs) { return centroids[lhs][axis] < centroids[rhs][axis]; });
+            }
+
+            subdivide(begin, mid, depth + 1);
+            uint32_t secondChild = subdivide(mid, end, depth + 1);
+            bvh.nodes[nodeIndex].first = secondChild;
+            bvh.nodes[nodeIndex].count = 0;
+
+            return nodeIndex;
+        }
+    };
+
+    template<class IndexArray>
+    void copyIndices(const IndexArray& source, uint32_t firstIndex, uint32_t indexCount, uint32_t primitiveSize, std::vector<uint32_t>& destination)
+    {
+        uint32_t end = std::min(firstIndex + indexCount, static_cast<uint32_t>(source.size()));
+        uint32_t numIndices = (end > firstIndex) ? ((end - firstIndex) / primitiveSize) * primitiveSize : 0;
+        destination.resize(numIndices);
+        for (uint32_t i = 0; i < numIndices; ++i) destination[i] = source[firstIndex + i];
+    }
+} // namespace
+
+bool TriangleBVH::valid(const vsg::vec3Array* in_vertices, const vsg::Data* in_indexData, uint32_t in_firstIndex, uint32_t in_indexCount, uint32_t in_primitiveSize) const
+{
+    return vertices.get() == in_vertices && indexData.get() == in_indexData && firstIndex == in_firstIndex && indexCount == in_indexCount && primitiveSize == in_primitiveSize &&
+           !vertices->differentModifiedCount(vertexModifiedCount) && (!indexData || !indexData->differentModifiedCount(indexModifiedCount));
+}
+
+bool TriangleBVH::build(vsg::ref_ptr<const vsg::vec3Array> in_vertices, vsg::ref_ptr<const vsg::Data> in_indexData, uint32_t in_firstIndex, uint32_t in_indexCount, uint32_t in_primitiveSize)
+{
+    auto startTime = vsg::clock::now();
+
+    vertices = in_vertices;
+    indexData = in_indexData;
+    firstIndex = in_firstIndex;
+    indexCount = in_indexCount;
+    primitiveSize = in_primitiveSize;
+    vertices->getModifiedCount(vertexModifiedCount);
+    if (indexData) indexData->getModifiedCount(indexModifiedCount);
+
+    if (primitiveSize != 1 && primitiveSize != 3) return false;
+
+    if (!indexData)
+    {
+        indices.resize((indexCount / primitiveSize) * primitiveSize);
+        for (uint32_t i = 0; i < indices.size(); ++i) indices[i] = firstIndex + i;
+    }
+    else if (auto us = indexData.cast<vsg::ushortArray>())
+        copyIndices(*us, firstIndex, indexCount, primitiveSize, indices);
+    else if (auto ui = indexData.cast<vsg::uintArray>())
+        copyIndices(*ui, firstIndex, indexCount, primitiveSize, indices);
+    else if (auto ub = indexData.cast<vsg::ubyteArray>())
+        copyIndices(*ub, firstIndex, indexCount, primitiveSize, indices);
+    else
+        return false;
+
+    // drop primitives that reference vertices outside the array so traversal doesn't need to check
+    uint32_t numVertices = static_cast<uint32_t>(vertices->size());
+    size_t numValid = 0;
+    for (size_t t = 0; t < indices.size(); t += primitiveSize)
+    {
+        bool inRange = true;
+        for (uint32_t i = 0; i < primitiveSize; ++i) inRange = inRange && indices[t + i] < numVertices;
+        if (inRange)
+        {
+            std::copy_n(indices.data() + t, primitiveSize, indices.data() + numValid);
+            numValid += primitiveSize;
+        }
+    }
+    indices.resize(numValid);
+
+    nodes.clear();
+    if (!indices.empty())
+    {
+        Builder builder(*this, *vertices);
+        builder.build();
+    }
+
+    buildTime = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+
+    return !nodes.empty();
+}
+
+vsg::ref_ptr<TriangleBVH> TriangleBVH::find(const vsg::Object& drawNode, uint32_t in_firstIndex, uint32_t in_indexCount, uint32_t in_primitiveSize)
+{
+    auto cache = getCache(drawNode, false);
+    if (!cache) return {};
+
+    std::scoped_lock<std::mutex> lock(cache->mutex);
+    auto itr = cache->bvhs.find(TriangleBVHCache::Key(in_firstIndex, in_indexCount, in_primitiveSize));
+    return itr != cache->bvhs.end() ? itr->second : vsg::ref_ptr<TriangleBVH>();
+}
+
+vsg::ref_ptr<TriangleBVH> TriangleBVH::get(const vsg::Object& drawNode, vsg::ref_ptr<const vsg::vec3Array> in_vertices, vsg::ref_ptr<const vsg::Data> in_indexData, uint32_t in_firstIndex, uint32_t in_indexCount, uint32_t in_primitiveSize)
+{
+    if (!in_vertices) return {};
+
+    auto cache = getCache(drawNode, true);
+    TriangleBVHCache::Key cacheKey(in_firstIndex, in_indexCount, in_primitiveSize);
+
+    vsg::ref_ptr<TriangleBVH> bvh;
+    {
+        std::scoped_lock<std::mutex> lock(cache->mutex);
+        if (auto itr = cache->bvhs.find(cacheKey); itr != cache->bvhs.end()) bvh = itr->second;
+    }
+
+    // a published BVH isn't modified, so it can be validated and used without the lock
+    if (bvh && bvh->valid(in_vertices.get(), in_indexData.get(), in_firstIndex, in_indexCount, in_primitiveSize)) return bvh;
+
+    // rebuilt only when the node's vertex or index arrays have been replaced or dirtied, outside the lock so lookups of the node's
+    // other BVHs aren't held up by the build
+    auto rebuilt = TriangleBVH::create();
+    bool built = rebuilt->build(in_vertices, in_indexData, in_firstIndex, in_indexCount, in_primitiveSize);
+
+    std::scoped_lock<std::mutex> lock(cache->mutex);
+
+    // check again, as a concurrent traversal may have published a valid BVH while this one was built, in which case use theirs
+    auto& cached = cache->bvhs[cacheKey];
+    if (cached && cached->valid(in_vertices.get(), in_indexData.get(), in_firstIndex, in_indexCount, in_primitiveSize)) return cached;
+
+    if (!built)
+    {
+        cache->bvhs.erase(cacheKey);
+        return {};
+    }
+
+    cached = rebuilt;
+    return rebuilt;
+}
+
+vsg::ref_ptr<TriangleBVH> TriangleBVH::get(const vsg::VertexIndexDraw& vid, vsg::ref_ptr<const vsg::vec3Array> in_vertices, uint32_t in_firstIndex, uint32_t in_indexCount)
+{
+    if (!vid.indices || !vid.indices->data) return {};
+
+    return get(vid, in_vertices, vid.indices->data, in_firstIndex, in_indexCount, 3);
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <vsg/all.h>
+
+/// TriangleBVH is a bounding volume hierarchy over the triangles of a triangle list, or the points of a point list, built once and then used to
+/// restrict intersection tests to the primitives whose bounds overlap the query rather than testing every primitive of the mesh.
+class TriangleBVH : public vsg::Inherit<vsg::Object, TriangleBVH>
+{
+public:
+    struct Node
+    {
+        vsg::vec3 min;
+        uint32_t first = 0; // first primitive for a leaf, index of the second child for an internal node, the first child always follows its parent
+        vsg::vec3 max;
+        uint32_t count = 0; // number of primitives in a leaf, 0 for an internal node
+
+        bool leaf() const { return count > 0; }
+    };
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> indices; // primitiveSize vertex indices per primitive, reordered so each leaf's primitives are contiguous
+
+    vsg::ref_ptr<const vsg::vec3Array> vertices;
+    vsg::ref_ptr<const vsg::Data> indexData; // null for non indexed draws, where firstIndex and indexCount are the vertex range
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    uint32_t primitiveSize = 3; // 3 for triangle lists, 1 for point lists
+    vsg::ModifiedCount vertexModifiedCount;
+    vsg::ModifiedCount indexModifiedCount;
+
+    uint32_t maxLeafSize = 4;
+    double buildTime = 0.0; // milliseconds
+
+    size_t numPrimitives() const { return indices.size() / primitiveSize; }
+
+    /// return true if the BVH was built from the same arrays and range, and neither array has been dirtied since.
+    bool valid(const vsg::vec3Array* in_vertices, const vsg::Data* in_indexData, uint32_t in_firstIndex, uint32_t in_indexCount, uint32_t in_primitiveSize) const;
+
+    /// build from a triangle list or point list, indexData must be a ushortArray, uintArray, ubyteArray or null for non indexed draws.
+    bool build(vsg::ref_ptr<const vsg::vec3Array> in_vertices, vsg::ref_ptr<const vsg::Data> in_indexData, uint32_t in_firstIndex, uint32_t in_indexCount, uint32_t in_primitiveSize = 3);
+
+    /// return the BVH cached on the draw node for the range and primitive size, building it on first use or when the arrays have been replaced or dirtied.
+    /// Safe to call from several threads, builds aren't serialized and the first valid BVH published for a range is the one kept.
+    static vsg::ref_ptr<TriangleBVH> get(const vsg::Object& drawNode, vsg::ref_ptr<const vsg::vec3Array> in_vertices, vsg::ref_ptr<const vsg::Data> in_indexData, uint32_t in_firstIndex, uint32_t in_indexCount, uint32_t in_primitiveSize = 3);
+
+    /// return the BVH already cached on the draw node for the range and primitive size, without checking it's still valid.
+    static vsg::ref_ptr<TriangleBVH> find(const vsg::Object& drawNode, uint32_t in_firstIndex, uint32_t in_indexCount, uint32_t in_primitiveSize = 3);
+
+    /// return the triangle list BVH cached on the VertexIndexDraw.
+    static vsg::ref_ptr<TriangleBVH> get(const vsg::VertexIndexDraw& vid, vsg::ref_ptr<const vsg::vec3Array> in_vertices, uint32_t in_firstIndex, uint32_t in_indexCount);
+
+    /// call hit(i0, i1, i2, t, u, v) for every triangle crossed by the line segment start to end, where t is the ratio along the segment and u, v the barycentric coordinates of the hit.
+    template<class Hit>
+    void intersect(const vsg::dvec3& start, const vsg::dvec3& end, Hit hit) const;
+
+    static const char* const key;
+};
+
+template<class Hit>
+void TriangleBVH::intersect(const vsg::dvec3& start, const vsg::dvec3& end, Hit hit) const
+{
+    if (nodes.empty() || primitiveSize != 3) return;
+
+    const vsg::dvec3 d = end - start;
+    const vsg::dvec3 invD(d.x != 0.0 ? 1.0 / d.x : std::numeric_limits<double>::max(),
+                          d.y != 0.0 ? 1.0 / d.y : std::numeric_limits<double>::max(),
+                          d.z != 0.0 ? 1.0 / d.z : std::numeric_limits<double>::max());
+
+    // slab test against the segment's [0, 1] range
+    auto overlaps = [&](const Node& node) -> bool {
+        double tmin = 0.0, tmax = 1.0;
+        for (int a = 0; a < 3; ++a)
+        {
+            double t0 = (static_cast<double>(node.min[a]) - start[a]) * invD[a];
+            double t1 = (static_cast<double>(node.max[a]) - start[a]) * invD[a];
+            if (t0 > t1) std::swap(t0, t1);
+            if (t0 > tmin) tmin = t0;
+            if (t1 < tmax) tmax = t1;
+            if (tmin > tmax) return false;
+        }
+        return true;
+    };
+
+    const auto& verts = *vertices;
+
+    uint32_t stack[64];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        const Node& node = nodes[stack[--stackSize]];
+        if (!overlaps(node)) continue;
+
+        if (!node.leaf())
+        {
+            stack[stackSize++] = node.first;
+            stack[stackSize++] = static_cast<uint32_t>(&node - nodes.data()) + 1;
+            continue;
+        }
+
+        const uint32_t* tri = indices.data() + node.first * 3;
+        for (uint32_t i = 0; i < node.count; ++i, tri += 3)
+        {
+            // Möller–Trumbore, double sided to match LineSegmentIntersector
+            vsg::dvec3 v0(verts[tri[0]]);
+            vsg::dvec3 e1 = vsg::dvec3(verts[tri[1]]) - v0;
+            vsg::dvec3 e2 = vsg::dvec3(verts[tri[2]]) - v0;
+
+            vsg::dvec3 p = vsg::cross(d, e2);
+            double det = vsg::dot(e1, p);
+            if (det == 0.0) continue;
+
+            double invDet = 1.0 / det;
+            vsg::dvec3 s = start - v0;
+            double u = vsg::dot(s, p) * invDet;
+            if (u < 0.0 || u > 1.0) continue;
+
+            vsg::dvec3 q = vsg::cross(s, e1);
+            double v = vsg::dot(d, q) * invDet;
+            if (v < 0.0 || u + v > 1.0) continue;
+
+            double t = vsg::dot(e2, q) * invDet;
+            if (t < 0.0 || t > 1.0) continue;
+
+            hit(tri[0], tri[1], tri[2], t, u, v);
+        }
+    }
+}
@@ -1,11 +1,22 @@
 #include <iostream>
 #include <vsg/all.h>
 
+#include "DirtyRegionUpload.h"
+
 class UpdateImage : public vsg::Visitor
 {
 public:
     double value = 0.0;
 
+    // region of the image to update, a width or height of 0 updates the whole image
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    // when assigned only the updated region is uploaded, otherwise the whole image is dirtied
+    vsg::ref_ptr<DirtyRegionUpload> dirtyRegionUpload;
+
     template<class A>
     void update(A& image)
     {
@@ -16,11 +27,19 @@ public:
         float c_mult = 1.0f / static_cast<float>(image.width() - 1);
         float c_offset = 0.5f + static_cast<float>(cos(value)) * 0.25f;
 
-        for (uint32_t r = 0; r < image.height(); ++r)
+        uint32_t c_begin = 0, c_end = image.width();
+        uint32_t r_begin = 0, r_end = image.height();
+        if (width > 0 && height > 0)
+        {
+            c_begin = std::min(x, image.width()), c_end = std::min(x + width, image.width());
+            r_begin = std::min(y, image.height()), r_end = std::min(y + height, image.height());
+        }
+
+        for (uint32_t r = r_begin; r < r_end; ++r)
         {
             float r_ratio = static_cast<float>(r) * r_mult;
-            value_type* ptr = &image.at(0, r);
-            for (uint32_t c = 0; c < image.width(); ++c)
+            value_type* ptr = &image.at(c_begin, r);
+            for (uint32_t c = c_begin; c < c_end; ++c)
             {
                 float c_ratio = static_cast<float>(c) * c_mult;
 
@@ -42,7 +61,11 @@ public:
                 ++ptr;
             }
         }
-        image.dirty();
+
+        if (dirtyRegionUpload)
+            dirtyRegionUpload->dirty(c_begin, r_begin, c_end - c_begin, r_end - r_begin);
+        else
+            image.dirty();
     }
 
     // use the vsg::Visitor to safely cast to types handled by the UpdateImage class
@@ -58,6 +81,51 @@ public:
     }
 };
 
+// find the ImageInfo the Builder created for the texture data so its regions can be uploaded directly
+class FindImageInfo : public vsg::Visitor
+{
+public:
+    explicit FindImageInfo(vsg::ref_ptr<vsg::Data> in_data) :
+        data(in_data) {}
+
+    vsg::ref_ptr<vsg::Data> data;
+    vsg::ref_ptr<vsg::ImageInfo> imageInfo;
+
+    void apply(vsg::Node& node) override
+    {
+        node.traverse(*this);
+    }
+
+    void apply(vsg::StateGroup& stateGroup) override
+    {
+        for (auto& stateCommand : stateGroup.stateCommands) stateCommand->accept(*this);
+        stateGroup.traverse(*this);
+    }
+
+    void apply(vsg::BindDescriptorSet& bds) override
+    {
+        if (bds.descriptorSet) bds.descriptorSet->accept(*this);
+    }
+
+    void apply(vsg::BindDescriptorSets& bds) override
+    {
+        for (auto& descriptorSet : bds.descriptorSets) descriptorSet->accept(*this);
+    }
+
+    void apply(vsg::DescriptorSet& descriptorSet) override
+    {
+        for (auto& descriptor : descriptorSet.descriptors) descriptor->accept(*this);
+    }
+
+    void apply(vsg::DescriptorImage& descriptorImage) override
+    {
+        for (auto& info : descriptorImage.imageInfoList)
+        {
+            if (info->imageView && info->imageView->image && info->imageView->image->data == data) imageInfo = info;
+        }
+    }
+};
+
 int main(int argc, char** argv)
 {
     // set up defaults and read command line arguments to override them
@@ -93,6 +161,20 @@ int main(int argc, char** argv)
     else if (arguments.read("--late"))
         dataVariance = vsg::DYNAMIC_DATA_TRANSFER_AFTER_RECORD;
 
+    // update a moving region of the image each frame, i.e. -s 4096 --region 256 --partial
+    auto regionSize = arguments.value<uint32_t>(0, "--region");
+    bool partialUpload = arguments.read("--partial");
+    if (partialUpload)
+    {
+        // the regions are uploaded by the DirtyRegionUpload command so the TransferTask mustn't upload the whole image as well
+        dataVariance = vsg::STATIC_DATA;
+        if (arrayType == USE_RGB)
+        {
+            std::cout << "--partial is not supported with --rgb, as RGB data has to be converted to RGBA, using --rgba instead." << std::endl;
+            arrayType = USE_RGBA;
+        }
+    }
+
     vsg::GeometryInfo geomInfo;
     vsg::StateInfo stateInfo;
     stateInfo.wireframe = arguments.read("--wireframe");
@@ -161,6 +243,9 @@ int main(int argc, char** argv)
         break;
     }
 
+    // only the base level is updated by partial uploads so disable mipmapping
+    if (partialUpload) textureData->properties.maxNumMipmaps = 1;
+
     // initialize the image
     UpdateImage updateImage;
     updateImage(textureData, 0.0);
@@ -184,6 +269,22 @@ int main(int argc, char** argv)
     }
 
     auto commandGraph = vsg::createCommandGraphForView(window, camera, scenegraph);
+
+    if (partialUpload)
+    {
+        FindImageInfo findImageInfo(textureData);
+        scenegraph->accept(findImageInfo);
+        if (!findImageInfo.imageInfo)
+        {
+            std::cout << "Could not find ImageInfo for texture." << std::endl;
+            return 1;
+        }
+
+        // record the copies ahead of the RenderGraph, with a staging segment for each frame that may be in flight
+        updateImage.dirtyRegionUpload = DirtyRegionUpload::create(vsg::ImageInfoList{findImageInfo.imageInfo}, static_cast<uint32_t>(window->numFrames()) + 1);
+        commandGraph->children.insert(commandGraph->children.begin(), updateImage.dirtyRegionUpload);
+    }
+
     viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
     if (multiThreading) viewer->setupThreading();
@@ -203,8 +304,20 @@ int main(int argc, char** argv)
         double time = std::chrono::duration<double, std::chrono::seconds::period>(viewer->getFrameStamp()->time - viewer->start_point()).count();
 
         // update texture data
+        if (regionSize > 0)
+        {
+            // sweep the region across the image, one region width per frame
+            uint32_t regionsPerRow = std::max(image_size / regionSize, 1u);
+            uint32_t index = static_cast<uint32_t>(numFramesCompleted) % (regionsPerRow * regionsPerRow);
+            updateImage.x = (index % regionsPerRow) * regionSize;
+            updateImage.y = (index / regionsPerRow) * regionSize;
+            updateImage.width = regionSize;
+            updateImage.height = regionSize;
+        }
         updateImage(textureData, time);
 
+        if (updateImage.dirtyRegionUpload) updateImage.dirtyRegionUpload->update();
+
         viewer->update();
 
         viewer->recordAndSubmit();
@@ -220,6 +333,8 @@ int main(int argc, char** argv)
         std::cout << "Average frame rate = " << (numFramesCompleted / duration) << std::endl;
     }
 
+    if (updateImage.dirtyRegionUpload) updateImage.dirtyRegionUpload->report(std::cout);
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }
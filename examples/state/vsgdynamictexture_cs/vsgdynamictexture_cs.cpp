@@ -1,11 +1,20 @@
 #include <iostream>
 #include <vsg/all.h>
 
+#include "DirtyRegionUpload.h"
+
 class UpdateImage : public vsg::Visitor
 {
 public:
     double value = 0.0;
 
+    // rows of the image to update, a height of 0 updates the whole image
+    uint32_t y = 0;
+    uint32_t height = 0;
+
+    // when assigned only the updated rows are uploaded, otherwise the whole image is dirtied
+    vsg::ref_ptr<DirtyRegionUpload> dirtyRegionUpload;
+
     template<class A>
     void update(A& image)
     {
@@ -16,7 +25,13 @@ public:
         float c_mult = 1.0f / static_cast<float>(image.width() - 1);
         float c_offset = 0.5f + static_cast<float>(cos(value)) * 0.25f;
 
-        for (uint32_t r = 0; r < image.height(); ++r)
+        uint32_t r_begin = 0, r_end = image.height();
+        if (height > 0)
+        {
+            r_begin = std::min(y, image.height()), r_end = std::min(y + height, image.height());
+        }
+
+        for (uint32_t r = r_begin; r < r_end; ++r)
         {
             float r_ratio = static_cast<float>(r) * r_mult;
             value_type* ptr = &image.at(0, r);
@@ -43,7 +58,10 @@ public:
             }
         }
 
-        image.dirty();
+        if (dirtyRegionUpload)
+            dirtyRegionUpload->dirty(0, r_begin, image.width(), r_end - r_begin);
+        else
+            image.dirty();
     }
 
     // use the vsg::Visitor to safely cast to types handled by the UpdateImage class
@@ -73,6 +91,11 @@ int main(int argc, char** argv)
     auto numFrames = arguments.value(-1, "-f");
     auto workgroupSize = arguments.value(32, "-w");
     auto nestedCommandGraph = arguments.read({"-n", "--nested"});
+    auto image_size = arguments.value<uint32_t>(256, "-s");
+
+    // update a moving band of rows each frame, with --partial uploading just those rows of the source buffer
+    auto regionSize = arguments.value<uint32_t>(0, "--region");
+    bool partialUpload = arguments.read("--partial");
 
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
@@ -114,9 +137,9 @@ int main(int argc, char** argv)
     viewer->addEventHandler(vsg::CloseHandler::create(viewer));
 
     // setup texture source image data
-    vsg::ref_ptr<vsg::Data> textureData = vsg::vec3Array2D::create(256, 256);
+    vsg::ref_ptr<vsg::Data> textureData = vsg::vec3Array2D::create(image_size, image_size);
     textureData->properties.format = VK_FORMAT_R32G32B32_SFLOAT;
-    textureData->properties.dataVariance = vsg::DYNAMIC_DATA;
+    textureData->properties.dataVariance = partialUpload ? vsg::STATIC_DATA : vsg::DYNAMIC_DATA;
 
     // initialize the source image data
     UpdateImage updateImage;
@@ -305,6 +328,14 @@ int main(int argc, char** argv)
         int computeQueueFamily = graphics_commandGraph->queueFamily;
         auto compute_commandGraph = vsg::CommandGraph::create(device, computeQueueFamily);
 
+        if (partialUpload)
+        {
+            // copy the dirty rows of the source buffer ahead of the dispatch, the whole image is still converted by the compute shader
+            updateImage.dirtyRegionUpload = DirtyRegionUpload::create(sourceBuffer->bufferInfoList.front(), static_cast<uint32_t>(window->numFrames()) + 1);
+            updateImage.dirtyRegionUpload->dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+            compute_commandGraph->addChild(updateImage.dirtyRegionUpload);
+        }
+
         compute_commandGraph->addChild(preCopyBarrierCmd);
         compute_commandGraph->addChild(bindPipeline);
         compute_commandGraph->addChild(bindDescriptorSet);
@@ -339,8 +370,17 @@ int main(int argc, char** argv)
         double time = std::chrono::duration<double, std::chrono::seconds::period>(viewer->getFrameStamp()->time - viewer->start_point()).count();
 
         // update texture data
+        if (regionSize > 0)
+        {
+            // sweep the band of rows down the image
+            uint32_t regionsPerImage = std::max(image_size / regionSize, 1u);
+            updateImage.y = (static_cast<uint32_t>(numFramesCompleted) % regionsPerImage) * regionSize;
+            updateImage.height = regionSize;
+        }
         updateImage(textureData, time);
 
+        if (updateImage.dirtyRegionUpload) updateImage.dirtyRegionUpload->update();
+
         viewer->update();
 
         viewer->recordAndSubmit();
@@ -356,6 +396,8 @@ int main(int argc, char** argv)
         std::cout << "Average frame rate = " << (numFramesCompleted / duration) << std::endl;
     }
 
+    if (updateImage.dirtyRegionUpload) updateImage.dirtyRegionUpload->report(std::cout);
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }
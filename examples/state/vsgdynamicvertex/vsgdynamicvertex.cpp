@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <vsg/all.h>
 
@@ -5,6 +6,8 @@
 #    include <vsgXchange/all.h>
 #endif
 
+#include "DirtyRegionUpload.h"
+
 class FindVertexData : public vsg::Visitor
 {
 public:
@@ -58,6 +61,78 @@ public:
     std::set<vsg::ref_ptr<vsg::BufferInfo>> bufferInfoSet;
 };
 
+// create a flat grid of at least numVertices vertices, split into tiles small enough for ushort indices that all share the same index array
+vsg::ref_ptr<vsg::Node> createMesh(size_t numVertices, vsg::ref_ptr<const vsg::Options> options)
+{
+    const uint32_t tileSize = 256; // vertices along each side of a tile
+    size_t numTiles = std::max(size_t(1), (numVertices + tileSize * tileSize - 1) / (tileSize * tileSize));
+    uint32_t tilesAcross = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(numTiles))));
+
+    auto indices = vsg::ushortArray::create((tileSize - 1) * (tileSize - 1) * 6);
+    auto itr = indices->begin();
+    for (uint32_t r = 0; r < (tileSize - 1); ++r)
+    {
+        for (uint32_t c = 0; c < (tileSize - 1); ++c)
+        {
+            uint16_t i = static_cast<uint16_t>(r * tileSize + c);
+            *(itr++) = i;
+            *(itr++) = i + 1;
+            *(itr++) = i + tileSize;
+            *(itr++) = i + tileSize;
+            *(itr++) = i + 1;
+            *(itr++) = i + tileSize + 1;
+        }
+    }
+
+    auto normals = vsg::vec3Value::create(vsg::vec3(0.0f, 0.0f, 1.0f));
+    auto colors = vsg::vec4Value::create(vsg::vec4(1.0f, 1.0f, 1.0f, 1.0f));
+
+    auto graphicsPipelineConfig = vsg::GraphicsPipelineConfigurator::create(vsg::createPhongShaderSet(options));
+    auto stateGroup = vsg::StateGroup::create();
+
+    float spacing = 1.0f / static_cast<float>(tileSize - 1);
+    for (size_t t = 0; t < numTiles; ++t)
+    {
+        vsg::vec3 origin(static_cast<float>(t % tilesAcross), static_cast<float>(t / tilesAcross), 0.0f);
+
+        auto vertices = vsg::vec3Array::create(tileSize * tileSize);
+        auto vertex_itr = vertices->begin();
+        for (uint32_t r = 0; r < tileSize; ++r)
+        {
+            for (uint32_t c = 0; c < tileSize; ++c)
+            {
+                *(vertex_itr++) = origin + vsg::vec3(static_cast<float>(c) * spacing, static_cast<float>(r) * spacing, 0.0f);
+            }
+        }
+
+        vsg::DataList vertexArrays;
+        if (t == 0)
+        {
+            // the first tile sets up the pipeline's vertex inputs, the rest follow the same array order
+            graphicsPipelineConfig->assignArray(vertexArrays, "vsg_Vertex", VK_VERTEX_INPUT_RATE_VERTEX, vertices);
+            graphicsPipelineConfig->assignArray(vertexArrays, "vsg_Normal", VK_VERTEX_INPUT_RATE_INSTANCE, normals);
+            graphicsPipelineConfig->assignArray(vertexArrays, "vsg_Color", VK_VERTEX_INPUT_RATE_INSTANCE, colors);
+        }
+        else
+        {
+            vertexArrays = vsg::DataList{vertices, normals, colors};
+        }
+
+        auto vid = vsg::VertexIndexDraw::create();
+        vid->firstBinding = graphicsPipelineConfig->baseAttributeBinding;
+        vid->assignArrays(vertexArrays);
+        vid->assignIndices(indices);
+        vid->indexCount = static_cast<uint32_t>(indices->size());
+        vid->instanceCount = 1;
+        stateGroup->addChild(vid);
+    }
+
+    graphicsPipelineConfig->init();
+    graphicsPipelineConfig->copyTo(stateGroup);
+
+    return stateGroup;
+}
+
 int main(int argc, char** argv)
 {
     try
@@ -96,6 +171,15 @@ int main(int argc, char** argv)
         auto modify = !arguments.read("--no-modify");
         auto dirty = arguments.read("--dirty");
 
+        // benchmark a generated mesh with a fraction of each vertex array moving per frame, i.e. --mesh 10000000 --moving 0.01 --partial
+        auto meshSize = arguments.value<size_t>(0, "--mesh");
+        auto movingRatio = arguments.value(1.0, "--moving");
+        auto numSpans = std::max(1u, arguments.value<uint32_t>(1, "--spans"));
+
+        // copy just the moving spans, rather than the whole vertex arrays, using the DirtyRegionUpload command
+        auto partialUpload = arguments.read("--partial");
+        auto coalesceGap = arguments.value<uint32_t>(0, "--coalesce-gap");
+
         // set the dynamic hint to tell the Viewer::compile() to assign this vsg::Data to a vsg::TransferTask
         vsg::DataVariance dataVariance = vsg::DYNAMIC_DATA;
         if (arguments.read("--static"))
@@ -103,20 +187,31 @@ int main(int argc, char** argv)
         else if (arguments.read("--late"))
             dataVariance = vsg::DYNAMIC_DATA_TRANSFER_AFTER_RECORD;
 
+        // the DirtyRegionUpload does the transfers, so the TransferTask mustn't upload the whole arrays as well
+        if (partialUpload) dataVariance = vsg::STATIC_DATA;
+
         if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
-        if (argc <= 1)
+        vsg::ref_ptr<vsg::Node> vsg_scene;
+        if (meshSize > 0)
         {
-            std::cout << "Please specify a 3d model on the command line." << std::endl;
-            return 1;
+            vsg_scene = createMesh(meshSize, options);
         }
-
-        vsg::Path filename = arguments[1];
-        auto vsg_scene = vsg::read_cast<vsg::Node>(filename, options);
-        if (!vsg_scene)
+        else
         {
-            std::cout << "Unable to load file " << filename << std::endl;
-            return 1;
+            if (argc <= 1)
+            {
+                std::cout << "Please specify a 3d model on the command line." << std::endl;
+                return 1;
+            }
+
+            vsg::Path filename = arguments[1];
+            vsg_scene = vsg::read_cast<vsg::Node>(filename, options);
+            if (!vsg_scene)
+            {
+                std::cout << "Unable to load file " << filename << std::endl;
+                return 1;
+            }
         }
 
         // visit the scene graph to collect all the vertex arrays
@@ -178,6 +273,25 @@ int main(int argc, char** argv)
         // set up commandGraph for rendering
         auto commandGraph = vsg::createCommandGraphForView(window, camera, vsg_scene);
 
+        vsg::ref_ptr<DirtyRegionUpload> dirtyRegionUpload;
+        if (partialUpload)
+        {
+            // order the BufferInfo to match verticesList so the array index passed to dirtyRange() is the same
+            vsg::BufferInfoList bufferInfos(verticesList.size());
+            for (auto& bufferInfo : fdv.bufferInfoSet)
+            {
+                auto itr = std::find(verticesList.begin(), verticesList.end(), bufferInfo->data);
+                if (itr != verticesList.end()) bufferInfos[itr - verticesList.begin()] = bufferInfo;
+            }
+
+            // record the copies ahead of the RenderGraph, with a staging segment for each frame that may be in flight
+            dirtyRegionUpload = DirtyRegionUpload::create(bufferInfos, static_cast<uint32_t>(window->numFrames()) + 1);
+            dirtyRegionUpload->coalesceGap = coalesceGap;
+            dirtyRegionUpload->dstStageMask = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+            dirtyRegionUpload->dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+            commandGraph->children.insert(commandGraph->children.begin(), dirtyRegionUpload);
+        }
+
         viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
         vsg::info("multiThreading = ", multiThreading);
@@ -200,16 +314,41 @@ int main(int argc, char** argv)
 
             if (modify)
             {
-                for (auto& vertices : verticesList)
+                float dz = static_cast<float>(sin(vsg::PI * frameCount / 180.0) * radius * 0.001);
+                for (uint32_t i = 0; i < verticesList.size(); ++i)
                 {
-                    for (auto& v : *vertices)
+                    auto& vertices = verticesList[i];
+                    if (movingRatio < 1.0)
                     {
-                        v.z += static_cast<float>(sin(vsg::PI * frameCount / 180.0) * radius * 0.001);
+                        // move numSpans evenly spaced spans of the array, sweeping them along the array from frame to frame
+                        uint32_t size = static_cast<uint32_t>(vertices->size());
+                        uint32_t spanSize = std::max(1u, static_cast<uint32_t>(static_cast<double>(size) * movingRatio / numSpans));
+                        uint32_t spacing = size / numSpans;
+                        uint32_t start = static_cast<uint32_t>((static_cast<uint64_t>(frameCount) * spanSize) % size);
+
+                        for (uint32_t s = 0; s < numSpans; ++s)
+                        {
+                            uint32_t first = (start + s * spacing) % size;
+                            uint32_t count = std::min(spanSize, size - first);
+                            for (uint32_t v = first; v < first + count; ++v) vertices->at(v).z += dz;
+
+                            if (dirtyRegionUpload) dirtyRegionUpload->dirtyRange(first, count, i);
+                        }
                     }
-                    vertices->dirty();
+                    else
+                    {
+                        for (auto& v : *vertices)
+                        {
+                            v.z += dz;
+                        }
+
+                        if (dirtyRegionUpload) dirtyRegionUpload->dirtyRange(0, static_cast<uint32_t>(vertices->size()), i);
+                    }
+
+                    if (!dirtyRegionUpload) vertices->dirty();
                 }
 
-                if (dataVariance == vsg::STATIC_DATA)
+                if (dataVariance == vsg::STATIC_DATA && !dirtyRegionUpload)
                 {
                     // If the data variance is static then we have to manually
                     // assign the buffer info we want to transfer on each frame.
@@ -233,14 +372,19 @@ int main(int argc, char** argv)
                 }
             }
 
+            if (dirtyRegionUpload) dirtyRegionUpload->update();
+
             viewer->recordAndSubmit();
             viewer->present();
         }
 
         auto fps = frameCount / (std::chrono::duration<double, std::chrono::seconds::period>(std::chrono::steady_clock::now() - startTime).count());
-        double transferSpeed = (double)(numVertices * sizeof(vsg::vec3) * fps);
+        double bytesPerFrame = dirtyRegionUpload ? static_cast<double>(dirtyRegionUpload->numBytes) / std::max(1.0, frameCount) : static_cast<double>(numVertices * sizeof(vsg::vec3));
+        double transferSpeed = bytesPerFrame * fps;
         std::cout << "Average fps = " << fps << std::endl;
         std::cout << "Average transfer speed " << (transferSpeed) / (1024.0 * 1024.0) << " Mb/sec" << std::endl;
+
+        if (dirtyRegionUpload) dirtyRegionUpload->report(std::cout);
     }
     catch (const vsg::Exception& exception)
     {
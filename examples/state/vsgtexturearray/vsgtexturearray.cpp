@@ -6,12 +6,16 @@
 
 #include <iostream>
 
-void updateBaseTexture(vsg::ubvec4Array2D& image, float value)
+#include "DirtyRegionUpload.h"
+
+void updateBaseTexture(vsg::ubvec4Array2D& image, float value, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
 {
-    for (uint32_t r = 0; r < image.height(); ++r)
+    uint32_t r_end = std::min(y + height, image.height());
+    uint32_t c_end = std::min(x + width, image.width());
+    for (uint32_t r = y; r < r_end; ++r)
     {
         float r_ratio = static_cast<float>(r) / static_cast<float>(image.height() - 1);
-        for (uint32_t c = 0; c < image.width(); ++c)
+        for (uint32_t c = x; c < c_end; ++c)
         {
             float c_ratio = static_cast<float>(c) / static_cast<float>(image.width() - 1);
 
@@ -25,6 +29,11 @@ void updateBaseTexture(vsg::ubvec4Array2D& image, float value)
             image.set(c, r, vsg::ubvec4(uint8_t(intensity * intensity * 255.0f), uint8_t(intensity * 255.0f), uint8_t(intensity * 255.0f), 255));
         }
     }
+}
+
+void updateBaseTexture(vsg::ubvec4Array2D& image, float value)
+{
+    updateBaseTexture(image, value, 0, 0, image.width(), image.height());
     image.dirty();
 }
 
@@ -151,7 +160,13 @@ int main(int argc, char** argv)
     bool update = arguments.read("--update");
     int numRows = arguments.value(4, "--rows");
     int numColumns = arguments.value(4, "--cols");
-    ;
+    auto numFrames = arguments.value(-1, "-f");
+    auto textureSize = arguments.value<uint32_t>(256, "--texture-size");
+
+    // update a moving region of a different texture each frame, with --partial uploading just those regions
+    auto regionSize = arguments.value<uint32_t>(0, "--region");
+    bool partialUpload = arguments.read("--partial");
+    if (regionSize > 0 || partialUpload) update = true;
 
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
@@ -200,9 +215,17 @@ int main(int argc, char** argv)
     std::vector<vsg::ref_ptr<vsg::ubvec4Array2D>> textureDataList;
     for (uint32_t i = 0; i < numTiles; ++i)
     {
-        auto textureData = vsg::ubvec4Array2D::create(256, 256);
+        auto textureData = vsg::ubvec4Array2D::create(textureSize, textureSize);
         textureData->properties.format = VK_FORMAT_R8G8B8A8_SRGB;
-        if (update) textureData->properties.dataVariance = vsg::DYNAMIC_DATA;
+        if (partialUpload)
+        {
+            // regions are uploaded by the DirtyRegionUpload command, which only updates the base mipmap level
+            textureData->properties.maxNumMipmaps = 1;
+        }
+        else if (update)
+        {
+            textureData->properties.dataVariance = vsg::DYNAMIC_DATA;
+        }
 
         updateBaseTexture(*textureData, 1.0f);
 
@@ -370,6 +393,16 @@ int main(int argc, char** argv)
     auto camera = vsg::Camera::create(perspective, lookAt, viewport);
 
     auto commandGraph = vsg::createCommandGraphForView(window, camera, scenegraph);
+
+    vsg::ref_ptr<DirtyRegionUpload> dirtyRegionUpload;
+    if (partialUpload)
+    {
+        // record the copies to the base textures ahead of the RenderGraph, with a staging segment for each frame that may be in flight
+        dirtyRegionUpload = DirtyRegionUpload::create(baseTextures, static_cast<uint32_t>(window->numFrames()) + 1);
+        dirtyRegionUpload->dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        commandGraph->children.insert(commandGraph->children.begin(), dirtyRegionUpload);
+    }
+
     viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
     // add event handlers
@@ -384,8 +417,11 @@ int main(int argc, char** argv)
     // create a context to manage the DeviceMemoryPool for us when we need to copy data to a staging buffer
     vsg::Context context(window->getOrCreateDevice());
 
+    auto startTime = vsg::clock::now();
+    uint64_t numFramesCompleted = 0;
+
     // main frame loop
-    while (viewer->advanceToNextFrame())
+    while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
     {
         // pass any events into EventHandlers assigned to the Viewer
         viewer->handleEvents();
@@ -395,22 +431,55 @@ int main(int argc, char** argv)
             // animate the transform
             float time = std::chrono::duration<float, std::chrono::seconds::period>(viewer->getFrameStamp()->time - viewer->start_point()).count();
 
-            uint32_t textureToUpdate = 0; // viewer->getFrameStamp()->frameCount % numTiles;
-            auto& textureData = textureDataList[textureToUpdate];
-            if (textureData)
+            if (regionSize > 0 || partialUpload)
+            {
+                // sweep a region across each texture in turn
+                uint32_t size = regionSize > 0 ? std::min(regionSize, textureSize) : textureSize;
+                uint32_t regionsPerRow = textureSize / size;
+                uint32_t textureToUpdate = static_cast<uint32_t>(numFramesCompleted % numTiles);
+                uint32_t index = static_cast<uint32_t>(numFramesCompleted / numTiles) % (regionsPerRow * regionsPerRow);
+                uint32_t x = (index % regionsPerRow) * size;
+                uint32_t y = (index / regionsPerRow) * size;
+
+                auto& textureData = textureDataList[textureToUpdate];
+                updateBaseTexture(*textureData, time, x, y, size, size);
+
+                if (dirtyRegionUpload)
+                    dirtyRegionUpload->dirty(x, y, size, size, 0, textureToUpdate);
+                else
+                    textureData->dirty();
+            }
+            else
             {
-                // update texture data
-                updateBaseTexture(*textureData, time);
+                uint32_t textureToUpdate = 0; // viewer->getFrameStamp()->frameCount % numTiles;
+                auto& textureData = textureDataList[textureToUpdate];
+                if (textureData)
+                {
+                    // update texture data
+                    updateBaseTexture(*textureData, time);
+                }
             }
         }
 
+        if (dirtyRegionUpload) dirtyRegionUpload->update();
+
         viewer->update();
 
         viewer->recordAndSubmit();
 
         viewer->present();
+
+        ++numFramesCompleted;
+    }
+
+    auto duration = std::chrono::duration<double, std::chrono::seconds::period>(vsg::clock::now() - startTime).count();
+    if (numFramesCompleted > 0)
+    {
+        std::cout << "Average frame rate = " << (static_cast<double>(numFramesCompleted) / duration) << std::endl;
     }
 
+    if (dirtyRegionUpload) dirtyRegionUpload->report(std::cout);
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }
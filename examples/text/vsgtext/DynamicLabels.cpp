@@ -0,0 +1,396 @@
+#include "DynamicLabels.h"
+
+#include <algorithm>
+
+DynamicLabels::DynamicLabels(vsg::ref_ptr<vsg::Font> in_font, Technique in_technique, uint32_t in_capacity) :
+    font(in_font),
+    technique(in_technique),
+    capacity(std::max(in_capacity, 1u))
+{
+}
+
+vsg::ref_ptr<vsg::stringValue> DynamicLabels::add(vsg::ref_ptr<vsg::StandardLayout> layout, const std::string& text)
+{
+    Label label;
+    label.layout = layout;
+    label.text = vsg::stringValue::create(text);
+    _labels.push_back(label);
+    return label.text;
+}
+
+void DynamicLabels::_convert(const std::string& str, std::vector<uint32_t>& glyphs)
+{
+    glyphs.clear();
+
+    auto& charmap = *(font->charmap);
+    for (auto c : str)
+    {
+        uint32_t charcode = static_cast<unsigned char>(c);
+        uint32_t glyph = 0; // newline
+        if (charcode != '\n')
+        {
+            // skip characters the font doesn't have, as glyph index 0 would be treated as a newline
+            glyph = charcode < charmap.size() ? charmap[charcode] : 0;
+            if (glyph == 0) continue;
+        }
+
+        if (glyphs.size() >= capacity)
+        {
+            ++numGlyphsTruncated;
+            break;
+        }
+        glyphs.push_back(glyph);
+    }
+}
+
+void DynamicLabels::_layoutGlyphs(uint32_t labelIndex, size_t first, size_t previousSize)
+{
+    // mirror the layout of text.vert's GPU_LAYOUT path so both techniques place glyphs identically
+    auto& label = _labels[labelIndex];
+    auto& layout = *label.layout;
+    uint32_t pageIndex = labelIndex / labelsPerPage;
+    auto& page = _pages[pageIndex];
+    auto& metrics = *(font->glyphMetrics);
+
+    size_t base = static_cast<size_t>(labelIndex % labelsPerPage) * capacity * 4;
+    vsg::vec3* vertices = page.vertices->data() + base;
+    vsg::vec3* texcoords = page.texcoords->data() + base;
+
+    label.pens.resize(label.glyphs.size() + 1);
+    vsg::vec2 pen = label.pens[first];
+
+    for (size_t i = first; i < label.glyphs.size(); ++i)
+    {
+        label.pens[i] = pen;
+
+        vsg::vec3* v = vertices + i * 4;
+        vsg::vec3* tc = texcoords + i * 4;
+
+        uint32_t glyph = label.glyphs[i];
+        if (glyph == 0)
+        {
+            pen.x = 0.0f;
+            pen.y -= 1.0f;
+            v[0] = v[1] = v[2] = v[3] = vsg::vec3(0.0f, 0.0f, 0.0f);
+            continue;
+        }
+
+        auto& metric = metrics[glyph];
+        vsg::vec3 origin = layout.position + layout.horizontal * (pen.x + metric.horiBearingX) + layout.vertical * (pen.y + metric.horiBearingY - metric.height);
+        vsg::vec3 dx = layout.horizontal * metric.width;
+        vsg::vec3 dy = layout.vertical * metric.height;
+
+        v[0] = origin;
+        v[1] = origin + dx;
+        v[2] = origin + dx + dy;
+        v[3] = origin + dy;
+
+        auto& uv = metric.uvrect;
+        tc[0].set(uv[0], uv[1], 0.0f);
+        tc[1].set(uv[2], uv[1], 0.0f);
+        tc[2].set(uv[2], uv[3], 0.0f);
+        tc[3].set(uv[0], uv[3], 0.0f);
+
+        pen.x += metric.horiAdvance;
+    }
+    label.pens[label.glyphs.size()] = pen;
+
+    // collapse the quads of glyphs the label no longer has so they don't rasterize
+    for (size_t i = label.glyphs.size(); i < previousSize; ++i)
+    {
+        vsg::vec3* v = vertices + i * 4;
+        v[0] = v[1] = v[2] = v[3] = vsg::vec3(0.0f, 0.0f, 0.0f);
+    }
+
+    if (!upload) return;
+
+    // copy just the quads from the first changed glyph, the collapsed quads only change the vertices
+    auto firstVertex = static_cast<uint32_t>(base + first * 4);
+    auto numVertices = static_cast<uint32_t>((std::max(label.glyphs.size(), previousSize) - first) * 4);
+    auto numTexCoords = static_cast<uint32_t>(first < label.glyphs.size() ? (label.glyphs.size() - first) * 4 : 0);
+
+    upload->dirtyRange(firstVertex, numVertices, pageIndex * 2);
+    numBytesDirtied += numVertices * sizeof(vsg::vec3);
+    if (numTexCoords > 0)
+    {
+        upload->dirtyRange(firstVertex, numTexCoords, pageIndex * 2 + 1);
+        numBytesDirtied += numTexCoords * sizeof(vsg::vec3);
+    }
+}
+
+void DynamicLabels::_writeGlyphIndices(Label& label, size_t first, size_t previousSize)
+{
+    auto& glyphIndices = *label.glyphIndices;
+    for (size_t i = first; i < label.glyphs.size(); ++i)
+    {
+        glyphIndices[i / 4][i % 4] = label.glyphs[i];
+    }
+
+    // the instance count limits the draw to the current glyphs, the unused tail is left as is
+    label.draw->instanceCount = static_cast<uint32_t>(label.glyphs.size());
+
+    if (first < label.glyphs.size() || label.glyphs.size() != previousSize)
+    {
+        glyphIndices.dirty();
+        numBytesDirtied += glyphIndices.dataSize();
+    }
+}
+
+void DynamicLabels::update()
+{
+    auto startTime = vsg::clock::now();
+
+    for (uint32_t i = 0; i < _labels.size(); ++i)
+    {
+        auto& label = _labels[i];
+        if (label.text->value() == label.current) continue;
+
+        ++numLabelsChanged;
+        label.current = label.text->value();
+
+        _convert(label.current, _newGlyphs);
+
+        // find the first glyph that has changed, the glyphs before it and their pen positions are still valid
+        size_t first = 0;
+        size_t common = std::min(_newGlyphs.size(), label.glyphs.size());
+        while (first < common && _newGlyphs[first] == label.glyphs[first]) ++first;
+
+        size_t previousSize = label.glyphs.size();
+        label.glyphs.swap(_newGlyphs);
+
+        if (first == label.glyphs.size() && first == previousSize) continue;
+
+        numGlyphsLaidOut += label.glyphs.size() - first;
+
+        if (technique == GPU_LAYOUT)
+            _writeGlyphIndices(label, first, previousSize);
+        else
+            _layoutGlyphs(i, first, previousSize);
+    }
+
+    ++numUpdates;
+    updateTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+}
+
+vsg::ref_ptr<vsg::Node> DynamicLabels::createSubgraph(vsg::ref_ptr<const vsg::Options> options)
+{
+    if (!font || !font->atlas || !font->glyphMetrics || !font->charmap) return {};
+
+    // createTextShaderSet() returns options->shaderSets["text"] when one is assigned, which the GPU_LAYOUT path mustn't modify
+    auto shaderSet = vsg::createTextShaderSet(options);
+    if (!shaderSet) return {};
+
+    auto atlasSampler = vsg::Sampler::create();
+    atlasSampler->addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    atlasSampler->addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+    if (technique == GPU_LAYOUT) return _createGpuSubgraph(shaderSet, atlasSampler);
+    return _createCpuSubgraph(shaderSet, atlasSampler);
+}
+
+vsg::ref_ptr<vsg::Node> DynamicLabels::_createCpuSubgraph(vsg::ref_ptr<vsg::ShaderSet> shaderSet, vsg::ref_ptr<vsg::Sampler> atlasSampler)
+{
+    auto config = vsg::GraphicsPipelineConfigurator::create(shaderSet);
+    config->shaderHints->defines.insert("CPU_LAYOUT");
+    config->enableArray("inPosition", VK_VERTEX_INPUT_RATE_VERTEX, 12);
+    config->enableArray("inColor", VK_VERTEX_INPUT_RATE_VERTEX, 16);
+    config->enableArray("inOutlineColor", VK_VERTEX_INPUT_RATE_VERTEX, 16);
+    config->enableArray("inOutlineWidth", VK_VERTEX_INPUT_RATE_VERTEX, 4);
+    config->enableArray("inTexCoord", VK_VERTEX_INPUT_RATE_VERTEX, 12);
+    config->assignTexture("textureAtlas", font->atlas, atlasSampler);
+    config->init();
+
+    auto stateGroup = vsg::StateGroup::create();
+    config->copyTo(stateGroup);
+
+    uint32_t numPages = (static_cast<uint32_t>(_labels.size()) + labelsPerPage - 1) / labelsPerPage;
+    _pages.resize(numPages);
+
+    vsg::BufferInfoList bufferInfos;
+
+    for (uint32_t p = 0; p < numPages; ++p)
+    {
+        uint32_t firstLabel = p * labelsPerPage;
+        uint32_t numLabels = std::min(labelsPerPage, static_cast<uint32_t>(_labels.size()) - firstLabel);
+        uint32_t numVertices = numLabels * capacity * 4;
+
+        // the glyph quads are rewritten in place and copied by the upload command, so all the arrays are left as STATIC_DATA
+        auto& page = _pages[p];
+        page.vertices = vsg::vec3Array::create(numVertices, vsg::vec3(0.0f, 0.0f, 0.0f));
+        page.texcoords = vsg::vec3Array::create(numVertices, vsg::vec3(0.0f, 0.0f, 0.0f));
+
+        auto colors = vsg::vec4Array::create(numVertices);
+        auto outlineColors = vsg::vec4Array::create(numVertices);
+        auto outlineWidths = vsg::floatArray::create(numVertices);
+        for (uint32_t l = 0; l < numLabels; ++l)
+        {
+            auto& layout = *_labels[firstLabel + l].layout;
+            uint32_t begin = l * capacity * 4;
+            std::fill(colors->begin() + begin, colors->begin() + begin + capacity * 4, layout.color);
+            std::fill(outlineColors->begin() + begin, outlineColors->begin() + begin + capacity * 4, layout.outlineColor);
+            std::fill(outlineWidths->begin() + begin, outlineWidths->begin() + begin + capacity * 4, layout.outlineWidth);
+        }
+
+        auto indices = vsg::uintArray::create(numLabels * capacity * 6);
+        auto index_itr = indices->begin();
+        for (uint32_t q = 0; q < numLabels * capacity; ++q)
+        {
+            uint32_t v = q * 4;
+            for (auto i : {v, v + 1, v + 2, v + 2, v + 3, v}) *(index_itr++) = i;
+        }
+
+        auto vid = vsg::VertexIndexDraw::create();
+        vid->assignArrays(vsg::DataList{page.vertices, colors, outlineColors, outlineWidths, page.texcoords});
+        vid->assignIndices(indices);
+        vid->indexCount = static_cast<uint32_t>(indices->size());
+        vid->instanceCount = 1;
+        vid->firstBinding = config->baseAttributeBinding;
+
+        stateGroup->addChild(vid);
+
+        // the vertex and texcoord BufferInfo of page p are the upload's buffers p * 2 and p * 2 + 1
+        bufferInfos.push_back(vid->arrays[0]);
+        bufferInfos.push_back(vid->arrays[4]);
+    }
+
+    // lay out the initial strings, these are uploaded when the subgraph is compiled
+    for (uint32_t i = 0; i < _labels.size(); ++i)
+    {
+        auto& label = _labels[i];
+        label.current = label.text->value();
+        _convert(label.current, label.glyphs);
+        _layoutGlyphs(i, 0, 0);
+    }
+
+    // size each staging segment to hold every page so an update that changes all the labels is never deferred
+    VkDeviceSize frameCapacity = 0;
+    for (auto& bufferInfo : bufferInfos) frameCapacity += bufferInfo->data->dataSize();
+    frameCapacity += static_cast<VkDeviceSize>(_labels.size()) * 2 * 16;
+
+    upload = DirtyRegionUpload::create(bufferInfos, uploadRingSize, frameCapacity);
+    upload->dstStageMask = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    upload->dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+
+    return stateGroup;
+}
+
+vsg::ref_ptr<vsg::Node> DynamicLabels::_createGpuSubgraph(vsg::ref_ptr<vsg::ShaderSet> shaderSet, vsg::ref_ptr<vsg::Sampler> atlasSampler)
+{
+    // size the text uniform to the capacity rather than the shader's default of 256 uvec4, keeping the per label uniform small.
+    // The constant is set on copies of the ShaderSet and its vertex stage so a shared ShaderSet is left as is, and the copy's variants
+    // are cleared as any compiled from the shared ShaderSet were created with its constants.
+    uint32_t numTextIndices = (capacity + 3) / 4;
+    shaderSet = vsg::clone(shaderSet);
+    shaderSet->variants.clear();
+    for (auto& stage : shaderSet->stages)
+    {
+        if (stage->stage != VK_SHADER_STAGE_VERTEX_BIT) continue;
+
+        stage = vsg::clone(stage);
+        stage->specializationConstants[0] = vsg::uintValue::create(numTextIndices);
+    }
+
+    // the glyph metrics are looked up by text.vert with unnormalized coordinates, one row per glyph
+    auto& metrics = *(font->glyphMetrics);
+    auto glyphMetrics = vsg::vec4Array2D::create(3, static_cast<uint32_t>(metrics.size()), vsg::Data::Properties{VK_FORMAT_R32G32B32A32_SFLOAT});
+    for (uint32_t i = 0; i < metrics.size(); ++i)
+    {
+        auto& metric = metrics[i];
+        glyphMetrics->set(0, i, vsg::vec4(metric.width, metric.height, metric.horiAdvance, metric.vertAdvance));
+        glyphMetrics->set(1, i, vsg::vec4(metric.horiBearingX, metric.horiBearingY, metric.vertBearingX, metric.vertBearingY));
+        glyphMetrics->set(2, i, metric.uvrect);
+    }
+
+    auto glyphMetricsSampler = vsg::Sampler::create();
+    glyphMetricsSampler->magFilter = VK_FILTER_NEAREST;
+    glyphMetricsSampler->minFilter = VK_FILTER_NEAREST;
+    glyphMetricsSampler->mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    glyphMetricsSampler->addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    glyphMetricsSampler->addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    glyphMetricsSampler->anisotropyEnable = VK_FALSE;
+    glyphMetricsSampler->unnormalizedCoordinates = VK_TRUE;
+    glyphMetricsSampler->maxLod = 0.0f;
+
+    // each label has its own layout and glyph index uniforms
+    for (auto& label : _labels)
+    {
+        label.glyphIndices = vsg::uivec4Array::create(numTextIndices, vsg::uivec4(0, 0, 0, 0));
+        label.glyphIndices->properties.dataVariance = vsg::DYNAMIC_DATA;
+        label.draw = vsg::DrawIndexed::create(6, 0, 0, 0, 0);
+    }
+
+    auto config = vsg::GraphicsPipelineConfigurator::create(shaderSet);
+    config->shaderHints->defines.insert("GPU_LAYOUT");
+    config->enableArray("inPosition", VK_VERTEX_INPUT_RATE_VERTEX, 12);
+    config->assignTexture("textureAtlas", font->atlas, atlasSampler);
+    config->assignTexture("glyphMetrics", glyphMetrics, glyphMetricsSampler);
+
+    // assign the first label's uniforms so the pipeline layout includes the per label descriptor set, each label then binds its own
+    auto createTextLayout = [](const vsg::StandardLayout& layout) {
+        auto textLayout = vsg::TextLayoutValue::create();
+        auto& value = textLayout->value();
+        value.position = vsg::vec4(layout.position.x, layout.position.y, layout.position.z, 0.0f);
+        value.horizontal = vsg::vec4(layout.horizontal.x, layout.horizontal.y, layout.horizontal.z, 0.0f);
+        value.vertical = vsg::vec4(layout.vertical.x, layout.vertical.y, layout.vertical.z, 0.0f);
+        value.color = layout.color;
+        value.outlineColor = layout.outlineColor;
+        value.outlineWidth = layout.outlineWidth;
+        return textLayout;
+    };
+
+    if (!_labels.empty())
+    {
+        config->assignDescriptor("textLayout", createTextLayout(*_labels.front().layout));
+        config->assignDescriptor("text", _labels.front().glyphIndices);
+    }
+    config->init();
+
+    auto stateGroup = vsg::StateGroup::create();
+    config->copyTo(stateGroup);
+
+    // a unit quad shared by every glyph instance, text.vert positions and sizes it from the glyph metrics
+    auto quadVertices = vsg::vec3Array::create({{0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 0.0f}, {0.0f, 1.0f, 0.0f}});
+    auto quadIndices = vsg::ushortArray::create({0, 1, 2, 2, 3, 0});
+
+    auto commands = vsg::Commands::create();
+    commands->addChild(vsg::BindVertexBuffers::create(config->baseAttributeBinding, vsg::DataList{quadVertices}));
+    commands->addChild(vsg::BindIndexBuffer::create(quadIndices));
+
+    auto textSetLayout = config->layout->setLayouts[1];
+    for (auto& label : _labels)
+    {
+        auto descriptorSet = vsg::DescriptorSet::create(textSetLayout, vsg::Descriptors{vsg::DescriptorBuffer::create(createTextLayout(*label.layout), 0, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER),
+                                                                                        vsg::DescriptorBuffer::create(label.glyphIndices, 1, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)});
+        commands->addChild(vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, config->layout, 1, descriptorSet));
+        commands->addChild(label.draw);
+    }
+
+    stateGroup->addChild(commands);
+
+    // write the initial strings
+    for (auto& label : _labels)
+    {
+        label.current = label.text->value();
+        _convert(label.current, label.glyphs);
+        _writeGlyphIndices(label, 0, 0);
+    }
+    numBytesDirtied = 0;
+
+    return stateGroup;
+}
+
+void DynamicLabels::report(std::ostream& out) const
+{
+    out << "DynamicLabels " << (technique == GPU_LAYOUT ? "GPU_LAYOUT" : "CPU_LAYOUT") << ", labels = " << _labels.size() << ", capacity = " << capacity;
+    if (technique == CPU_LAYOUT) out << ", pages = " << _pages.size();
+    out << std::endl;
+
+    if (numUpdates == 0) return;
+
+    double updates = static_cast<double>(numUpdates);
+    out << "    updates = " << numUpdates << ", average update time = " << (updateTime / updates) << "ms" << std::endl;
+    out << "    labels changed per update = " << (static_cast<double>(numLabelsChanged) / updates) << ", glyphs laid out per update = " << (static_cast<double>(numGlyphsLaidOut) / updates) << std::endl;
+    out << "    data marked for upload per update = " << (static_cast<double>(numBytesDirtied) / updates / 1024.0) << "KB, glyphs truncated = " << numGlyphsTruncated << std::endl;
+
+    if (upload) upload->report(out);
+}
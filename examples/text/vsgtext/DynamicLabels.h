@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include "DirtyRegionUpload.h"
+
+#include <ostream>
+
+/// DynamicLabels renders large numbers of frequently updated labels, such as telemetry read-outs, without rebuilding vsg::Text objects.
+/// Each label has a fixed glyph capacity allocated up front, and when its stringValue changes only the glyphs from the first changed character are
+/// laid out again and written in place. With CPU_LAYOUT the glyph quads of labelsPerPage labels share vertex arrays and just the changed quads are
+/// copied by the upload command, with GPU_LAYOUT each label's glyph indices are held in a small uniform that is updated in place and laid out
+/// by the text vertex shader. Labels are left aligned and not billboarded.
+class DynamicLabels : public vsg::Inherit<vsg::Object, DynamicLabels>
+{
+public:
+    enum Technique
+    {
+        CPU_LAYOUT,
+        GPU_LAYOUT
+    };
+
+    DynamicLabels(vsg::ref_ptr<vsg::Font> in_font, Technique in_technique = CPU_LAYOUT, uint32_t in_capacity = 32);
+
+    vsg::ref_ptr<vsg::Font> font;
+    Technique technique = CPU_LAYOUT;
+    uint32_t capacity = 32;       // maximum number of glyphs per label, longer strings are truncated
+    uint32_t labelsPerPage = 256; // CPU_LAYOUT labels that share vertex arrays
+    uint32_t uploadRingSize = 4;  // CPU_LAYOUT staging segments, must be more than the number of frames in flight
+
+    /// CPU_LAYOUT command that copies the changed glyph quads, created by createSubgraph(). Place it in the CommandGraph ahead of the RenderGraph
+    /// and call its update() every frame after update() and before Viewer::recordAndSubmit().
+    vsg::ref_ptr<DirtyRegionUpload> upload;
+
+    /// add a label using the layout's position, horizontal, vertical, color, outlineColor and outlineWidth, returns the string to modify to update the label.
+    /// Labels must be added before createSubgraph().
+    vsg::ref_ptr<vsg::stringValue> add(vsg::ref_ptr<vsg::StandardLayout> layout, const std::string& text);
+
+    /// create the rendering subgraph with all the glyph storage for the labels allocated
+    vsg::ref_ptr<vsg::Node> createSubgraph(vsg::ref_ptr<const vsg::Options> options);
+
+    /// lay out the labels whose strings have changed since the last update and mark their data for upload, call before Viewer::recordAndSubmit().
+    void update();
+
+    void report(std::ostream& out) const;
+
+    // stats
+    uint64_t numUpdates = 0;
+    uint64_t numLabelsChanged = 0;
+    uint64_t numGlyphsLaidOut = 0;
+    uint64_t numGlyphsTruncated = 0;
+    uint64_t numBytesDirtied = 0; // size of the data marked for upload
+    double updateTime = 0.0;      // milliseconds spent in update()
+
+protected:
+    struct Label
+    {
+        vsg::ref_ptr<vsg::StandardLayout> layout;
+        vsg::ref_ptr<vsg::stringValue> text;
+        std::string current;            // string the glyphs were last laid out from
+        std::vector<uint32_t> glyphs;   // glyph indices, 0 for a newline
+        std::vector<vsg::vec2> pens;    // pen position before each glyph, and after the last one
+        vsg::ref_ptr<vsg::uivec4Array> glyphIndices; // GPU_LAYOUT
+        vsg::ref_ptr<vsg::DrawIndexed> draw;         // GPU_LAYOUT
+    };
+
+    struct Page
+    {
+        vsg::ref_ptr<vsg::vec3Array> vertices;
+        vsg::ref_ptr<vsg::vec3Array> texcoords;
+    };
+
+    void _convert(const std::string& str, std::vector<uint32_t>& glyphs);
+    void _layoutGlyphs(uint32_t labelIndex, size_t first, size_t previousSize);
+    void _writeGlyphIndices(Label& label, size_t first, size_t previousSize);
+
+    vsg::ref_ptr<vsg::Node> _createCpuSubgraph(vsg::ref_ptr<vsg::ShaderSet> shaderSet, vsg::ref_ptr<vsg::Sampler> atlasSampler);
+    vsg::ref_ptr<vsg::Node> _createGpuSubgraph(vsg::ref_ptr<vsg::ShaderSet> shaderSet, vsg::ref_ptr<vsg::Sampler> atlasSampler);
+
+    std::vector<Label> _labels;
+    std::vector<Page> _pages;
+    std::vector<uint32_t> _newGlyphs;
+};
@@ -1,6 +1,8 @@
 #include <iostream>
 #include <vsg/all.h>
 
+#include "DynamicLabels.h"
+
 #ifdef vsgXchange_FOUND
 #    include <vsgXchange/all.h>
 #endif
@@ -181,6 +183,12 @@ int main(int argc, char** argv)
     auto numFrames = arguments.value(-1, "--nf");
     auto clearColor = arguments.value(vsg::vec4(0.2f, 0.2f, 0.4f, 1.0f), "--clear");
     bool disableDepthTest = arguments.read({"--ddt", "--disable-depth-test"});
+    auto numDynamicLabels = arguments.value<uint32_t>(0, "--dynamic");
+    auto dynamicTechnique = arguments.read("--gpu-layout") ? DynamicLabels::GPU_LAYOUT : DynamicLabels::CPU_LAYOUT;
+    auto dynamicCapacity = arguments.value<uint32_t>(32, "--capacity");
+    auto labelsPerPage = arguments.value<uint32_t>(256, "--labels-per-page");
+    auto updateRate = arguments.value(60.0, "--update-rate");
+    bool rebuildLabels = arguments.read("--rebuild");
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
     // set up search paths to SPIRV shaders and textures
@@ -219,7 +227,61 @@ int main(int argc, char** argv)
     vsg::ref_ptr<vsg::stringValue> dynamic_text_label;
     vsg::ref_ptr<vsg::StandardLayout> dynamic_text_layout;
 
-    if (render_all_glyphs)
+    // telemetry labels are updated at updateRate in the main loop, either in place by DynamicLabels or by calling setup() on each vsg::Text with --rebuild
+    vsg::ref_ptr<DynamicLabels> dynamicLabels;
+    std::vector<vsg::ref_ptr<vsg::stringValue>> telemetryStrings;
+    std::vector<vsg::ref_ptr<vsg::Text>> telemetryTexts;
+
+    if (numDynamicLabels > 0)
+    {
+        if (!rebuildLabels) dynamicLabels = DynamicLabels::create(font, dynamicTechnique, dynamicCapacity);
+        if (dynamicLabels) dynamicLabels->labelsPerPage = std::max(labelsPerPage, 1u);
+
+        uint32_t numColumns = static_cast<uint32_t>(ceil(sqrt(static_cast<double>(numDynamicLabels))));
+        for (uint32_t i = 0; i < numDynamicLabels; ++i)
+        {
+            auto layout = vsg::StandardLayout::create();
+            layout->position = vsg::vec3(static_cast<float>(i % numColumns) * 12.0f, 0.0f, -static_cast<float>(i / numColumns) * 1.5f);
+            layout->horizontal = vsg::vec3(0.5f, 0.0f, 0.0f);
+            layout->vertical = vsg::vec3(0.0f, 0.0f, 0.5f);
+            layout->color = vsg::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+
+            std::string label = vsg::make_string("sensor ", i, " : 0");
+            if (dynamicLabels)
+            {
+                telemetryStrings.push_back(dynamicLabels->add(layout, label));
+            }
+            else
+            {
+                // use the same layout technique as the DynamicLabels being compared against
+                auto text = vsg::Text::create();
+                if (dynamicTechnique == DynamicLabels::GPU_LAYOUT)
+                    text->technique = vsg::GpuLayoutTechnique::create();
+                else
+                    text->technique = vsg::CpuLayoutTechnique::create();
+                text->text = vsg::stringValue::create(label);
+                text->font = font;
+                text->layout = layout;
+                text->setup(dynamicCapacity, options);
+                scenegraph->addChild(text);
+
+                telemetryStrings.push_back(text->text.cast<vsg::stringValue>());
+                telemetryTexts.push_back(text);
+            }
+        }
+
+        if (dynamicLabels)
+        {
+            auto subgraph = dynamicLabels->createSubgraph(options);
+            if (!subgraph)
+            {
+                std::cout << "Failed to create DynamicLabels subgraph." << std::endl;
+                return 1;
+            }
+            scenegraph->addChild(subgraph);
+        }
+    }
+    else if (render_all_glyphs)
     {
         auto layout = vsg::StandardLayout::create();
         layout->position = vsg::vec3(0.0, 0.0, 0.0);
@@ -588,6 +650,10 @@ int main(int argc, char** argv)
     auto camera = vsg::Camera::create(perspective, lookAt, viewport);
 
     auto commandGraph = vsg::createCommandGraphForView(window, camera, scenegraph);
+
+    // CPU_LAYOUT DynamicLabels copy their changed glyph quads ahead of the RenderGraph
+    if (dynamicLabels && dynamicLabels->upload) commandGraph->children.insert(commandGraph->children.begin(), dynamicLabels->upload);
+
     viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
     // compile the Vulkan objects
@@ -599,9 +665,42 @@ int main(int argc, char** argv)
     // assign a CloseHandler to the Viewer to respond to pressing Escape or the window close button
     viewer->addEventHandlers({vsg::CloseHandler::create(viewer)});
 
+    auto startTime = vsg::clock::now();
+    double numFramesCompleted = 0.0;
+    double nextTelemetryUpdate = 0.0;
+    double rebuildTime = 0.0;
+    uint64_t numRebuilds = 0;
+
     // main frame loop
     while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
     {
+        double simulationTime = viewer->getFrameStamp()->simulationTime;
+        if (!telemetryStrings.empty() && simulationTime >= nextTelemetryUpdate)
+        {
+            nextTelemetryUpdate = simulationTime + 1.0 / updateRate;
+
+            // only the trailing value changes, like a typical read-out
+            for (size_t i = 0; i < telemetryStrings.size(); ++i)
+            {
+                telemetryStrings[i]->value() = vsg::make_string("sensor ", i, " : ", std::round(1000.0 * sin(simulationTime + 0.01 * static_cast<double>(i))) * 0.1);
+            }
+
+            if (dynamicLabels)
+            {
+                dynamicLabels->update();
+            }
+            else
+            {
+                auto rebuildStartTime = vsg::clock::now();
+                for (auto& text : telemetryTexts) text->setup(0, options);
+                rebuildTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - rebuildStartTime).count();
+                ++numRebuilds;
+            }
+        }
+
+        // pack this frame's copies, or clear the last frame's when no labels have changed
+        if (dynamicLabels && dynamicLabels->upload) dynamicLabels->upload->update();
+
         if (dynamic_text)
         {
             // update the dynamic_text label string and position
@@ -618,6 +717,16 @@ int main(int argc, char** argv)
         viewer->recordAndSubmit();
 
         viewer->present();
+
+        numFramesCompleted += 1.0;
+    }
+
+    auto duration = std::chrono::duration<double, std::chrono::seconds::period>(vsg::clock::now() - startTime).count();
+    if (numDynamicLabels > 0 && numFramesCompleted > 0.0)
+    {
+        std::cout << "Average frame rate = " << (numFramesCompleted / duration) << std::endl;
+        if (dynamicLabels) dynamicLabels->report(std::cout);
+        if (numRebuilds > 0) std::cout << "vsg::Text::setup() rebuild of " << telemetryTexts.size() << " labels, updates = " << numRebuilds << ", average update time = " << (rebuildTime / static_cast<double>(numRebuilds)) << "ms" << std::endl;
     }
 
     // clean up done automatically thanks to ref_ptr<>
@@ -0,0 +1,206 @@
+#include "LabelLayout.h"
+
+#include "ParallelFor.h"
+
+#include <algorithm>
+
+namespace
+{
+    template<typename T>
+    void append(std::string& key, const T& value)
+    {
+        key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void prepareLabels(vsg::TextGroup::Children::iterator begin, vsg::TextGroup::Children::iterator end)
+    {
+        for (auto itr = begin; itr != end; ++itr)
+        {
+            auto& text = *itr;
+            if (auto labelLayout = text->layout.cast<LabelLayout>(); labelLayout && text->text && text->font)
+            {
+                labelLayout->prepare(text->text.get(), *(text->font));
+            }
+        }
+    }
+} // namespace
+
+std::shared_ptr<const LabelLayoutCache::Entry> LabelLayoutCache::find(const std::string& key)
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    auto itr = _entries.find(key);
+    if (itr == _entries.end())
+    {
+        ++numMisses;
+        return {};
+    }
+
+    ++numHits;
+    return itr->second;
+}
+
+std::shared_ptr<const LabelLayoutCache::Entry> LabelLayoutCache::insert(const std::string& key, std::shared_ptr<const Entry> entry)
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    return _entries.emplace(key, entry).first->second;
+}
+
+void LabelLayoutCache::clear()
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    _entries.clear();
+    numHits = 0;
+    numMisses = 0;
+}
+
+size_t LabelLayoutCache::memoryUsage() const
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    size_t size = 0;
+    for (auto& [key, entry] : _entries)
+    {
+        size += key.capacity() + sizeof(Entry) + entry->quads.capacity() * sizeof(vsg::TextQuad);
+    }
+    return size;
+}
+
+void LabelLayoutCache::report(std::ostream& out) const
+{
+    size_t memory = memoryUsage();
+    std::scoped_lock<std::mutex> lock(_mutex);
+    out << "LabelLayoutCache entries = " << _entries.size() << ", hits = " << numHits << ", misses = " << numMisses << ", memory = " << (static_cast<double>(memory) / 1024.0) << "KB" << std::endl;
+}
+
+LabelLayout::LabelLayout(vsg::ref_ptr<LabelLayoutCache> in_cache) :
+    cache(in_cache)
+{
+}
+
+bool LabelLayout::_key(const vsg::Data* text, const vsg::Font& font, std::string& key) const
+{
+    // only the parameters that shape the quads go in the key, position is applied as a translation
+    append(key, &font);
+    append(key, glyphLayout);
+    append(key, horizontalAlignment);
+    append(key, verticalAlignment);
+    append(key, horizontal);
+    append(key, vertical);
+    append(key, color);
+    append(key, outlineColor);
+    append(key, outlineWidth);
+    append(key, billboard);
+    append(key, billboardAutoScaleDistance);
+
+    if (auto str = dynamic_cast<const vsg::stringValue*>(text))
+    {
+        key.push_back('s');
+        key.append(str->value());
+    }
+    else if (auto wstr = dynamic_cast<const vsg::wstringValue*>(text))
+    {
+        key.push_back('w');
+        key.append(reinterpret_cast<const char*>(wstr->value().data()), wstr->value().size() * sizeof(wchar_t));
+    }
+    else if (dynamic_cast<const vsg::uintArray*>(text) || dynamic_cast<const vsg::ubyteArray*>(text))
+    {
+        key.push_back('a');
+        key.append(static_cast<const char*>(text->dataPointer()), text->dataSize());
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+void LabelLayout::_layout(const vsg::Data* text, const vsg::Font& font, vsg::TextQuads& quads)
+{
+    std::string key;
+    if (!cache || !_key(text, font, key))
+    {
+        Inherit::layout(text, font, quads);
+        return;
+    }
+
+    auto entry = cache->find(key);
+    if (!entry)
+    {
+        auto newEntry = std::make_shared<LabelLayoutCache::Entry>();
+        newEntry->position = position;
+        Inherit::layout(text, font, newEntry->quads);
+
+        // lay out again at an offset to find which of the quad's fields the position is baked into, so hits can be translated rather than relaid
+        if (!newEntry->quads.empty())
+        {
+            vsg::TextQuads probe;
+            vsg::vec3 original = position;
+            position += vsg::vec3(1.0f, 1.0f, 1.0f);
+            Inherit::layout(text, font, probe);
+            position = original;
+
+            if (probe.size() == newEntry->quads.size())
+            {
+                newEntry->translateVertices = probe.front().vertices[0] != newEntry->quads.front().vertices[0];
+                newEntry->translateCenter = probe.front().centerAndAutoScaleDistance != newEntry->quads.front().centerAndAutoScaleDistance;
+            }
+        }
+
+        entry = cache->insert(key, newEntry);
+    }
+
+    size_t start = quads.size();
+    quads.insert(quads.end(), entry->quads.begin(), entry->quads.end());
+
+    vsg::vec3 delta = position - entry->position;
+    if (delta == vsg::vec3(0.0f, 0.0f, 0.0f)) return;
+
+    for (size_t qi = start; qi < quads.size(); ++qi)
+    {
+        auto& quad = quads[qi];
+        if (entry->translateVertices)
+        {
+            for (auto& vertex : quad.vertices) vertex += delta;
+        }
+        if (entry->translateCenter)
+        {
+            quad.centerAndAutoScaleDistance.x += delta.x;
+            quad.centerAndAutoScaleDistance.y += delta.y;
+            quad.centerAndAutoScaleDistance.z += delta.z;
+        }
+    }
+}
+
+void LabelLayout::layout(const vsg::Data* text, const vsg::Font& font, vsg::TextQuads& quads)
+{
+    if (text == _preparedText && &font == _preparedFont)
+    {
+        quads.insert(quads.end(), _prepared.begin(), _prepared.end());
+
+        // the prepared quads are now held by the caller, so release ours
+        _prepared = {};
+        _preparedText = nullptr;
+        _preparedFont = nullptr;
+        return;
+    }
+
+    _layout(text, font, quads);
+}
+
+void LabelLayout::prepare(const vsg::Data* text, const vsg::Font& font)
+{
+    _prepared.clear();
+    _layout(text, font, _prepared);
+    _preparedText = text;
+    _preparedFont = &font;
+}
+
+void setupTextGroup(vsg::TextGroup& textgroup, vsg::ref_ptr<vsg::OperationThreads> operationThreads, vsg::ref_ptr<const vsg::Options> options, uint32_t labelsPerOperation)
+{
+    auto& children = textgroup.children;
+    parallelFor(operationThreads, children.size(), labelsPerOperation, [&children](size_t begin, size_t end) {
+        prepareLabels(children.begin() + begin, children.begin() + end);
+    });
+
+    // the quads are now prepared so setup only has to copy them into the vertex arrays
+    textgroup.setup(0, options);
+}
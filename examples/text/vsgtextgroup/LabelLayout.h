@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+
+/// LabelLayoutCache shares the glyph quads of labels that have the same font, string and layout parameters, so a scene of many
+/// repeated labels only runs the glyph layout once per distinct label and translates the cached quads to each label's position.
+class LabelLayoutCache : public vsg::Inherit<vsg::Object, LabelLayoutCache>
+{
+public:
+    struct Entry
+    {
+        vsg::TextQuads quads;
+        vsg::vec3 position;             // position the quads were laid out at
+        bool translateVertices = false; // vertices include the position, true for non billboard text
+        bool translateCenter = false;   // centerAndAutoScaleDistance includes the position, true for billboard text
+    };
+
+    /// return the entry for key, or an empty pointer if it hasn't been laid out yet
+    std::shared_ptr<const Entry> find(const std::string& key);
+
+    /// add an entry, if another thread got there first its entry is kept and returned
+    std::shared_ptr<const Entry> insert(const std::string& key, std::shared_ptr<const Entry> entry);
+
+    void clear();
+
+    /// approximate memory held by the cached quads and keys
+    size_t memoryUsage() const;
+
+    void report(std::ostream& out) const;
+
+    // stats
+    uint64_t numHits = 0;
+    uint64_t numMisses = 0;
+
+protected:
+    mutable std::mutex _mutex;
+    std::unordered_map<std::string, std::shared_ptr<const Entry>> _entries;
+};
+
+/// LabelLayout is a StandardLayout that can look its quads up in a LabelLayoutCache, and can be laid out ahead of TextGroup::setup() by prepare()
+/// so the layout of large numbers of labels can be spread across threads, leaving setup() to just copy the prepared quads into the TextGroup's arrays.
+class LabelLayout : public vsg::Inherit<vsg::StandardLayout, LabelLayout>
+{
+public:
+    explicit LabelLayout(vsg::ref_ptr<LabelLayoutCache> in_cache = {});
+
+    vsg::ref_ptr<LabelLayoutCache> cache;
+
+    void layout(const vsg::Data* text, const vsg::Font& font, vsg::TextQuads& quads) override;
+
+    /// lay out text ahead of time, the result is consumed by the next layout() call for the same text and font.
+    void prepare(const vsg::Data* text, const vsg::Font& font);
+
+    /// approximate memory held by prepared quads that haven't been consumed yet
+    size_t memoryUsage() const { return _prepared.capacity() * sizeof(vsg::TextQuad); }
+
+protected:
+    void _layout(const vsg::Data* text, const vsg::Font& font, vsg::TextQuads& quads);
+    bool _key(const vsg::Data* text, const vsg::Font& font, std::string& key) const;
+
+    vsg::TextQuads _prepared;
+    const vsg::Data* _preparedText = nullptr;
+    const vsg::Font* _preparedFont = nullptr;
+};
+
+/// prepare the LabelLayout of each of the textgroup's children across operationThreads and then call TextGroup::setup(),
+/// children with other layouts are laid out by setup() as usual. Falls back to a serial prepare when operationThreads is null.
+void setupTextGroup(vsg::TextGroup& textgroup, vsg::ref_ptr<vsg::OperationThreads> operationThreads, vsg::ref_ptr<const vsg::Options> options, uint32_t labelsPerOperation = 1024);
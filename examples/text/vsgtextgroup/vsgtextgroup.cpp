@@ -1,10 +1,30 @@
 #include <iostream>
 #include <vsg/all.h>
 
+#include "LabelLayout.h"
+
+#if defined(__linux__)
+#    include <fstream>
+#    include <unistd.h>
+#endif
+
 #ifdef vsgXchange_FOUND
 #    include <vsgXchange/all.h>
 #endif
 
+// resident memory of the process in bytes, or 0 where it isn't available
+size_t residentMemory()
+{
+#if defined(__linux__)
+    std::ifstream statm("/proc/self/statm");
+    size_t size = 0, resident = 0;
+    statm >> size >> resident;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+    return 0;
+#endif
+}
+
 int main(int argc, char** argv)
 {
     // set up defaults and read command line arguments to override them
@@ -28,6 +48,10 @@ int main(int argc, char** argv)
     bool billboard = arguments.read({"-b", "--billboard"});
     bool disableDepthTest = arguments.read({"--ddt", "--disable-depth-test"});
     float billboardAutoScaleDistance = arguments.value(100.0f, "--distance");
+    bool useCache = arguments.read("--cache");
+    auto numLayoutThreads = arguments.value<uint32_t>(0, "--lt");
+    auto labelsPerOperation = arguments.value<uint32_t>(1024, "--labels-per-operation");
+    auto benchmarkLabels = arguments.value<uint32_t>(0, "--benchmark");
 
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
@@ -57,258 +81,329 @@ int main(int argc, char** argv)
         shaderSet->defaultGraphicsPipelineStates.push_back(depthStencilState);
     }
 
-    // set up text group
-    auto textgroup = vsg::TextGroup::create();
+    // create a TextGroup containing numLabels labels, the StandardLayouts are replaced by LabelLayouts when a cache or layout threads are used
+    auto createTextGroup = [&](uint32_t numLabels, vsg::ref_ptr<LabelLayoutCache> cache, bool labelLayouts) {
+        auto createLayout = [&]() -> vsg::ref_ptr<vsg::StandardLayout> {
+            if (labelLayouts || cache) return LabelLayout::create(cache);
+            return vsg::StandardLayout::create();
+        };
 
-    double numBlocks = ceil(static_cast<double>(numLabels) / 10.0);
-    uint32_t numColumns = static_cast<uint32_t>(ceil(sqrt(numBlocks)));
-    uint32_t numRows = static_cast<uint32_t>(ceil(static_cast<double>(numBlocks) / static_cast<double>(numColumns)));
-    float size = 1.0f;
+        auto textgroup = vsg::TextGroup::create();
 
-    vsg::vec3 row_origin(0.0f, 0.0f, 0.0f);
-    vsg::vec3 dx(20.0f, 0.0f, 0.0f);
-    vsg::vec3 dy(0.0f, 20.0f, 0.0f);
-    vsg::vec3 horizontal = vsg::vec3(size, 0.0, 0.0);
-    vsg::vec3 vertical = billboard ? vsg::vec3(0.0, size, 0.0) : vsg::vec3(0.0, 0.0, size);
+        double numBlocks = ceil(static_cast<double>(numLabels) / 10.0);
+        uint32_t numColumns = static_cast<uint32_t>(ceil(sqrt(numBlocks)));
+        uint32_t numRows = static_cast<uint32_t>(ceil(static_cast<double>(numBlocks) / static_cast<double>(numColumns)));
+        float size = 1.0f;
 
-    for (uint32_t r = 0; r < numRows; ++r)
-    {
-        vsg::vec3 local_origin = row_origin;
-        for (uint32_t c = 0; c < numColumns; ++c)
-        {
-
-            if (textgroup->children.size() < numLabels)
-            {
-                auto layout = vsg::StandardLayout::create();
-                layout->horizontalAlignment = vsg::StandardLayout::CENTER_ALIGNMENT;
-                //layout->verticalAlignment = vsg::StandardLayout::CENTER_ALIGNMENT;
-                layout->position = local_origin + vsg::vec3(6.0, 0.0, 0.0);
-                layout->horizontal = horizontal;
-                layout->vertical = vertical;
-                layout->color = vsg::vec4(1.0, 1.0, 1.0, 1.0);
-                layout->outlineWidth = 0.1f;
-                layout->billboard = billboard;
-                layout->billboardAutoScaleDistance = billboardAutoScaleDistance;
-
-                auto text = vsg::Text::create();
-                text->text = vsg::stringValue::create("VulkanSceneGraph now\nhas SDF text support.");
-                text->font = font;
-                text->layout = layout;
-                textgroup->addChild(text);
-            }
+        vsg::vec3 row_origin(0.0f, 0.0f, 0.0f);
+        vsg::vec3 dx(20.0f, 0.0f, 0.0f);
+        vsg::vec3 dy(0.0f, 20.0f, 0.0f);
+        vsg::vec3 horizontal = vsg::vec3(size, 0.0, 0.0);
+        vsg::vec3 vertical = billboard ? vsg::vec3(0.0, size, 0.0) : vsg::vec3(0.0, 0.0, size);
 
-            if (textgroup->children.size() < numLabels)
+        for (uint32_t r = 0; r < numRows; ++r)
+        {
+            vsg::vec3 local_origin = row_origin;
+            for (uint32_t c = 0; c < numColumns; ++c)
             {
-                auto layout = vsg::StandardLayout::create();
-                layout->glyphLayout = vsg::StandardLayout::VERTICAL_LAYOUT;
-                layout->position = local_origin + vsg::vec3(-1.0, 0.0, 2.0);
-                layout->horizontal = horizontal * 0.5f;
-                layout->vertical = vertical * 0.5f;
-                layout->color = vsg::vec4(1.0, 0.0, 0.0, 1.0);
-                layout->billboard = billboard;
-                layout->billboardAutoScaleDistance = billboardAutoScaleDistance;
-
-                auto text = vsg::Text::create();
-                text->text = vsg::stringValue::create("VERTICAL_LAYOUT");
-                text->font = font;
-                text->layout = layout;
-                textgroup->addChild(text);
-            }
 
-            if (textgroup->children.size() < numLabels)
-            {
-                auto layout = vsg::StandardLayout::create();
-                layout->glyphLayout = vsg::StandardLayout::LEFT_TO_RIGHT_LAYOUT;
-                layout->position = local_origin + vsg::vec3(-1.0, 0.0, 2.0);
-                layout->horizontal = horizontal * 0.5f;
-                layout->vertical = vertical * 0.5f;
-                layout->color = vsg::vec4(0.0, 1.0, 0.0, 1.0);
-                layout->billboard = billboard;
-                layout->billboardAutoScaleDistance = billboardAutoScaleDistance;
-
-                auto text = vsg::Text::create();
-                text->text = vsg::stringValue::create("LEFT_TO_RIGHT_LAYOUT");
-                text->font = font;
-                text->layout = layout;
-                textgroup->addChild(text);
-            }
+                if (textgroup->children.size() < numLabels)
+                {
+                    auto layout = createLayout();
+                    layout->horizontalAlignment = vsg::StandardLayout::CENTER_ALIGNMENT;
+                    //layout->verticalAlignment = vsg::StandardLayout::CENTER_ALIGNMENT;
+                    layout->position = local_origin + vsg::vec3(6.0, 0.0, 0.0);
+                    layout->horizontal = horizontal;
+                    layout->vertical = vertical;
+                    layout->color = vsg::vec4(1.0, 1.0, 1.0, 1.0);
+                    layout->outlineWidth = 0.1f;
+                    layout->billboard = billboard;
+                    layout->billboardAutoScaleDistance = billboardAutoScaleDistance;
+
+                    auto text = vsg::Text::create();
+                    text->text = vsg::stringValue::create("VulkanSceneGraph now\nhas SDF text support.");
+                    text->font = font;
+                    text->layout = layout;
+                    textgroup->addChild(text);
+                }
+
+                if (textgroup->children.size() < numLabels)
+                {
+                    auto layout = createLayout();
+                    layout->glyphLayout = vsg::StandardLayout::VERTICAL_LAYOUT;
+                    layout->position = local_origin + vsg::vec3(-1.0, 0.0, 2.0);
+                    layout->horizontal = horizontal * 0.5f;
+                    layout->vertical = vertical * 0.5f;
+                    layout->color = vsg::vec4(1.0, 0.0, 0.0, 1.0);
+                    layout->billboard = billboard;
+                    layout->billboardAutoScaleDistance = billboardAutoScaleDistance;
+
+                    auto text = vsg::Text::create();
+                    text->text = vsg::stringValue::create("VERTICAL_LAYOUT");
+                    text->font = font;
+                    text->layout = layout;
+                    textgroup->addChild(text);
+                }
+
+                if (textgroup->children.size() < numLabels)
+                {
+                    auto layout = createLayout();
+                    layout->glyphLayout = vsg::StandardLayout::LEFT_TO_RIGHT_LAYOUT;
+                    layout->position = local_origin + vsg::vec3(-1.0, 0.0, 2.0);
+                    layout->horizontal = horizontal * 0.5f;
+                    layout->vertical = vertical * 0.5f;
+                    layout->color = vsg::vec4(0.0, 1.0, 0.0, 1.0);
+                    layout->billboard = billboard;
+                    layout->billboardAutoScaleDistance = billboardAutoScaleDistance;
+
+                    auto text = vsg::Text::create();
+                    text->text = vsg::stringValue::create("LEFT_TO_RIGHT_LAYOUT");
+                    text->font = font;
+                    text->layout = layout;
+                    textgroup->addChild(text);
+                }
+
+                if (textgroup->children.size() < numLabels)
+                {
+                    auto layout = createLayout();
+                    layout->glyphLayout = vsg::StandardLayout::RIGHT_TO_LEFT_LAYOUT;
+                    layout->position = local_origin + vsg::vec3(13.0, 0.0, 2.0);
+                    layout->horizontal = horizontal * 0.5f;
+                    layout->vertical = vertical * 0.5f;
+                    layout->color = vsg::vec4(0.0, 0.0, 1.0, 1.0);
+                    layout->billboard = billboard;
+                    layout->billboardAutoScaleDistance = billboardAutoScaleDistance;
+
+                    auto text = vsg::Text::create();
+                    text->text = vsg::stringValue::create("RIGHT_TO_LEFT_LAYOUT");
+                    text->font = font;
+                    text->layout = layout;
+                    textgroup->addChild(text);
+                }
+
+                if (textgroup->children.size() < numLabels)
+                {
+                    auto layout = createLayout();
+                    layout->horizontalAlignment = vsg::StandardLayout::CENTER_ALIGNMENT;
+                    layout->position = local_origin + vsg::vec3(2.0, 0.0, -8.0);
+                    layout->horizontal = horizontal * 0.5f;
+                    layout->vertical = vertical * 0.5f;
+                    layout->color = vsg::vec4(1.0, 0.0, 1.0, 1.0);
+                    layout->billboard = billboard;
+                    layout->billboardAutoScaleDistance = billboardAutoScaleDistance;
+
+                    auto text = vsg::Text::create();
+                    text->text = vsg::stringValue::create("horizontalAlignment\nCENTER_ALIGNMENT");
+                    text->font = font;
+                    text->layout = layout;
+                    textgroup->addChild(text);
+                }
+
+                if (textgroup->children.size() < numLabels)
+                {
+                    auto layout = createLayout();
+                    layout->horizontalAlignment = vsg::StandardLayout::LEFT_ALIGNMENT;
+                    layout->position = local_origin + vsg::vec3(2.0, 0.0, -9.0);
+                    layout->horizontal = horizontal * 0.5f;
+                    layout->vertical = vertical * 0.5f;
+                    layout->color = vsg::vec4(1.0, 1.0, 0.0, 1.0);
+                    layout->billboard = billboard;
+                    layout->billboardAutoScaleDistance = billboardAutoScaleDistance;
+
+                    auto text = vsg::Text::create();
+                    text->text = vsg::stringValue::create("horizontalAlignment\nLEFT_ALIGNMENT");
+                    text->font = font;
+                    text->layout = layout;
+                    textgroup->addChild(text);
+                }
+
+                if (textgroup->children.size() < numLabels)
+                {
+                    auto layout = createLayout();
+                    layout->horizontalAlignment = vsg::StandardLayout::RIGHT_ALIGNMENT;
+                    layout->position = local_origin + vsg::vec3(2.0, 0.0, -10.0);
+                    layout->horizontal = horizontal * 0.5f;
+                    layout->vertical = vertical * 0.5f;
+                    layout->color = vsg::vec4(0.0, 1.0, 1.0, 1.0);
+                    layout->billboard = billboard;
+                    layout->billboardAutoScaleDistance = billboardAutoScaleDistance;
+
+                    auto text = vsg::Text::create();
+                    text->text = vsg::stringValue::create("horizontalAlignment\nRIGHT_ALIGNMENT");
+                    text->font = font;
+                    text->layout = layout;
+                    textgroup->addChild(text);
+                }
+
+                if (textgroup->children.size() < numLabels)
+                {
+                    auto layout = createLayout();
+                    layout->horizontalAlignment = vsg::StandardLayout::CENTER_ALIGNMENT;
+                    layout->verticalAlignment = vsg::StandardLayout::BOTTOM_ALIGNMENT;
+                    layout->position = local_origin + vsg::vec3(10.0, 0.0, -8.5);
+                    layout->horizontal = horizontal * 0.5f;
+                    layout->vertical = vertical * 0.5f;
+                    layout->color = vsg::vec4(0.0, 1.0, 1.0, 1.0);
+                    layout->billboard = billboard;
+                    layout->billboardAutoScaleDistance = billboardAutoScaleDistance;
+
+                    auto text = vsg::Text::create();
+                    text->text = vsg::stringValue::create("verticalAlignment\nBOTTOM_ALIGNMENT");
+                    text->font = font;
+                    text->layout = layout;
+                    textgroup->addChild(text);
+                }
+
+                if (textgroup->children.size() < numLabels)
+                {
+                    auto layout = createLayout();
+                    layout->horizontalAlignment = vsg::StandardLayout::CENTER_ALIGNMENT;
+                    layout->verticalAlignment = vsg::StandardLayout::CENTER_ALIGNMENT;
+                    layout->position = local_origin + vsg::vec3(10.0, 0.0, -9.0);
+                    layout->horizontal = horizontal * 0.5f;
+                    layout->vertical = vertical * 0.5f;
+                    layout->color = vsg::vec4(1.0, 0.0, 1.0, 1.0);
+                    layout->billboard = billboard;
+                    layout->billboardAutoScaleDistance = billboardAutoScaleDistance;
+
+                    auto text = vsg::Text::create();
+                    text->text = vsg::stringValue::create("verticalAlignment\nCENTER_ALIGNMENT");
+                    text->font = font;
+                    text->layout = layout;
+                    textgroup->addChild(text);
+                }
+
+                if (textgroup->children.size() < numLabels)
+                {
+                    auto layout = createLayout();
+                    layout->horizontalAlignment = vsg::StandardLayout::CENTER_ALIGNMENT;
+                    layout->verticalAlignment = vsg::StandardLayout::TOP_ALIGNMENT;
+                    layout->position = local_origin + vsg::vec3(10.0, 0.0, -9.5);
+                    layout->horizontal = horizontal * 0.5f;
+                    layout->vertical = vertical * 0.5f;
+                    layout->color = vsg::vec4(1.0, 1.0, 0.0, 1.0);
+                    layout->billboard = billboard;
+                    layout->billboardAutoScaleDistance = billboardAutoScaleDistance;
+
+                    auto text = vsg::Text::create();
+                    text->text = vsg::stringValue::create("verticalAlignment\nTOP_ALIGNMENT");
+                    text->font = font;
+                    text->layout = layout;
+                    textgroup->addChild(text);
+                }
+
+                if (textgroup->children.size() < numLabels && output_filename.empty())
+                {
+                    struct CustomLayout : public vsg::Inherit<vsg::StandardLayout, CustomLayout>
+                    {
+                        void layout(const vsg::Data* text, const vsg::Font& font, vsg::TextQuads& quads) override
+                        {
+                            // Let the base StandardLayout class do the basic glyph setup
+                            size_t start_of_text = quads.size();
 
-            if (textgroup->children.size() < numLabels)
-            {
-                auto layout = vsg::StandardLayout::create();
-                layout->glyphLayout = vsg::StandardLayout::RIGHT_TO_LEFT_LAYOUT;
-                layout->position = local_origin + vsg::vec3(13.0, 0.0, 2.0);
-                layout->horizontal = horizontal * 0.5f;
-                layout->vertical = vertical * 0.5f;
-                layout->color = vsg::vec4(0.0, 0.0, 1.0, 1.0);
-                layout->billboard = billboard;
-                layout->billboardAutoScaleDistance = billboardAutoScaleDistance;
-
-                auto text = vsg::Text::create();
-                text->text = vsg::stringValue::create("RIGHT_TO_LEFT_LAYOUT");
-                text->font = font;
-                text->layout = layout;
-                textgroup->addChild(text);
-            }
+                            Inherit::layout(text, font, quads);
 
-            if (textgroup->children.size() < numLabels)
-            {
-                auto layout = vsg::StandardLayout::create();
-                layout->horizontalAlignment = vsg::StandardLayout::CENTER_ALIGNMENT;
-                layout->position = local_origin + vsg::vec3(2.0, 0.0, -8.0);
-                layout->horizontal = horizontal * 0.5f;
-                layout->vertical = vertical * 0.5f;
-                layout->color = vsg::vec4(1.0, 0.0, 1.0, 1.0);
-                layout->billboard = billboard;
-                layout->billboardAutoScaleDistance = billboardAutoScaleDistance;
-
-                auto text = vsg::Text::create();
-                text->text = vsg::stringValue::create("horizontalAlignment\nCENTER_ALIGNMENT");
-                text->font = font;
-                text->layout = layout;
-                textgroup->addChild(text);
-            }
+                            // modify each generated glyph quad's position and colours etc.
+                            for (size_t qi = start_of_text; qi < quads.size(); ++qi)
+                            {
+                                auto& quad = quads[qi];
+                                for (int i = 0; i < 4; ++i)
+                                {
+                                    quad.vertices[i].z += 0.5f * sin(quad.vertices[i].x);
+                                    quad.colors[i].r = 0.5f + 0.5f * sin(quad.vertices[i].x);
+                                    quad.outlineColors[i] = vsg::vec4(cos(0.5f * quad.vertices[i].x), 0.1f, 0.0f, 1.0f);
+                                    quad.outlineWidths[i] = 0.1f + 0.15f * (1.0f + sin(quad.vertices[i].x));
+                                }
+                            }
+                        };
+                    };
 
-            if (textgroup->children.size() < numLabels)
-            {
-                auto layout = vsg::StandardLayout::create();
-                layout->horizontalAlignment = vsg::StandardLayout::LEFT_ALIGNMENT;
-                layout->position = local_origin + vsg::vec3(2.0, 0.0, -9.0);
-                layout->horizontal = horizontal * 0.5f;
-                layout->vertical = vertical * 0.5f;
-                layout->color = vsg::vec4(1.0, 1.0, 0.0, 1.0);
-                layout->billboard = billboard;
-                layout->billboardAutoScaleDistance = billboardAutoScaleDistance;
-
-                auto text = vsg::Text::create();
-                text->text = vsg::stringValue::create("horizontalAlignment\nLEFT_ALIGNMENT");
-                text->font = font;
-                text->layout = layout;
-                textgroup->addChild(text);
+                    auto layout = CustomLayout::create();
+                    layout->position = local_origin + vsg::vec3(0.0, 0.0, -3.0);
+                    layout->horizontal = horizontal;
+                    layout->vertical = vertical;
+                    layout->color = vsg::vec4(1.0, 0.5, 1.0, 1.0);
+                    layout->billboard = billboard;
+                    layout->billboardAutoScaleDistance = billboardAutoScaleDistance;
+
+                    auto text = vsg::Text::create();
+                    text->text = vsg::stringValue::create("You can use Outlines\nand your own CustomLayout.");
+                    text->font = font;
+                    text->layout = layout;
+                    textgroup->addChild(text);
+                }
+
+                local_origin += dx;
             }
+            row_origin += dy;
+        }
 
-            if (textgroup->children.size() < numLabels)
-            {
-                auto layout = vsg::StandardLayout::create();
-                layout->horizontalAlignment = vsg::StandardLayout::RIGHT_ALIGNMENT;
-                layout->position = local_origin + vsg::vec3(2.0, 0.0, -10.0);
-                layout->horizontal = horizontal * 0.5f;
-                layout->vertical = vertical * 0.5f;
-                layout->color = vsg::vec4(0.0, 1.0, 1.0, 1.0);
-                layout->billboard = billboard;
-                layout->billboardAutoScaleDistance = billboardAutoScaleDistance;
-
-                auto text = vsg::Text::create();
-                text->text = vsg::stringValue::create("horizontalAlignment\nRIGHT_ALIGNMENT");
-                text->font = font;
-                text->layout = layout;
-                textgroup->addChild(text);
-            }
+        return textgroup;
+    };
 
-            if (textgroup->children.size() < numLabels)
-            {
-                auto layout = vsg::StandardLayout::create();
-                layout->horizontalAlignment = vsg::StandardLayout::CENTER_ALIGNMENT;
-                layout->verticalAlignment = vsg::StandardLayout::BOTTOM_ALIGNMENT;
-                layout->position = local_origin + vsg::vec3(10.0, 0.0, -8.5);
-                layout->horizontal = horizontal * 0.5f;
-                layout->vertical = vertical * 0.5f;
-                layout->color = vsg::vec4(0.0, 1.0, 1.0, 1.0);
-                layout->billboard = billboard;
-                layout->billboardAutoScaleDistance = billboardAutoScaleDistance;
-
-                auto text = vsg::Text::create();
-                text->text = vsg::stringValue::create("verticalAlignment\nBOTTOM_ALIGNMENT");
-                text->font = font;
-                text->layout = layout;
-                textgroup->addChild(text);
-            }
+    if (benchmarkLabels > 0)
+    {
+        // compare the setup of increasing numbers of labels with plain StandardLayouts, the LabelLayoutCache and parallel layout
+        uint32_t numThreads = numLayoutThreads > 0 ? numLayoutThreads : std::max(1u, std::thread::hardware_concurrency());
+        auto operationThreads = vsg::OperationThreads::create(numThreads - 1);
 
-            if (textgroup->children.size() < numLabels)
+        struct Mode
+        {
+            std::string name;
+            bool cache;
+            bool parallel;
+        };
+        std::vector<Mode> modes{{"StandardLayout", false, false}, {"LabelLayoutCache", true, false}, {vsg::make_string("parallel x", numThreads), false, true}, {vsg::make_string("cache + parallel x", numThreads), true, true}};
+
+        std::cout << "labels, mode, create (ms), setup (ms), total (ms), cache (KB), resident delta (MB)" << std::endl;
+        for (uint32_t count = std::min(1000u, benchmarkLabels);; count = std::min(count * 10, benchmarkLabels))
+        {
+            for (auto& mode : modes)
             {
-                auto layout = vsg::StandardLayout::create();
-                layout->horizontalAlignment = vsg::StandardLayout::CENTER_ALIGNMENT;
-                layout->verticalAlignment = vsg::StandardLayout::CENTER_ALIGNMENT;
-                layout->position = local_origin + vsg::vec3(10.0, 0.0, -9.0);
-                layout->horizontal = horizontal * 0.5f;
-                layout->vertical = vertical * 0.5f;
-                layout->color = vsg::vec4(1.0, 0.0, 1.0, 1.0);
-                layout->billboard = billboard;
-                layout->billboardAutoScaleDistance = billboardAutoScaleDistance;
-
-                auto text = vsg::Text::create();
-                text->text = vsg::stringValue::create("verticalAlignment\nCENTER_ALIGNMENT");
-                text->font = font;
-                text->layout = layout;
-                textgroup->addChild(text);
-            }
+                size_t memoryBefore = residentMemory();
+                auto startTime = vsg::clock::now();
 
-            if (textgroup->children.size() < numLabels)
-            {
-                auto layout = vsg::StandardLayout::create();
-                layout->horizontalAlignment = vsg::StandardLayout::CENTER_ALIGNMENT;
-                layout->verticalAlignment = vsg::StandardLayout::TOP_ALIGNMENT;
-                layout->position = local_origin + vsg::vec3(10.0, 0.0, -9.5);
-                layout->horizontal = horizontal * 0.5f;
-                layout->vertical = vertical * 0.5f;
-                layout->color = vsg::vec4(1.0, 1.0, 0.0, 1.0);
-                layout->billboard = billboard;
-                layout->billboardAutoScaleDistance = billboardAutoScaleDistance;
-
-                auto text = vsg::Text::create();
-                text->text = vsg::stringValue::create("verticalAlignment\nTOP_ALIGNMENT");
-                text->font = font;
-                text->layout = layout;
-                textgroup->addChild(text);
-            }
+                auto cache = mode.cache ? LabelLayoutCache::create() : vsg::ref_ptr<LabelLayoutCache>();
+                auto textgroup = createTextGroup(count, cache, mode.parallel);
+                auto createdTime = vsg::clock::now();
 
-            if (textgroup->children.size() < numLabels && output_filename.empty())
-            {
-                struct CustomLayout : public vsg::Inherit<vsg::StandardLayout, CustomLayout>
-                {
-                    void layout(const vsg::Data* text, const vsg::Font& font, vsg::TextQuads& quads) override
-                    {
-                        // Let the base StandardLayout class do the basic glyph setup
-                        size_t start_of_text = quads.size();
+                if (mode.parallel)
+                    setupTextGroup(*textgroup, operationThreads, options, labelsPerOperation);
+                else
+                    textgroup->setup(0, options);
+                auto endTime = vsg::clock::now();
 
-                        Inherit::layout(text, font, quads);
+                double createMS = std::chrono::duration<double, std::chrono::milliseconds::period>(createdTime - startTime).count();
+                double setupMS = std::chrono::duration<double, std::chrono::milliseconds::period>(endTime - createdTime).count();
+                double cacheKB = cache ? static_cast<double>(cache->memoryUsage()) / 1024.0 : 0.0;
+                double residentMB = (static_cast<double>(residentMemory()) - static_cast<double>(memoryBefore)) / (1024.0 * 1024.0);
 
-                        // modify each generated glyph quad's position and colours etc.
-                        for (size_t qi = start_of_text; qi < quads.size(); ++qi)
-                        {
-                            auto& quad = quads[qi];
-                            for (int i = 0; i < 4; ++i)
-                            {
-                                quad.vertices[i].z += 0.5f * sin(quad.vertices[i].x);
-                                quad.colors[i].r = 0.5f + 0.5f * sin(quad.vertices[i].x);
-                                quad.outlineColors[i] = vsg::vec4(cos(0.5f * quad.vertices[i].x), 0.1f, 0.0f, 1.0f);
-                                quad.outlineWidths[i] = 0.1f + 0.15f * (1.0f + sin(quad.vertices[i].x));
-                            }
-                        }
-                    };
-                };
-
-                auto layout = CustomLayout::create();
-                layout->position = local_origin + vsg::vec3(0.0, 0.0, -3.0);
-                layout->horizontal = horizontal;
-                layout->vertical = vertical;
-                layout->color = vsg::vec4(1.0, 0.5, 1.0, 1.0);
-                layout->billboard = billboard;
-                layout->billboardAutoScaleDistance = billboardAutoScaleDistance;
-
-                auto text = vsg::Text::create();
-                text->text = vsg::stringValue::create("You can use Outlines\nand your own CustomLayout.");
-                text->font = font;
-                text->layout = layout;
-                textgroup->addChild(text);
+                std::cout << count << ", " << mode.name << ", " << createMS << ", " << setupMS << ", " << (createMS + setupMS) << ", " << cacheKB << ", " << residentMB << std::endl;
             }
 
-            local_origin += dx;
+            if (count >= benchmarkLabels) break;
         }
-        row_origin += dy;
+        return 0;
     }
 
-    textgroup->setup(0, options);
+    // LabelLayout isn't serializable so only use it when viewing
+    if (!output_filename.empty())
+    {
+        useCache = false;
+        numLayoutThreads = 0;
+    }
+
+    auto cache = useCache ? LabelLayoutCache::create() : vsg::ref_ptr<LabelLayoutCache>();
+    auto textgroup = createTextGroup(numLabels, cache, numLayoutThreads > 0);
+
+    auto setupStartTime = vsg::clock::now();
+    if (numLayoutThreads > 0)
+        setupTextGroup(*textgroup, vsg::OperationThreads::create(numLayoutThreads - 1), options, labelsPerOperation);
+    else
+        textgroup->setup(0, options);
+
+    std::cout << "TextGroup::setup() of " << textgroup->children.size() << " labels took " << std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - setupStartTime).count() << "ms" << std::endl;
+    if (cache) cache->report(std::cout);
 
     if (!output_filename.empty())
     {
@@ -0,0 +1,281 @@
+#include "StripedSharedObjects.h"
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+
+namespace
+{
+    void combine(size_t& seed, size_t value)
+    {
+        seed ^= value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+    }
+
+    // FNV-1a over the leading bytes, enough to spread distinct data across the stripes without hashing whole images
+    size_t hashBytes(const void* ptr, size_t size)
+    {
+        auto bytes = static_cast<const uint8_t*>(ptr);
+        size_t numBytes = bytes ? std::min(size, size_t(1024)) : 0;
+
+        uint64_t hash = 14695981039346656037ull ^ size;
+        for (size_t i = 0; i < numBytes; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return static_cast<size_t>(hash);
+    }
+
+    size_t hashData(const vsg::Data* data)
+    {
+        return data ? hashBytes(data->dataPointer(), data->dataSize()) : 0;
+    }
+
+    // the hashes below use the members that the objects' compare() uses, so objects that compare equal always land in the same stripe.
+    // Data referenced by the objects is hashed by value as compare() compares it by value, not by pointer.
+    size_t hashSampler(const vsg::Sampler* sampler)
+    {
+        if (!sampler) return 0;
+
+        size_t hash = 0;
+        for (auto value : {static_cast<uint32_t>(sampler->flags), static_cast<uint32_t>(sampler->magFilter), static_cast<uint32_t>(sampler->minFilter), static_cast<uint32_t>(sampler->mipmapMode),
+                           static_cast<uint32_t>(sampler->addressModeU), static_cast<uint32_t>(sampler->addressModeV), static_cast<uint32_t>(sampler->addressModeW),
+                           static_cast<uint32_t>(sampler->anisotropyEnable), static_cast<uint32_t>(sampler->compareEnable), static_cast<uint32_t>(sampler->compareOp),
+                           static_cast<uint32_t>(sampler->borderColor), static_cast<uint32_t>(sampler->unnormalizedCoordinates)})
+        {
+            combine(hash, value);
+        }
+        for (auto value : {sampler->mipLodBias, sampler->maxAnisotropy, sampler->minLod, sampler->maxLod}) combine(hash, std::hash<float>{}(value));
+        return hash;
+    }
+
+    size_t hashDescriptorSet(const vsg::DescriptorSet* descriptorSet)
+    {
+        if (!descriptorSet) return 0;
+
+        size_t hash = 0;
+        for (auto& descriptor : descriptorSet->descriptors)
+        {
+            combine(hash, descriptor->dstBinding);
+            combine(hash, descriptor->dstArrayElement);
+            combine(hash, static_cast<size_t>(descriptor->descriptorType));
+
+            if (auto descriptorImage = descriptor.cast<vsg::DescriptorImage>())
+            {
+                for (auto& imageInfo : descriptorImage->imageInfoList)
+                {
+                    combine(hash, hashSampler(imageInfo->sampler.get()));
+                    if (imageInfo->imageView && imageInfo->imageView->image) combine(hash, hashData(imageInfo->imageView->image->data.get()));
+                }
+            }
+            else if (auto descriptorBuffer = descriptor.cast<vsg::DescriptorBuffer>())
+            {
+                for (auto& bufferInfo : descriptorBuffer->bufferInfoList)
+                {
+                    if (bufferInfo) combine(hash, hashData(bufferInfo->data.get()));
+                }
+            }
+        }
+        return hash;
+    }
+
+    size_t hashGraphicsPipeline(const vsg::GraphicsPipeline* pipeline)
+    {
+        if (!pipeline) return 0;
+
+        size_t hash = pipeline->subpass;
+        for (auto& shaderStage : pipeline->stages)
+        {
+            combine(hash, static_cast<size_t>(shaderStage->stage));
+            combine(hash, std::hash<std::string>{}(shaderStage->entryPointName));
+            if (auto& module = shaderStage->module)
+            {
+                if (!module->code.empty())
+                    combine(hash, hashBytes(module->code.data(), module->code.size() * sizeof(uint32_t)));
+                else
+                    combine(hash, hashBytes(module->source.data(), module->source.size()));
+            }
+        }
+        combine(hash, pipeline->pipelineStates.size());
+        return hash;
+    }
+
+    // hash the value of the commonly shared types, other objects are partitioned by type alone
+    size_t hashValue(const vsg::Object& object)
+    {
+        if (auto data = object.cast<vsg::Data>()) return hashData(data);
+        if (auto sampler = object.cast<vsg::Sampler>()) return hashSampler(sampler);
+        if (auto descriptorSet = object.cast<vsg::DescriptorSet>()) return hashDescriptorSet(descriptorSet);
+        if (auto bindGraphicsPipeline = object.cast<vsg::BindGraphicsPipeline>()) return hashGraphicsPipeline(bindGraphicsPipeline->pipeline.get());
+        if (auto bindDescriptorSet = object.cast<vsg::BindDescriptorSet>())
+        {
+            size_t hash = bindDescriptorSet->firstSet;
+            combine(hash, hashDescriptorSet(bindDescriptorSet->descriptorSet.get()));
+            return hash;
+        }
+        if (auto bindDescriptorSets = object.cast<vsg::BindDescriptorSets>())
+        {
+            size_t hash = bindDescriptorSets->firstSet;
+            for (auto& descriptorSet : bindDescriptorSets->descriptorSets) combine(hash, hashDescriptorSet(descriptorSet.get()));
+            return hash;
+        }
+        return 0;
+    }
+} // namespace
+
+StripedSharedObjects::StripedSharedObjects(uint32_t in_numStripes) :
+    numStripes(std::max(in_numStripes, 1u)),
+    _stripes(new Stripe[numStripes])
+{
+}
+
+void StripedSharedObjects::_waited(vsg::clock::time_point startTime)
+{
+    ++numContended;
+    lockWaitTime += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(vsg::clock::now() - startTime).count());
+}
+
+vsg::ref_ptr<vsg::Object> StripedSharedObjects::_share(vsg::ref_ptr<vsg::Object> object)
+{
+    std::type_index type(typeid(*object));
+
+    size_t hash = type.hash_code();
+    combine(hash, hashValue(*object));
+
+    auto& stripe = _stripes[hash % numStripes];
+
+    // most objects loaded concurrently are repeats of ones already shared, so look up with a shared lock first
+    {
+        std::shared_lock<std::shared_mutex> lock(stripe.mutex, std::try_to_lock);
+        if (!lock.owns_lock())
+        {
+            auto startTime = vsg::clock::now();
+            lock.lock();
+            _waited(startTime);
+        }
+
+        if (auto typeItr = stripe.objects.find(type); typeItr != stripe.objects.end())
+        {
+            if (auto itr = typeItr->second.find(object); itr != typeItr->second.end())
+            {
+                ++numHits;
+                return *itr;
+            }
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(stripe.mutex, std::try_to_lock);
+    if (!lock.owns_lock())
+    {
+        auto startTime = vsg::clock::now();
+        lock.lock();
+        _waited(startTime);
+    }
+
+    // another thread may have registered a match since the shared lock was released
+    auto [itr, inserted] = stripe.objects[type].insert(object);
+    if (inserted)
+        ++numMisses;
+    else
+        ++numHits;
+    return *itr;
+}
+
+void StripedSharedObjects::report(std::ostream& out) const
+{
+    size_t numObjects = 0;
+    size_t maxStripeObjects = 0;
+    for (uint32_t i = 0; i < numStripes; ++i)
+    {
+        std::shared_lock<std::shared_mutex> lock(_stripes[i].mutex);
+
+        size_t stripeObjects = 0;
+        for (auto& [type, objects] : _stripes[i].objects) stripeObjects += objects.size();
+        numObjects += stripeObjects;
+        maxStripeObjects = std::max(maxStripeObjects, stripeObjects);
+    }
+
+    out << "StripedSharedObjects : stripes = " << numStripes << ", objects = " << numObjects << ", hits = " << numHits << ", misses = " << numMisses << std::endl;
+    out << "    largest stripe = " << maxStripeObjects << " objects, contended locks = " << numContended << ", lock wait time = " << (static_cast<double>(lockWaitTime) / 1.0e6) << "ms" << std::endl;
+}
+
+void ShareLoadedObjects::apply(vsg::Node& node)
+{
+    node.traverse(*this);
+}
+
+void ShareLoadedObjects::apply(vsg::StateGroup& stateGroup)
+{
+    for (auto& stateCommand : stateGroup.stateCommands)
+    {
+        if (!_visited.insert(stateCommand.get()).second) continue;
+
+        // share the textures and buffers the descriptor sets reference first, so that descriptor sets only differing in duplicated data then match
+        if (auto bindDescriptorSet = stateCommand.cast<vsg::BindDescriptorSet>())
+        {
+            _shareDescriptorSet(bindDescriptorSet->descriptorSet);
+        }
+        else if (auto bindDescriptorSets = stateCommand.cast<vsg::BindDescriptorSets>())
+        {
+            for (auto& descriptorSet : bindDescriptorSets->descriptorSets) _shareDescriptorSet(descriptorSet);
+        }
+
+        _share(stateCommand);
+    }
+
+    stateGroup.traverse(*this);
+}
+
+void ShareLoadedObjects::apply(vsg::VertexIndexDraw& vid)
+{
+    _shareArrays(vid.arrays);
+    if (vid.indices) _shareData(vid.indices->data);
+}
+
+void ShareLoadedObjects::apply(vsg::VertexDraw& vd)
+{
+    _shareArrays(vd.arrays);
+}
+
+void ShareLoadedObjects::apply(vsg::Geometry& geometry)
+{
+    _shareArrays(geometry.arrays);
+    if (geometry.indices) _shareData(geometry.indices->data);
+}
+
+void ShareLoadedObjects::_shareDescriptorSet(vsg::ref_ptr<vsg::DescriptorSet>& descriptorSet)
+{
+    if (!descriptorSet) return;
+
+    for (auto& descriptor : descriptorSet->descriptors)
+    {
+        if (auto descriptorImage = descriptor.cast<vsg::DescriptorImage>())
+        {
+            for (auto& imageInfo : descriptorImage->imageInfoList)
+            {
+                _share(imageInfo->sampler);
+                if (imageInfo->imageView && imageInfo->imageView->image) _shareData(imageInfo->imageView->image->data);
+            }
+        }
+        else if (auto descriptorBuffer = descriptor.cast<vsg::DescriptorBuffer>())
+        {
+            _shareArrays(descriptorBuffer->bufferInfoList);
+        }
+    }
+
+    _share(descriptorSet);
+}
+
+void ShareLoadedObjects::_shareArrays(vsg::BufferInfoList& arrays)
+{
+    for (auto& bufferInfo : arrays)
+    {
+        if (bufferInfo) _shareData(bufferInfo->data);
+    }
+}
+
+void ShareLoadedObjects::_shareData(vsg::ref_ptr<vsg::Data>& data)
+{
+    // data that is updated after loading has to stay unique to its subgraph
+    if (data && data->properties.dataVariance == vsg::STATIC_DATA) _share(data);
+}
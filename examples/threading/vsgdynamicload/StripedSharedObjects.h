@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include <shared_mutex>
+#include <typeindex>
+
+/// StripedSharedObjects is a registry of shared objects for use by many loader threads at once. Where vsg::SharedObjects guards all
+/// of its objects with a single mutex, StripedSharedObjects partitions them into stripes, each with its own std::shared_mutex, so threads
+/// sharing different objects rarely contend, and threads that find an existing object only need a shared lock. Objects are assigned to
+/// a stripe by their type and a hash of the members their compare() uses: the leading bytes of vsg::Data, the create info of samplers,
+/// the descriptors' data of descriptor sets and the shader stages of graphics pipelines. Other objects are partitioned by type alone.
+/// Objects are matched by value, using the same vsg::DereferenceLess comparison as vsg::SharedObjects.
+class StripedSharedObjects : public vsg::Inherit<vsg::Object, StripedSharedObjects>
+{
+public:
+    explicit StripedSharedObjects(uint32_t in_numStripes = 64);
+
+    const uint32_t numStripes;
+
+    /// replace object with the matching object already registered, or register object if there isn't a match
+    template<class T>
+    void share(vsg::ref_ptr<T>& object)
+    {
+        if (!object) return;
+        auto shared = _share(vsg::ref_ptr<vsg::Object>(object));
+        if (shared.get() != object.get()) object = vsg::ref_ptr<T>(static_cast<T*>(shared.get()));
+    }
+
+    void report(std::ostream& out) const;
+
+    // stats
+    std::atomic_uint64_t numHits{0};
+    std::atomic_uint64_t numMisses{0};
+    std::atomic_uint64_t numContended{0}; // lock acquisitions that had to wait
+    std::atomic_uint64_t lockWaitTime{0}; // nanoseconds spent waiting for locks
+
+protected:
+    struct Stripe
+    {
+        std::shared_mutex mutex;
+        std::map<std::type_index, std::set<vsg::ref_ptr<vsg::Object>, vsg::DereferenceLess>> objects;
+    };
+
+    std::unique_ptr<Stripe[]> _stripes;
+
+    vsg::ref_ptr<vsg::Object> _share(vsg::ref_ptr<vsg::Object> object);
+    void _waited(vsg::clock::time_point startTime);
+};
+
+/// ShareLoadedObjects shares the state, textures and vertex arrays of a loaded subgraph through a StripedSharedObjects, or through a
+/// vsg::SharedObjects, used in place of reading with vsg::Options::sharedObjects assigned.
+class ShareLoadedObjects : public vsg::Inherit<vsg::Visitor, ShareLoadedObjects>
+{
+public:
+    explicit ShareLoadedObjects(vsg::ref_ptr<StripedSharedObjects> in_stripedSharedObjects) :
+        stripedSharedObjects(in_stripedSharedObjects) {}
+
+    explicit ShareLoadedObjects(vsg::ref_ptr<vsg::SharedObjects> in_sharedObjects) :
+        sharedObjects(in_sharedObjects) {}
+
+    vsg::ref_ptr<StripedSharedObjects> stripedSharedObjects;
+    vsg::ref_ptr<vsg::SharedObjects> sharedObjects;
+
+    void apply(vsg::Node& node) override;
+    void apply(vsg::StateGroup& stateGroup) override;
+    void apply(vsg::VertexIndexDraw& vid) override;
+    void apply(vsg::VertexDraw& vd) override;
+    void apply(vsg::Geometry& geometry) override;
+
+protected:
+    std::set<vsg::Object*> _visited;
+
+    template<class T>
+    void _share(vsg::ref_ptr<T>& object)
+    {
+        if (stripedSharedObjects)
+            stripedSharedObjects->share(object);
+        else if (sharedObjects && object)
+            sharedObjects->share(object);
+    }
+
+    void _shareDescriptorSet(vsg::ref_ptr<vsg::DescriptorSet>& descriptorSet);
+    void _shareArrays(vsg::BufferInfoList& arrays);
+    void _shareData(vsg::ref_ptr<vsg::Data>& data);
+};
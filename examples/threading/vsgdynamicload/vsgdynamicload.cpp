@@ -13,6 +13,9 @@
 #include <iostream>
 #include <thread>
 
+#include "PipelineCache.h"
+#include "StripedSharedObjects.h"
+
 vsg::ref_ptr<vsg::Node> decorateWithInstrumentationNode(vsg::ref_ptr<vsg::Node> node, const std::string& name, vsg::uint_color color)
 {
     auto instrumentationNode = vsg::InstrumentationNode::create(node);
@@ -107,6 +110,22 @@ struct LoadOperation : public vsg::Inherit<vsg::Operation, LoadOperation>
                 node = decorateWithInstrumentationNode(node, filename.string(), vsg::uint_color(255, 255, 64, 255));
             }
 
+            // share state and data with previously loaded models after reading when the loaders read without vsg::SharedObjects
+            if (auto stripedSharedObjects = options->getRefObject<StripedSharedObjects>("stripedSharedObjects"))
+            {
+                node->accept(*ShareLoadedObjects::create(stripedSharedObjects));
+            }
+            else if (auto sharedObjects = options->getRefObject<vsg::SharedObjects>("sharedObjects"))
+            {
+                node->accept(*ShareLoadedObjects::create(sharedObjects));
+            }
+
+            // create the graphics pipelines through the shared pipeline cache when one is assigned
+            if (auto pipelineCache = options->getRefObject<PipelineCache>("pipelineCache"))
+            {
+                node->accept(*UsePipelineCache::create(pipelineCache));
+            }
+
             auto result = ref_viewer->compileManager->compile(node);
 
 
@@ -120,6 +139,8 @@ int main(int argc, char** argv)
 {
     try
     {
+        auto startTime = vsg::clock::now();
+
         // set up defaults and read command line arguments to override them
         vsg::CommandLine arguments(&argc, argv);
 
@@ -192,6 +213,14 @@ int main(int argc, char** argv)
         auto outputFilename = arguments.value<vsg::Path>("", "-o");
         if (arguments.read("--write")) options->setValue("write", true);
 
+        // keep the compiled graphics pipelines in a file so later runs start warm, i.e. --pipeline-cache vsgdynamicload.cache
+        auto pipelineCacheFilename = arguments.value<vsg::Path>("", "--pipeline-cache");
+
+        // share loaded objects through a StripedSharedObjects with the specified number of stripes, rather than through vsg::SharedObjects, i.e. --striped 64
+        auto numStripes = arguments.value<uint32_t>(0, "--striped");
+        auto numRepeats = std::max(arguments.value(1, "--repeat"), 1);
+        bool reportMemoryStats = arguments.read("--rms");
+
         if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
         if (argc <= 1)
@@ -215,12 +244,37 @@ int main(int argc, char** argv)
 
         viewer->addWindow(window);
 
+        // load the pipeline cache as soon as the device is created, it's then shared by the viewer's compile and the CompileManager via the options
+        vsg::ref_ptr<PipelineCache> pipelineCache;
+        if (pipelineCacheFilename)
+        {
+            pipelineCache = PipelineCache::create(window->getOrCreateDevice(), pipelineCacheFilename);
+            options->setObject("pipelineCache", pipelineCache);
+        }
+
+        // when benchmarking, the loaders read without vsg::SharedObjects so every repeat is read rather than returned from its filename cache,
+        // and the loaded subgraphs are shared afterwards through either vsg::SharedObjects or the StripedSharedObjects, so both do the same work
+        auto sharedObjects = options->sharedObjects;
+        vsg::ref_ptr<StripedSharedObjects> stripedSharedObjects;
+        if (numStripes > 0)
+        {
+            stripedSharedObjects = StripedSharedObjects::create(numStripes);
+            options->sharedObjects = {};
+            options->setObject("stripedSharedObjects", stripedSharedObjects);
+        }
+        else if (numRepeats > 1)
+        {
+            options->sharedObjects = {};
+            options->setObject("sharedObjects", sharedObjects);
+        }
+
         // set up the grid dimensions to place the loaded model(s) on.
         vsg::dvec3 origin(0.0, 0.0, 0.0);
         vsg::dvec3 primary(2.0, 0.0, 0.0);
         vsg::dvec3 secondary(0.0, 2.0, 0.0);
 
-        int numModels = argc - 1;
+        // loading the same models repeatedly provides a contention benchmark for the shared objects, i.e. --repeat 16
+        int numModels = (argc - 1) * numRepeats;
         int numColumns = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(numModels))));
         int numRows = static_cast<int>(std::ceil(static_cast<float>(numModels) / static_cast<float>(numColumns)));
 
@@ -243,6 +297,8 @@ int main(int argc, char** argv)
         auto commandGraph = vsg::createCommandGraphForView(window, camera, vsg_scene);
         viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
+        if (pipelineCache) commandGraph->accept(*UsePipelineCache::create(pipelineCache));
+
         if (instrumentation) viewer->assignInstrumentation(instrumentation);
 
         if (!resourceHints)
@@ -277,15 +333,14 @@ int main(int argc, char** argv)
 
         // assign the LoadOperation that will do the load in the background and once loaded and compiled, merge via Merge operation that is assigned to updateOperations and called from viewer.update()
         vsg::observer_ptr<vsg::Viewer> observer_viewer(viewer);
-        for (int i = 1; i < argc; ++i)
+        for (int index = 0; index < numModels; ++index)
         {
-            int index = i - 1;
             vsg::dvec3 position = origin + primary * static_cast<double>(index % numColumns) + secondary * static_cast<double>(index / numColumns);
             auto transform = vsg::MatrixTransform::create(vsg::translate(position));
 
             vsg_scene->addChild(transform);
 
-            loadQueue->add(LoadOperation::create(observer_viewer, transform, argv[i], options));
+            loadQueue->add(LoadOperation::create(observer_viewer, transform, argv[1 + index % (argc - 1)], options));
         }
 
         if (singleThreaded)
@@ -296,6 +351,9 @@ int main(int argc, char** argv)
             }
         }
 
+        bool firstFrame = true;
+        bool allLoaded = false;
+
         // rendering main loop
         while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
         {
@@ -308,9 +366,44 @@ int main(int argc, char** argv)
 
             viewer->present();
 
+            if (firstFrame)
+            {
+                firstFrame = false;
+                std::cout << "Time to first frame = " << std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count() << "ms" << pipelineCacheState(pipelineCache) << std::endl;
+            }
+
+            if (!allLoaded)
+            {
+                // each model is merged into its own transform once it has been loaded and compiled
+                allLoaded = std::all_of(vsg_scene->children.begin(), vsg_scene->children.end(), [](auto& child) { return !child.template cast<vsg::Group>()->children.empty(); });
+                if (allLoaded)
+                {
+                    std::cout << "Time to first frame with all models = " << std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count() << "ms" << pipelineCacheState(pipelineCache) << std::endl;
+                }
+            }
+
             // if (loadThreads->queue->empty()) break;
         }
 
+        if (reportMemoryStats)
+        {
+            if (stripedSharedObjects)
+            {
+                stripedSharedObjects->report(std::cout);
+            }
+            else if (sharedObjects)
+            {
+                vsg::LogOutput output;
+                sharedObjects->report(output);
+            }
+        }
+
+        if (pipelineCache)
+        {
+            pipelineCache->save();
+            pipelineCache->report(std::cout);
+        }
+
         if (outputFilename)
         {
             vsg::write(vsg_scene, outputFilename, options);
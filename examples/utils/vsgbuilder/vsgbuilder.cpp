@@ -6,6 +6,8 @@
 
 #include <iostream>
 
+#include "ShapeBatcher.h"
+
 int main(int argc, char** argv)
 {
     // set up defaults and read command line arguments to override them
@@ -98,6 +100,9 @@ int main(int argc, char** argv)
     }
 
     auto numVertices = arguments.value<uint32_t>(0, "-n");
+    auto numShapes = arguments.value<uint32_t>(0, "--shapes");
+    bool useShapeCache = arguments.read("--shape-cache");
+    bool useInstancing = arguments.read("--instance");
 
     vsg::Path textureFile = arguments.value(vsg::Path{}, {"-i", "--image"});
     vsg::Path displacementFile = arguments.value(vsg::Path{}, "--dm");
@@ -189,6 +194,73 @@ int main(int argc, char** argv)
             }
         }
 
+        if (numShapes > 0)
+        {
+            // scatter numShapes copies of the selected shapes through a cube, to compare the cost of building large procedural scenes with and without the ShapeCache or ShapeBatcher
+            std::vector<ShapeCache::Shape> shapes;
+            if (box) shapes.push_back(ShapeCache::BOX);
+            if (capsule) shapes.push_back(ShapeCache::CAPSULE);
+            if (cone) shapes.push_back(ShapeCache::CONE);
+            if (cylinder) shapes.push_back(ShapeCache::CYLINDER);
+            if (disk) shapes.push_back(ShapeCache::DISK);
+            if (quad) shapes.push_back(ShapeCache::QUAD);
+            if (sphere) shapes.push_back(ShapeCache::SPHERE);
+            if (heightfield) shapes.push_back(ShapeCache::HEIGHTFIELD);
+
+            auto shapeCache = ShapeCache::create(builder);
+            auto shapeBatcher = ShapeBatcher::create(builder);
+            auto group = vsg::Group::create();
+
+            float w = std::pow(float(numShapes), 0.33f) * 2.0f * vsg::length(geomInfo.dx);
+            auto startTime = vsg::clock::now();
+
+            for (uint32_t i = 0; i < numShapes; ++i)
+            {
+                geomInfo.position.set(w * (float(std::rand()) / float(RAND_MAX) - 0.5f),
+                                      w * (float(std::rand()) / float(RAND_MAX) - 0.5f),
+                                      w * (float(std::rand()) / float(RAND_MAX) - 0.5f));
+
+                auto shape = shapes[i % shapes.size()];
+                if (useInstancing)
+                {
+                    shapeBatcher->add(shape, geomInfo, stateInfo);
+                }
+                else if (useShapeCache)
+                {
+                    group->addChild(shapeCache->create(shape, geomInfo, stateInfo));
+                }
+                else
+                {
+                    switch (shape)
+                    {
+                    case (ShapeCache::BOX): group->addChild(builder->createBox(geomInfo, stateInfo)); break;
+                    case (ShapeCache::CAPSULE): group->addChild(builder->createCapsule(geomInfo, stateInfo)); break;
+                    case (ShapeCache::CONE): group->addChild(builder->createCone(geomInfo, stateInfo)); break;
+                    case (ShapeCache::CYLINDER): group->addChild(builder->createCylinder(geomInfo, stateInfo)); break;
+                    case (ShapeCache::DISK): group->addChild(builder->createDisk(geomInfo, stateInfo)); break;
+                    case (ShapeCache::QUAD): group->addChild(builder->createQuad(geomInfo, stateInfo)); break;
+                    case (ShapeCache::SPHERE): group->addChild(builder->createSphere(geomInfo, stateInfo)); break;
+                    case (ShapeCache::HEIGHTFIELD): group->addChild(builder->createHeightField(geomInfo, stateInfo)); break;
+                    }
+                }
+            }
+
+            if (useInstancing) group->addChild(shapeBatcher->build());
+
+            auto creationTime = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+            std::cout << "Created " << numShapes << " shapes in " << creationTime << "ms" << (useInstancing ? " using ShapeBatcher" : (useShapeCache ? " using ShapeCache" : "")) << std::endl;
+            if (useInstancing) shapeBatcher->report(std::cout);
+            if (useShapeCache) shapeCache->report(std::cout);
+            vsg::visit<CollectGeometryStats>(group).report(std::cout);
+
+            scene->addChild(group);
+            bound.add(vsg::dvec3(-w, -w, -w) * 0.5);
+            bound.add(vsg::dvec3(w, w, w) * 0.5);
+
+            // all the shapes have been created above so skip the single shapes below
+            box = capsule = cone = cylinder = disk = quad = sphere = heightfield = false;
+        }
+
         if (box)
         {
             auto node = builder->createBox(geomInfo, stateInfo);
@@ -0,0 +1,101 @@
+#include "FlightRecorder.h"
+#include "ChromeTraceExporter.h"
+
+#include <algorithm>
+
+FlightRecorder::FlightRecorder(vsg::ref_ptr<vsg::Profiler> in_profiler, const vsg::Path& in_prefix, double in_thresholdMS) :
+    profiler(in_profiler),
+    prefix(in_prefix),
+    thresholdMS(in_thresholdMS)
+{
+}
+
+bool FlightRecorder::_inLog(uint64_t index) const
+{
+    auto& log = *profiler->log;
+    return (log.index.load() - index) <= log.entries.size();
+}
+
+void FlightRecorder::update()
+{
+    if (!profiler || !profiler->log) return;
+
+    auto& log = *profiler->log;
+    uint64_t numLogFrames = log.frameIndices.size();
+    if (numLogFrames < _nextFrame)
+    {
+        // log has been reset
+        _nextFrame = 0;
+        _lastDumpEndFrame = 0;
+        _pendingSpikes.clear();
+    }
+
+    // a frame's time is only known once the next frame has started
+    for (; _nextFrame + 1 < numLogFrames; ++_nextFrame)
+    {
+        uint64_t beginIndex = log.frameIndices[_nextFrame];
+        if (!_inLog(beginIndex)) continue;
+
+        uint64_t nextIndex = log.frameIndices[_nextFrame + 1];
+        double frameTime = std::chrono::duration<double, std::chrono::milliseconds::period>(log.entry(nextIndex).cpuTime - log.entry(beginIndex).cpuTime).count();
+
+        ++numFramesChecked;
+        maxFrameTime = std::max(maxFrameTime, frameTime);
+
+        if (frameTime > thresholdMS)
+        {
+            ++numSpikes;
+
+            // spikes that fall within an earlier dump's window are already covered
+            bool covered = _nextFrame < _lastDumpEndFrame || (!_pendingSpikes.empty() && _nextFrame <= _pendingSpikes.back() + framesAfter);
+            if (!covered) _pendingSpikes.push_back(_nextFrame);
+        }
+    }
+
+    // write dumps once the frames after the spike have been recorded and their GPU timestamps read back
+    while (!_pendingSpikes.empty() && (_pendingSpikes.front() + framesAfter + lag + 1) < numLogFrames)
+    {
+        if (dumps.size() < maxDumps) _dump(_pendingSpikes.front());
+        _pendingSpikes.pop_front();
+    }
+}
+
+void FlightRecorder::_dump(uint64_t spikeFrame)
+{
+    auto& log = *profiler->log;
+    uint64_t numLogFrames = log.frameIndices.size();
+
+    uint64_t beginFrame = spikeFrame > framesBefore ? spikeFrame - framesBefore : 0;
+    uint64_t endFrame = std::min<uint64_t>(spikeFrame + framesAfter + 1, numLogFrames - 1);
+
+    if (!_inLog(log.frameIndices[beginFrame]))
+    {
+        ++numTruncated;
+        while (beginFrame < spikeFrame && !_inLog(log.frameIndices[beginFrame])) ++beginFrame;
+    }
+
+    vsg::Path filename(vsg::make_string(prefix.string(), "_", spikeFrame, ".json"));
+    auto exporter = ChromeTraceExporter::create(profiler, filename);
+    if (!exporter->valid())
+    {
+        vsg::warn("FlightRecorder : unable to write ", filename);
+        return;
+    }
+
+    exporter->frameNumberOffset = beginFrame;
+    exporter->exportRange(log.frameIndices[beginFrame], log.frameIndices[endFrame]);
+    exporter->finish();
+
+    _lastDumpEndFrame = endFrame;
+    dumps.push_back(filename);
+
+    vsg::info("FlightRecorder : frame ", spikeFrame, " exceeded ", thresholdMS, "ms, frames ", beginFrame, " to ", endFrame - 1, " written to ", filename);
+}
+
+void FlightRecorder::report(std::ostream& out) const
+{
+    out << "FlightRecorder threshold = " << thresholdMS << "ms" << std::endl;
+    out << "    frames checked = " << numFramesChecked << ", max frame time = " << maxFrameTime << "ms" << std::endl;
+    out << "    spikes = " << numSpikes << ", dumps = " << dumps.size() << ", truncated = " << numTruncated << std::endl;
+    for (auto& filename : dumps) out << "    " << filename << std::endl;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <deque>
+#include <ostream>
+
+/// FlightRecorder leaves a vsg::Profiler running at low instrumentation levels and uses its fixed size ProfileLog as a ring of the most recent frames,
+/// when a frame takes longer than thresholdMS the frames around it are written to a Chrome trace file so rare hitches can be caught in the field.
+/// The ProfileLog's log_size must be large enough to hold framesBefore + framesAfter + lag frames, windows that have been partially overwritten are truncated.
+class FlightRecorder : public vsg::Inherit<vsg::Object, FlightRecorder>
+{
+public:
+    FlightRecorder(vsg::ref_ptr<vsg::Profiler> in_profiler, const vsg::Path& in_prefix, double in_thresholdMS);
+
+    vsg::ref_ptr<vsg::Profiler> profiler;
+    vsg::Path prefix;           // dumps are written to prefix_<frame>.json
+    double thresholdMS = 50.0;  // frame to frame time that triggers a dump
+    uint32_t framesBefore = 120;
+    uint32_t framesAfter = 30;
+    uint32_t lag = 8;           // frames to wait after the window so GPU timestamps are available
+    uint32_t maxDumps = 32;     // stop writing once this many dumps have been written so a bad run doesn't fill the disk
+
+    /// check the frames completed since the last call and write any pending dumps, call once per frame after Viewer::present().
+    void update();
+
+    void report(std::ostream& out) const;
+
+    // stats
+    uint64_t numFramesChecked = 0;
+    uint64_t numSpikes = 0;
+    uint64_t numTruncated = 0; // dumps where the start of the window had already been overwritten in the ProfileLog
+    double maxFrameTime = 0.0;
+    std::vector<vsg::Path> dumps;
+
+protected:
+    bool _inLog(uint64_t index) const;
+    void _dump(uint64_t spikeFrame);
+
+    uint64_t _nextFrame = 0;
+    uint64_t _lastDumpEndFrame = 0;
+    std::deque<uint64_t> _pendingSpikes;
+};
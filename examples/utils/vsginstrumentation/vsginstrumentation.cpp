@@ -6,9 +6,13 @@
 
 #include <vsg/utils/Instrumentation.h>
 
+#include "ChromeTraceExporter.h"
+#include "FlightRecorder.h"
+
 #include <algorithm>
 #include <chrono>
 #include <iostream>
+#include <limits>
 #include <thread>
 
 class InstrumentationHandler : public vsg::Inherit<vsg::Visitor, InstrumentationHandler>
@@ -51,6 +55,52 @@ vsg::ref_ptr<vsg::Node> decorateWithInstrumentationNode(vsg::ref_ptr<vsg::Node>
     return instrumentationNode;
 }
 
+// render numFrames at each cpu_instrumentation_level, repeated numRounds times taking the fastest round to reduce noise, and report the cost of each level relative to level 0
+void benchmarkOverhead(vsg::Viewer& viewer, vsg::Profiler& profiler, int numFrames, int numRounds)
+{
+    const uint32_t maxLevel = 3;
+    auto originalLevel = profiler.settings->cpu_instrumentation_level;
+
+    std::vector<double> frameTimes(maxLevel + 1, std::numeric_limits<double>::max());
+    std::vector<double> entriesPerFrame(maxLevel + 1, 0.0);
+
+    for (int round = 0; round < numRounds && viewer.active(); ++round)
+    {
+        for (uint32_t level = 0; level <= maxLevel && viewer.active(); ++level)
+        {
+            profiler.settings->cpu_instrumentation_level = level;
+
+            uint64_t startIndex = profiler.log->index.load();
+            auto startTime = vsg::clock::now();
+
+            int frame = 0;
+            for (; frame < numFrames && viewer.advanceToNextFrame(); ++frame)
+            {
+                viewer.handleEvents();
+                viewer.update();
+                viewer.recordAndSubmit();
+                viewer.present();
+            }
+
+            if (frame == 0) break;
+
+            double frameTime = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count() / static_cast<double>(frame);
+            frameTimes[level] = std::min(frameTimes[level], frameTime);
+            entriesPerFrame[level] = static_cast<double>(profiler.log->index.load() - startIndex) / static_cast<double>(frame);
+        }
+    }
+
+    profiler.settings->cpu_instrumentation_level = originalLevel;
+
+    std::cout << "Instrumentation overhead, gpu_instrumentation_level = " << profiler.settings->gpu_instrumentation_level << ", " << numFrames << " frames x " << numRounds << " rounds" << std::endl;
+    for (uint32_t level = 0; level <= maxLevel; ++level)
+    {
+        if (frameTimes[level] == std::numeric_limits<double>::max()) continue;
+        double overhead = (frameTimes[level] - frameTimes[0]) / frameTimes[0] * 100.0;
+        std::cout << "    cpu_instrumentation_level " << level << " : " << frameTimes[level] << "ms per frame, overhead = " << overhead << "%, log entries per frame = " << entriesPerFrame[level] << std::endl;
+    }
+}
+
 int main(int argc, char** argv)
 {
     try
@@ -108,6 +158,20 @@ int main(int argc, char** argv)
         arguments.read("--log-size", settings->log_size);
         arguments.read("--gpu-size", settings->gpu_timestamp_size);
 
+        // stream the profile log to a Chrome trace event file for viewing in chrome://tracing, Perfetto UI or Speedscope
+        auto traceFilename = arguments.value<vsg::Path>("", "--trace");
+        auto traceLag = arguments.value<uint32_t>(8, "--trace-lag");
+
+        // leave the profiler running and write the frames around any frame exceeding the threshold, e.g. --flight-recorder 50 with --cpu 1 --gpu 1
+        auto flightRecorderThreshold = arguments.value<double>(0.0, "--flight-recorder");
+        auto flightRecorderPrefix = arguments.value<std::string>("spike", "--fr-prefix");
+        auto flightRecorderBefore = arguments.value<uint32_t>(120, "--fr-before");
+        auto flightRecorderAfter = arguments.value<uint32_t>(30, "--fr-after");
+
+        // benchmark the cost of each cpu_instrumentation_level
+        auto overheadFrames = arguments.value<int>(0, "--overhead");
+        auto overheadRounds = arguments.value<int>(3, "--overhead-rounds");
+
         // create the profiler
         auto instrumentation = vsg::Profiler::create(settings);
 
@@ -238,8 +302,34 @@ int main(int argc, char** argv)
 
         viewer->compile();
 
+        vsg::ref_ptr<ChromeTraceExporter> traceExporter;
+        if (traceFilename)
+        {
+            traceExporter = ChromeTraceExporter::create(instrumentation, traceFilename);
+            traceExporter->lag = traceLag;
+            if (!traceExporter->valid())
+            {
+                std::cout << "Unable to open trace file " << traceFilename << std::endl;
+                traceExporter = {};
+            }
+        }
+
+        vsg::ref_ptr<FlightRecorder> flightRecorder;
+        if (flightRecorderThreshold > 0.0)
+        {
+            flightRecorder = FlightRecorder::create(instrumentation, flightRecorderPrefix, flightRecorderThreshold);
+            flightRecorder->framesBefore = flightRecorderBefore;
+            flightRecorder->framesAfter = flightRecorderAfter;
+        }
+
         viewer->start_point() = vsg::clock::now();
 
+        if (overheadFrames > 0)
+        {
+            benchmarkOverhead(*viewer, *instrumentation, overheadFrames, overheadRounds);
+            return 0;
+        }
+
         // rendering main loop
         while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
         {
@@ -251,6 +341,9 @@ int main(int argc, char** argv)
             viewer->recordAndSubmit();
 
             viewer->present();
+
+            if (traceExporter) traceExporter->update();
+            if (flightRecorder) flightRecorder->update();
         }
 
         if (reportAverageFrameRate)
@@ -265,6 +358,14 @@ int main(int argc, char** argv)
             instrumentation->finish();
             instrumentation->log->report(std::cout);
         }
+
+        if (flightRecorder) flightRecorder->report(std::cout);
+
+        if (traceExporter)
+        {
+            traceExporter->finish();
+            std::cout << "Trace written to " << traceExporter->filename << ", events = " << traceExporter->numEvents << ", frames = " << traceExporter->numFrames << ", lost entries = " << traceExporter->numLost << ", dropped GPU scopes = " << traceExporter->numDroppedGpuScopes << std::endl;
+        }
     }
     catch (const vsg::Exception& ve)
     {
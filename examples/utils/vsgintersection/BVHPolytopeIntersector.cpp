@@ -0,0 +1,344 @@
+#include "BVHPolytopeIntersector.h"
+
+#include "ParallelFor.h"
+
+#include <algorithm>
+
+namespace
+{
+    using Planes = std::vector<vsg::dplane>;
+
+    enum Containment
+    {
+        OUTSIDE,
+        PARTIAL,
+        INSIDE
+    };
+
+    Containment classify(const Planes& planes, const vsg::vec3& min, const vsg::vec3& max)
+    {
+        bool inside = true;
+        for (auto& plane : planes)
+        {
+            // corners of the box furthest along and against the plane normal
+            vsg::dvec3 positive(plane.n.x >= 0.0 ? max.x : min.x, plane.n.y >= 0.0 ? max.y : min.y, plane.n.z >= 0.0 ? max.z : min.z);
+            vsg::dvec3 negative(plane.n.x >= 0.0 ? min.x : max.x, plane.n.y >= 0.0 ? min.y : max.y, plane.n.z >= 0.0 ? min.z : max.z);
+
+            if (vsg::distance(plane, positive) < 0.0) return OUTSIDE;
+            if (vsg::distance(plane, negative) < 0.0) inside = false;
+        }
+        return inside ? INSIDE : PARTIAL;
+    }
+
+    Containment classify(const Planes& planes, const vsg::dsphere& sphere)
+    {
+        bool inside = true;
+        for (auto& plane : planes)
+        {
+            double d = vsg::distance(plane, sphere.center);
+            if (d < -sphere.radius) return OUTSIDE;
+            if (d < sphere.radius) inside = false;
+        }
+        return inside ? INSIDE : PARTIAL;
+    }
+
+    bool inside(const Planes& planes, const vsg::dvec3& v)
+    {
+        for (auto& plane : planes)
+        {
+            if (vsg::distance(plane, v) < 0.0) return false;
+        }
+        return true;
+    }
+
+    // clip the triangle against the polytope, returning true and the centroid of the remaining polygon if any of it is inside
+    bool clipTriangle(const Planes& planes, const vsg::dvec3& v0, const vsg::dvec3& v1, const vsg::dvec3& v2, vsg::dvec3& centroid)
+    {
+        std::vector<vsg::dvec3> polygon{v0, v1, v2};
+        std::vector<vsg::dvec3> clipped;
+        for (auto& plane : planes)
+        {
+            clipped.clear();
+            for (size_t i = 0; i < polygon.size(); ++i)
+            {
+                auto& a = polygon[i];
+                auto& b = polygon[(i + 1) % polygon.size()];
+                double da = vsg::distance(plane, a);
+                double db = vsg::distance(plane, b);
+                if (da >= 0.0) clipped.push_back(a);
+                if ((da >= 0.0) != (db >= 0.0)) clipped.push_back(a + (b - a) * (da / (da - db)));
+            }
+            polygon.swap(clipped);
+            if (polygon.empty()) return false;
+        }
+
+        centroid = {};
+        for (auto& v : polygon) centroid += v;
+        centroid /= static_cast<double>(polygon.size());
+        return true;
+    }
+
+    struct Job
+    {
+        uint32_t node = 0;
+        bool inside = false;
+        std::vector<BVHPolytopeIntersector::Result> results;
+        uint64_t numPrimitivesTested = 0;
+        uint64_t numNodesInside = 0;
+        uint64_t numNodesOutside = 0;
+    };
+
+    void addPrimitive(const TriangleBVH& bvh, uint32_t primitive, std::vector<BVHPolytopeIntersector::Result>& results, const Planes* planes, uint64_t& numPrimitivesTested)
+    {
+        const auto& vertices = *bvh.vertices;
+        const uint32_t* indices = bvh.indices.data() + static_cast<size_t>(primitive) * bvh.primitiveSize;
+
+        BVHPolytopeIntersector::Result result;
+        if (bvh.primitiveSize == 1)
+        {
+            result.localIntersection = vsg::dvec3(vertices[indices[0]]);
+            if (planes)
+            {
+                ++numPrimitivesTested;
+                if (!inside(*planes, result.localIntersection)) return;
+            }
+        }
+        else
+        {
+            vsg::dvec3 v0(vertices[indices[0]]), v1(vertices[indices[1]]), v2(vertices[indices[2]]);
+            if (planes)
+            {
+                ++numPrimitivesTested;
+                if (!clipTriangle(*planes, v0, v1, v2, result.localIntersection)) return;
+            }
+            else
+            {
+                result.localIntersection = (v0 + v1 + v2) / 3.0;
+            }
+        }
+
+        std::copy_n(indices, bvh.primitiveSize, result.indices);
+        results.push_back(result);
+    }
+
+    // collect the primitives of a BVH subtree that intersect the planes, skipping subtrees outside and accepting subtrees inside without further tests
+    void collect(const TriangleBVH& bvh, const Planes& planes, Job& job)
+    {
+        std::vector<std::pair<uint32_t, bool>> stack;
+        stack.emplace_back(job.node, job.inside);
+
+        while (!stack.empty())
+        {
+            auto [nodeIndex, nodeInside] = stack.back();
+            stack.pop_back();
+
+            const auto& node = bvh.nodes[nodeIndex];
+            if (!nodeInside)
+            {
+                auto containment = classify(planes, node.min, node.max);
+                if (containment == OUTSIDE)
+                {
+                    ++job.numNodesOutside;
+                    continue;
+                }
+                if (containment == INSIDE)
+                {
+                    ++job.numNodesInside;
+                    nodeInside = true;
+                }
+            }
+
+            if (!node.leaf())
+            {
+                // push the second child first so results come out in BVH order
+                stack.emplace_back(node.first, nodeInside);
+                stack.emplace_back(nodeIndex + 1, nodeInside);
+                continue;
+            }
+
+            for (uint32_t p = node.first; p < node.first + node.count; ++p)
+            {
+                addPrimitive(bvh, p, job.results, nodeInside ? nullptr : &planes, job.numPrimitivesTested);
+            }
+        }
+    }
+} // namespace
+
+BVHPolytopeIntersector::BVHPolytopeIntersector(const vsg::Camera& camera, double xMin, double yMin, double xMax, double yMax, vsg::ref_ptr<vsg::ArrayState> initialArrayData) :
+    Inherit(camera, xMin, yMin, xMax, yMax, initialArrayData)
+{
+}
+
+void BVHPolytopeIntersector::apply(const vsg::CullNode& cullNode)
+{
+    if (_insideDepth == 0)
+    {
+        const auto& polytope = _polytopeStack.back();
+        Planes planes(polytope.begin(), polytope.end());
+
+        auto containment = classify(planes, cullNode.bound);
+        if (containment == OUTSIDE)
+        {
+            ++numNodesOutside;
+            return;
+        }
+
+        if (containment == INSIDE)
+        {
+            ++numNodesInside;
+            ++_insideDepth;
+            vsg::PolytopeIntersector::apply(cullNode);
+            --_insideDepth;
+            return;
+        }
+    }
+
+    vsg::PolytopeIntersector::apply(cullNode);
+}
+
+void BVHPolytopeIntersector::apply(const vsg::VertexIndexDraw& vid)
+{
+    // let the base class set up the ArrayState and node path, then pick up the draw in intersectDrawIndexed()
+    _currentDrawNode = &vid;
+    _currentArrays = &vid.arrays;
+    _currentIndices = vid.indices.get();
+    vsg::PolytopeIntersector::apply(vid);
+    _currentDrawNode = nullptr;
+    _currentArrays = nullptr;
+    _currentIndices = nullptr;
+}
+
+void BVHPolytopeIntersector::apply(const vsg::VertexDraw& vd)
+{
+    _currentDrawNode = &vd;
+    _currentArrays = &vd.arrays;
+    vsg::PolytopeIntersector::apply(vd);
+    _currentDrawNode = nullptr;
+    _currentArrays = nullptr;
+}
+
+void BVHPolytopeIntersector::apply(const vsg::Geometry& geometry)
+{
+    _currentDrawNode = &geometry;
+    _currentArrays = &geometry.arrays;
+    _currentIndices = geometry.indices.get();
+    vsg::PolytopeIntersector::apply(geometry);
+    _currentDrawNode = nullptr;
+    _currentArrays = nullptr;
+    _currentIndices = nullptr;
+}
+
+vsg::ref_ptr<TriangleBVH> BVHPolytopeIntersector::_getBVH(vsg::ref_ptr<const vsg::Data> indexData, uint32_t first, uint32_t count, uint32_t firstInstance, uint32_t instanceCount)
+{
+    if (!_currentDrawNode || !_currentArrays || instanceCount > 1) return {};
+
+    auto& arrayState = *arrayStateStack.back();
+
+    uint32_t primitiveSize = 0;
+    if (arrayState.topology == VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
+        primitiveSize = 3;
+    else if (arrayState.topology == VK_PRIMITIVE_TOPOLOGY_POINT_LIST)
+        primitiveSize = 1;
+    else
+        return {};
+
+    // only use the BVH when the ArrayState passes the vertex array through unmodified, rather than generating per instance positions
+    auto vertices = arrayState.vertexArray(firstInstance);
+    bool sourceVertices = false;
+    for (auto& bufferInfo : *_currentArrays)
+    {
+        if (bufferInfo && bufferInfo->data.get() == vertices.get()) sourceVertices = true;
+    }
+    if (!sourceVertices) return {};
+
+    return TriangleBVH::get(*_currentDrawNode, vertices, indexData, first, count, primitiveSize);
+}
+
+bool BVHPolytopeIntersector::intersectDraw(uint32_t firstVertex, uint32_t vertexCount, uint32_t firstInstance, uint32_t instanceCount)
+{
+    if (auto bvh = _getBVH({}, firstVertex, vertexCount, firstInstance, instanceCount))
+    {
+        return _intersect(*bvh, firstInstance);
+    }
+
+    ++numFallbackTests;
+    return vsg::PolytopeIntersector::intersectDraw(firstVertex, vertexCount, firstInstance, instanceCount);
+}
+
+bool BVHPolytopeIntersector::intersectDrawIndexed(uint32_t firstIndex, uint32_t indexCount, uint32_t firstInstance, uint32_t instanceCount)
+{
+    if (_currentIndices && _currentIndices->data)
+    {
+        if (auto bvh = _getBVH(_currentIndices->data, firstIndex, indexCount, firstInstance, instanceCount))
+        {
+            return _intersect(*bvh, firstInstance);
+        }
+    }
+
+    ++numFallbackTests;
+    return vsg::PolytopeIntersector::intersectDrawIndexed(firstIndex, indexCount, firstInstance, instanceCount);
+}
+
+bool BVHPolytopeIntersector::_intersect(const TriangleBVH& bvh, uint32_t instanceIndex)
+{
+    if (bvh.nodes.empty()) return false;
+
+    ++numBVHTests;
+
+    const auto& polytope = _polytopeStack.back();
+    Planes planes(polytope.begin(), polytope.end());
+
+    // split the BVH into subtrees, enough to keep all the threads busy for large meshes
+    std::vector<Job> jobs(1);
+    jobs.front().inside = (_insideDepth > 0);
+
+    if (operationThreads && bvh.numPrimitives() >= parallelThreshold && !jobs.front().inside)
+    {
+        size_t targetJobs = 4 * (operationThreads->threads.size() + 1);
+        while (jobs.size() < targetJobs)
+        {
+            // replace each job with its two children, breadth first so the subtrees stay balanced, keeping BVH order
+            std::vector<Job> split;
+            for (auto& job : jobs)
+            {
+                const auto& node = bvh.nodes[job.node];
+                if (node.leaf())
+                {
+                    split.push_back(std::move(job));
+                    continue;
+                }
+
+                split.emplace_back();
+                split.back().node = job.node + 1;
+                split.emplace_back();
+                split.back().node = node.first;
+            }
+
+            if (split.size() == jobs.size()) break;
+            jobs.swap(split);
+        }
+
+        parallelFor(operationThreads, jobs.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) collect(bvh, planes, jobs[i]);
+        });
+    }
+    else
+    {
+        collect(bvh, planes, jobs.front());
+    }
+
+    size_t previousSize = intersections.size();
+    for (auto& job : jobs)
+    {
+        numPrimitivesTested += job.numPrimitivesTested;
+        numNodesInside += job.numNodesInside;
+        numNodesOutside += job.numNodesOutside;
+
+        for (auto& result : job.results)
+        {
+            add(result.localIntersection, std::vector<uint32_t>(result.indices, result.indices + bvh.primitiveSize), instanceIndex);
+        }
+    }
+
+    return intersections.size() != previousSize;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "TriangleBVH.h"
+
+/// BVHPolytopeIntersector is a drop in replacement for vsg::PolytopeIntersector for box selection of dense meshes and point clouds.
+/// CullNode bounds and the nodes of each draw's cached TriangleBVH are classified against the polytope, subtrees entirely outside are skipped
+/// and those entirely inside are accepted without per primitive tests, leaving only primitives on the polytope's boundary to test.
+/// When operationThreads is assigned the subtrees of large meshes are processed in parallel.
+class BVHPolytopeIntersector : public vsg::Inherit<vsg::PolytopeIntersector, BVHPolytopeIntersector>
+{
+public:
+    BVHPolytopeIntersector(const vsg::Camera& camera, double xMin, double yMin, double xMax, double yMax, vsg::ref_ptr<vsg::ArrayState> initialArrayData = {});
+
+    vsg::ref_ptr<vsg::OperationThreads> operationThreads;
+    uint32_t parallelThreshold = 65536; // minimum number of primitives in a draw before it is split across operationThreads
+
+    using vsg::PolytopeIntersector::apply;
+
+    void apply(const vsg::CullNode& cullNode) override;
+    void apply(const vsg::VertexIndexDraw& vid) override;
+    void apply(const vsg::VertexDraw& vd) override;
+    void apply(const vsg::Geometry& geometry) override;
+
+    bool intersectDraw(uint32_t firstVertex, uint32_t vertexCount, uint32_t firstInstance, uint32_t instanceCount) override;
+    bool intersectDrawIndexed(uint32_t firstIndex, uint32_t indexCount, uint32_t firstInstance, uint32_t instanceCount) override;
+
+    // stats
+    uint32_t numBVHTests = 0;         // draws tested via their BVH
+    uint32_t numFallbackTests = 0;    // draws tested primitive by primitive
+    uint64_t numPrimitivesTested = 0; // primitives on the polytope boundary that needed an individual test
+    uint64_t numNodesInside = 0;      // CullNode and BVH nodes accepted without testing their contents
+    uint64_t numNodesOutside = 0;     // CullNode and BVH nodes culled
+
+    struct Result
+    {
+        vsg::dvec3 localIntersection;
+        uint32_t indices[3];
+    };
+
+protected:
+    const vsg::Node* _currentDrawNode = nullptr;
+    const vsg::BufferInfoList* _currentArrays = nullptr;
+    const vsg::BufferInfo* _currentIndices = nullptr;
+    uint32_t _insideDepth = 0; // > 0 while traversing a CullNode that is entirely inside the polytope
+
+    vsg::ref_ptr<TriangleBVH> _getBVH(vsg::ref_ptr<const vsg::Data> indexData, uint32_t first, uint32_t count, uint32_t firstInstance, uint32_t instanceCount);
+    bool _intersect(const TriangleBVH& bvh, uint32_t instanceIndex);
+};
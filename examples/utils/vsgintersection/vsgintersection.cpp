@@ -5,6 +5,12 @@
 #endif
 
 #include <iostream>
+#include <thread>
+
+#include "BVHLineSegmentIntersector.h"
+#include "BVHPolytopeIntersector.h"
+#include "BatchRayCaster.h"
+#include "ShapeCache.h"
 
 class IntersectionHandler : public vsg::Inherit<vsg::Visitor, IntersectionHandler>
 {
@@ -13,12 +19,17 @@ public:
     vsg::StateInfo state;
 
     vsg::ref_ptr<vsg::Builder> builder;
+    vsg::ref_ptr<ShapeCache> shapeCache; // when set shapes of the same size share their geometry
     vsg::ref_ptr<vsg::Options> options;
     vsg::ref_ptr<vsg::Camera> camera;
     vsg::ref_ptr<vsg::Group> scenegraph;
     vsg::ref_ptr<vsg::EllipsoidModel> ellipsoidModel;
     double scale = 1.0;
     bool verbose = true;
+    bool useBVH = true;  // use BVHLineSegmentIntersector rather than vsg::LineSegmentIntersector
+    bool compare = false; // also time the standard vsg::LineSegmentIntersector and vsg::PolytopeIntersector on each pick
+    double selectionSize = 5.0; // half width of the PolytopeIntersector selection rectangle in pixels
+    vsg::ref_ptr<vsg::OperationThreads> operationThreads; // when set the BVHPolytopeIntersector tests large meshes in parallel
 
     IntersectionHandler(vsg::ref_ptr<vsg::Builder> in_builder, vsg::ref_ptr<vsg::Camera> in_camera, vsg::ref_ptr<vsg::Group> in_scenegraph, vsg::ref_ptr<vsg::EllipsoidModel> in_ellipsoidModel, double in_scale, vsg::ref_ptr<vsg::Options> in_options) :
         builder(in_builder),
@@ -65,27 +76,27 @@ public:
 
             if (keyPress.keyBase == 'b')
             {
-                scenegraph->addChild(builder->createBox(geom, state));
+                scenegraph->addChild(shapeCache ? shapeCache->createBox(geom, state) : builder->createBox(geom, state));
             }
             else if (keyPress.keyBase == 'q')
             {
-                scenegraph->addChild(builder->createQuad(geom, state));
+                scenegraph->addChild(shapeCache ? shapeCache->createQuad(geom, state) : builder->createQuad(geom, state));
             }
             else if (keyPress.keyBase == 'c')
             {
-                scenegraph->addChild(builder->createCylinder(geom, state));
+                scenegraph->addChild(shapeCache ? shapeCache->createCylinder(geom, state) : builder->createCylinder(geom, state));
             }
             else if (keyPress.keyBase == 'p')
             {
-                scenegraph->addChild(builder->createCapsule(geom, state));
+                scenegraph->addChild(shapeCache ? shapeCache->createCapsule(geom, state) : builder->createCapsule(geom, state));
             }
             else if (keyPress.keyBase == 's')
             {
-                scenegraph->addChild(builder->createSphere(geom, state));
+                scenegraph->addChild(shapeCache ? shapeCache->createSphere(geom, state) : builder->createSphere(geom, state));
             }
             else if (keyPress.keyBase == 'n')
             {
-                scenegraph->addChild(builder->createCone(geom, state));
+                scenegraph->addChild(shapeCache ? shapeCache->createCone(geom, state) : builder->createCone(geom, state));
             }
         }
 
@@ -100,6 +111,10 @@ public:
         {
             vsg::write(scenegraph, "builder.vsgt");
         }
+        else if (keyPress.keyBase == 'l')
+        {
+            intersection_BatchRayCaster();
+        }
     }
 
     void apply(vsg::ButtonPressEvent& buttonPressEvent) override
@@ -123,7 +138,12 @@ public:
 
     void intersection_LineSegmentIntersector(vsg::PointerEvent& pointerEvent)
     {
-        auto intersector = vsg::LineSegmentIntersector::create(*camera, pointerEvent.x, pointerEvent.y);
+        vsg::ref_ptr<vsg::LineSegmentIntersector> intersector;
+        auto bvhIntersector = useBVH ? BVHLineSegmentIntersector::create(*camera, pointerEvent.x, pointerEvent.y) : vsg::ref_ptr<BVHLineSegmentIntersector>();
+        if (bvhIntersector)
+            intersector = bvhIntersector;
+        else
+            intersector = vsg::LineSegmentIntersector::create(*camera, pointerEvent.x, pointerEvent.y);
 
         auto before_intersection = vsg::clock::now();
 
@@ -135,6 +155,25 @@ public:
         {
             std::cout << "\nintersection_LineSegmentIntersector(" << pointerEvent.x << ", " << pointerEvent.y << ") " << intersector->intersections.size() << ")";
             std::cout << "time = " << std::chrono::duration<double, std::chrono::milliseconds::period>(after_intersection - before_intersection).count() << "ms" << std::endl;
+
+            if (bvhIntersector)
+            {
+                std::cout << "    BVH tests = " << bvhIntersector->numBVHTests << ", fallback tests = " << bvhIntersector->numFallbackTests;
+                if (bvhIntersector->numBVHBuilt > 0) std::cout << ", built " << bvhIntersector->numBVHBuilt << " BVH in " << bvhIntersector->bvhBuildTime << "ms";
+                std::cout << std::endl;
+            }
+        }
+
+        if (compare)
+        {
+            // time the same query with the standard per triangle tests
+            auto reference = vsg::LineSegmentIntersector::create(*camera, pointerEvent.x, pointerEvent.y);
+
+            auto before_reference = vsg::clock::now();
+            scenegraph->accept(*reference);
+            auto after_reference = vsg::clock::now();
+
+            std::cout << "    vsg::LineSegmentIntersector " << reference->intersections.size() << " intersections, time = " << std::chrono::duration<double, std::chrono::milliseconds::period>(after_reference - before_reference).count() << "ms" << std::endl;
         }
 
         if (intersector->intersections.empty()) return;
@@ -186,18 +225,83 @@ public:
         lastIntersection = intersector->intersections.front();
     }
 
+    void intersection_BatchRayCaster()
+    {
+        auto lookAt = camera->viewMatrix.cast<vsg::LookAt>();
+        if (!lookAt) return;
+
+        if (!rayCaster) rayCaster = BatchRayCaster::create(scenegraph, vsg::OperationThreads::create(std::max(1u, std::thread::hardware_concurrency()) - 1));
+
+        // collect meshes each time as shapes may have been added
+        rayCaster->update();
+
+        // 64 x 1024 lidar sweep from the eye point, ranging out to twice the distance to the centre of the view
+        double range = vsg::length(lookAt->center - lookAt->eye) * 2.0;
+        auto rays = BatchRayCaster::createLidarSweep(lookAt->eye, lookAt->center - lookAt->eye, lookAt->up, 64, 1024, -24.8, 2.0, range);
+
+        auto before_intersection = vsg::clock::now();
+        auto hits = rayCaster->intersect(rays);
+        auto after_intersection = vsg::clock::now();
+
+        size_t numHits = 0;
+        for (auto& hit : hits)
+        {
+            if (hit.valid()) ++numHits;
+        }
+
+        std::cout << "\nintersection_BatchRayCaster() " << rays.size() << " rays, " << numHits << " hits, " << rayCaster->meshes.size() << " meshes, " << rayCaster->numTriangles << " triangles, ";
+        std::cout << "update = " << rayCaster->updateTime << "ms, time = " << std::chrono::duration<double, std::chrono::milliseconds::period>(after_intersection - before_intersection).count() << "ms" << std::endl;
+    }
+
     void intersection_PolytopeIntersector(vsg::PointerEvent& pointerEvent)
     {
-        double size = 5.0;
+        double size = selectionSize;
         double xMin = static_cast<double>(pointerEvent.x) - size;
         double xMax = static_cast<double>(pointerEvent.x) + size;
         double yMin = static_cast<double>(pointerEvent.y) - size;
         double yMax = static_cast<double>(pointerEvent.y) + size;
 
-        auto intersector = vsg::PolytopeIntersector::create(*camera, xMin, yMin, xMax, yMax);
+        vsg::ref_ptr<vsg::PolytopeIntersector> intersector;
+        auto bvhIntersector = useBVH ? BVHPolytopeIntersector::create(*camera, xMin, yMin, xMax, yMax) : vsg::ref_ptr<BVHPolytopeIntersector>();
+        if (bvhIntersector)
+        {
+            bvhIntersector->operationThreads = operationThreads;
+            intersector = bvhIntersector;
+        }
+        else
+        {
+            intersector = vsg::PolytopeIntersector::create(*camera, xMin, yMin, xMax, yMax);
+        }
+
+        auto before_intersection = vsg::clock::now();
+
         scenegraph->accept(*intersector);
 
-        if (verbose) std::cout << "intersection_PolytopeIntersector(" << pointerEvent.x << ", " << pointerEvent.y << ") " << intersector->intersections.size() << ")" << std::endl;
+        auto after_intersection = vsg::clock::now();
+
+        if (verbose)
+        {
+            std::cout << "intersection_PolytopeIntersector(" << pointerEvent.x << ", " << pointerEvent.y << ") " << intersector->intersections.size() << ")";
+            std::cout << "time = " << std::chrono::duration<double, std::chrono::milliseconds::period>(after_intersection - before_intersection).count() << "ms" << std::endl;
+
+            if (bvhIntersector)
+            {
+                std::cout << "    BVH tests = " << bvhIntersector->numBVHTests << ", fallback tests = " << bvhIntersector->numFallbackTests << ", primitives tested = " << bvhIntersector->numPrimitivesTested;
+                std::cout << ", nodes inside = " << bvhIntersector->numNodesInside << ", nodes outside = " << bvhIntersector->numNodesOutside << std::endl;
+            }
+        }
+
+        if (compare)
+        {
+            // time the same selection with the standard per primitive tests
+            auto reference = vsg::PolytopeIntersector::create(*camera, xMin, yMin, xMax, yMax);
+
+            auto before_reference = vsg::clock::now();
+            scenegraph->accept(*reference);
+            auto after_reference = vsg::clock::now();
+
+            std::cout << "    vsg::PolytopeIntersector " << reference->intersections.size() << " intersections, time = " << std::chrono::duration<double, std::chrono::milliseconds::period>(after_reference - before_reference).count() << "ms" << std::endl;
+        }
 
         if (intersector->intersections.empty()) return;
 
@@ -246,6 +350,7 @@ public:
 protected:
     vsg::ref_ptr<vsg::PointerEvent> lastPointerEvent;
     vsg::ref_ptr<vsg::LineSegmentIntersector::Intersection> lastIntersection;
+    vsg::ref_ptr<BatchRayCaster> rayCaster;
 };
 
 int main(int argc, char** argv)
@@ -265,6 +370,11 @@ int main(int argc, char** argv)
     auto pointOfInterest = arguments.value(vsg::dvec3(0.0, 0.0, std::numeric_limits<double>::max()), "--poi");
     auto horizonMountainHeight = arguments.value(0.0, "--hmh");
     vsg::Path textureFile = arguments.value<std::string>("", "-t");
+    bool useBVH = !arguments.read("--no-bvh");
+    bool compare = arguments.read("--compare");
+    auto selectionSize = arguments.value(5.0, "--select-size");
+    bool parallelSelection = arguments.read("--parallel");
+    bool useShapeCache = arguments.read("--shape-cache");
 
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
@@ -376,6 +486,11 @@ int main(int argc, char** argv)
 
     auto intersectionHandler = IntersectionHandler::create(builder, camera, scene, ellipsoidModel, radius * 0.1, options);
     intersectionHandler->state = stateInfo;
+    intersectionHandler->useBVH = useBVH;
+    intersectionHandler->compare = compare;
+    intersectionHandler->selectionSize = selectionSize;
+    if (useShapeCache) intersectionHandler->shapeCache = ShapeCache::create(builder);
+    if (parallelSelection) intersectionHandler->operationThreads = vsg::OperationThreads::create(std::max(1u, std::thread::hardware_concurrency()) - 1);
     viewer->addEventHandler(intersectionHandler);
 
     // assign a CompileTraversal to the Builder that will compile for all the views assigned to the viewer,
@@ -397,6 +512,8 @@ int main(int argc, char** argv)
         viewer->present();
     }
 
+    if (intersectionHandler->shapeCache) intersectionHandler->shapeCache->report(std::cout);
+
     // clean up done automatically thanks to ref_ptr<>
     return 0;
 }
@@ -0,0 +1,97 @@
+#include <iostream>
+#include <vsg/all.h>
+
+#ifdef vsgXchange_FOUND
+#    include <vsgXchange/all.h>
+#endif
+
+#include "SpirvCache.h"
+
+int main(int argc, char** argv)
+{
+    // use the vsg::Options object to pass the ReaderWriter_all to use when reading files.
+    auto options = vsg::Options::create();
+#ifdef vsgXchange_FOUND
+    options->add(vsgXchange::all::create());
+#endif
+    options->paths = vsg::getEnvPaths("VSG_FILE_PATH");
+    options->sharedObjects = vsg::SharedObjects::create();
+
+    // set up defaults and read command line arguments to override them
+    vsg::CommandLine arguments(&argc, argv);
+
+    // read any command line options that the ReaderWriters support
+    options->readOptions(arguments);
+
+    auto cacheDirectory = arguments.value<vsg::Path>("spirv_cache", "--spirv-cache");
+    bool verbose = arguments.read({"-v", "--verbose"});
+
+    if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
+
+    if (argc <= 1)
+    {
+        std::cout << "Usage: vsgprecompileshaders [--spirv-cache directory] model [model...]" << std::endl;
+        std::cout << "Compiles the shader variants the models need into the SPIR-V cache, so later runs of vsgviewer --spirv-cache directory don't compile GLSL." << std::endl;
+        return 1;
+    }
+
+    // assign the built in ShaderSets so the loaders record the variants each model needs in them
+    options->shaderSets["flat"] = vsg::createFlatShadedShaderSet(options);
+    options->shaderSets["phong"] = vsg::createPhongShaderSet(options);
+    options->shaderSets["pbr"] = vsg::createPhysicsBasedRenderingShaderSet(options);
+
+    auto collectShaderStages = CollectShaderStages::create();
+    for (int i = 1; i < argc; ++i)
+    {
+        vsg::Path filename(argv[i]);
+        if (auto model = vsg::read_cast<vsg::Node>(filename, options))
+        {
+            model->accept(*collectShaderStages);
+            std::cout << "Loaded " << filename << std::endl;
+        }
+        else
+        {
+            std::cout << "Unable to load " << filename << std::endl;
+        }
+    }
+
+    // include the ShaderSets' variants, which cover the stages shared between the models as well as any not directly in the scene graphs
+    auto& stages = collectShaderStages->stages;
+    for (auto& [name, shaderSet] : options->shaderSets)
+    {
+        std::cout << "ShaderSet " << name << " variants = " << shaderSet->variants.size() << std::endl;
+        for (auto& [shaderCompileSettings, variantStages] : shaderSet->variants)
+        {
+            stages.insert(stages.end(), variantStages.begin(), variantStages.end());
+        }
+    }
+
+    auto shaderCompiler = vsg::ShaderCompiler::create();
+    if (!shaderCompiler->supported())
+    {
+        std::cout << "vsg::ShaderCompiler not supported, unable to precompile shaders." << std::endl;
+        return 1;
+    }
+
+    auto spirvCache = SpirvCache::create(cacheDirectory);
+
+    // compile each stage separately so one failure doesn't prevent the rest being cached
+    size_t numFailed = 0;
+    for (auto& stage : stages)
+    {
+        vsg::ShaderStages stagesToCompile{stage};
+        if (!spirvCache->compile(stagesToCompile, shaderCompiler, options)) ++numFailed;
+
+        if (verbose && stage->module && stage->module->hints)
+        {
+            std::cout << "    stage " << stage->stage << " defines { ";
+            for (auto& define : stage->module->hints->defines) std::cout << define << " ";
+            std::cout << "}" << std::endl;
+        }
+    }
+
+    std::cout << "Shader stages = " << stages.size() << ", failed = " << numFailed << std::endl;
+    spirvCache->report(std::cout);
+
+    return numFailed == 0 ? 0 : 1;
+}
@@ -1,10 +1,15 @@
+#include <atomic>
 #include <iostream>
+#include <thread>
 #include <vsg/all.h>
 
 #ifdef vsgXchange_FOUND
 #    include <vsgXchange/all.h>
 #endif
 
+#include "ParallelFor.h"
+#include "SpirvCache.h"
+
 // functions provided by text.cpp, flat.cpp
 extern vsg::ref_ptr<vsg::ShaderSet> text_ShaderSet(vsg::ref_ptr<const vsg::Options> options);
 extern vsg::ref_ptr<vsg::ShaderSet> flat_ShaderSet(vsg::ref_ptr<const vsg::Options> options);
@@ -128,6 +133,33 @@ std::set<std::string> supportedDefines(const vsg::ShaderSet& shaderSet)
     return defines;
 }
 
+// compile a variant's stages, unless they have already been compiled, then release their GLSL source
+bool compileVariant(vsg::ShaderStages& stagesToCompile, vsg::ref_ptr<vsg::ShaderCompiler> shaderCompiler, vsg::ref_ptr<SpirvCache> spirvCache, vsg::ref_ptr<const vsg::Options> options)
+{
+    size_t numShadersWithSource = 0;
+    for (auto& stage : stagesToCompile)
+    {
+        if (stage->module->code.empty() && !stage->module->source.empty()) ++numShadersWithSource;
+    }
+
+    // no need to compile so skip compilation
+    bool result = true;
+    if (numShadersWithSource == stagesToCompile.size())
+    {
+        if (spirvCache)
+            result = spirvCache->compile(stagesToCompile, shaderCompiler, options);
+        else
+            result = shaderCompiler->compile(stagesToCompile, {}, options);
+    }
+
+    for (auto& stage : stagesToCompile)
+    {
+        stage->module->source.clear();
+    }
+
+    return result;
+}
+
 int main(int argc, char** argv)
 {
     // use the vsg::Options object to pass the ReaderWriter_all to use when reading files.
@@ -152,6 +184,14 @@ int main(int argc, char** argv)
     bool stripShaderSetBeforeWrite = arguments.read({"-s", "--strip"});
     bool compileShaders = !arguments.read({"--nc", "--no-compile"});
 
+    // reuse SPIR-V compiled by previous runs, or by vsgprecompileshaders, rather than compiling every variant
+    vsg::ref_ptr<SpirvCache> spirvCache;
+    if (vsg::Path cacheDirectory; arguments.read("--spirv-cache", cacheDirectory)) spirvCache = SpirvCache::create(cacheDirectory);
+
+    // compile the variants across multiple threads, --parallel uses a thread per core
+    auto numThreads = arguments.value<uint32_t>(1, "--threads");
+    if (arguments.read("--parallel")) numThreads = std::max(1u, std::thread::hardware_concurrency());
+
     vsg::ref_ptr<vsg::ShaderSet> shaderSet;
     if (inputFilename)
     {
@@ -222,6 +262,33 @@ int main(int argc, char** argv)
         std::cout << std::endl;
     }
 
+    // assign every combination of up to maxDefines of the supported defines, i.e. --phong --all-variants 2 --parallel to benchmark compiling them
+    if (int maxDefines = 0; arguments.read("--all-variants", maxDefines))
+    {
+        std::vector<std::set<std::string>> combinations{{}};
+        for (auto& define : defines)
+        {
+            size_t numCombinations = combinations.size();
+            for (size_t i = 0; i < numCombinations; ++i)
+            {
+                if (static_cast<int>(combinations[i].size()) >= maxDefines) continue;
+
+                auto combination = combinations[i];
+                combination.insert(define);
+                combinations.push_back(combination);
+            }
+        }
+
+        for (auto& combination : combinations)
+        {
+            auto scs = vsg::ShaderCompileSettings::create();
+            scs->defines = combination;
+            shaderSet->getShaderStages(scs);
+        }
+
+        std::cout << "all variants with up to " << maxDefines << " defines : " << combinations.size() << std::endl;
+    }
+
     // load remaining command line parameters as models to help fill out the required ShaderSet variants
     for (int i = 1; i < argc; ++i)
     {
@@ -250,28 +317,60 @@ int main(int argc, char** argv)
         if (shaderCompiler->supported())
         {
             std::cout << "\ncompiling shaderSet->variants.size() = " << shaderSet->variants.size() << std::endl;
-            std::cout << "{" << std::endl;
+
+            // gather the variants in the ShaderSet's order, deferring any with ShaderModules shared with an earlier variant so no module is compiled by two threads at once
+            std::vector<vsg::ShaderStages*> variants;
+            std::vector<vsg::ShaderStages*> deferred;
+            std::set<vsg::ShaderModule*> modules;
             for (auto& [shaderCompileSetting, stagesToCompile] : shaderSet->variants)
             {
-                std::cout << "    " << shaderCompileSetting << " : ";
-                for (auto& define : shaderCompileSetting->defines) std::cout << define << " ";
-
-                size_t numShadersWithSource = 0;
+                bool shared = false;
                 for (auto& stage : stagesToCompile)
                 {
-                    if (stage->module->code.empty() && !stage->module->source.empty()) ++numShadersWithSource;
+                    if (!modules.insert(stage->module.get()).second) shared = true;
                 }
+                (shared ? deferred : variants).push_back(&stagesToCompile);
+            }
 
-                // no need to compile so skip compilation
-                if (numShadersWithSource == stagesToCompile.size())
-                {
-                    shaderCompiler->compile(stagesToCompile, {}, options);
-                }
+            auto startTime = vsg::clock::now();
+            std::atomic_size_t numFailed = 0;
 
-                for (auto& stage : stagesToCompile)
+            if (numThreads > 1 && variants.size() > 1)
+            {
+                // each thread takes variants from a shared list until it's exhausted, each variant is written only by the thread that takes it so the result doesn't depend on scheduling
+                auto operationThreads = vsg::OperationThreads::create(numThreads - 1);
+                std::atomic_size_t next = 0;
+                parallelFor(operationThreads, numThreads, 1, [&](size_t, size_t) {
+                    // each thread uses its own ShaderCompiler
+                    auto threadShaderCompiler = vsg::ShaderCompiler::create();
+                    for (size_t i = next++; i < variants.size(); i = next++)
+                    {
+                        if (!compileVariant(*variants[i], threadShaderCompiler, spirvCache, options)) ++numFailed;
+                    }
+                });
+            }
+            else
+            {
+                for (auto variant : variants)
                 {
-                    stage->module->source.clear();
+                    if (!compileVariant(*variant, shaderCompiler, spirvCache, options)) ++numFailed;
                 }
+            }
+
+            for (auto variant : deferred)
+            {
+                if (!compileVariant(*variant, shaderCompiler, spirvCache, options)) ++numFailed;
+            }
+
+            auto compileTime = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+            std::cout << "compiled " << (variants.size() + deferred.size()) << " variants in " << compileTime << "ms using " << numThreads << " threads, failed = " << numFailed << std::endl;
+
+            // share the compiled stages, done serially in the ShaderSet's order so the result is the same however the variants were compiled
+            std::cout << "{" << std::endl;
+            for (auto& [shaderCompileSetting, stagesToCompile] : shaderSet->variants)
+            {
+                std::cout << "    " << shaderCompileSetting << " : ";
+                for (auto& define : shaderCompileSetting->defines) std::cout << define << " ";
 
                 for (auto& stage : stagesToCompile)
                 {
@@ -307,6 +406,8 @@ int main(int argc, char** argv)
             std::cout << "}" << std::endl;
         }
 
+        if (spirvCache) spirvCache->report(std::cout);
+
         std::cout << "stages.size() = " << existing_stages.size() << std::endl;
         for (auto& stage : existing_stages)
         {
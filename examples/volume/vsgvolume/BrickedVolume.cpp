@@ -0,0 +1,323 @@
+#include "BrickedVolume.h"
+
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace
+{
+    double milliseconds(vsg::clock::time_point start)
+    {
+        return std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - start).count();
+    }
+
+    // the six planes of the view frustum, pointing inwards
+    std::array<vsg::dvec4, 6> frustumPlanes(const vsg::dmat4& m)
+    {
+        auto row = [&m](int i) { return vsg::dvec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+        return {row(3) + row(0), row(3) - row(0), row(3) + row(1), row(3) - row(1), row(2), row(3) - row(2)};
+    }
+
+    bool intersects(const std::array<vsg::dvec4, 6>& planes, const vsg::dvec3& minCorner, const vsg::dvec3& maxCorner)
+    {
+        for (auto& plane : planes)
+        {
+            // the corner furthest along the plane's normal
+            vsg::dvec3 corner(plane.x >= 0.0 ? maxCorner.x : minCorner.x, plane.y >= 0.0 ? maxCorner.y : minCorner.y, plane.z >= 0.0 ? maxCorner.z : minCorner.z);
+            if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0.0) return false;
+        }
+        return true;
+    }
+} // namespace
+
+BrickedVolume::BrickedVolume(uint32_t in_volumeSize, uint32_t in_brickSize, uint32_t in_slotsPerAxis, Generator in_generator, vsg::ref_ptr<vsg::OperationThreads> in_operationThreads) :
+    volumeSize(std::max(in_volumeSize, 1u)),
+    brickSize(std::clamp(in_brickSize, 1u, volumeSize)),
+    slotsPerAxis(std::clamp(in_slotsPerAxis, 1u, 255u)),
+    bricksPerAxis((volumeSize + brickSize - 1) / brickSize),
+    generator(in_generator),
+    operationThreads(in_operationThreads)
+{
+    uint32_t slotSize = brickSize + 2;
+    uint32_t atlasSize = slotsPerAxis * slotSize;
+
+    atlas = vsg::ubyteArray3D::create(atlasSize, atlasSize, atlasSize, vsg::Data::Properties{VK_FORMAT_R8_UNORM});
+    atlas->properties.dataVariance = vsg::DYNAMIC_DATA;
+    std::memset(atlas->dataPointer(), 0, atlas->dataSize());
+
+    pageTable = vsg::ubvec4Array3D::create(bricksPerAxis, bricksPerAxis, bricksPerAxis, vsg::Data::Properties{VK_FORMAT_R8G8B8A8_UINT});
+    pageTable->properties.dataVariance = vsg::DYNAMIC_DATA;
+    std::memset(pageTable->dataPointer(), 0, pageTable->dataSize());
+
+    brickInfo = vsg::ubvec4Array3D::create(bricksPerAxis, bricksPerAxis, bricksPerAxis, vsg::Data::Properties{VK_FORMAT_R8G8B8A8_UNORM});
+
+    settings = vsg::vec4Array::create(3);
+    settings->at(0) = vsg::vec4(static_cast<float>(volumeSize), static_cast<float>(volumeSize), static_cast<float>(volumeSize), 0.0f);
+    settings->at(1) = vsg::vec4(static_cast<float>(bricksPerAxis), static_cast<float>(bricksPerAxis), static_cast<float>(bricksPerAxis), static_cast<float>(brickSize));
+    settings->at(2) = vsg::vec4(static_cast<float>(atlasSize), static_cast<float>(atlasSize), static_cast<float>(atlasSize), emptyThreshold);
+
+    _bricks.resize(bricksPerAxis * bricksPerAxis * bricksPerAxis);
+    for (uint32_t z = 0; z < bricksPerAxis; ++z)
+    {
+        for (uint32_t y = 0; y < bricksPerAxis; ++y)
+        {
+            for (uint32_t x = 0; x < bricksPerAxis; ++x)
+            {
+                _bricks[(z * bricksPerAxis + y) * bricksPerAxis + x].index.set(x, y, z);
+            }
+        }
+    }
+
+    uint32_t numSlots = slotsPerAxis * slotsPerAxis * slotsPerAxis;
+    _slots.resize(numSlots, ~0u);
+    for (uint32_t slot = numSlots; slot > 0; --slot) _freeSlots.push_back(slot - 1);
+}
+
+void BrickedVolume::_dispatch(size_t count, const std::function<void(size_t, size_t)>& function)
+{
+    // a few operations per thread so uneven brick costs balance out
+    size_t numThreads = operationThreads ? operationThreads->threads.size() + 1 : 1;
+    parallelFor(operationThreads, count, count / (numThreads * 4), function);
+}
+
+void BrickedVolume::_generate(const Brick& brick, uint8_t* voxels) const
+{
+    // the apron voxels come from the neighbouring bricks, clamped at the edges of the volume to match CLAMP_TO_EDGE
+    uint32_t slotSize = brickSize + 2;
+    int32_t maxVoxel = static_cast<int32_t>(volumeSize) - 1;
+    vsg::ivec3 origin(static_cast<int32_t>(brick.index.x * brickSize) - 1, static_cast<int32_t>(brick.index.y * brickSize) - 1, static_cast<int32_t>(brick.index.z * brickSize) - 1);
+
+    for (uint32_t k = 0; k < slotSize; ++k)
+    {
+        uint32_t d = static_cast<uint32_t>(std::clamp(origin.z + static_cast<int32_t>(k), 0, maxVoxel));
+        for (uint32_t j = 0; j < slotSize; ++j)
+        {
+            uint32_t r = static_cast<uint32_t>(std::clamp(origin.y + static_cast<int32_t>(j), 0, maxVoxel));
+            for (uint32_t i = 0; i < slotSize; ++i)
+            {
+                uint32_t c = static_cast<uint32_t>(std::clamp(origin.x + static_cast<int32_t>(i), 0, maxVoxel));
+                float value = std::clamp(generator(c, r, d), 0.0f, 1.0f);
+                *(voxels++) = static_cast<uint8_t>(value * 255.0f + 0.5f);
+            }
+        }
+    }
+}
+
+vsg::uivec3 BrickedVolume::_slotOrigin(uint32_t slot) const
+{
+    uint32_t slotSize = brickSize + 2;
+    return vsg::uivec3((slot % slotsPerAxis) * slotSize, ((slot / slotsPerAxis) % slotsPerAxis) * slotSize, (slot / (slotsPerAxis * slotsPerAxis)) * slotSize);
+}
+
+void BrickedVolume::_copyToSlot(const uint8_t* voxels, uint32_t slot)
+{
+    uint32_t slotSize = brickSize + 2;
+    auto origin = _slotOrigin(slot);
+
+    for (uint32_t k = 0; k < slotSize; ++k)
+    {
+        for (uint32_t j = 0; j < slotSize; ++j)
+        {
+            std::memcpy(&atlas->at(origin.x, origin.y + j, origin.z + k), voxels, slotSize);
+            voxels += slotSize;
+        }
+    }
+}
+
+vsg::ref_ptr<DirtyRegionUpload> BrickedVolume::createAtlasUpload(vsg::ref_ptr<vsg::ImageInfo> atlasInfo, uint32_t ringSize)
+{
+    // the atlas is uploaded whole when compiled, after that only the slots paged in are copied so the TransferTask mustn't upload it
+    atlas->properties.dataVariance = vsg::STATIC_DATA;
+
+    // room for a frame's bricks, with slack for the merging of touching slots into larger boxes
+    uint32_t slotSize = brickSize + 2;
+    VkDeviceSize frameCapacity = static_cast<VkDeviceSize>(bricksPerFrame) * slotSize * slotSize * slotSize * 2;
+
+    atlasUpload = DirtyRegionUpload::create(vsg::ImageInfoList{atlasInfo}, ringSize, frameCapacity);
+    atlasUpload->dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    return atlasUpload;
+}
+
+void BrickedVolume::computeBrickInfo()
+{
+    auto startTime = vsg::clock::now();
+
+    uint32_t slotSize = brickSize + 2;
+    size_t voxelsPerBrick = slotSize * slotSize * slotSize;
+    uint8_t threshold = static_cast<uint8_t>(std::clamp(emptyThreshold, 0.0f, 1.0f) * 255.0f);
+
+    _dispatch(_bricks.size(), [&](size_t begin, size_t end) {
+        std::vector<uint8_t> voxels(voxelsPerBrick);
+        for (size_t bi = begin; bi < end; ++bi)
+        {
+            auto& brick = _bricks[bi];
+            _generate(brick, voxels.data());
+
+            uint8_t minValue = 255, maxValue = 0;
+            uint64_t total = 0;
+            for (auto value : voxels)
+            {
+                minValue = std::min(minValue, value);
+                maxValue = std::max(maxValue, value);
+                total += value;
+            }
+
+            brick.empty = maxValue <= threshold;
+            brickInfo->set(brick.index.x, brick.index.y, brick.index.z, vsg::ubvec4(minValue, maxValue, static_cast<uint8_t>(total / voxelsPerBrick), 0));
+        }
+    });
+
+    _candidates.clear();
+    numEmptyBricks = 0;
+    for (uint32_t bi = 0; bi < _bricks.size(); ++bi)
+    {
+        if (_bricks[bi].empty)
+            ++numEmptyBricks;
+        else
+            _candidates.push_back(bi);
+    }
+    settings->at(2).w = emptyThreshold;
+    _eyeValid = false;
+
+    infoTime += milliseconds(startTime);
+}
+
+void BrickedVolume::update(const vsg::dvec3& eye, const vsg::dmat4& projectionViewMatrix)
+{
+    auto startTime = vsg::clock::now();
+    ++numFrames;
+
+    // reject the bricks outside the view frustum then prioritize the rest by distance from the eye, only needed when the view has changed
+    if (!_eyeValid || eye != _eye || projectionViewMatrix != _projectionViewMatrix)
+    {
+        auto planes = frustumPlanes(projectionViewMatrix);
+        double scale = static_cast<double>(brickSize) / static_cast<double>(volumeSize);
+        for (auto bi : _candidates)
+        {
+            auto& brick = _bricks[bi];
+            vsg::dvec3 minCorner = vsg::dvec3(brick.index) * scale;
+            vsg::dvec3 maxCorner = minCorner + vsg::dvec3(scale, scale, scale);
+            brick.visible = intersects(planes, minCorner, maxCorner);
+            if (!brick.visible) continue;
+
+            vsg::dvec3 delta(std::max({minCorner.x - eye.x, 0.0, eye.x - maxCorner.x}),
+                             std::max({minCorner.y - eye.y, 0.0, eye.y - maxCorner.y}),
+                             std::max({minCorner.z - eye.z, 0.0, eye.z - maxCorner.z}));
+            brick.distance = vsg::length(delta);
+        }
+        std::sort(_candidates.begin(), _candidates.end(), [&](uint32_t lhs, uint32_t rhs) {
+            auto& lhsBrick = _bricks[lhs];
+            auto& rhsBrick = _bricks[rhs];
+            if (lhsBrick.visible != rhsBrick.visible) return lhsBrick.visible;
+            return lhsBrick.visible && lhsBrick.distance < rhsBrick.distance;
+        });
+
+        _eye = eye;
+        _projectionViewMatrix = projectionViewMatrix;
+        _eyeValid = true;
+    }
+
+    // the nearest visible bricks that fit in the atlas are wanted, page in the nearest of those that aren't resident
+    size_t numVisible = std::count_if(_candidates.begin(), _candidates.end(), [&](uint32_t bi) { return _bricks[bi].visible; });
+    size_t numWanted = std::min(numVisible, _slots.size());
+    std::vector<uint32_t> toLoad;
+    for (size_t ci = 0; ci < numWanted && toLoad.size() < bricksPerFrame; ++ci)
+    {
+        if (_bricks[_candidates[ci]].slot < 0) toLoad.push_back(_candidates[ci]);
+    }
+
+    if (toLoad.empty())
+    {
+        // still update the upload so the previous frame's copies aren't recorded again
+        if (atlasUpload) atlasUpload->update();
+
+        updateTime += milliseconds(startTime);
+        return;
+    }
+
+    // take free slots first, then evict the furthest resident bricks that are no longer wanted
+    size_t evictCursor = _candidates.size();
+    for (auto bi : toLoad)
+    {
+        uint32_t slot = ~0u;
+        if (!_freeSlots.empty())
+        {
+            slot = _freeSlots.back();
+            _freeSlots.pop_back();
+        }
+        else
+        {
+            while (evictCursor > numWanted && slot == ~0u)
+            {
+                auto& evicted = _bricks[_candidates[--evictCursor]];
+                if (evicted.slot >= 0)
+                {
+                    slot = static_cast<uint32_t>(evicted.slot);
+                    evicted.slot = -1;
+                    pageTable->set(evicted.index.x, evicted.index.y, evicted.index.z, vsg::ubvec4(0, 0, 0, 0));
+                    ++numBricksEvicted;
+                }
+            }
+        }
+        if (slot == ~0u) break;
+
+        _bricks[bi].slot = static_cast<int32_t>(slot);
+        _slots[slot] = bi;
+    }
+
+    // generate the bricks in parallel, each writes to its own slot of the atlas
+    auto generateStartTime = vsg::clock::now();
+    size_t voxelsPerBrick = (brickSize + 2) * (brickSize + 2) * (brickSize + 2);
+    _dispatch(toLoad.size(), [&](size_t begin, size_t end) {
+        std::vector<uint8_t> voxels(voxelsPerBrick);
+        for (size_t li = begin; li < end; ++li)
+        {
+            auto& brick = _bricks[toLoad[li]];
+            if (brick.slot < 0) continue;
+
+            _generate(brick, voxels.data());
+            _copyToSlot(voxels.data(), static_cast<uint32_t>(brick.slot));
+        }
+    });
+    generateTime += milliseconds(generateStartTime);
+
+    for (auto bi : toLoad)
+    {
+        auto& brick = _bricks[bi];
+        if (brick.slot < 0) continue;
+
+        uint32_t slot = static_cast<uint32_t>(brick.slot);
+        pageTable->set(brick.index.x, brick.index.y, brick.index.z, vsg::ubvec4(static_cast<uint8_t>(slot % slotsPerAxis), static_cast<uint8_t>((slot / slotsPerAxis) % slotsPerAxis), static_cast<uint8_t>(slot / (slotsPerAxis * slotsPerAxis)), 1));
+        ++numBricksPaged;
+
+        if (atlasUpload) atlasUpload->dirty(_slotOrigin(slot), vsg::uivec3(brickSize + 2, brickSize + 2, brickSize + 2));
+    }
+
+    if (atlasUpload)
+        atlasUpload->update();
+    else
+        atlas->dirty();
+    pageTable->dirty();
+
+    updateTime += milliseconds(startTime);
+}
+
+size_t BrickedVolume::textureMemory() const
+{
+    return atlas->dataSize() + pageTable->dataSize() + brickInfo->dataSize();
+}
+
+void BrickedVolume::report(std::ostream& out) const
+{
+    double MB = 1024.0 * 1024.0;
+    double denseSize = static_cast<double>(volumeSize) * static_cast<double>(volumeSize) * static_cast<double>(volumeSize) * sizeof(float);
+    size_t numResident = _slots.size() - _freeSlots.size();
+
+    out << "BrickedVolume " << volumeSize << "^3 voxels, " << bricksPerAxis << "^3 bricks of " << brickSize << "^3, empty bricks = " << numEmptyBricks << " (" << (100.0 * numEmptyBricks / _bricks.size()) << "%)" << std::endl;
+    out << "    atlas slots = " << _slots.size() << ", resident = " << numResident << ", texture memory = " << (static_cast<double>(textureMemory()) / MB) << "MB, dense floatArray3D = " << (denseSize / MB) << "MB" << std::endl;
+    out << "    brick info = " << infoTime << "ms, bricks paged = " << numBricksPaged << ", evicted = " << numBricksEvicted << ", generate = " << generateTime << "ms";
+    if (numFrames > 0) out << ", update = " << (updateTime / static_cast<double>(numFrames)) << "ms/frame";
+    out << std::endl;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include "DirtyRegionUpload.h"
+
+#include <functional>
+#include <ostream>
+
+/// BrickedVolume holds a large volume as a grid of bricks of brickSize^3 voxels, so only the bricks close to the viewer need to be resident on the GPU.
+/// Resident bricks are stored as 8 bit voxels in the slots of a 3D atlas texture, each with a one voxel apron so trilinear filtering matches across
+/// brick boundaries, and a page table texture maps each brick to its slot. A brick info texture holds the min, max and mean of every brick, the
+/// fragment shader skips bricks whose max is below the empty threshold and falls back to the mean for bricks that haven't been paged in yet.
+/// Bricks are generated from the generator function on demand, spread across OperationThreads, and only the bricks within the view frustum are paged in.
+/// With an atlas upload command created, only the atlas slots paged in each frame are copied to the GPU rather than the whole atlas.
+class BrickedVolume : public vsg::Inherit<vsg::Object, BrickedVolume>
+{
+public:
+    /// return the value of a voxel in the range 0 to 1, must be safe to call from multiple threads
+    using Generator = std::function<float(uint32_t c, uint32_t r, uint32_t d)>;
+
+    BrickedVolume(uint32_t in_volumeSize, uint32_t in_brickSize, uint32_t in_slotsPerAxis, Generator in_generator, vsg::ref_ptr<vsg::OperationThreads> in_operationThreads = {});
+
+    const uint32_t volumeSize;   // voxels along each side of the volume
+    const uint32_t brickSize;    // voxels along each side of a brick
+    const uint32_t slotsPerAxis; // bricks along each side of the atlas
+    const uint32_t bricksPerAxis;
+    Generator generator;
+    vsg::ref_ptr<vsg::OperationThreads> operationThreads;
+
+    uint32_t bricksPerFrame = 64; // maximum number of bricks paged in each frame
+    float emptyThreshold = 0.5f;  // bricks with no voxels above this value are skipped
+
+    vsg::ref_ptr<vsg::ubyteArray3D> atlas;     // R8_UNORM
+    vsg::ref_ptr<vsg::ubvec4Array3D> pageTable; // R8G8B8A8_UINT, xyz atlas slot, w 1 when resident
+    vsg::ref_ptr<vsg::ubvec4Array3D> brickInfo; // R8G8B8A8_UNORM, min, max and mean of each brick including its apron
+    vsg::ref_ptr<vsg::vec4Array> settings;      // volume size, brick count and size, atlas size and empty threshold, for the fragment shader
+    vsg::ref_ptr<DirtyRegionUpload> atlasUpload;
+
+    /// generate every brick once to compute the brick info, call before compiling.
+    void computeBrickInfo();
+
+    /// create the command that copies the slots paged in to the atlas image, to place in the CommandGraph ahead of the RenderGraph. Call before compiling.
+    vsg::ref_ptr<DirtyRegionUpload> createAtlasUpload(vsg::ref_ptr<vsg::ImageInfo> atlasInfo, uint32_t ringSize);
+
+    /// page in the non empty bricks within the view frustum nearest to eye, with eye and projectionViewMatrix in the volume's 0 to 1 texture coordinate space.
+    /// Call before Viewer::recordAndSubmit().
+    void update(const vsg::dvec3& eye, const vsg::dmat4& projectionViewMatrix);
+
+    /// GPU memory used by the textures
+    size_t textureMemory() const;
+
+    void report(std::ostream& out) const;
+
+    // stats
+    uint32_t numEmptyBricks = 0;
+    uint64_t numFrames = 0;
+    uint64_t numBricksPaged = 0;
+    uint64_t numBricksEvicted = 0;
+    double infoTime = 0.0;    // milliseconds spent in computeBrickInfo()
+    double generateTime = 0.0; // milliseconds spent generating the bricks paged in
+    double updateTime = 0.0;   // milliseconds spent in update(), including generation
+
+protected:
+    struct Brick
+    {
+        vsg::uivec3 index;
+        int32_t slot = -1;
+        bool empty = false;
+        bool visible = true;
+        double distance = 0.0;
+    };
+
+    void _dispatch(size_t count, const std::function<void(size_t, size_t)>& function);
+    void _generate(const Brick& brick, uint8_t* voxels) const;
+    void _copyToSlot(const uint8_t* voxels, uint32_t slot);
+    vsg::uivec3 _slotOrigin(uint32_t slot) const;
+
+    std::vector<Brick> _bricks;
+    std::vector<uint32_t> _candidates; // non empty bricks, visible then nearest first each time the view changes
+    std::vector<uint32_t> _slots;      // brick in each slot
+    std::vector<uint32_t> _freeSlots;
+    vsg::dvec3 _eye = {-1.0, -1.0, -1.0};
+    vsg::dmat4 _projectionViewMatrix;
+    bool _eyeValid = false;
+};
@@ -1,6 +1,9 @@
 #include <iostream>
 #include <vsg/all.h>
 
+#include "BrickedVolume.h"
+#include "ParallelFor.h"
+
 #ifdef vsgXchange_FOUND
 #    include <vsgXchange/all.h>
 #endif
@@ -118,9 +121,148 @@ void main() {
     outColor = fragColor;
 })";
 
-void updateBaseTexture3D(vsg::floatArray3D& image, float value)
+char volume_bricked_frag[] = R"(
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(binding = 0) uniform sampler3D atlas;
+layout(binding = 1) uniform usampler3D pageTable;
+layout(binding = 2) uniform sampler3D brickInfo;
+layout(binding = 3) uniform VolumeSettings
+{
+    vec4 volume; // xyz voxels along each axis of the volume
+    vec4 bricks; // xyz bricks along each axis, w voxels along each side of a brick
+    vec4 atlas;  // xyz texels along each axis of the atlas, w value below which bricks are empty
+} settings;
+
+layout(location = 0) in vec4 cameraPos;
+layout(location = 1) in vec4 vertexPos;
+layout(location = 2) in mat4 texgen;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec4 t0 = vertexPos;
+    vec4 te = cameraPos;
+    if( te.x>=0.0 && te.x<=1.0 &&
+        te.y>=0.0 && te.y<=1.0 &&
+        te.z>=0.0 && te.z<=1.0
+        )
+    { } else {
+        if (te.x<0.0){
+            float r = -te.x / (t0.x-te.x);
+            te = te + (t0-te)*r;
+        }
+        if (te.x>1.0){
+            float r = (1.0-te.x) / (t0.x-te.x);
+            te = te + (t0-te)*r;
+        }
+        if (te.y<0.0){
+            float r = -te.y / (t0.y-te.y);
+            te = te + (t0-te)*r;
+        }
+        if (te.y>1.0){
+            float r = (1.0-te.y) / (t0.y-te.y);
+            te = te + (t0-te)*r;
+        }
+        if (te.z<0.0){
+            float r = -te.z / (t0.z-te.z);
+            te = te + (t0-te)*r;
+        }
+        if (te.z>1.0){
+            float r = (1.0-te.z) / (t0.z-te.z);
+            te = te + (t0-te)*r;
+        }
+    }
+    t0 = t0 * texgen;
+    te = te * texgen;
+
+    const float min_iterations = 2.0;
+    const float max_iterations = 2048.0;
+
+    float TransparencyValue = 0.2;
+    float AlphaFuncValue = 0.1;
+    float SampleDensityValue = 0.005; // 0.5 / texture_sample_count
+
+    float num_iterations = ceil(length((te-t0).xyz)/SampleDensityValue);
+    if (num_iterations<min_iterations) num_iterations = min_iterations;
+    else if (num_iterations>max_iterations) num_iterations = max_iterations;
+
+    vec3 deltaTexCoord=(te-t0).xyz/(num_iterations-1.0);
+    vec3 texcoord = t0.xyz;
+
+    float brickSize = settings.bricks.w;
+    ivec3 maxBrick = ivec3(settings.bricks.xyz) - 1;
+    vec3 brickExtent = vec3(brickSize) / settings.volume.xyz;
+
+    vec4 fragColor = vec4(0.0, 0.0, 0.0, 0.0);
+    while(num_iterations>0.0)
+    {
+        vec3 voxel = texcoord * settings.volume.xyz;
+        ivec3 brick = clamp(ivec3(floor(voxel / brickSize)), ivec3(0), maxBrick);
+
+        vec4 info = texelFetch(brickInfo, brick, 0);
+        if (info.g <= settings.atlas.w)
+        {
+            // none of the brick's samples can pass the alpha test, so step straight to the first sample beyond it
+            vec3 brickMin = vec3(brick) * brickExtent;
+            vec3 exitPlane = brickMin + step(0.0, deltaTexCoord) * brickExtent;
+            vec3 exitSteps = abs(exitPlane - texcoord) / max(abs(deltaTexCoord), vec3(1e-10));
+            float steps = min(floor(min(exitSteps.x, min(exitSteps.y, exitSteps.z))) + 1.0, num_iterations);
+
+            texcoord += deltaTexCoord * steps;
+            num_iterations -= steps;
+            continue;
+        }
+
+        float alpha;
+        uvec4 page = texelFetch(pageTable, brick, 0);
+        if (page.w != 0u)
+        {
+            // bricks are stored with a one voxel apron either side
+            vec3 atlasCoord = vec3(page.xyz) * (brickSize + 2.0) + 1.0 + (voxel - vec3(brick) * brickSize);
+            alpha = texture(atlas, atlasCoord / settings.atlas.xyz).r;
+        }
+        else
+        {
+            // brick not paged in yet, so use its mean
+            alpha = texture(brickInfo, texcoord).b;
+        }
+
+        vec4 color = vec4(alpha, alpha, alpha, alpha * TransparencyValue);
+        float r = color.a;
+        if (r > AlphaFuncValue)
+        {
+            fragColor.rgb = mix(fragColor.rgb, color.rgb, r);
+            fragColor.a += r;
+        }
+
+        if (color.a > fragColor.a)
+        {
+            fragColor = color;
+        }
+
+        texcoord += deltaTexCoord;
+        --num_iterations;
+    }
+    if (fragColor.a>1.0) fragColor.a = 1.0;
+    if (fragColor.a<AlphaFuncValue) discard;
+    outColor = fragColor;
+})";
+
+float syntheticVoxel(float c_ratio, float r_ratio, float d_ratio, float value)
 {
-    for (uint32_t d = 0; d < image.depth(); ++d)
+    vsg::vec3 delta((r_ratio - 0.5f), (c_ratio - 0.5f), (d_ratio - 0.5f));
+    float angle = atan2(delta.x, delta.y);
+    float distance_from_center = sqrt(d_ratio * d_ratio + r_ratio * r_ratio);
+
+    float intensity = (sin(1.0f * angle + 30.0f * distance_from_center + 10.0f * value) + 1.0f) * 0.5f;
+    return 1.0f - intensity;
+}
+
+void updateSlices(vsg::floatArray3D& image, float value, uint32_t begin, uint32_t end)
+{
+    for (uint32_t d = begin; d < end; ++d)
     {
         float d_ratio = static_cast<float>(d) / static_cast<float>(image.depth() - 1);
         for (uint32_t r = 0; r < image.height(); ++r)
@@ -129,16 +271,19 @@ void updateBaseTexture3D(vsg::floatArray3D& image, float value)
             for (uint32_t c = 0; c < image.width(); ++c)
             {
                 float c_ratio = static_cast<float>(c) / static_cast<float>(image.width() - 1);
-
-                vsg::vec3 delta((r_ratio - 0.5f), (c_ratio - 0.5f), (d_ratio - 0.5f));
-                float angle = atan2(delta.x, delta.y);
-                float distance_from_center = sqrt(d_ratio * d_ratio + r_ratio * r_ratio);
-
-                float intensity = (sin(1.0f * angle + 30.0f * distance_from_center + 10.0f * value) + 1.0f) * 0.5f;
-                image.set(c, r, d, 1.0f - intensity);
+                image.set(c, r, d, syntheticVoxel(c_ratio, r_ratio, d_ratio, value));
             }
         }
     }
+}
+
+void updateBaseTexture3D(vsg::floatArray3D& image, float value, vsg::ref_ptr<vsg::OperationThreads> operationThreads = {})
+{
+    // split the slices between the threads
+    uint32_t numThreads = operationThreads ? static_cast<uint32_t>(operationThreads->threads.size()) + 1 : 1;
+    parallelFor(operationThreads, image.depth(), (image.depth() + numThreads - 1) / numThreads, [&image, value](size_t begin, size_t end) {
+        updateSlices(image, value, static_cast<uint32_t>(begin), static_cast<uint32_t>(end));
+    });
 
     image.dirty();
 }
@@ -205,14 +350,25 @@ int main(int argc, char** argv)
     options->add(vsgXchange::all::create());
 #endif
 
+    auto numFrames = arguments.value(-1, "-f");
+    auto numThreads = arguments.value<uint32_t>(std::max(1u, std::thread::hardware_concurrency()), "--threads");
+    auto operationThreads = numThreads > 1 ? vsg::OperationThreads::create(numThreads - 1) : vsg::ref_ptr<vsg::OperationThreads>();
+
+    // bricked volume paged into a 3D atlas by distance from the eye, with empty bricks skipped by the ray marching
+    auto volumeSize = arguments.value<uint32_t>(0, "--bricked");
+    auto brickSize = arguments.value<uint32_t>(32, "--brick-size");
+    auto atlasSlots = arguments.value<uint32_t>(12, "--atlas-slots");
+    auto bricksPerFrame = arguments.value<uint32_t>(64, "--bricks-per-frame");
+    auto denseSize = arguments.value<uint32_t>(100, "--size");
+
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
     // load shaders
     auto vertexShader = vsg::read_cast<vsg::ShaderStage>("shaders/volume.vert", options);
-    auto fragmentShader = vsg::read_cast<vsg::ShaderStage>("shaders/volume.frag", options);
+    auto fragmentShader = vsg::read_cast<vsg::ShaderStage>(volumeSize > 0 ? "shaders/volume_bricked.frag" : "shaders/volume.frag", options);
 
     if (!vertexShader) vertexShader = vsg::ShaderStage::create(VK_SHADER_STAGE_VERTEX_BIT, "main", volume_vert);
-    if (!fragmentShader) fragmentShader = vsg::ShaderStage::create(VK_SHADER_STAGE_FRAGMENT_BIT, "main", volume_frag);
+    if (!fragmentShader) fragmentShader = vsg::ShaderStage::create(VK_SHADER_STAGE_FRAGMENT_BIT, "main", volumeSize > 0 ? volume_bricked_frag : volume_frag);
 
     if (!vertexShader || !fragmentShader)
     {
@@ -220,8 +376,26 @@ int main(int argc, char** argv)
         return {};
     }
 
+    vsg::ref_ptr<BrickedVolume> brickedVolume;
+    if (volumeSize > 0)
+    {
+        float value = 1.0f;
+        float scale = 1.0f / static_cast<float>(volumeSize - 1);
+        auto generator = [value, scale](uint32_t c, uint32_t r, uint32_t d) {
+            return syntheticVoxel(static_cast<float>(c) * scale, static_cast<float>(r) * scale, static_cast<float>(d) * scale, value);
+        };
+
+        brickedVolume = BrickedVolume::create(volumeSize, brickSize, atlasSlots, generator, operationThreads);
+        brickedVolume->bricksPerFrame = bricksPerFrame;
+        brickedVolume->computeBrickInfo();
+    }
+
     vsg::ref_ptr<vsg::Data> textureData;
-    if (auto texturePath = arguments.value<vsg::Path>("", "-i"))
+    if (brickedVolume)
+    {
+        textureData = brickedVolume->atlas;
+    }
+    else if (auto texturePath = arguments.value<vsg::Path>("", "-i"))
     {
         textureData = vsg::read_cast<vsg::Data>(texturePath, options);
         std::cout << "Reading " << textureData << " from " << texturePath << std::endl;
@@ -230,11 +404,11 @@ int main(int argc, char** argv)
     if (!textureData)
     {
         // read texture image
-        auto data = vsg::floatArray3D::create(100, 100, 100);
+        auto data = vsg::floatArray3D::create(denseSize, denseSize, denseSize);
         data->properties.format = VK_FORMAT_R32_SFLOAT;
         data->properties.dataVariance = vsg::DYNAMIC_DATA;
 
-        updateBaseTexture3D(*data, 1.0f);
+        updateBaseTexture3D(*data, 1.0f, operationThreads);
         if (!data)
         {
             std::cout << "Could not create texture" << std::endl;
@@ -249,6 +423,13 @@ int main(int argc, char** argv)
         {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr} // { binding, descriptorType, descriptorCount, stageFlags, pImmutableSamplers}
     };
 
+    if (brickedVolume)
+    {
+        descriptorBindings.push_back(VkDescriptorSetLayoutBinding{1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr}); // page table
+        descriptorBindings.push_back(VkDescriptorSetLayoutBinding{2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr}); // brick info
+        descriptorBindings.push_back(VkDescriptorSetLayoutBinding{3, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr});         // settings
+    }
+
     auto descriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings);
 
     vsg::PushConstantRanges pushConstantRanges{
@@ -285,7 +466,27 @@ int main(int argc, char** argv)
 
     auto texture = vsg::DescriptorImage::create(clampToEdge_sampler, textureData, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
 
-    auto descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, vsg::Descriptors{texture});
+    vsg::Descriptors descriptors{texture};
+    if (brickedVolume)
+    {
+        // the page table is an integer format so has to be read with nearest filtering
+        auto nearest_sampler = vsg::Sampler::create();
+        nearest_sampler->magFilter = VK_FILTER_NEAREST;
+        nearest_sampler->minFilter = VK_FILTER_NEAREST;
+        nearest_sampler->mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        nearest_sampler->addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        nearest_sampler->addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        nearest_sampler->addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        nearest_sampler->anisotropyEnable = VK_FALSE;
+
+        clampToEdge_sampler->addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+        descriptors.push_back(vsg::DescriptorImage::create(nearest_sampler, brickedVolume->pageTable, 1, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER));
+        descriptors.push_back(vsg::DescriptorImage::create(clampToEdge_sampler, brickedVolume->brickInfo, 2, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER));
+        descriptors.push_back(vsg::DescriptorBuffer::create(brickedVolume->settings, 3, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER));
+    }
+
+    auto descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, descriptors);
     auto bindDescriptorSet = vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline->layout, 0, descriptorSet);
 
     // create StateGroup as the root of the scene/command graph to hold the GraphicsPipeline, and binding of Descriptors to decorate the whole graph
@@ -323,6 +524,9 @@ int main(int argc, char** argv)
     auto commandGraph = vsg::createCommandGraphForView(window, camera, scenegraph);
     viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
+    // copy just the atlas slots paged in each frame, ahead of the RenderGraph that samples the atlas
+    if (brickedVolume) commandGraph->children.insert(commandGraph->children.begin(), brickedVolume->createAtlasUpload(texture->imageInfoList.front(), static_cast<uint32_t>(window->numFrames()) + 1));
+
     // compile the Vulkan objects
     viewer->compile();
 
@@ -330,17 +534,40 @@ int main(int argc, char** argv)
     viewer->addEventHandler(vsg::CloseHandler::create(viewer));
     viewer->addEventHandler(vsg::Trackball::create(camera));
 
+    auto startTime = vsg::clock::now();
+    double numFramesCompleted = 0.0;
+
     // main frame loop
-    while (viewer->advanceToNextFrame())
+    while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
     {
         // pass any events into EventHandlers assigned to the Viewer
         viewer->handleEvents();
 
         viewer->update();
 
+        // the volume's unit cube is untransformed, so the eye and view are already in texture coordinates
+        if (brickedVolume) brickedVolume->update(lookAt->eye, perspective->transform() * lookAt->transform());
+
         viewer->recordAndSubmit();
 
         viewer->present();
+
+        numFramesCompleted += 1.0;
+    }
+
+    auto duration = std::chrono::duration<double, std::chrono::seconds::period>(vsg::clock::now() - startTime).count();
+    if (numFramesCompleted > 0.0)
+    {
+        std::cout << "Average frame rate = " << (numFramesCompleted / duration) << std::endl;
+    }
+
+    if (brickedVolume)
+    {
+        brickedVolume->report(std::cout);
+    }
+    else
+    {
+        std::cout << "Volume texture memory = " << (static_cast<double>(textureData->dataSize()) / (1024.0 * 1024.0)) << "MB" << std::endl;
     }
 
     // clean up done automatically thanks to ref_ptr<>
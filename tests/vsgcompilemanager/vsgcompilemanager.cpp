@@ -1,8 +1,11 @@
 #include <cassert>
+#include <iostream>
 #include <string>
 
 #include "vsg/all.h"
 
+#include "PipelineCache.h"
+
 std::string VERT{R"(
 #version 450
 layout(push_constant) uniform PushConstants { mat4 projection; mat4 modelView; };
@@ -108,6 +111,8 @@ vsg::ref_ptr<vsg::StateGroup> createScene1()
 
 int main(int argc, char** argv)
 {
+    auto startTime = vsg::clock::now();
+
     auto windowTraits = vsg::WindowTraits::create();
     windowTraits->windowTitle = "vsgcompilemanager";
     auto requestFeatures = windowTraits->deviceFeatures = vsg::DeviceFeatures::create();
@@ -117,8 +122,15 @@ int main(int argc, char** argv)
     vsg::CommandLine arguments(&argc, argv);
     windowTraits->debugLayer = arguments.read({"--debug", "-d"});
     windowTraits->apiDumpLayer = arguments.read({"--api", "-a"});
+    auto numFrames = arguments.value(-1, "-f");
+    auto pipelineCacheFilename = arguments.value<vsg::Path>("", "--pipeline-cache");
 
     auto window = vsg::Window::create(windowTraits);
+
+    // the pipeline cache is shared by the viewer's compile and the CompileManager's compiles of the replacement scenes
+    vsg::ref_ptr<PipelineCache> pipelineCache;
+    if (pipelineCacheFilename) pipelineCache = PipelineCache::create(window->getOrCreateDevice(), pipelineCacheFilename);
+
     auto lookAt = vsg::LookAt::create(
         vsg::dvec3{2, -5, -1},
         vsg::dvec3{0, 0, 0},
@@ -134,6 +146,7 @@ int main(int argc, char** argv)
 
     auto sceneGraph = vsg::Group::create();
     auto stateGroup = createScene0();
+    if (pipelineCache) stateGroup->accept(*UsePipelineCache::create(pipelineCache));
     sceneGraph->addChild(stateGroup);
 
     auto commandGraph = vsg::createCommandGraphForView(window, camera, sceneGraph);
@@ -142,7 +155,7 @@ int main(int argc, char** argv)
 
     int sceneNumber{0};
     int frameCount{0};
-    while (viewer->advanceToNextFrame())
+    while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
     {
         if ((++frameCount % 60) == 0)
         {
@@ -159,6 +172,7 @@ int main(int argc, char** argv)
                 stateGroup = createScene0();
             }
 
+            if (pipelineCache) stateGroup->accept(*UsePipelineCache::create(pipelineCache));
             sceneGraph->addChild(stateGroup);
             auto result = viewer->compileManager->compile(sceneGraph);
             assert(result.result == VK_SUCCESS);
@@ -169,5 +183,16 @@ int main(int argc, char** argv)
         viewer->update();
         viewer->recordAndSubmit();
         viewer->present();
+
+        if (frameCount == 1)
+        {
+            std::cout << "Time to first frame = " << std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count() << "ms" << pipelineCacheState(pipelineCache) << std::endl;
+        }
+    }
+
+    if (pipelineCache)
+    {
+        pipelineCache->save();
+        pipelineCache->report(std::cout);
     }
 }
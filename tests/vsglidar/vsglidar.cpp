@@ -0,0 +1,227 @@
+#include <vsg/all.h>
+
+#ifdef vsgXchange_FOUND
+#    include <vsgXchange/all.h>
+#endif
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "BVHLineSegmentIntersector.h"
+#include "BatchRayCaster.h"
+
+// create a city block like scene of buildings and trees on a ground plane so the benchmark can run without any models.
+vsg::ref_ptr<vsg::Node> createTestScene(vsg::ref_ptr<vsg::Builder> builder, uint32_t gridSize, float spacing)
+{
+    auto scene = vsg::Group::create();
+
+    vsg::GeometryInfo geomInfo;
+    vsg::StateInfo stateInfo;
+
+    float extent = spacing * static_cast<float>(gridSize);
+    geomInfo.position.set(0.0f, 0.0f, 0.0f);
+    geomInfo.dx.set(extent * 2.0f, 0.0f, 0.0f);
+    geomInfo.dy.set(0.0f, extent * 2.0f, 0.0f);
+    geomInfo.dz.set(0.0f, 0.0f, 1.0f);
+    scene->addChild(builder->createQuad(geomInfo, stateInfo));
+
+    float origin = -0.5f * spacing * static_cast<float>(gridSize - 1);
+    for (uint32_t r = 0; r < gridSize; ++r)
+    {
+        for (uint32_t c = 0; c < gridSize; ++c)
+        {
+            float x = origin + spacing * static_cast<float>(c);
+            float y = origin + spacing * static_cast<float>(r);
+            float height = spacing * (0.5f + 0.25f * static_cast<float>((r * 7 + c * 13) % 5));
+
+            // leave the centre clear for the sensor
+            if (std::abs(x) < spacing && std::abs(y) < spacing) continue;
+
+            if ((r + c) % 3 == 0)
+            {
+                // tree, trunk and canopy
+                geomInfo.position.set(x, y, spacing * 0.2f);
+                geomInfo.dx.set(spacing * 0.1f, 0.0f, 0.0f);
+                geomInfo.dy.set(0.0f, spacing * 0.1f, 0.0f);
+                geomInfo.dz.set(0.0f, 0.0f, spacing * 0.4f);
+                scene->addChild(builder->createCylinder(geomInfo, stateInfo));
+
+                geomInfo.position.set(x, y, spacing * 0.55f);
+                geomInfo.dx.set(spacing * 0.4f, 0.0f, 0.0f);
+                geomInfo.dy.set(0.0f, spacing * 0.4f, 0.0f);
+                geomInfo.dz.set(0.0f, 0.0f, spacing * 0.4f);
+                scene->addChild(builder->createSphere(geomInfo, stateInfo));
+            }
+            else
+            {
+                // building
+                geomInfo.position.set(x, y, height * 0.5f);
+                geomInfo.dx.set(spacing * 0.6f, 0.0f, 0.0f);
+                geomInfo.dy.set(0.0f, spacing * 0.6f, 0.0f);
+                geomInfo.dz.set(0.0f, 0.0f, height);
+                scene->addChild(builder->createBox(geomInfo, stateInfo));
+            }
+        }
+    }
+
+    return scene;
+}
+
+double nearestRatio(const vsg::LineSegmentIntersector::Intersections& intersections)
+{
+    double ratio = -1.0;
+    for (auto& intersection : intersections)
+    {
+        if (ratio < 0.0 || intersection->ratio < ratio) ratio = intersection->ratio;
+    }
+    return ratio;
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        // set up defaults and read command line arguments to override them
+        vsg::CommandLine arguments(&argc, argv);
+
+        auto options = vsg::Options::create();
+        options->paths = vsg::getEnvPaths("VSG_FILE_PATH");
+
+#ifdef vsgXchange_FOUND
+        // add vsgXchange's support for reading and writing 3rd party file formats
+        options->add(vsgXchange::all::create());
+#endif
+
+        auto numBeams = arguments.value<uint32_t>(64, "--beams");
+        auto numColumns = arguments.value<uint32_t>(1024, "--columns");
+        auto minElevation = arguments.value(-24.8, "--min-elevation");
+        auto maxElevation = arguments.value(2.0, "--max-elevation");
+        auto range = arguments.value(120.0, "--range");
+        auto numSweeps = arguments.value<uint32_t>(10, "--sweeps");
+        auto numThreads = arguments.value<uint32_t>(std::thread::hardware_concurrency(), "--threads");
+        auto numReferenceRays = arguments.value<uint32_t>(1024, "--reference");
+        auto gridSize = arguments.value<uint32_t>(24, "--grid");
+        auto spacing = arguments.value<float>(10.0f, "--spacing");
+        vsg::dvec3 sensorPosition(0.0, 0.0, 2.0);
+        bool positionSet = arguments.read("--position", sensorPosition);
+
+        if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
+
+        vsg::ref_ptr<vsg::Node> scene;
+        if (argc > 1)
+        {
+            scene = vsg::read_cast<vsg::Node>(arguments[1], options);
+            if (!scene)
+            {
+                std::cout << "Unable to load " << arguments[1] << std::endl;
+                return 1;
+            }
+
+            // default to a sensor at the centre of the model
+            if (!positionSet)
+            {
+                auto bounds = vsg::visit<vsg::ComputeBounds>(scene).bounds;
+                sensorPosition = (bounds.min + bounds.max) * 0.5;
+            }
+        }
+        else
+        {
+            auto builder = vsg::Builder::create();
+            builder->options = options;
+            scene = createTestScene(builder, gridSize, spacing);
+        }
+
+        auto operationThreads = numThreads > 1 ? vsg::OperationThreads::create(numThreads - 1) : vsg::ref_ptr<vsg::OperationThreads>();
+
+        auto rayCaster = BatchRayCaster::create(scene, operationThreads);
+        rayCaster->update();
+
+        std::cout << "meshes = " << rayCaster->meshes.size() << ", triangles = " << rayCaster->numTriangles << ", update with BVH build = " << rayCaster->updateTime << "ms" << std::endl;
+
+        auto rays = BatchRayCaster::createLidarSweep(sensorPosition, vsg::dvec3(1.0, 0.0, 0.0), vsg::dvec3(0.0, 0.0, 1.0), numBeams, numColumns, minElevation, maxElevation, range);
+
+        // batched sweeps
+        std::vector<BatchRayCaster::Hit> hits;
+        double totalTime = 0.0;
+        double bestTime = std::numeric_limits<double>::max();
+        for (uint32_t s = 0; s < numSweeps; ++s)
+        {
+            auto start = vsg::clock::now();
+            hits = rayCaster->intersect(rays);
+            auto time = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - start).count();
+            totalTime += time;
+            bestTime = std::min(bestTime, time);
+        }
+
+        size_t numHits = 0;
+        for (auto& hit : hits)
+        {
+            if (hit.valid()) ++numHits;
+        }
+
+        double averageTime = totalTime / static_cast<double>(std::max(1u, numSweeps));
+        std::cout << "sweep " << numBeams << " x " << numColumns << " = " << rays.size() << " rays, " << numHits << " hits, threads = " << numThreads << ", packet size = " << BatchRayCaster::packetSize << std::endl;
+        std::cout << "    batched: average " << averageTime << "ms, best " << bestTime << "ms, " << static_cast<double>(rays.size()) / (averageTime * 1e-3) << " rays/second" << std::endl;
+
+        // one ray at a time with the standard and BVH accelerated intersectors for a subset of the sweep, checking the batched results against them
+        size_t numReference = std::min<size_t>(numReferenceRays, rays.size());
+        if (numReference > 0)
+        {
+            double standardTime = 0.0;
+            double bvhTime = 0.0;
+            size_t numMismatched = 0;
+            size_t numAcceleratedMismatched = 0;
+
+            for (size_t i = 0; i < numReference; ++i)
+            {
+                auto& ray = rays[i];
+
+                auto before_standard = vsg::clock::now();
+                auto standard = vsg::LineSegmentIntersector::create(ray.start, ray.end);
+                scene->accept(*standard);
+                auto before_bvh = vsg::clock::now();
+                auto accelerated = BVHLineSegmentIntersector::create(ray.start, ray.end);
+                scene->accept(*accelerated);
+                auto after_bvh = vsg::clock::now();
+
+                standardTime += std::chrono::duration<double, std::chrono::milliseconds::period>(before_bvh - before_standard).count();
+                bvhTime += std::chrono::duration<double, std::chrono::milliseconds::period>(after_bvh - before_bvh).count();
+
+                double expected = nearestRatio(standard->intersections);
+                if ((expected < 0.0) != !hits[i].valid() || (expected >= 0.0 && std::abs(expected - hits[i].ratio) * range > 1e-2)) ++numMismatched;
+
+                double acceleratedRatio = nearestRatio(accelerated->intersections);
+                if ((expected < 0.0) != (acceleratedRatio < 0.0) || (expected >= 0.0 && std::abs(expected - acceleratedRatio) * range > 1e-2)) ++numAcceleratedMismatched;
+            }
+
+            double scale = static_cast<double>(rays.size()) / static_cast<double>(numReference);
+            std::cout << "    vsg::LineSegmentIntersector per ray: " << standardTime << "ms for " << numReference << " rays, estimated sweep " << standardTime * scale << "ms" << std::endl;
+            std::cout << "    BVHLineSegmentIntersector per ray: " << bvhTime << "ms for " << numReference << " rays, estimated sweep " << bvhTime * scale << "ms" << std::endl;
+
+            // both intersectors test in double precision, so the BVH must find the same nearest hit for every ray
+            if (numAcceleratedMismatched > 0)
+            {
+                std::cout << "FAILED: " << numAcceleratedMismatched << " of " << numReference << " BVHLineSegmentIntersector hits differ from vsg::LineSegmentIntersector." << std::endl;
+                return 1;
+            }
+
+            // allow for the odd ray grazing a silhouette edge, where the batched single precision test can differ from the double precision one
+            if (numMismatched > numReference / 1000)
+            {
+                std::cout << "FAILED: " << numMismatched << " of " << numReference << " batched hits differ from vsg::LineSegmentIntersector." << std::endl;
+                return 1;
+            }
+        }
+
+        std::cout << "Passed." << std::endl;
+    }
+    catch (const vsg::Exception& ve)
+    {
+        for (int i = 0; i < argc; ++i) std::cerr << argv[i] << " ";
+        std::cerr << "\n[Exception] - " << ve.message << " result = " << ve.result << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
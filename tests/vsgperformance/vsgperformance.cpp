@@ -9,6 +9,9 @@
 #include <iostream>
 #include <thread>
 
+#include "ChromeTraceExporter.h"
+#include "ResidencyBudget.h"
+
 vsg::ref_ptr<vsg::Node> createTextureQuad(vsg::ref_ptr<vsg::Data> sourceData, vsg::ref_ptr<vsg::Options> options)
 {
     auto builder = vsg::Builder::create();
@@ -193,6 +196,7 @@ int main(int argc, char** argv)
         auto pathFilename = arguments.value<vsg::Path>("", "-p");
         auto loadLevels = arguments.value(0, "--load-levels");
         auto maxPagedLOD = arguments.value(0, "--maxPagedLOD");
+        auto residencyBudgetMB = arguments.value<uint64_t>(0, "--budget");
         auto horizonMountainHeight = arguments.value(0.0, "--hmh");
         auto nearFarRatio = arguments.value<double>(0.001, "--nfr");
         if (arguments.read("--rgb")) options->mapRGBtoRGBAHint = false;
@@ -235,6 +239,7 @@ int main(int argc, char** argv)
 
         if (int log_level = 0; arguments.read("--log-level", log_level)) vsg::Logger::instance()->level = vsg::Logger::Level(log_level);
         auto logFilename = arguments.value<vsg::Path>("", "--log");
+        auto traceFilename = arguments.value<vsg::Path>("", "--trace");
 
         vsg::ref_ptr<vsg::Instrumentation> instrumentation;
         if (arguments.read({"--gpu-annotation", "--ga"}) && vsg::isExtensionSupported(VK_EXT_DEBUG_UTILS_EXTENSION_NAME))
@@ -275,6 +280,12 @@ int main(int argc, char** argv)
 
         if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
+        if (residencyBudgetMB > 0 && maxPagedLOD > 0)
+        {
+            std::cout << "--budget sets targetMaxNumPagedLODWithHighResSubgraphs each frame, so can't be combined with --maxPagedLOD." << std::endl;
+            return 1;
+        }
+
         if (argc <= 1)
         {
             std::cout << "Please specify a 3d model or image file on the command line." << std::endl;
@@ -500,6 +511,8 @@ int main(int argc, char** argv)
             }
         }
 
+        auto residencyBudget = ResidencyBudget::install(*viewer, vsg_scene, residencyBudgetMB * 1024 * 1024);
+
         if (autoPlay)
         {
             // find any animation groups in the loaded scene graph and play the first animation in each of the animation groups.
@@ -510,6 +523,13 @@ int main(int argc, char** argv)
             }
         }
 
+        // stream the profile log to a Chrome trace event file so long runs aren't limited by --log-size
+        vsg::ref_ptr<ChromeTraceExporter> traceExporter;
+        if (auto profiler = instrumentation.cast<vsg::Profiler>(); profiler && traceFilename)
+        {
+            traceExporter = ChromeTraceExporter::create(profiler, traceFilename);
+        }
+
         if (initialFrameCycleCount > 0)
         {
             // run an initial set of frames to get past the intiial frame time variability so we get stable frame rate stats
@@ -518,8 +538,10 @@ int main(int argc, char** argv)
                 viewer->getFrameStamp()->simulationTime = 0.0;
                 viewer->handleEvents();
                 viewer->update();
+                if (residencyBudget) residencyBudget->update(viewer->getFrameStamp());
                 viewer->recordAndSubmit();
                 viewer->present();
+                if (traceExporter) traceExporter->update();
             }
         }
 
@@ -539,8 +561,10 @@ int main(int argc, char** argv)
 
                 viewer->handleEvents();
                 viewer->update();
+                if (residencyBudget) residencyBudget->update(viewer->getFrameStamp());
                 viewer->recordAndSubmit();
                 viewer->present();
+                if (traceExporter) traceExporter->update();
 
                 ++frameCount;
             }
@@ -558,6 +582,8 @@ int main(int argc, char** argv)
             std::cout << "Insufficient runtime, no frame stats collected." << std::endl;
         }
 
+        if (residencyBudget) residencyBudget->report(std::cout);
+
         if (reportMemoryStats)
         {
             if (options->sharedObjects)
@@ -580,6 +606,12 @@ int main(int argc, char** argv)
                 profiler->log->report(std::cout);
             }
         }
+
+        if (traceExporter)
+        {
+            traceExporter->finish();
+            std::cout << "Trace written to " << traceFilename << ", events = " << traceExporter->numEvents << ", frames = " << traceExporter->numFrames << ", lost entries = " << traceExporter->numLost << ", dropped GPU scopes = " << traceExporter->numDroppedGpuScopes << std::endl;
+        }
     }
     catch (const vsg::Exception& ve)
     {
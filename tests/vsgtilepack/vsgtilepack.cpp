@@ -0,0 +1,227 @@
+#include <vsg/all.h>
+
+#ifdef vsgXchange_FOUND
+#    include <vsgXchange/all.h>
+#endif
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include "TilePack.h"
+
+// write a small pyramid of synthetic .vsgb tiles laid out as {z}/{x}/{y}.vsgb so the test can run without any downloaded imagery.
+size_t createSyntheticTiles(const vsg::Path& directory, uint32_t numLevels, uint32_t tileSize)
+{
+    size_t numTiles = 0;
+    for (uint32_t z = 0; z < numLevels; ++z)
+    {
+        uint32_t numTilesAcross = 1 << z;
+        for (uint32_t x = 0; x < numTilesAcross; ++x)
+        {
+            vsg::Path tileDirectory = directory / vsg::make_string(z) / vsg::make_string(x);
+            vsg::makeDirectory(tileDirectory);
+
+            for (uint32_t y = 0; y < numTilesAcross; ++y)
+            {
+                auto image = vsg::ubvec4Array2D::create(tileSize, tileSize, vsg::Data::Properties{VK_FORMAT_R8G8B8A8_UNORM});
+                for (uint32_t r = 0; r < tileSize; ++r)
+                {
+                    for (uint32_t c = 0; c < tileSize; ++c)
+                    {
+                        image->set(c, r, vsg::ubvec4(static_cast<uint8_t>(x * 16 + c), static_cast<uint8_t>(y * 16 + r), static_cast<uint8_t>(z * 32), 255));
+                    }
+                }
+
+                vsg::write(image, tileDirectory / vsg::make_string(y, ".vsgb"));
+                ++numTiles;
+            }
+        }
+    }
+    return numTiles;
+}
+
+bool sameData(const vsg::Data* lhs, const vsg::Data* rhs)
+{
+    if (!lhs || !rhs) return false;
+    if (lhs->dataSize() != rhs->dataSize() || lhs->width() != rhs->width() || lhs->height() != rhs->height()) return false;
+    return std::memcmp(lhs->dataPointer(), rhs->dataPointer(), lhs->dataSize()) == 0;
+}
+
+int main(int argc, char** argv)
+{
+    // set up defaults and read command line arguments to override them
+    vsg::CommandLine arguments(&argc, argv);
+
+    auto options = vsg::Options::create();
+    options->paths = vsg::getEnvPaths("VSG_FILE_PATH");
+
+#ifdef vsgXchange_FOUND
+    // add vsgXchange's support for reading .png/.jpeg etc. tiles
+    options->add(vsgXchange::all::create());
+#endif
+
+    auto packFilename = arguments.value<vsg::Path>("tilepack_test/tiles.vsgpack", "-o");
+    auto numLevels = arguments.value<uint32_t>(5, "--levels");
+    auto tileSize = arguments.value<uint32_t>(64, "--tile-size");
+    auto extension = arguments.value<std::string>("", "--ext");
+
+    if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
+
+    // source directory laid out as {z}/{x}/{y}.ext, if none is given generate one
+    vsg::Path sourceDirectory;
+    if (argc > 1)
+    {
+        sourceDirectory = arguments[1];
+    }
+    else
+    {
+        sourceDirectory = vsg::filePath(packFilename) / "source";
+        auto numCreated = createSyntheticTiles(sourceDirectory, numLevels, tileSize);
+        std::cout << "Created " << numCreated << " synthetic tiles in " << sourceDirectory << std::endl;
+    }
+
+    // start from an empty pack
+    std::error_code ec;
+    for (auto& filename : {packFilename, vsg::Path(packFilename.string() + ".index")})
+    {
+        std::filesystem::remove(std::filesystem::path(filename.native()), ec);
+    }
+
+    struct SourceTile
+    {
+        TileKey key;
+        vsg::Path filename;
+    };
+    std::vector<SourceTile> sourceTiles;
+
+    auto sourceRoot = std::filesystem::path(sourceDirectory.native());
+    for (auto& entry : std::filesystem::recursive_directory_iterator(sourceRoot, ec))
+    {
+        if (!entry.is_regular_file()) continue;
+        if (!extension.empty() && entry.path().extension().string() != extension) continue;
+
+        // expect z/x/y.ext relative to the source directory
+        auto relative = std::filesystem::relative(entry.path(), sourceRoot);
+        std::vector<std::string> parts;
+        for (auto& part : relative) parts.push_back(part.string());
+        if (parts.size() != 3) continue;
+
+        try
+        {
+            TileKey key;
+            key.level = static_cast<uint32_t>(std::stoul(parts[0]));
+            key.x = static_cast<uint32_t>(std::stoul(parts[1]));
+            key.y = static_cast<uint32_t>(std::stoul(entry.path().stem().string()));
+            sourceTiles.push_back(SourceTile{key, vsg::Path(entry.path().string())});
+        }
+        catch (const std::exception&)
+        {
+            // not a tile, skip
+        }
+    }
+
+    if (sourceTiles.empty())
+    {
+        std::cout << "No tiles found in " << sourceDirectory << std::endl;
+        return 1;
+    }
+
+    int result = 0;
+
+    // fill the pack
+    uint64_t totalBytes = 0;
+    {
+        auto tilePack = TilePack::create(packFilename, std::numeric_limits<uint64_t>::max());
+        if (!tilePack->valid()) return 1;
+
+        auto start = vsg::clock::now();
+        for (auto& sourceTile : sourceTiles)
+        {
+            auto data = vsg::read_cast<vsg::Data>(sourceTile.filename, options);
+            if (!data || !tilePack->write(sourceTile.key, data))
+            {
+                std::cout << "Failed to add " << sourceTile.filename << std::endl;
+                result = 1;
+            }
+        }
+        tilePack->flush();
+
+        auto time = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - start).count();
+        auto stats = tilePack->getStats();
+        totalBytes = stats.liveBytes;
+        std::cout << "Filled pack with " << stats.numTiles << " tiles, " << stats.fileSize << " bytes in " << time << "ms" << std::endl;
+    }
+
+    // reopen using the index written by flush() and read everything back, comparing against the source tiles
+    auto indexPath = std::filesystem::path(packFilename.native()).concat(".index");
+    auto indexWriteTime = std::filesystem::last_write_time(indexPath, ec);
+    {
+        auto start = vsg::clock::now();
+        auto tilePack = TilePack::create(packFilename, std::numeric_limits<uint64_t>::max());
+        auto openTime = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - start).count();
+
+        double packReadTime = 0.0;
+        double fileReadTime = 0.0;
+        size_t numMismatched = 0;
+        for (auto& sourceTile : sourceTiles)
+        {
+            auto before_pack = vsg::clock::now();
+            auto packed = tilePack->read(sourceTile.key);
+            auto before_file = vsg::clock::now();
+            auto original = vsg::read_cast<vsg::Data>(sourceTile.filename, options);
+            auto after_file = vsg::clock::now();
+
+            packReadTime += std::chrono::duration<double, std::chrono::milliseconds::period>(before_file - before_pack).count();
+            fileReadTime += std::chrono::duration<double, std::chrono::milliseconds::period>(after_file - before_file).count();
+
+            if (!sameData(packed.get(), original.get())) ++numMismatched;
+        }
+
+        std::cout << "Reopened pack in " << openTime << "ms, read " << sourceTiles.size() << " tiles in " << packReadTime << "ms vs " << fileReadTime << "ms from individual files" << std::endl;
+
+        if (numMismatched > 0)
+        {
+            std::cout << "FAILED: " << numMismatched << " tiles differ from their source." << std::endl;
+            result = 1;
+        }
+    }
+
+    // reads only change the access order held in memory, so closing the pack mustn't have rewritten the index
+    if (std::filesystem::last_write_time(indexPath, ec) != indexWriteTime)
+    {
+        std::cout << "FAILED: index rewritten after only reading tiles." << std::endl;
+        result = 1;
+    }
+
+    // reopen with half the budget, the least recently written half should be evicted while the most recently written survive
+    {
+        auto tilePack = TilePack::create(packFilename, totalBytes / 2);
+        auto stats = tilePack->getStats();
+
+        std::cout << "Reopened with budget of " << totalBytes / 2 << " bytes, " << stats.numTiles << " tiles kept, " << stats.evictions << " evicted" << std::endl;
+
+        if (stats.liveBytes > totalBytes / 2 || stats.evictions == 0 || !tilePack->contains(sourceTiles.back().key))
+        {
+            std::cout << "FAILED: LRU eviction did not honour the size budget." << std::endl;
+            result = 1;
+        }
+
+        if (!tilePack->compact() || tilePack->getStats().fileSize != tilePack->getStats().liveBytes)
+        {
+            std::cout << "FAILED: compaction left evicted records in the data file." << std::endl;
+            result = 1;
+        }
+
+        if (!sameData(tilePack->read(sourceTiles.back().key).get(), vsg::read_cast<vsg::Data>(sourceTiles.back().filename, options).get()))
+        {
+            std::cout << "FAILED: tile differs after compaction." << std::endl;
+            result = 1;
+        }
+    }
+
+    if (result == 0) std::cout << "Passed." << std::endl;
+
+    return result;
+}